@@ -0,0 +1,96 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+#include "Main.h"
+#include "Application.h"
+#include "GameObject.h"
+#include "Resource.h"
+#include "graphics/Camera.h"
+#include "graphics/Light.h"
+#include "graphics/LightCluster.h"
+#include "graphics/Material.h"
+#include "renderer/MeshRenderer.h"
+#include "math/Mathf.h"
+#include "time/Time.h"
+
+using namespace Viry3D;
+
+class AppLights: public Application
+{
+public:
+	AppLights()
+	{
+		this->SetName("Viry3D::AppLights");
+		this->SetInitSize(1280, 720);
+	}
+
+	virtual void Start()
+	{
+		// binning cost printed once, compare single thread and worker threads on device
+		LightCluster::Benchmark(1000, 100);
+
+		auto camera = GameObject::Create("camera")->AddComponent<Camera>();
+		camera->GetTransform()->SetPosition(Vector3(0, 20, -40));
+		camera->GetTransform()->SetRotation(Quaternion::Euler(30, 0, 0));
+		camera->SetClipFar(200);
+
+		auto plane_mesh = Resource::LoadMesh("Assets/Library/unity default resources.Plane.mesh");
+
+		auto plane_mat = Material::Create("Clustered/Diffuse");
+
+		auto plane = GameObject::Create("plane")->AddComponent<MeshRenderer>();
+		plane->GetTransform()->SetLocalScale(Vector3(8, 1, 8));
+		plane->SetSharedMaterial(plane_mat);
+		plane->SetSharedMesh(plane_mesh);
+
+		auto light = GameObject::Create("light")->AddComponent<Light>();
+		light->GetTransform()->SetRotation(Quaternion::Euler(60, -30, 0));
+		light->intensity = 0.1f;
+		Light::main = light;
+
+		for (int i = 0; i < LIGHT_COUNT; i++)
+		{
+			auto point = GameObject::Create("point")->AddComponent<Light>();
+			point->type = LightType::Point;
+			point->color = Color(Mathf::RandomRange(0.2f, 1.0f), Mathf::RandomRange(0.2f, 1.0f), Mathf::RandomRange(0.2f, 1.0f), 1);
+			point->range = Mathf::RandomRange(2.0f, 6.0f);
+
+			m_lights.Add(point);
+			m_orbits.Add(Vector3(Mathf::RandomRange(2.0f, 38.0f), Mathf::RandomRange(0.0f, 360.0f), Mathf::RandomRange(-30.0f, 30.0f)));
+		}
+	}
+
+	virtual void Update()
+	{
+		float time = Time::GetTime();
+
+		for (int i = 0; i < m_lights.Size(); i++)
+		{
+			const auto& orbit = m_orbits[i];
+			auto rotation = Quaternion::Euler(0, orbit.y + orbit.z * time, 0);
+			m_lights[i]->GetTransform()->SetPosition(rotation * Vector3(orbit.x, 1, 0));
+		}
+	}
+
+	static const int LIGHT_COUNT = 256;
+	Vector<Ref<Light>> m_lights;
+	// x radius, y start angle, z degrees per second
+	Vector<Vector3> m_orbits;
+};
+
+#if 0
+VR_MAIN(AppLights);
+#endif
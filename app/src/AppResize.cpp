@@ -0,0 +1,137 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "Main.h"
+#include "Application.h"
+#include "GameObject.h"
+#include "Debug.h"
+#include "graphics/Camera.h"
+#include "graphics/Graphics.h"
+#include "graphics/Mesh.h"
+#include "graphics/Material.h"
+#include "renderer/MeshRenderer.h"
+#include "time/Time.h"
+#include "math/Mathf.h"
+
+using namespace Viry3D;
+
+// resize hitch benchmark, drive repeated OnResize and log resize and next frame time
+class AppResize : public Application
+{
+public:
+	AppResize()
+    {
+        this->SetName("Viry3D::AppResize");
+        this->SetInitSize(1280, 720);
+    }
+    
+	virtual void Start()
+    {
+        auto camera = GameObject::Create("camera")->AddComponent<Camera>();
+        camera->GetTransform()->SetPosition(Vector3(0, 6, -10));
+        camera->GetTransform()->SetRotation(Quaternion::Euler(30, 0, 0));
+        camera->SetCullingMask(1 << 0);
+        
+        auto mesh = Mesh::Create();
+        mesh->vertices.Add(Vector3(-1, 1, -1));
+        mesh->vertices.Add(Vector3(-1, -1, -1));
+        mesh->vertices.Add(Vector3(1, -1, -1));
+        mesh->vertices.Add(Vector3(1, 1, -1));
+        mesh->uv.Add(Vector2(0, 0));
+        mesh->uv.Add(Vector2(0, 1));
+        mesh->uv.Add(Vector2(1, 1));
+        mesh->uv.Add(Vector2(1, 0));
+        unsigned short triangles[] = {
+            0, 1, 2, 0, 2, 3
+        };
+        mesh->triangles.AddRange(triangles, 6);
+        mesh->Apply();
+        
+        // one object per shader, each one owns its pipelines
+        const char* shaders[] = { "Diffuse", "DiffuseCullOff", "Cutout", "Transparent", "Reflect" };
+        for (int i = 0; i < 5; i++)
+        {
+            auto renderer = GameObject::Create("mesh")->AddComponent<MeshRenderer>();
+            renderer->GetTransform()->SetPosition(Vector3(-4.0f + i * 2, 0, 0));
+            renderer->SetSharedMesh(mesh);
+            renderer->SetSharedMaterial(Material::Create(shaders[i]));
+        }
+        
+        m_frame = 0;
+        m_resize_count = 0;
+        m_resize_time = -1;
+        m_resize_total = 0;
+        m_resize_max = 0;
+        m_frame_total = 0;
+        m_frame_max = 0;
+    }
+    
+	virtual void Update()
+    {
+        float now = Time::GetRealTimeSinceStartup();
+        
+        if (m_resize_time >= 0)
+        {
+            // first frame after resize, includes any pipeline rebuild
+            float frame_time = now - m_resize_time;
+            m_frame_total += frame_time;
+            m_frame_max = Mathf::Max(m_frame_max, frame_time);
+            m_resize_time = -1;
+            
+            if (m_resize_count == RESIZE_COUNT)
+            {
+                Log("AppResize %d resizes, resize avg:%.2fms max:%.2fms, next frame avg:%.2fms max:%.2fms",
+                    m_resize_count,
+                    m_resize_total / m_resize_count * 1000, m_resize_max * 1000,
+                    m_frame_total / m_resize_count * 1000, m_frame_max * 1000);
+            }
+        }
+        
+        m_frame++;
+        
+        // skip first frames, pipelines are created at first draw
+        if (m_frame > 30 && m_frame % 10 == 0 && m_resize_count < RESIZE_COUNT)
+        {
+            int width = Graphics::GetDisplay()->GetWidth();
+            int height = Graphics::GetDisplay()->GetHeight();
+            
+            float begin = Time::GetRealTimeSinceStartup();
+            this->OnResize(width, height);
+            float end = Time::GetRealTimeSinceStartup();
+            
+            float resize_time = end - begin;
+            m_resize_total += resize_time;
+            m_resize_max = Mathf::Max(m_resize_max, resize_time);
+            m_resize_count++;
+            m_resize_time = end;
+        }
+    }
+    
+    static const int RESIZE_COUNT = 50;
+    
+    int m_frame;
+    int m_resize_count;
+    float m_resize_time;
+    float m_resize_total;
+    float m_resize_max;
+    float m_frame_total;
+    float m_frame_max;
+};
+
+#if 0
+VR_MAIN(AppResize);
+#endif
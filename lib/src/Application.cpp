@@ -19,7 +19,9 @@
 #include "World.h"
 #include "Input.h"
 #include "time/Time.h"
+#include "time/FramePacer.h"
 #include "graphics/Graphics.h"
+#include "graphics/RenderThread.h"
 #include "renderer/Renderer.h"
 
 #if VR_WINDOWS
@@ -97,9 +99,11 @@ namespace Viry3D
 		m_init_width = 1280;
 		m_init_height = 720;
 		m_init_fps = -1;
+		m_init_render_thread = false;
 		m_pre_runloop = RefMake<RunLoop>();
 		m_post_runloop = RefMake<RunLoop>();
 		m_thread_pool_update = RefMake<ThreadPool>(4);
+		m_frame_pacer = RefMake<FramePacer>();
 	}
 
 	Application::~Application()
@@ -108,6 +112,9 @@ namespace Viry3D
 		m_post_runloop.reset();
 		m_thread_pool_update.reset();
 
+		// last frame may still be rendering objects world is going to destroy
+		Graphics::SetRenderThread(false);
+
 		World::Deinit();
 		Graphics::Deinit();
 
@@ -125,6 +132,11 @@ namespace Viry3D
 		m_init_fps = fps;
 	}
 
+	void Application::SetInitRenderThread(bool enable)
+	{
+		m_init_render_thread = enable;
+	}
+
 	void Application::SetName(const String& name)
 	{
 		m_name = name;
@@ -153,6 +165,7 @@ namespace Viry3D
 	{
 		m_start = true;
 		Graphics::Init(m_init_width, m_init_height, m_init_fps);
+		Graphics::SetRenderThread(m_init_render_thread);
 		World::Init();
 		this->Start();
 	}
@@ -164,23 +177,14 @@ namespace Viry3D
 
 	void Application::EnsureFPS()
 	{
-		auto fps = Graphics::GetDisplay()->GetPreferredFPS();
-		if (fps > 0)
-		{
-			static long long frame_time_start_last = 0;
-			auto frame_time_min = 1000 / fps;
-			auto frame_time_start_this = Time::GetTimeMS();
-			auto frame_time_delta = frame_time_start_this - frame_time_start_last;
-			if (frame_time_delta < frame_time_min)
-			{
-				Thread::Sleep((int) (frame_time_min - frame_time_delta));
-			}
-			frame_time_start_last = Time::GetTimeMS();
-		}
+		m_frame_pacer->SetTargetFPS(Graphics::GetDisplay()->GetPreferredFPS());
+		m_frame_pacer->Wait();
 	}
 
 	void Application::OnUpdate()
 	{
+		m_frame_pacer->BeginFrame();
+
 		Profiler::Reset();
 
 		Profiler::SampleBegin("Application::OnUpdate");
@@ -212,9 +216,26 @@ namespace Viry3D
 	{
 		Profiler::SampleBegin("Application::OnDraw");
 
-		Graphics::Render();
+		auto render_thread = Graphics::GetRenderThread();
+		if (render_thread)
+		{
+			// last frame rendered while this one updated
+			render_thread->Wait();
+			Graphics::PrepareFrame();
+			render_thread->Render([]() {
+				Graphics::RenderFrame();
+			});
+		}
+		else
+		{
+			Graphics::Render();
+		}
 
 		Profiler::SampleEnd();
+
+		// gpu time of a frame some frames before, zero when timestamps are not supported
+		m_frame_pacer->SetGPUTime(Profiler::GetGPUFrameTime() * 1000);
+		m_frame_pacer->EndFrame();
 	}
 
 	void Application::OnResize(int width, int height)
@@ -233,6 +254,7 @@ namespace Viry3D
     {
         Graphics::OnResume();
         World::OnResume();
+        m_frame_pacer->Reset();
         m_paused = false;
     }
 
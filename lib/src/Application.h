@@ -30,6 +30,7 @@ namespace Viry3D
 {
 	class UILabel;
 	struct FrameBuffer;
+	class FramePacer;
 
 	class Application
 	{
@@ -46,6 +47,8 @@ namespace Viry3D
 
 		void SetInitSize(int width, int height);
 		void SetInitFPS(int fps);
+		//	render frames on a render thread while next frame updates
+		void SetInitRenderThread(bool enable);
 		void SetName(const String& name);
 		String GetName();
 
@@ -55,6 +58,8 @@ namespace Viry3D
 		void OnDraw();
 		void AddAsyncUpdateTask(const Thread::Task& task);
 		void EnsureFPS();
+		//	frame times of update and draw, and pacing to preferred fps of display
+		FramePacer* GetFramePacer() const { return m_frame_pacer.get(); }
         bool IsPaused() const { return m_paused; }
 
 		virtual void Start() { }
@@ -77,8 +82,10 @@ namespace Viry3D
 		int m_init_width;
 		int m_init_height;
 		int m_init_fps;
+		bool m_init_render_thread;
 		Ref<RunLoop> m_pre_runloop;
 		Ref<RunLoop> m_post_runloop;
 		Ref<ThreadPool> m_thread_pool_update;
+		Ref<FramePacer> m_frame_pacer;
 	};
 }
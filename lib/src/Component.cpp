@@ -20,6 +20,8 @@
 
 #include "graphics/Camera.h"
 #include "graphics/Light.h"
+#include "graphics/CascadedShadowMap.h"
+#include "graphics/DynamicResolution.h"
 #include "graphics/RenderTextureBliter.h"
 #include "renderer/MeshRenderer.h"
 #include "renderer/SkinnedMeshRenderer.h"
@@ -32,6 +34,10 @@
 #include "ui/UILabel.h"
 #include "postprocess/ImageEffect.h"
 #include "postprocess/ImageEffectBlur.h"
+#include "postprocess/ImageEffectTint.h"
+#include "postprocess/ImageEffectVignette.h"
+#include "postprocess/ImageEffectTonemap.h"
+#include "postprocess/ImageEffectColorGrading.h"
 #include "tweener/TweenPosition.h"
 #include "tweener/TweenUIColor.h"
 #include "time/Timer.h"
@@ -60,12 +66,18 @@ namespace Viry3D
 		UILabel::RegisterComponent();
 		ImageEffect::RegisterComponent();
 		ImageEffectBlur::RegisterComponent();
+		ImageEffectTint::RegisterComponent();
+		ImageEffectVignette::RegisterComponent();
+		ImageEffectTonemap::RegisterComponent();
+		ImageEffectColorGrading::RegisterComponent();
 		TweenPosition::RegisterComponent();
 		TweenUIColor::RegisterComponent();
 		Timer::RegisterComponent();
 		AudioListener::RegisterComponent();
 		AudioSource::RegisterComponent();
 		Light::RegisterComponent();
+		CascadedShadowMap::RegisterComponent();
+		DynamicResolution::RegisterComponent();
 		RenderTextureBliter::RegisterComponent();
 		BoxCollider::RegisterComponent();
 		MeshCollider::RegisterComponent();
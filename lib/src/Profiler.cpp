@@ -17,19 +17,29 @@
 
 #include "Profiler.h"
 #include "time/Time.h"
+#include "graphics/Graphics.h"
+#include "Debug.h"
 
 namespace Viry3D
 {
 	Map<String, ProfilerSample> Profiler::m_samples;
-	List<ProfilerSample*> Profiler::m_current_samples;
+	Mutex Profiler::m_mutex;
+	thread_local List<ProfilerSample*> Profiler::m_current_samples;
+	thread_local List<ProfilerGPUScope> Profiler::m_gpu_open_scopes;
+	Vector<Vector<ProfilerGPUScope>> Profiler::m_gpu_scopes;
+	int Profiler::m_gpu_slot = 0;
+	Map<String, ProfilerSample> Profiler::m_gpu_samples;
+	float Profiler::m_gpu_frame_time = 0;
 
 	void Profiler::Reset()
 	{
+		std::lock_guard<Mutex> lock(m_mutex);
+
+		// samples render thread has begun keep their begin time
 		for (auto& i : m_samples)
 		{
 			i.second.call_count = 0;
 			i.second.time = 0;
-			i.second.time_begin = 0;
 		}
 
 		m_current_samples.Clear();
@@ -37,6 +47,8 @@ namespace Viry3D
 
 	void Profiler::SampleBegin(const String& name)
 	{
+		std::lock_guard<Mutex> lock(m_mutex);
+
 		ProfilerSample* sample;
 
 		if (!m_samples.TryGet(name, &sample))
@@ -60,6 +72,7 @@ namespace Viry3D
 			auto sample = m_current_samples.First();
 			m_current_samples.RemoveFirst();
 
+			std::lock_guard<Mutex> lock(m_mutex);
 			sample->time += Time::GetRealTimeSinceStartup() - sample->time_begin;
 			sample->call_count++;
 		}
@@ -67,6 +80,148 @@ namespace Viry3D
 
 	const ProfilerSample& Profiler::GetSample(const String& name)
 	{
+		std::lock_guard<Mutex> lock(m_mutex);
+
 		return m_samples[name];
 	}
+
+	bool Profiler::IsGPUSampling()
+	{
+		auto display = Graphics::GetDisplay();
+		return display != NULL && display->IsTimestampSupported();
+	}
+
+	void Profiler::GPUSampleBegin(const String& name)
+	{
+		ProfilerGPUScope scope;
+		scope.name = name;
+		scope.begin = -1;
+		scope.end = -1;
+
+		if (IsGPUSampling())
+		{
+			scope.begin = Graphics::GetDisplay()->WriteTimestamp();
+		}
+
+		m_gpu_open_scopes.AddFirst(scope);
+	}
+
+	void Profiler::GPUSampleEnd()
+	{
+		if (m_gpu_open_scopes.Empty())
+		{
+			return;
+		}
+
+		auto scope = m_gpu_open_scopes.First();
+		m_gpu_open_scopes.RemoveFirst();
+
+		if (IsGPUSampling())
+		{
+			int end = Graphics::GetDisplay()->WriteTimestamp();
+			if (end >= 0)
+			{
+				scope.end = end;
+			}
+		}
+
+		// scope without commands recorded in it has no gpu time
+		if (scope.begin >= 0 && scope.end >= 0)
+		{
+			std::lock_guard<Mutex> lock(m_mutex);
+
+			if (m_gpu_slot >= m_gpu_scopes.Size())
+			{
+				m_gpu_scopes.Resize(m_gpu_slot + 1);
+			}
+			m_gpu_scopes[m_gpu_slot].Add(scope);
+		}
+	}
+
+	void Profiler::OnGPUCommandBegin(int timestamp)
+	{
+		for (auto& i : m_gpu_open_scopes)
+		{
+			if (i.begin < 0)
+			{
+				i.begin = timestamp;
+			}
+		}
+	}
+
+	void Profiler::OnGPUCommandEnd(int timestamp)
+	{
+		for (auto& i : m_gpu_open_scopes)
+		{
+			i.end = timestamp;
+		}
+	}
+
+	void Profiler::OnGPUFrameBegin(int slot, const Vector<double>* timestamps)
+	{
+		std::lock_guard<Mutex> lock(m_mutex);
+
+		if (slot >= m_gpu_scopes.Size())
+		{
+			m_gpu_scopes.Resize(slot + 1);
+		}
+
+		if (timestamps != NULL && timestamps->Size() > 0)
+		{
+			m_gpu_samples.Clear();
+
+			for (const auto& i : m_gpu_scopes[slot])
+			{
+				if (i.begin >= timestamps->Size() || i.end >= timestamps->Size())
+				{
+					continue;
+				}
+
+				ProfilerSample* sample;
+				if (!m_gpu_samples.TryGet(i.name, &sample))
+				{
+					m_gpu_samples.Add(i.name, ProfilerSample());
+					sample = &m_gpu_samples[i.name];
+
+					sample->call_count = 0;
+					sample->time = 0;
+					sample->time_begin = (float) ((*timestamps)[i.begin] / 1000.0);
+				}
+
+				sample->time += (float) (((*timestamps)[i.end] - (*timestamps)[i.begin]) / 1000.0);
+				sample->call_count++;
+			}
+
+			double min = (*timestamps)[0];
+			double max = (*timestamps)[0];
+			for (int i = 1; i < timestamps->Size(); i++)
+			{
+				min = (*timestamps)[i] < min ? (*timestamps)[i] : min;
+				max = (*timestamps)[i] > max ? (*timestamps)[i] : max;
+			}
+			m_gpu_frame_time = (float) ((max - min) / 1000.0);
+		}
+
+		m_gpu_scopes[slot].Clear();
+		m_gpu_slot = slot;
+	}
+
+	void Profiler::LogSamples()
+	{
+		std::lock_guard<Mutex> lock(m_mutex);
+
+		String log = "cpu samples:\n";
+		for (const auto& i : m_samples)
+		{
+			log += String::Format("%-48s %8.3fms x%d\n", i.first.CString(), i.second.time * 1000, i.second.call_count);
+		}
+
+		log += String::Format("gpu samples of frame %.3fms:\n", m_gpu_frame_time * 1000);
+		for (const auto& i : m_gpu_samples)
+		{
+			log += String::Format("%-48s %8.3fms x%d\n", i.first.CString(), i.second.time * 1000, i.second.call_count);
+		}
+
+		Log("%s", log.CString());
+	}
 }
@@ -20,6 +20,8 @@
 #include "string/String.h"
 #include "container/Map.h"
 #include "container/List.h"
+#include "container/Vector.h"
+#include "thread/Thread.h"
 
 namespace Viry3D
 {
@@ -30,6 +32,13 @@ namespace Viry3D
 		float time_begin;
 	};
 
+	struct ProfilerGPUScope
+	{
+		String name;
+		int begin;
+		int end;
+	};
+
 	class Profiler
 	{
 	public:
@@ -38,9 +47,33 @@ namespace Viry3D
 		static void SampleEnd();
 		static const Map<String, ProfilerSample>& GetSamples() { return m_samples; }
 		static const ProfilerSample& GetSample(const String& name);
+		//	gpu scopes on thread recording commands, nested like cpu samples,
+		//	no-op when display can not write timestamps
+		static bool IsGPUSampling();
+		static void GPUSampleBegin(const String& name);
+		static void GPUSampleEnd();
+		//	gpu time of last frame gpu finished, some frames behind cpu samples
+		static const Map<String, ProfilerSample>& GetGPUSamples() { return m_gpu_samples; }
+		static float GetGPUFrameTime() { return m_gpu_frame_time; }
+		static void LogSamples();
+		//	display calls when frame slot begins, timestamps in ms of last frame used slot,
+		//	NULL when they could not be read
+		static void OnGPUFrameBegin(int slot, const Vector<double>* timestamps);
+		//	display calls with timestamps at begin and end of every command buffer,
+		//	open scopes take them when they could not write own ones
+		static void OnGPUCommandBegin(int timestamp);
+		static void OnGPUCommandEnd(int timestamp);
 
 	private:
 		static Map<String, ProfilerSample> m_samples;
-		static List<ProfilerSample*> m_current_samples;
+		//	render thread samples while main thread updates
+		static Mutex m_mutex;
+		static thread_local List<ProfilerSample*> m_current_samples;
+		static thread_local List<ProfilerGPUScope> m_gpu_open_scopes;
+		//	closed scopes per frame slot
+		static Vector<Vector<ProfilerGPUScope>> m_gpu_scopes;
+		static int m_gpu_slot;
+		static Map<String, ProfilerSample> m_gpu_samples;
+		static float m_gpu_frame_time;
 	};
 }
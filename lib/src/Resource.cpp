@@ -41,6 +41,10 @@
 #include "animation/AnimationClip.h"
 #include "animation/Animation.h"
 
+#if VR_VULKAN
+#include "vulkan/UploadQueueVulkan.h"
+#endif
+
 namespace Viry3D
 {
 	Ref<ThreadPool> Resource::m_thread_res_load;
@@ -1517,6 +1521,11 @@ namespace Viry3D
 		m_thread_res_load.reset();
 	}
 
+	void Resource::AddAsyncLoadTask(const Thread::Task& task)
+	{
+		m_thread_res_load->AddTask(task);
+	}
+
 	Ref<GameObject> Resource::LoadGameObject(const String& path, bool static_batch, LoadComplete callback)
 	{
 		auto obj = read_gameobject(path, static_batch);
@@ -1605,7 +1614,14 @@ namespace Viry3D
 			auto tex = any->Get<Ref<Texture>>();
 			if (callback)
 			{
+#if VR_VULKAN
+				// loader thread only recorded the upload, report texture once it is resident
+				Graphics::GetDisplay()->GetUploadQueue()->WhenComplete([=]() {
+					callback(tex);
+				});
+#else
 				callback(tex);
+#endif
 			}
 		}
 		}
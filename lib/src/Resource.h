@@ -22,12 +22,11 @@
 #include "graphics/Mesh.h"
 #include "graphics/Texture2D.h"
 #include "ui/Font.h"
+#include "thread/Thread.h"
 #include <functional>
 
 namespace Viry3D
 {
-	class ThreadPool;
-
 	class Resource
 	{
 	public:
@@ -45,6 +44,8 @@ namespace Viry3D
 		static void LoadTextureAsync(const String& path, LoadComplete callback = NULL);
 		static void LoadFontAsync(const String& path, LoadComplete callback = NULL);
 		static void LoadMeshAsync(const String& path, LoadComplete callback = NULL);
+		//	run task on resource load thread which has shared graphics context
+		static void AddAsyncLoadTask(const Thread::Task& task);
 
 	private:
 		static Ref<ThreadPool> m_thread_res_load;
@@ -24,9 +24,13 @@
 #include "graphics/Camera.h"
 #include "graphics/RenderTexture.h"
 #include "graphics/LightmapSettings.h"
+#include "graphics/Image.h"
 #include "renderer/Renderer.h"
+#include "renderer/ParticleSystem.h"
+#include "renderer/ParticleSystemRenderer.h"
 #include "audio/AudioManager.h"
 #include "physics/Physics.h"
+#include "thread/TaskGraph.h"
 #include <stdlib.h>
 
 namespace Viry3D
@@ -34,6 +38,8 @@ namespace Viry3D
 	FastList<Ref<GameObject>> World::m_gameobjects;
 	List<Ref<GameObject>> World::m_gameobjects_start;
 	Mutex World::m_mutex;
+	Ref<TaskGraph> World::m_frame_graph;
+	Vector<WeakRef<ParticleSystem>> World::m_particle_systems;
 
 	void World::AddGameObject(const Ref<GameObject>& obj)
 	{
@@ -54,8 +60,40 @@ namespace Viry3D
 
 	void World::Update()
 	{
-		Physics::Update();
+		m_frame_graph->Clear();
 
+		int physics = m_frame_graph->AddTask("Physics", []() {
+			Physics::Update();
+		});
+
+		// scripts and components may touch anything, they stay on main thread in order
+		int update = m_frame_graph->AddTask("Update", UpdateGameObjects, true);
+		int late_update = m_frame_graph->AddTask("LateUpdate", LateUpdateGameObjects, true);
+		int start = m_frame_graph->AddTask("Start", StartGameObjects, true);
+		int renderers = m_frame_graph->AddTask("Renderers", UpdateRenderers, true);
+		m_frame_graph->AddDependency(update, physics);
+		m_frame_graph->AddDependency(late_update, update);
+		m_frame_graph->AddDependency(start, late_update);
+		m_frame_graph->AddDependency(renderers, start);
+
+		// particles simulate while physics steps, emitters are where last frame left them
+		for (const auto& i : m_particle_systems)
+		{
+			auto particle_system = i.lock();
+			if (particle_system && particle_system->PrepareSimulate())
+			{
+				int simulate = m_frame_graph->AddTask("Particles", [=]() {
+					particle_system->Simulate();
+				});
+				m_frame_graph->AddDependency(update, simulate);
+			}
+		}
+
+		m_frame_graph->Run();
+	}
+
+	void World::UpdateGameObjects()
+	{
         for (auto i = m_gameobjects.begin(); i != m_gameobjects.end(); )
         {
             auto& obj = *i;
@@ -75,7 +113,10 @@ namespace Viry3D
 
             ++i;
         }
+	}
 
+	void World::LateUpdateGameObjects()
+	{
         for (auto i = m_gameobjects.begin(); i != m_gameobjects.end(); )
         {
             auto& obj = *i;
@@ -94,7 +135,10 @@ namespace Viry3D
 
             ++i;
         }
+	}
 
+	void World::StartGameObjects()
+	{
         List<Ref<GameObject>> starts;
         do
         {
@@ -133,7 +177,10 @@ namespace Viry3D
             m_gameobjects_start.Clear();
             m_mutex.unlock();
         } while (starts.Size() > 0);
+	}
 
+	void World::UpdateRenderers()
+	{
 		if (Renderer::IsRenderersDirty())
 		{
 			Renderer::SetRenderersDirty(false);
@@ -143,6 +190,17 @@ namespace Viry3D
 			renderers.Clear();
 
 			FindAllRenders(m_gameobjects, renderers, false, false, false);
+
+			// particle systems simulated at next frame begin
+			m_particle_systems.Clear();
+			for (auto i : renderers)
+			{
+				auto particle_renderer = dynamic_cast<ParticleSystemRenderer*>(i);
+				if (particle_renderer)
+				{
+					m_particle_systems.Add(particle_renderer->GetParticleSystem());
+				}
+			}
 		}
 	}
 
@@ -183,6 +241,8 @@ namespace Viry3D
 	void World::Init()
 	{
 		srand((unsigned int) Time::GetTimeMS());
+		TaskGraph::Init();
+		m_frame_graph = RefMake<TaskGraph>("World::Update");
 
 		Component::RegisterComponents();
 
@@ -201,6 +261,7 @@ namespace Viry3D
 	{
 		LightmapSettings::Clear();
 		Resource::Deinit();
+		Image::Deinit();
 		m_gameobjects.Clear();
 
         m_mutex.lock();
@@ -215,5 +276,8 @@ namespace Viry3D
 		Object::Deinit();
 		Shader::Deinit();
 		Font::Deinit();
+		m_particle_systems.Clear();
+		m_frame_graph.reset();
+		TaskGraph::Deinit();
 	}
 }
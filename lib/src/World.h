@@ -20,10 +20,13 @@
 #include "GameObject.h"
 #include "container/FastList.h"
 #include "container/List.h"
+#include "container/Vector.h"
 
 namespace Viry3D
 {
 	class Renderer;
+	class ParticleSystem;
+	class TaskGraph;
 
 	class World
 	{
@@ -35,13 +38,21 @@ namespace Viry3D
 		static void Update();
 		static void OnPause();
 		static void OnResume();
+		//	timeline of last update is in its GetTimeline
+		static const Ref<TaskGraph>& GetFrameGraph() { return m_frame_graph; }
 
 	private:
+		static void UpdateGameObjects();
+		static void LateUpdateGameObjects();
+		static void StartGameObjects();
+		static void UpdateRenderers();
 		static void FindAllRenders(const FastList<Ref<GameObject>>& objs, List<Renderer*>& renderers, bool include_inactive, bool include_disable, bool static_only);
 
 	private:
 		static FastList<Ref<GameObject>> m_gameobjects;
 		static List<Ref<GameObject>> m_gameobjects_start;
 		static Mutex m_mutex;
+		static Ref<TaskGraph> m_frame_graph;
+		static Vector<WeakRef<ParticleSystem>> m_particle_systems;
 	};
 }
@@ -15,12 +15,27 @@
 * limitations under the License.
 */
 
+#if VR_GLES
+
 #include "BufferGLES.h"
 #include "Debug.h"
 #include "memory/Memory.h"
+#include "graphics/Graphics.h"
 
 namespace Viry3D
 {
+	// element array binding is part of vertex array state,
+	// upload index data through copy write target to keep cached vertex arrays intact
+	static GLenum get_upload_target(GLenum type)
+	{
+		if (type == GL_ELEMENT_ARRAY_BUFFER)
+		{
+			return GL_COPY_WRITE_BUFFER;
+		}
+
+		return type;
+	}
+
 	BufferGLES::BufferGLES():
 		m_size(0),
 		m_buffer(0),
@@ -31,6 +46,15 @@ namespace Viry3D
 
 	BufferGLES::~BufferGLES()
 	{
+		if (m_type == GL_ARRAY_BUFFER || m_type == GL_ELEMENT_ARRAY_BUFFER)
+		{
+			auto display = Graphics::GetDisplay();
+			if (display)
+			{
+				display->DestroyVertexArrays(m_buffer);
+			}
+		}
+
 		glDeleteBuffers(1, &m_buffer);
 	}
 
@@ -86,9 +110,10 @@ namespace Viry3D
 
 		if (m_usage == GL_DYNAMIC_DRAW)
 		{
-			glBindBuffer(m_type, m_buffer);
-			glBufferData(m_type, m_size, NULL, m_usage);
-			glBindBuffer(m_type, 0);
+			GLenum target = get_upload_target(m_type);
+			glBindBuffer(target, m_buffer);
+			glBufferData(target, m_size, NULL, m_usage);
+			glBindBuffer(target, 0);
 		}
 
 		LogGLError();
@@ -100,9 +125,10 @@ namespace Viry3D
 
 		if (m_usage == GL_DYNAMIC_DRAW)
 		{
-			glBindBuffer(m_type, m_buffer);
-			glBufferSubData(m_type, offset, size, data);
-			glBindBuffer(m_type, 0);
+			GLenum target = get_upload_target(m_type);
+			glBindBuffer(target, m_buffer);
+			glBufferSubData(target, offset, size, data);
+			glBindBuffer(target, 0);
 		}
 
 		LogGLError();
@@ -112,35 +138,42 @@ namespace Viry3D
 	{
 		LogGLError();
 
-		glBindBuffer(m_type, m_buffer);
+		GLenum target = get_upload_target(m_type);
+		glBindBuffer(target, m_buffer);
 
 		if (m_usage == GL_DYNAMIC_DRAW)
 		{
-			/*GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
-			void* mapped = glMapBufferRange(m_type, 0, m_size, access);
-
-			ByteBuffer buffer((byte*) mapped, m_size);
-			fill(param, buffer);
-
-			auto unmap_result = glUnmapBuffer(m_type);
-			if(unmap_result == GL_FALSE)
+			// orphan storage gpu may still read, then fill new storage in place without a cpu copy
+			glBufferData(target, m_size, NULL, m_usage);
+			void* mapped = glMapBufferRange(target, 0, m_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			if (mapped)
 			{
-				Log("glUnmapBuffer failed type:", m_type);
-			}*/
+				ByteBuffer buffer((byte*) mapped, m_size);
+				fill(param, buffer);
 
-			auto& buffer = *this->GetLocalBuffer().get();
-			fill(param, buffer);
-			glBufferSubData(m_type, 0, m_size, buffer.Bytes());
+				if (glUnmapBuffer(target) == GL_FALSE)
+				{
+					Log("glUnmapBuffer failed type:%d", m_type);
+				}
+			}
+			else
+			{
+				auto& buffer = *this->GetLocalBuffer().get();
+				fill(param, buffer);
+				glBufferSubData(target, 0, m_size, buffer.Bytes());
+			}
 		}
 		else
 		{
 			ByteBuffer buffer(m_size);
 			fill(param, buffer);
-			glBufferData(m_type, m_size, buffer.Bytes(), m_usage);
+			glBufferData(target, m_size, buffer.Bytes(), m_usage);
 		}
 
-		glBindBuffer(m_type, 0);
+		glBindBuffer(target, 0);
 
 		LogGLError();
 	}
 }
+
+#endif
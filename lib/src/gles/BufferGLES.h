@@ -35,6 +35,8 @@ namespace Viry3D
 		typedef std::function<void(void* param, const ByteBuffer& buffer)> FillFunc;
 		void Fill(void* param, FillFunc fill);
 		void UpdateRange(int offset, int size, const void* data);
+		//	gles renders on main thread, buffers keep one version
+		int CaptureVersion() const { return 0; }
 
 	protected:
 		BufferGLES();
@@ -22,28 +22,26 @@
 #include "graphics/VertexBuffer.h"
 #include "graphics/Shader.h"
 #include "graphics/VertexAttribute.h"
+#include "graphics/XMLShader.h"
 #include "graphics/Graphics.h"
 #include "graphics/Screen.h"
+#include "graphics/RenderTexture.h"
+#include "graphics/VideoEncoder.h"
 #include "memory/ByteBuffer.h"
 #include "memory/Memory.h"
 #include "io/File.h"
-#include "thread/Thread.h"
 #include "time/Time.h"
+#include "Profiler.h"
 #include "Debug.h"
 
-#if VR_WINDOWS
-extern "C" {
-#include "libavcodec/avcodec.h"
-#include "libavformat/avformat.h"
-#include "libswscale/swscale.h"
-}
-#pragma warning(disable: 4996)
-#endif
-
 #if VR_ANDROID
 #include "android/jni.h"
 #endif
 
+// frames of recording read back into pixel buffers, mapped after their fences signaled
+#define RECORD_READBACK_COUNT 3
+#define RECORD_QUEUE_MAX 8
+
 namespace Viry3D
 {
 	class DisplayGLESPrivate
@@ -52,39 +50,49 @@ namespace Viry3D
 		DisplayGLESPrivate()
 		{
 #if VR_WINDOWS
-			video_out_context = NULL;
-			video_out_stream = NULL;
-			video_codec_context = NULL;
-			video_frame = NULL;
-			input_frame = NULL;
-			yuv_convert_context = NULL;
-			audio_out_stream = NULL;
-			audio_codec_context = NULL;
-			audio_frame = NULL;
-			audio_samples_count = 0;
 			record_begin_frame = -1;
+			record_read = 0;
+			record_pending = 0;
+			record_dropped = 0;
 #endif
 		}
 
 #if VR_WINDOWS
-		Ref<Thread> record_thread;
-		AVFormatContext* video_out_context;
-		AVStream* video_out_stream;
-		AVCodecContext* video_codec_context;
-		AVFrame* video_frame;
-		AVFrame* input_frame;
-		SwsContext* yuv_convert_context;
-		AVStream* audio_out_stream;
-		AVCodecContext* audio_codec_context;
-		AVFrame* audio_frame;
-		int audio_samples_count;
+		struct RecordReadback
+		{
+			GLuint buffer;
+			GLsync fence;
+			int frame_index;
+		};
+
+		Ref<VideoEncoder> encoder;
+		Vector<RecordReadback> record_readbacks;
 		int record_begin_frame;
+		//	oldest readback not mapped yet
+		int record_read;
+		int record_pending;
+		int record_dropped;
 #endif
+
+		struct PixelsReadback
+		{
+			Ref<RenderTexture> texture;
+			ReadPixelsComplete complete;
+			GLuint buffer;
+			GLsync fence;
+			int width;
+			int height;
+		};
+
+		//	requested this frame, read at swap
+		Vector<PixelsReadback> pixels_requests;
+		Vector<PixelsReadback> pixels_readbacks;
 	};
 
 	DisplayGLES::DisplayGLES():
 		m_private(RefMake<DisplayGLESPrivate>()),
 		m_uniform_buffer_offset_alignment(0),
+		m_program_binary_supported(false),
 		m_default_vao(0)
 	{
 	}
@@ -126,6 +134,7 @@ namespace Viry3D
 		auto renderer = (char *) glGetString(GL_RENDERER);
 		String version = (char *) glGetString(GL_VERSION);
 		m_device_name = String::Format("%s/%s/%s", vender, renderer, version.CString());
+		m_driver_version = String::Format("%s/%s", version.CString(), (char *) glGetString(GL_SHADING_LANGUAGE_VERSION));
 
 #if VR_MAC
         int ext_count = 0;
@@ -149,11 +158,25 @@ namespace Viry3D
 
 		m_uniform_buffer_offset_alignment = (int) uniform_buffer_offset_alignment;
 
+		GLint program_binary_formats = 0;
+#if VR_WINDOWS
+		if (glGetProgramBinary != NULL && glProgramBinary != NULL)
+#endif
+		{
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &program_binary_formats);
+		}
+		m_program_binary_supported = program_binary_formats > 0;
+
+		m_timer_query = RefMake<TimerQueryGLES>(m_extensions);
+		m_context_thread_id = std::this_thread::get_id();
+
 		Log("device_name: %s", m_device_name.CString());
 		Log("extensions: %s", m_extensions.CString());
 		Log("max_vertex_uniform_vectors:%d", max_vertex_uniform_vectors);
 		Log("max_uniform_block_size:%d", max_uniform_block_size);
 		Log("uniform_buffer_offset_alignment:%d", uniform_buffer_offset_alignment);
+		Log("program_binary_formats:%d", program_binary_formats);
+		Log("timestamps: %s", m_timer_query->IsSupported() ? "supported" : "not supported");
 
 		LogGLError();
 	}
@@ -375,6 +398,8 @@ namespace Viry3D
 			RecordBuffer();
 		}
 
+		this->ReadPixelsRequests();
+
 #if VR_ANDROID
 		eglSwapBuffers(m_display, m_surface);
 #elif VR_WINDOWS
@@ -384,11 +409,24 @@ namespace Viry3D
 
 	void DisplayGLES::Deinit()
 	{
+		m_timer_query.reset();
+
+		// captures already read are worth a wait, requests not read yet are dropped
+		m_private->pixels_requests.Clear();
+		this->ReadPixelsReadbacks(true);
+
 		if (m_default_vao != 0)
 		{
 			glDeleteVertexArrays(1, &m_default_vao);
 		}
 
+		this->DeleteDestroyedVertexArrays();
+		for (auto& i : m_vertex_arrays)
+		{
+			glDeleteVertexArrays(1, &i.second);
+		}
+		m_vertex_arrays.Clear();
+
 #if VR_ANDROID || VR_WINDOWS
 		if (m_default_depth_render_buffer != 0)
 		{
@@ -408,6 +446,26 @@ namespace Viry3D
 #endif
 	}
 
+	void DisplayGLES::BeginFrame()
+	{
+		Vector<double> timestamps;
+		bool timestamps_read = m_timer_query->BeginFrame(timestamps);
+		Profiler::OnGPUFrameBegin(m_timer_query->GetFrameIndex(), timestamps_read ? &timestamps : NULL);
+
+		this->ReadPixelsReadbacks(false);
+	}
+
+	int DisplayGLES::WriteTimestamp()
+	{
+		// shared contexts of loading threads are not part of frame
+		if (std::this_thread::get_id() != m_context_thread_id)
+		{
+			return -1;
+		}
+
+		return m_timer_query->Write();
+	}
+
 	void DisplayGLES::BindVertexArray()
 	{
 		LogGLError();
@@ -421,6 +479,102 @@ namespace Viry3D
 		LogGLError();
 	}
 
+	void DisplayGLES::BindVertexArray(const VertexBuffer* vertex_buffer, const IndexBuffer* index_buffer, IndexType index_type, const Ref<Shader>& shader, int pass_index, int vertex_version, int index_version)
+	{
+		LogGLError();
+
+		this->DeleteDestroyedVertexArrays();
+
+		VertexArrayKey key;
+		key.vertex_buffer = vertex_buffer->GetBuffer();
+		key.index_buffer = index_buffer->GetBuffer();
+		key.vertex_layout = shader->GetVertexLayout(pass_index);
+
+		GLuint* find;
+		m_vertex_array_mutex.lock();
+		bool cached = m_vertex_arrays.TryGet(key, &find);
+		GLuint vao = cached ? *find : 0;
+		m_vertex_array_mutex.unlock();
+
+		if (cached)
+		{
+			glBindVertexArray(vao);
+		}
+		else
+		{
+			glGenVertexArrays(1, &vao);
+			glBindVertexArray(vao);
+
+			glBindBuffer(GL_ARRAY_BUFFER, key.vertex_buffer);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, key.index_buffer);
+			this->BindVertexAttribArray(shader, pass_index);
+
+			m_vertex_array_mutex.lock();
+			m_vertex_arrays.Add(key, vao);
+			m_vertex_array_mutex.unlock();
+		}
+
+		LogGLError();
+	}
+
+	int DisplayGLES::GetVertexLayout(const XMLVertexShader* vs)
+	{
+		String signature = String::ToString(vs->stride);
+		for (const auto& i : vs->attrs)
+		{
+			signature += String::Format("|%d,%d,%d", i.location, i.size, i.offset);
+		}
+
+		int layout;
+
+		m_vertex_array_mutex.lock();
+		int* find;
+		if (m_vertex_layouts.TryGet(signature, &find))
+		{
+			layout = *find;
+		}
+		else
+		{
+			layout = m_vertex_layouts.Size();
+			m_vertex_layouts.Add(signature, layout);
+		}
+		m_vertex_array_mutex.unlock();
+
+		return layout;
+	}
+
+	// may be called from a loading thread, vertex arrays are not shared between contexts,
+	// so only drop them from the cache here and delete on main context at next bind
+	void DisplayGLES::DestroyVertexArrays(GLuint buffer)
+	{
+		m_vertex_array_mutex.lock();
+		for (auto i = m_vertex_arrays.begin(); i != m_vertex_arrays.end(); )
+		{
+			if (i->first.vertex_buffer == buffer || i->first.index_buffer == buffer)
+			{
+				m_vertex_arrays_destroyed.Add(i->second);
+				i = m_vertex_arrays.Remove(i);
+			}
+			else
+			{
+				i++;
+			}
+		}
+		m_vertex_array_mutex.unlock();
+	}
+
+	void DisplayGLES::DeleteDestroyedVertexArrays()
+	{
+		m_vertex_array_mutex.lock();
+		if (!m_vertex_arrays_destroyed.Empty())
+		{
+			glBindVertexArray(0);
+			glDeleteVertexArrays(m_vertex_arrays_destroyed.Size(), &m_vertex_arrays_destroyed[0]);
+			m_vertex_arrays_destroyed.Clear();
+		}
+		m_vertex_array_mutex.unlock();
+	}
+
 	void DisplayGLES::BindVertexBuffer(const VertexBuffer* buffer)
 	{
 		LogGLError();
@@ -503,149 +657,24 @@ namespace Viry3D
 		m_fps = 30;
 
 		m_private->record_begin_frame = Time::GetFrameCount();
-		m_private->audio_samples_count = 0;
-
-		m_private->record_thread = RefMake<Thread>(0, ThreadInfo({
-			[=]() {
-			av_register_all();
-
-			AVFormatContext* oc;
-			auto ret = avformat_alloc_output_context2(&oc, NULL, NULL, file.CString());
-			
-			AVPixelFormat pix_fmt = AV_PIX_FMT_YUV420P;
-			AVStream* video_out_stream = NULL;
-			AVCodecContext* video_codec_context = NULL;
-			AVFrame* video_frame = NULL;
-			AVStream* audio_out_stream = NULL;
-			AVCodecContext* audio_codec_context = NULL;
-			AVFrame* audio_frame = NULL;
-
-			// setup video stream
-			{
-				auto codec_id = oc->oformat->video_codec;
-				auto stream = avformat_new_stream(oc, NULL);
-				stream->id = oc->nb_streams - 1;
-				stream->time_base = { 1, m_fps };
-
-				auto c = stream->codec;
-				c->qmin = 1;
-				c->qmax = 50;
-				c->qcompress = 1;
-				c->gop_size = 12; /* emit one intra frame every twelve frames at most */
-				c->bit_rate = 4000 * m_fps / 30 * 1000;
-				c->pix_fmt = pix_fmt;
-				c->codec_type = AVMEDIA_TYPE_VIDEO;
-				c->codec_id = codec_id;
-				c->width = m_width;
-				c->height = m_height;
-				c->time_base = stream->time_base;
-
-				if (oc->oformat->flags & AVFMT_GLOBALHEADER)
-				{
-					c->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
-				}
-
-				auto codec = avcodec_find_encoder(codec_id);
-				ret = avcodec_open2(c, codec, NULL);
-
-				video_frame = av_frame_alloc();
-				video_frame->format = pix_fmt;
-				video_frame->width = m_width;
-				video_frame->height = m_height;
-				ret = av_frame_get_buffer(video_frame, 32);
-
-				video_out_stream = stream;
-				video_codec_context = c;
-			}
-
-			// setup audio stream
-			{
-				auto codec_id = oc->oformat->audio_codec;
-				auto stream = avformat_new_stream(oc, NULL);
-				stream->id = oc->nb_streams - 1;
-				
-				auto codec = avcodec_find_encoder(codec_id);
-
-				auto c = stream->codec;
-				c->sample_fmt = AV_SAMPLE_FMT_FLTP;
-				c->bit_rate = 64000;
-				c->sample_rate = 44100;
-				c->channel_layout = AV_CH_LAYOUT_STEREO;
-				c->channels = av_get_channel_layout_nb_channels(c->channel_layout);
-				c->codec_type = AVMEDIA_TYPE_AUDIO;
-
-				stream->time_base = { 1, c->sample_rate };
-
-				ret = avcodec_open2(c, codec, NULL);
-
-				int nb_samples;
-				if (codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE)
-					nb_samples = 10000;
-				else
-					nb_samples = c->frame_size;
-
-				auto frame = av_frame_alloc();
-				frame->format = c->sample_fmt;
-				frame->channel_layout = c->channel_layout;
-				frame->sample_rate = c->sample_rate;
-				frame->nb_samples = nb_samples;
-				ret = av_frame_get_buffer(frame, 0);
-
-				audio_out_stream = stream;
-				audio_codec_context = c;
-				audio_frame = frame;
-			}
+		m_private->record_read = 0;
+		m_private->record_pending = 0;
+		m_private->record_dropped = 0;
+		m_private->encoder = RefMake<VideoEncoder>(file, m_width, m_height, m_fps, RECORD_QUEUE_MAX);
+
+		int buffer_size = m_width * m_height * 3;
+		m_private->record_readbacks.Resize(RECORD_READBACK_COUNT);
+		for (auto& i : m_private->record_readbacks)
+		{
+			glGenBuffers(1, &i.buffer);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, i.buffer);
+			glBufferData(GL_PIXEL_PACK_BUFFER, buffer_size, NULL, GL_STREAM_READ);
+			i.fence = NULL;
+			i.frame_index = -1;
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 
-			auto input_frame = av_frame_alloc();
-			input_frame->format = AV_PIX_FMT_RGB24;
-			input_frame->width = m_width;
-			input_frame->height = m_height;
-			ret = av_frame_get_buffer(input_frame, 32);
-
-			auto yuv_convert_context = sws_getContext(
-				m_width, m_height,
-				AV_PIX_FMT_RGB24,
-				m_width, m_height,
-				pix_fmt,
-				0, NULL, NULL, NULL);
-
-			ret = avio_open(&oc->pb, file.CString(), AVIO_FLAG_WRITE);
-			ret = avformat_write_header(oc, NULL);
-
-			m_private->video_out_context = oc;
-			m_private->video_out_stream = video_out_stream;
-			m_private->video_codec_context = video_codec_context;
-			m_private->video_frame = video_frame;
-			m_private->input_frame = input_frame;
-			m_private->yuv_convert_context = yuv_convert_context;
-
-			m_private->audio_out_stream = audio_out_stream;
-			m_private->audio_codec_context = audio_codec_context;
-			m_private->audio_frame = audio_frame;
-		},
-			[=]() {
-			av_write_trailer(m_private->video_out_context);
-
-			avcodec_close(m_private->video_codec_context);
-			av_frame_free(&m_private->video_frame);
-			avcodec_close(m_private->audio_codec_context);
-			av_frame_free(&m_private->audio_frame);
-			avio_closep(&m_private->video_out_context->pb);
-			avformat_free_context(m_private->video_out_context);
-			av_frame_free(&m_private->input_frame);
-			sws_freeContext(m_private->yuv_convert_context);
-
-			m_private->video_out_context = NULL;
-			m_private->video_out_stream = NULL;
-			m_private->video_codec_context = NULL;
-			m_private->video_frame = NULL;
-			m_private->input_frame = NULL;
-			m_private->yuv_convert_context = NULL;
-			m_private->audio_out_stream = NULL;
-			m_private->audio_codec_context = NULL;
-			m_private->audio_frame = NULL;
-		}
-		}));
+		LogGLError();
 #endif
 	}
 
@@ -654,103 +683,231 @@ namespace Viry3D
 		DisplayBase::EndRecord();
 
 #if VR_WINDOWS
-		m_private->record_thread.reset();
+		// last frames are worth a wait, recording is over
+		this->ReadRecordBuffers(true);
+
+		for (auto& i : m_private->record_readbacks)
+		{
+			glDeleteBuffers(1, &i.buffer);
+		}
+		m_private->record_readbacks.Clear();
+
+		if (m_private->record_dropped > 0)
+		{
+			Log("record dropped %d frames waiting readback", m_private->record_dropped);
+		}
+
+		m_private->encoder.reset();
 		m_private->record_begin_frame = -1;
 #endif
 	}
 
+	void DisplayGLES::ReadRecordBuffers(bool wait)
+	{
+#if VR_WINDOWS
+		auto& readbacks = m_private->record_readbacks;
+		int buffer_size = m_private->encoder->GetWidth() * m_private->encoder->GetHeight() * 3;
+
+		while (m_private->record_pending > 0)
+		{
+			auto& readback = readbacks[m_private->record_read];
+
+			GLenum status = glClientWaitSync(readback.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			{
+				break;
+			}
+			glDeleteSync(readback.fence);
+			readback.fence = NULL;
+
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+			void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, buffer_size, GL_MAP_READ_BIT);
+			if (mapped)
+			{
+				// buffer is reused next frames, encoder takes a copy
+				ByteBuffer frame(buffer_size);
+				Memory::Copy(frame.Bytes(), mapped, buffer_size);
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+				m_private->encoder->PushFrame(frame, readback.frame_index, true);
+			}
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+			m_private->record_read = (m_private->record_read + 1) % readbacks.Size();
+			m_private->record_pending--;
+		}
+
+		LogGLError();
+#endif
+	}
+
 	void DisplayGLES::RecordBuffer()
 	{
 #if VR_WINDOWS
+		if (m_width != m_private->encoder->GetWidth() || m_height != m_private->encoder->GetHeight())
+		{
+			return;
+		}
+
+		this->ReadRecordBuffers(false);
+
+		// gpu is behind by all readbacks, drop frame instead of stalling
+		auto& readbacks = m_private->record_readbacks;
+		if (m_private->record_pending == readbacks.Size())
+		{
+			m_private->record_dropped++;
+			return;
+		}
+
+		auto& readback = readbacks[(m_private->record_read + m_private->record_pending) % readbacks.Size()];
+		readback.frame_index = Time::GetFrameCount() - m_private->record_begin_frame;
+
 		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 		glReadBuffer(GL_BACK);
 		glPixelStorei(GL_PACK_ALIGNMENT, 1);
-		ByteBuffer buffer(m_width * m_height * 3);
-		glReadPixels(0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, buffer.Bytes());
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		glReadPixels(0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		m_private->record_pending++;
 
-		int frame_index = Time::GetFrameCount() - m_private->record_begin_frame;
+		LogGLError();
+#endif
+	}
 
-		const int task_max = 30;
-		int task_count;
-		while ((task_count = m_private->record_thread->QueueLength()) >= task_max)
+	void DisplayGLES::ReadPixelsAsync(const Ref<RenderTexture>& texture, ReadPixelsComplete complete)
+	{
+		DisplayGLESPrivate::PixelsReadback readback;
+		readback.texture = texture;
+		readback.complete = complete;
+		readback.buffer = 0;
+		readback.fence = NULL;
+		readback.width = texture ? texture->GetWidth() : m_width;
+		readback.height = texture ? texture->GetHeight() : m_height;
+
+		m_private->pixels_requests.Add(readback);
+	}
+
+	void DisplayGLES::ReadPixelsRequests()
+	{
+		if (m_private->pixels_requests.Empty())
 		{
-			Thread::Sleep(10);
+			return;
 		}
 
-		m_private->record_thread->AddTask({ [=]() {
-			Ref<Any> empty;
-
-			auto oc = m_private->video_out_context;
-			auto vs = m_private->video_out_stream;
-			auto vc = m_private->video_codec_context;
-			auto output_frame = m_private->video_frame;
-			auto input_frame = m_private->input_frame;
-			auto yuv_convert_context = m_private->yuv_convert_context;
-			auto audio_frame = m_private->audio_frame;
-			auto ac = m_private->audio_codec_context;
-			auto as = m_private->audio_out_stream;
+		LogGLError();
 
-			byte* input = buffer.Bytes();
+		// complete may request again
+		auto requests = m_private->pixels_requests;
+		m_private->pixels_requests.Clear();
 
-			auto ret = av_frame_make_writable(input_frame);
+		for (auto& i : requests)
+		{
+			if (i.texture && i.texture->GetFormat() != RenderTextureFormat::RGBA32)
+			{
+				Log("read pixels supports RGBA32 render texture only");
+				i.complete(ByteBuffer(), i.width, i.height);
+				continue;
+			}
 
-			for (int i = 0; i < m_height; i++)
+			GLuint framebuffer = 0;
+			if (i.texture)
 			{
-				for (int j = 0; j < m_width; j++)
-				{
-					byte r = input[(m_height - i - 1) * m_width * 3 + j * 3];
-					byte g = input[(m_height - i - 1) * m_width * 3 + j * 3 + 1];
-					byte b = input[(m_height - i - 1) * m_width * 3 + j * 3 + 2];
+				glGenFramebuffers(1, &framebuffer);
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+				glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, i.texture->GetTexture(), 0);
+			}
+			else
+			{
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+			}
 
-					input_frame->data[0][i * input_frame->linesize[0] + j * 3 + 0] = r;
-					input_frame->data[0][i * input_frame->linesize[0] + j * 3 + 1] = g;
-					input_frame->data[0][i * input_frame->linesize[0] + j * 3 + 2] = b;
-				}
+			glGenBuffers(1, &i.buffer);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, i.buffer);
+			glBufferData(GL_PIXEL_PACK_BUFFER, i.width * i.height * 4, NULL, GL_STREAM_READ);
+			glReadPixels(0, 0, i.width, i.height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			i.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+			if (framebuffer)
+			{
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+				glDeleteFramebuffers(1, &framebuffer);
 			}
 
-			sws_scale(yuv_convert_context, input_frame->data, input_frame->linesize,
-				0, vc->height, output_frame->data, output_frame->linesize);
+			m_private->pixels_readbacks.Add(i);
+		}
 
-			output_frame->pts = frame_index;
-			
-			AVPacket pkt;
-			pkt.data = NULL;
-			pkt.size = 0;
-			av_init_packet(&pkt);
+		LogGLError();
+	}
 
-			int got_packet;
-			ret = avcodec_encode_video2(vc, &pkt, output_frame, &got_packet);
+	void DisplayGLES::ReadPixelsReadbacks(bool wait)
+	{
+		auto& readbacks = m_private->pixels_readbacks;
+		if (readbacks.Empty())
+		{
+			return;
+		}
 
-			if (got_packet)
-			{
-				av_packet_rescale_ts(&pkt, vc->time_base, vs->time_base);
-				pkt.stream_index = vs->index;
-				ret = av_interleaved_write_frame(oc, &pkt);
-			}
+		LogGLError();
+
+		Vector<DisplayGLESPrivate::PixelsReadback> completes;
+		Vector<ByteBuffer> colors;
 
-			if (av_compare_ts(frame_index, vc->time_base, m_private->audio_samples_count, ac->time_base) > 0)
+		for (int i = 0; i < readbacks.Size(); i++)
+		{
+			auto& readback = readbacks[i];
+
+			GLenum status = glClientWaitSync(readback.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
 			{
-				pkt.data = NULL;
-				pkt.size = 0;
-				av_init_packet(&pkt);
+				continue;
+			}
+			glDeleteSync(readback.fence);
 
-				audio_frame->pts = av_rescale_q(m_private->audio_samples_count, { 1, ac->sample_rate }, ac->time_base);
-				m_private->audio_samples_count += audio_frame->nb_samples;
+			int row_size = readback.width * 4;
+			ByteBuffer pixels(row_size * readback.height);
 
-				ret = av_frame_make_writable(audio_frame);
-				ret = avcodec_encode_audio2(ac, &pkt, audio_frame, &got_packet);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+			void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pixels.Size(), GL_MAP_READ_BIT);
+			if (mapped)
+			{
+				// gl rows are bottom up
+				for (int j = 0; j < readback.height; j++)
+				{
+					Memory::Copy(&pixels[j * row_size], (byte*) mapped + (readback.height - 1 - j) * row_size, row_size);
+				}
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
 
-				if (got_packet)
+				// back buffer alpha is whatever blending left
+				if (!readback.texture)
 				{
-					av_packet_rescale_ts(&pkt, ac->time_base, as->time_base);
-					pkt.stream_index = as->index;
-					ret = av_interleaved_write_frame(oc, &pkt);
+					for (int j = 3; j < pixels.Size(); j += 4)
+					{
+						pixels[j] = 255;
+					}
 				}
 			}
+			else
+			{
+				pixels = ByteBuffer();
+			}
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			glDeleteBuffers(1, &readback.buffer);
 
-			return empty;
-		}, NULL });
-#endif
+			completes.Add(readback);
+			colors.Add(pixels);
+			readbacks.Remove(i);
+			i--;
+		}
+
+		LogGLError();
+
+		for (int i = 0; i < completes.Size(); i++)
+		{
+			completes[i].complete(colors[i], completes[i].width, completes[i].height);
+		}
 	}
 }
 
@@ -30,13 +30,19 @@
 #include "memory/Ref.h"
 #include "graphics/IndexBuffer.h"
 #include "string/String.h"
+#include "container/Map.h"
+#include "container/Vector.h"
+#include "TimerQueryGLES.h"
 #include <mutex>
+#include <thread>
 
 namespace Viry3D
 {
 	class VertexBuffer;
+	class RenderTexture;
 	class Shader;
 	class Thread;
+	struct XMLVertexShader;
 
 	class DisplayGLESPrivate;
 
@@ -59,20 +65,31 @@ namespace Viry3D
 		void OnResize(int width, int height);
 		void OnPause();
 		void OnResume();
-		void BeginFrame() { }
+		void BeginFrame();
 		void EndFrame() { }
 		void WaitQueueIdle() { }
 		void BindVertexArray();
+		//	buffers have one version in gles, versions are ignored
+		void BindVertexArray(const VertexBuffer* vertex_buffer, const IndexBuffer* index_buffer, IndexType index_type, const Ref<Shader>& shader, int pass_index, int vertex_version = -1, int index_version = -1);
 		void BindVertexBuffer(const VertexBuffer* buffer);
 		void BindIndexBuffer(const IndexBuffer* buffer, IndexType index_type);
 		void BindVertexAttribArray(const Ref<Shader>& shader, int pass_index);
 		void DrawIndexed(int start, int count, IndexType index_type);
 		void DisableVertexArray(const Ref<Shader>& shader, int pass_index);
 		void SubmitQueue(void* cmd) { }
+		bool IsTimestampSupported() const { return m_timer_query && m_timer_query->IsSupported(); }
+		//	into context of this thread, -1 when none can take it
+		int WriteTimestamp();
 		virtual void BeginRecord(const String& file);
 		virtual void EndRecord();
+		//	null texture reads back buffer, read into pixel buffer at swap and mapped after its fence signaled,
+		//	call on main thread, complete runs on main thread
+		void ReadPixelsAsync(const Ref<RenderTexture>& texture, ReadPixelsComplete complete);
 
 		int GetMinUniformBufferOffsetAlignment() const { return m_uniform_buffer_offset_alignment; }
+		bool IsProgramBinarySupported() const { return m_program_binary_supported; }
+		int GetVertexLayout(const XMLVertexShader* vs);
+		void DestroyVertexArrays(GLuint buffer);
 
 #if VR_ANDROID
 		void EGLInit(int& width, int& height);
@@ -94,9 +111,43 @@ namespace Viry3D
 		void SwapBuffers();
 
 		const String& GetDeviceName() const { return m_device_name; }
+		//	GL_VERSION and GL_SHADING_LANGUAGE_VERSION, changes with driver updates on same gpu
+		const String& GetDriverVersion() const { return m_driver_version; }
 
 	private:
 		void RecordBuffer();
+		//	maps readbacks gpu finished in order and sends them to encoder
+		void ReadRecordBuffers(bool wait);
+		void ReadPixelsRequests();
+		//	wait: deinit, complete every readback
+		void ReadPixelsReadbacks(bool wait);
+		void DeleteDestroyedVertexArrays();
+
+		struct VertexArrayKey
+		{
+			GLuint vertex_buffer;
+			GLuint index_buffer;
+			int vertex_layout;
+
+			bool operator <(const VertexArrayKey& right) const
+			{
+				if (vertex_buffer == right.vertex_buffer)
+				{
+					if (index_buffer == right.index_buffer)
+					{
+						return vertex_layout < right.vertex_layout;
+					}
+					else
+					{
+						return index_buffer < right.index_buffer;
+					}
+				}
+				else
+				{
+					return vertex_buffer < right.vertex_buffer;
+				}
+			}
+		};
 
 	private:
 		Ref<DisplayGLESPrivate> m_private;
@@ -113,8 +164,16 @@ namespace Viry3D
 #endif
 
 		int m_uniform_buffer_offset_alignment;
+		bool m_program_binary_supported;
 		String m_extensions;
 		String m_device_name;
+		String m_driver_version;
 		GLuint m_default_vao;
+		Map<String, int> m_vertex_layouts;
+		Map<VertexArrayKey, GLuint> m_vertex_arrays;
+		Vector<GLuint> m_vertex_arrays_destroyed;
+		std::mutex m_vertex_array_mutex;
+		Ref<TimerQueryGLES> m_timer_query;
+		std::thread::id m_context_thread_id;
 	};
 }
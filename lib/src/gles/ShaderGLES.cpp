@@ -32,12 +32,32 @@
 #include "io/File.h"
 #include "io/MemoryStream.h"
 #include "memory/Memory.h"
+#include "time/Time.h"
 #include "Debug.h"
 
+extern "C"
+{
+#include "crypto/md5/md5.h"
+}
+
 namespace Viry3D
 {
 	static const int UNIFORM_BUFFER_OBJ_BINDING = 0;
 	static const String LIGHTMAP_NAME = "_Lightmap";
+	static const int PROGRAM_BINARY_MAGIC = 0x42505256; // VRPB
+	static const int PROGRAM_BINARY_VERSION = 1;
+
+	struct ProgramBinaryHeader
+	{
+		int magic;
+		int version;
+		GLenum format;
+		int size;
+		float compile_time;
+	};
+
+	float ShaderGLES::m_compile_time_saved = 0;
+	Mutex ShaderGLES::m_compile_time_mutex;
 
 	static GLuint create_shader(GLenum type, const String& src)
 	{
@@ -71,12 +91,17 @@ namespace Viry3D
 		return shader;
 	}
 
-	static GLuint create_program(GLuint vs, GLuint ps)
+	static GLuint create_program(GLuint vs, GLuint ps, bool retrievable)
 	{
 		LogGLError();
 
 		auto program = glCreateProgram();
 
+		if (retrievable)
+		{
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+
 		glAttachShader(program, vs);
 		glAttachShader(program, ps);
 
@@ -104,6 +129,111 @@ namespace Viry3D
 		return program;
 	}
 
+	// driver version is part of key, binaries of an old driver would fail glProgramBinary every launch
+	static String get_program_binary_path(const String& device_name, const String& driver_version, const String& vs_src, const String& ps_src)
+	{
+		unsigned char hash_bytes[16];
+		MD5_CTX md5_context;
+		MD5_Init(&md5_context);
+		MD5_Update(&md5_context, (void*) device_name.CString(), device_name.Size());
+		MD5_Update(&md5_context, (void*) driver_version.CString(), driver_version.Size());
+		MD5_Update(&md5_context, (void*) vs_src.CString(), vs_src.Size());
+		MD5_Update(&md5_context, (void*) ps_src.CString(), ps_src.Size());
+		MD5_Final(hash_bytes, &md5_context);
+		String md5_str;
+		for (int i = 0; i < (int) sizeof(hash_bytes); i++)
+		{
+			md5_str += String::Format("%02x", hash_bytes[i]);
+		}
+
+		return Application::SavePath() + "/" + md5_str + ".program";
+	}
+
+	static GLuint load_program_binary(const String& path, float& compile_time)
+	{
+		if (!File::Exist(path))
+		{
+			return 0;
+		}
+
+		LogGLError();
+
+		auto buffer = File::ReadAllBytes(path);
+
+		ProgramBinaryHeader header;
+		if (buffer.Size() < (int) sizeof(header))
+		{
+			File::Delete(path);
+			return 0;
+		}
+
+		Memory::Copy(&header, buffer.Bytes(), sizeof(header));
+		if (header.magic != PROGRAM_BINARY_MAGIC ||
+			header.version != PROGRAM_BINARY_VERSION ||
+			header.size != buffer.Size() - (int) sizeof(header))
+		{
+			File::Delete(path);
+			return 0;
+		}
+
+		auto program = glCreateProgram();
+		glProgramBinary(program, header.format, buffer.Bytes() + sizeof(header), header.size);
+
+		GLint success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			// driver updated or binary format changed, fall back to source
+			Log("program binary rejected by driver: %s", path.CString());
+
+			glDeleteProgram(program);
+			program = 0;
+
+			while (glGetError() != GL_NO_ERROR) { }
+			File::Delete(path);
+		}
+		else
+		{
+			compile_time = header.compile_time;
+		}
+
+		LogGLError();
+
+		return program;
+	}
+
+	static void save_program_binary(const String& path, GLuint program, float compile_time)
+	{
+		LogGLError();
+
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+		{
+			return;
+		}
+
+		ProgramBinaryHeader header;
+		header.magic = PROGRAM_BINARY_MAGIC;
+		header.version = PROGRAM_BINARY_VERSION;
+		header.format = 0;
+		header.size = 0;
+		header.compile_time = compile_time;
+
+		ByteBuffer buffer(sizeof(header) + length);
+		GLsizei size = 0;
+		glGetProgramBinary(program, length, &size, &header.format, buffer.Bytes() + sizeof(header));
+		header.size = size;
+
+		if (size == length)
+		{
+			Memory::Copy(buffer.Bytes(), &header, sizeof(header));
+			File::WriteAllBytes(path, buffer);
+		}
+
+		LogGLError();
+	}
+
 	static void prepare_pipeline(
 		const XMLPass& pass,
 		XMLShader& xml,
@@ -132,6 +262,7 @@ namespace Viry3D
 				}
 
 				shader_pass.vs = &i;
+				shader_pass.vertex_layout = display->GetVertexLayout(&i);
 				break;
 			}
 		}
@@ -459,6 +590,12 @@ namespace Viry3D
 		LogGLError();
 	}
 
+	float ShaderGLES::GetCompileTimeSaved()
+	{
+		std::lock_guard<Mutex> lock(m_compile_time_mutex);
+		return m_compile_time_saved;
+	}
+
 	ShaderGLES::ShaderGLES()
 	{
 	}
@@ -486,7 +623,6 @@ namespace Viry3D
 
 	void ShaderGLES::Compile()
 	{
-		this->CreateShaders();
 		this->CreatePasses();
 	}
 
@@ -516,49 +652,96 @@ namespace Viry3D
 		return source;
 	}
 
-	void ShaderGLES::CreateShaders()
+	GLuint ShaderGLES::GetShader(GLenum type, const String& name, const String& source)
 	{
-		const auto& xml = ((Shader*) this)->m_xml;
+		auto& shaders = type == GL_VERTEX_SHADER ? m_vertex_shaders : m_pixel_shaders;
 
-		for (const auto& i : xml.vss)
+		GLuint* find;
+		if (shaders.TryGet(name, &find))
 		{
-			auto source = combine_shader_src(i.includes, i.src);
-
-			auto shader = create_shader(GL_VERTEX_SHADER, source);
-			if (shader == 0)
-			{
-				Log("shader create failed:%s", this->m_name.CString());
-			}
-
-			m_vertex_shaders.Add(i.name, shader);
+			return *find;
 		}
 
-		for (const auto& i : xml.pss)
+		auto shader = create_shader(type, source);
+		if (shader == 0)
 		{
-			auto source = combine_shader_src(i.includes, i.src);
+			Log("shader create failed:%s", this->m_name.CString());
+		}
 
-			auto shader = create_shader(GL_FRAGMENT_SHADER, source);
-			if (shader == 0)
-			{
-				Log("shader create failed:%s", this->m_name.CString());
-			}
+		shaders.Add(name, shader);
 
-			m_pixel_shaders.Add(i.name, shader);
-		}
+		return shader;
 	}
 
 	void ShaderGLES::CreatePasses()
 	{
 		auto& xml = ((Shader*) this)->m_xml;
+		auto display = (DisplayGLES*) Graphics::GetDisplay();
+		bool binary_supported = display->IsProgramBinarySupported();
+
+		Map<String, String> vs_sources;
+		for (const auto& i : xml.vss)
+		{
+			vs_sources.Add(i.name, combine_shader_src(i.includes, i.src));
+		}
+
+		Map<String, String> ps_sources;
+		for (const auto& i : xml.pss)
+		{
+			ps_sources.Add(i.name, combine_shader_src(i.includes, i.src));
+		}
 
 		m_passes.Resize(xml.passes.Size());
 		for (int i = 0; i < xml.passes.Size(); i++)
 		{
 			auto& xml_pass = xml.passes[i];
 			auto& pass = m_passes[i];
+			const auto& vs_src = vs_sources[xml_pass.vs];
+			const auto& ps_src = ps_sources[xml_pass.ps];
 
 			pass.name = xml_pass.name;
-			pass.program = create_program(m_vertex_shaders[xml_pass.vs], m_pixel_shaders[xml_pass.ps]);
+			pass.program = 0;
+
+			String binary_path;
+			if (binary_supported)
+			{
+				binary_path = get_program_binary_path(display->GetDeviceName(), display->GetDriverVersion(), vs_src, ps_src);
+
+				float load_begin = Time::GetRealTimeSinceStartup();
+				float compile_time = 0;
+				pass.program = load_program_binary(binary_path, compile_time);
+
+				if (pass.program != 0)
+				{
+					float load_time = (Time::GetRealTimeSinceStartup() - load_begin) * 1000;
+					float saved = compile_time - load_time;
+					if (saved > 0)
+					{
+						m_compile_time_mutex.lock();
+						m_compile_time_saved += saved;
+						m_compile_time_mutex.unlock();
+					}
+
+					Log("shader %s pass %s loaded from program binary, compile time saved: %.1f ms",
+						this->m_name.CString(), pass.name.CString(), saved);
+				}
+			}
+
+			if (pass.program == 0)
+			{
+				float compile_begin = Time::GetRealTimeSinceStartup();
+
+				auto vs = this->GetShader(GL_VERTEX_SHADER, xml_pass.vs, vs_src);
+				auto ps = this->GetShader(GL_FRAGMENT_SHADER, xml_pass.ps, ps_src);
+				pass.program = create_program(vs, ps, binary_supported);
+
+				float compile_time = (Time::GetRealTimeSinceStartup() - compile_begin) * 1000;
+
+				if (pass.program != 0 && binary_supported)
+				{
+					save_program_binary(binary_path, pass.program, compile_time);
+				}
+			}
 
 			prepare_pipeline(xml_pass, xml, pass);
 		}
@@ -20,6 +20,7 @@
 #include "Object.h"
 #include "gles_include.h"
 #include "math/Matrix4x4.h"
+#include "thread/Thread.h"
 
 namespace Viry3D
 {
@@ -64,6 +65,7 @@ namespace Viry3D
 		Vector<const XMLSampler*> sampler_infos;
 		Vector<GLint> sampler_locations;
 		const XMLVertexShader* vs;
+		int vertex_layout;
 		GLRenderState render_state;
 		unsigned int buf_obj_index;
 		unsigned int lightmap_location;
@@ -75,6 +77,9 @@ namespace Viry3D
 	class ShaderGLES: public Object
 	{
 	public:
+		//	total ms saved by loading program binaries instead of compiling sources
+		static float GetCompileTimeSaved();
+
 		virtual ~ShaderGLES();
 
 		int GetPassCount() const { return 1; }
@@ -92,15 +97,19 @@ namespace Viry3D
 		const Vector<GLint>& GetSamplerLocations(int index) const { return m_passes[index].sampler_locations; }
 		const Vector<XMLUniformBuffer*>& GetUniformBufferInfos(int index) const { return m_passes[index].uniform_buffer_infos; }
 		const XMLVertexShader* GetVertexShaderInfo(int index) const { return m_passes[index].vs; }
+		int GetVertexLayout(int index) const { return m_passes[index].vertex_layout; }
 
 	protected:
 		ShaderGLES();
 		void Compile();
 
 	private:
-		void CreateShaders();
+		GLuint GetShader(GLenum type, const String& name, const String& source);
 		void CreatePasses();
 
+		static float m_compile_time_saved;
+		// passes compile on resource load thread
+		static Mutex m_compile_time_mutex;
 		Vector<ShaderPass> m_passes;
 		Map<String, GLuint> m_vertex_shaders;
 		Map<String, GLuint> m_pixel_shaders;
@@ -138,6 +138,12 @@ namespace Viry3D
 			format = GL_RGB;
 			type = GL_FLOAT;
 		}
+		else if (texture_format == TextureFormat::RGBAFloat)
+		{
+			m_format = GL_RGBA32F;
+			format = GL_RGBA;
+			type = GL_FLOAT;
+		}
 		else
 		{
 			assert(!"texture format not implement");
@@ -170,6 +176,11 @@ namespace Viry3D
             format = GL_RED;
 			type = GL_UNSIGNED_BYTE;
 		}
+		else if (texture_format == TextureFormat::RGBAFloat)
+		{
+			format = GL_RGBA;
+			type = GL_FLOAT;
+		}
 		else
 		{
 			assert(!"texture format not implement");
@@ -0,0 +1,162 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#if VR_GLES
+
+#include "TimerQueryGLES.h"
+#include "Debug.h"
+
+#define FRAME_COUNT 3
+#define TIMESTAMP_COUNT_MAX 256
+
+#if VR_ANDROID
+// EXT_disjoint_timer_query, not part of gles 3.0 headers
+#define GL_TIMESTAMP 0x8E28
+#define GL_GPU_DISJOINT 0x8FBB
+typedef void (GL_APIENTRY *QueryCounterFunc)(GLuint id, GLenum target);
+typedef void (GL_APIENTRY *GetQueryObjectui64vFunc)(GLuint id, GLenum pname, GLuint64* params);
+static QueryCounterFunc glQueryCounter = NULL;
+static GetQueryObjectui64vFunc glGetQueryObjectui64v = NULL;
+#endif
+
+namespace Viry3D
+{
+	TimerQueryGLES::TimerQueryGLES(const String& extensions):
+		m_supported(false),
+		m_frame_index(0)
+	{
+#if VR_ANDROID
+		if (extensions.Contains("GL_EXT_disjoint_timer_query"))
+		{
+			glQueryCounter = (QueryCounterFunc) eglGetProcAddress("glQueryCounterEXT");
+			glGetQueryObjectui64v = (GetQueryObjectui64vFunc) eglGetProcAddress("glGetQueryObjectui64vEXT");
+			m_supported = glQueryCounter != NULL && glGetQueryObjectui64v != NULL;
+		}
+#elif VR_WINDOWS
+		m_supported = glQueryCounter != NULL && glGetQueryObjectui64v != NULL;
+#elif VR_MAC
+		m_supported = true;
+#endif
+
+		m_frames.Resize(FRAME_COUNT);
+		for (auto& i : m_frames)
+		{
+			i.count = 0;
+		}
+	}
+
+	TimerQueryGLES::~TimerQueryGLES()
+	{
+		for (auto& i : m_frames)
+		{
+			if (i.queries.Size() > 0)
+			{
+				glDeleteQueries(i.queries.Size(), &i.queries[0]);
+			}
+		}
+		m_frames.Clear();
+	}
+
+	bool TimerQueryGLES::BeginFrame(Vector<double>& timestamps)
+	{
+		if (!m_supported)
+		{
+			return false;
+		}
+
+		m_frame_index = (m_frame_index + 1) % m_frames.Size();
+
+		auto& frame = m_frames[m_frame_index];
+		int count = frame.count;
+		frame.count = 0;
+
+		if (count == 0)
+		{
+			return false;
+		}
+
+		// queries complete in order, last one available means all are
+		GLuint available = 0;
+		glGetQueryObjectuiv(frame.queries[count - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			return false;
+		}
+
+#if VR_ANDROID
+		// gpu frequency changed or context was lost, timestamps are not comparable
+		GLint disjoint = 0;
+		glGetIntegerv(GL_GPU_DISJOINT, &disjoint);
+		if (disjoint)
+		{
+			return false;
+		}
+#endif
+
+#if VR_ANDROID || VR_WINDOWS || VR_MAC
+		timestamps.Resize(count);
+
+		GLuint64 first = 0;
+		for (int i = 0; i < count; i++)
+		{
+			GLuint64 ns = 0;
+			glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &ns);
+			if (i == 0)
+			{
+				first = ns;
+			}
+
+			timestamps[i] = (double) (int64_t) (ns - first) / 1000000.0;
+		}
+
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	int TimerQueryGLES::Write()
+	{
+		if (!m_supported)
+		{
+			return -1;
+		}
+
+		auto& frame = m_frames[m_frame_index];
+		if (frame.count == frame.queries.Size())
+		{
+			if (frame.queries.Size() >= TIMESTAMP_COUNT_MAX)
+			{
+				return -1;
+			}
+
+			GLuint query = 0;
+			glGenQueries(1, &query);
+			frame.queries.Add(query);
+		}
+
+		int index = frame.count++;
+
+#if VR_ANDROID || VR_WINDOWS || VR_MAC
+		glQueryCounter(frame.queries[index], GL_TIMESTAMP);
+#endif
+
+		return index;
+	}
+}
+
+#endif
@@ -0,0 +1,52 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "gles_include.h"
+#include "string/String.h"
+#include "container/Vector.h"
+
+namespace Viry3D
+{
+	//	timestamp queries of last frames, a frame is read when its queries are reused,
+	//	results not available by then are dropped instead of waited
+	class TimerQueryGLES
+	{
+	public:
+		TimerQueryGLES(const String& extensions);
+		~TimerQueryGLES();
+		bool IsSupported() const { return m_supported; }
+		int GetFrameIndex() const { return m_frame_index; }
+		//	moves to next frame, gets timestamps in ms of frame used it before,
+		//	false when it wrote none or they are not available or disjoint
+		bool BeginFrame(Vector<double>& timestamps);
+		//	on context thread, -1 when frame has no query left
+		int Write();
+
+	private:
+		struct Frame
+		{
+			Vector<GLuint> queries;
+			int count;
+		};
+
+		bool m_supported;
+		Vector<Frame> m_frames;
+		int m_frame_index;
+	};
+}
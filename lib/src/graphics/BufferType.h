@@ -17,6 +17,9 @@
 
 #pragma once
 
+// dynamic buffers grow with headroom, producers changing size every frame would reallocate otherwise
+#define DYNAMIC_BUFFER_CAPACITY(size) ((size) + (size) / 2)
+
 namespace Viry3D
 {
 	enum class BufferType
@@ -23,7 +23,12 @@
 #include "Material.h"
 #include "RenderPass.h"
 #include "RenderTexture.h"
+#include "RenderGraph.h"
+#include "RenderThread.h"
+#include "LightCluster.h"
+#include "Light.h"
 #include "time/Time.h"
+#include "math/Mathf.h"
 #include "renderer/Renderer.h"
 #include "postprocess/ImageEffect.h"
 
@@ -33,18 +38,18 @@ namespace Viry3D
 
 	List<Camera*> Camera::m_cameras;
 	Camera* Camera::m_current;
-	Ref<FrameBuffer> Camera::m_post_target_front;
-	Ref<FrameBuffer> Camera::m_post_target_back;
+	Ref<RenderGraph> Camera::m_render_graph;
 
 	void Camera::Init()
 	{
+		m_render_graph = RefMake<RenderGraph>();
 	}
 
 	void Camera::Deinit()
 	{
 		m_cameras.Clear();
-		m_post_target_front.reset();
-		m_post_target_back.reset();
+		m_render_graph.reset();
+		LightCluster::Deinit();
 	}
 
 	bool Camera::IsValidCamera(Camera* cam)
@@ -66,7 +71,9 @@ namespace Viry3D
 		m_matrix_dirty(true),
         m_matrix_external(false),
         m_frustum_culling(true),
-		m_render_mode(CameraRenderMode::Normal)
+		m_render_mode(CameraRenderMode::Normal),
+		m_shadow_casters(CameraShadowCasters::All),
+		m_render_scale(1)
 	{
 		m_cameras.AddLast(this);
 
@@ -97,6 +104,16 @@ namespace Viry3D
 		}
 	}
 
+	void Camera::SetShadowCasters(CameraShadowCasters casters)
+	{
+		if (m_shadow_casters != casters)
+		{
+			m_shadow_casters = casters;
+
+			Renderer::SetCullingDirty(this);
+		}
+	}
+
 	void Camera::SetDepth(int depth)
 	{
 		m_depth = depth;
@@ -125,6 +142,12 @@ namespace Viry3D
 	}
 
 	void Camera::OnTranformChanged()
+	{
+		this->SetMatrixDirty();
+	}
+
+	// projection settings change frustum too
+	void Camera::SetMatrixDirty()
 	{
 		m_matrix_dirty = true;
 
@@ -141,8 +164,7 @@ namespace Viry3D
 
 			Renderer::SetCullingDirty(i);
 		}
-		m_post_target_front.reset();
-		m_post_target_back.reset();
+		m_render_graph->Clear();
 
 		Renderer::OnResize(width, height);
 	}
@@ -157,33 +179,188 @@ namespace Viry3D
 
 			Renderer::SetCullingDirty(i);
 		}
-		m_post_target_front.reset();
-		m_post_target_back.reset();
+		m_render_graph->Clear();
 
 		Renderer::OnPause();
 	}
 
-	void Camera::RenderAll()
+	void Camera::PrepareAll()
 	{
-		Profiler::SampleBegin("Camera::RenderAll");
+		Profiler::SampleBegin("Camera::PrepareAll");
 
+		Renderer::BeginFrame();
+
+		List<Camera*> cameras;
 		for (auto i : m_cameras)
 		{
 			if (i->CanRender())
 			{
-				m_current = i;
-				i->Prepare();
-				i->Render();
+				cameras.AddLast(i);
+			}
+		}
+		Renderer::CullingAll(cameras);
+
+		m_render_graph->Reset();
+
+		auto render_thread = Graphics::GetRenderThread();
+
+		for (auto i : cameras)
+		{
+			i->AddPasses(m_render_graph.get());
+
+			// passes of camera run on render thread after main thread may have destroyed it
+			if (render_thread)
+			{
+				render_thread->Retain(i->GetGameObject());
 			}
 		}
+
+		m_render_graph->Compile();
+		m_render_graph->Prepare();
+
+		m_current = NULL;
+
+		Profiler::SampleEnd();
+	}
+
+	void Camera::RenderAll()
+	{
+		Profiler::SampleBegin("Camera::RenderAll");
+
+		m_render_graph->Execute();
+
 		m_current = NULL;
 
 		Profiler::SampleEnd();
 	}
 
+	void Camera::AddPasses(RenderGraph* graph)
+	{
+		auto effects = this->GetGameObject()->GetComponents<ImageEffect>();
+
+		Ref<RenderTexture> target_texture;
+		if (m_frame_buffer)
+		{
+			target_texture = m_frame_buffer->color_texture ? m_frame_buffer->color_texture : m_frame_buffer->depth_texture;
+		}
+		int target = graph->ImportTexture("CameraTarget", target_texture);
+
+		// scene is rendered into a transient when image effects follow or it is scaled down
+		RenderGraphTextureDesc desc = {
+			Mathf::Max((int) (this->GetTargetWidth() * m_render_scale + 0.5f), 1),
+			Mathf::Max((int) (this->GetTargetHeight() * m_render_scale + 0.5f), 1),
+			RenderTextureFormat::RGBA32,
+			DepthBuffer::Depth_0,
+			FilterMode::Bilinear
+		};
+		bool scaled = m_render_scale < 1;
+		int color = effects.Empty() && !scaled ? target : graph->CreateTexture("CameraColor", desc);
+
+		int pass = graph->AddPass("Camera", [=]() {
+			m_current = this;
+
+			this->Render();
+		});
+		graph->SetPrepare(pass, [=]() {
+			m_current = this;
+
+			if (color == target)
+			{
+				m_target_rendering = m_frame_buffer;
+			}
+			else
+			{
+				if (!m_target_rendering || m_target_rendering == m_frame_buffer)
+				{
+					m_target_rendering = RefMake<FrameBuffer>();
+				}
+				m_target_rendering->color_texture = graph->GetTexture(color);
+			}
+
+			this->Prepare();
+		});
+		graph->Write(pass, color);
+
+		int src = color;
+		int i = 0;
+		while (i < effects.Size())
+		{
+			// consecutive composable effects run as one pass
+			Vector<ImageEffect*> composed;
+			while (i < effects.Size() && effects[i]->IsComposable())
+			{
+				composed.Add(effects[i].get());
+				i++;
+			}
+
+			Ref<ImageEffect> effect;
+			if (composed.Empty())
+			{
+				effect = effects[i];
+				i++;
+			}
+
+			int dest = i == effects.Size() ? target : graph->CreateTexture("ImageEffect", desc);
+
+			if (composed.Empty())
+			{
+				pass = graph->AddPass("ImageEffect", [=]() {
+					m_current = this;
+
+					Profiler::GPUSampleBegin("ImageEffect");
+					effect->OnRenderImage(graph->GetTexture(src), graph->GetTexture(dest));
+					Profiler::GPUSampleEnd();
+				});
+			}
+			else
+			{
+				pass = graph->AddPass("ImageEffectComposed", [=]() {
+					m_current = this;
+
+					Profiler::GPUSampleBegin("ImageEffectComposed");
+					ImageEffect::RenderComposed(composed, graph->GetTexture(src), graph->GetTexture(dest));
+					Profiler::GPUSampleEnd();
+				});
+			}
+			graph->Read(pass, src);
+			graph->Write(pass, dest);
+
+			src = dest;
+		}
+
+		// last image effect upscales into target, without one a bilinear blit does
+		if (src != target)
+		{
+			pass = graph->AddPass("Upscale", [=]() {
+				m_current = this;
+
+				Graphics::Blit(graph->GetTexture(src), graph->GetTexture(target));
+			});
+			graph->Read(pass, src);
+			graph->Write(pass, target);
+		}
+	}
+
 	void Camera::Prepare()
 	{
-		this->DecideTarget();
+		if (m_render_pass)
+		{
+			// transient target may be another render texture than last frame
+			auto frame_buffer = m_render_pass->GetFrameBuffer();
+			Ref<RenderTexture> color_texture;
+			Ref<RenderTexture> depth_texture;
+			if (m_target_rendering)
+			{
+				color_texture = m_target_rendering->color_texture;
+				depth_texture = m_target_rendering->depth_texture;
+			}
+
+			if (frame_buffer.color_texture != color_texture || frame_buffer.depth_texture != depth_texture)
+			{
+				m_render_pass.reset();
+				m_render_pass_post.reset();
+			}
+		}
 
 		if (!m_render_pass)
 		{
@@ -199,6 +376,11 @@ namespace Viry3D
 			}
 		}
 
+		if (m_render_mode == CameraRenderMode::Normal)
+		{
+			this->UpdateLightCluster();
+		}
+
 		m_render_pass->Bind();
 
 		Renderer::PrepareAllPass();
@@ -206,9 +388,36 @@ namespace Viry3D
 		m_render_pass->Unbind();
 	}
 
+	// light lists are needed by materials before passes are prepared
+	void Camera::UpdateLightCluster()
+	{
+		if (!m_light_cluster)
+		{
+			bool has_light = false;
+			for (auto i : Light::GetLights())
+			{
+				if (i->type != LightType::Directional && i->IsShading())
+				{
+					has_light = true;
+					break;
+				}
+			}
+
+			if (!has_light)
+			{
+				return;
+			}
+
+			m_light_cluster = RefMake<LightCluster>();
+		}
+
+		Profiler::SampleBegin("LightCluster::Update");
+		m_light_cluster->Update(this);
+		Profiler::SampleEnd();
+	}
+
 	void Camera::BeginRenderPass(bool post) const
 	{
-		Graphics::GetDisplay()->WaitQueueIdle();
 		if (post)
 		{
 			m_render_pass_post->Begin(this->GetClearColor());
@@ -235,109 +444,22 @@ namespace Viry3D
 
 	void Camera::Render()
 	{
+		Profiler::GPUSampleBegin("Camera:" + this->GetName());
 		this->BeginRenderPass(false);
 		Renderer::RenderAllPass();
 		this->EndRenderPass(false);
+		Profiler::GPUSampleEnd();
 
 		this->GetGameObject()->OnPostRender();
 		if (m_post_render_func)
 		{
 			m_post_render_func();
 		}
-
-		this->PostProcess();
-	}
-
-	Ref<FrameBuffer> Camera::GetPostTargetFront()
-	{
-		if (!m_post_target_front)
-		{
-			m_post_target_front = RefMake<FrameBuffer>();
-			m_post_target_front->color_texture = RenderTexture::Create(
-				this->GetTargetWidth(),
-				this->GetTargetHeight(),
-				RenderTextureFormat::RGBA32,
-				DepthBuffer::Depth_0,
-				FilterMode::Bilinear);
-		}
-
-		return m_post_target_front;
-	}
-
-	Ref<FrameBuffer> Camera::GetPostTargetBack()
-	{
-		if (!m_post_target_back)
-		{
-			m_post_target_back = RefMake<FrameBuffer>();
-			m_post_target_back->color_texture = RenderTexture::Create(
-				this->GetTargetWidth(),
-				this->GetTargetHeight(),
-				RenderTextureFormat::RGBA32,
-				DepthBuffer::Depth_0,
-				FilterMode::Bilinear);
-		}
-
-		return m_post_target_back;
-	}
-
-	void Camera::SwapPostTargets()
-	{
-		if (m_post_target_front && m_post_target_back)
-		{
-			RefSwap(m_post_target_front, m_post_target_back);
-		}
-	}
-
-	void Camera::DecideTarget()
-	{
-		auto effects = this->GetGameObject()->GetComponents<ImageEffect>();
-
-		if (effects.Empty())
-		{
-			m_target_rendering = m_frame_buffer;
-		}
-		else
-		{
-			m_target_rendering = this->GetPostTargetFront();
-		}
 	}
 
-	void Camera::PostProcess()
+	void Camera::SetRenderScale(float scale)
 	{
-		auto effects = this->GetGameObject()->GetComponents<ImageEffect>();
-
-		if (!effects.Empty())
-		{
-			for (int i = 0; i < effects.Size(); i++)
-			{
-				Ref<FrameBuffer> src = this->GetPostTargetFront();
-				Ref<FrameBuffer> dest;
-				Ref<RenderTexture> src_texture;
-				Ref<RenderTexture> dest_texture;
-
-				if (i == effects.Size() - 1)
-				{
-					dest = m_frame_buffer;
-				}
-				else
-				{
-					dest = this->GetPostTargetBack();
-				}
-
-				if (src)
-				{
-					src_texture = src->color_texture;
-				}
-				if (dest)
-				{
-					dest_texture = dest->color_texture;
-				}
-
-				effects[i]->OnRenderImage(src_texture, dest_texture);
-
-				this->SwapPostTargets();
-			}
-		}
+		m_render_scale = Mathf::Clamp01(scale);
 	}
 
 	int Camera::GetTargetWidth() const
@@ -403,6 +525,7 @@ namespace Viry3D
 		}
 
 		m_view_projection_matrix = m_projection_matrix * m_view_matrix;
+		m_frustum = Frustum(m_view_projection_matrix);
 	}
 
 	const Matrix4x4& Camera::GetViewMatrix()
@@ -440,8 +563,6 @@ namespace Viry3D
 		if (m_matrix_dirty)
 		{
 			UpdateMatrix();
-
-			m_frustum = Frustum(m_view_projection_matrix);
 		}
 
 		return m_frustum;
@@ -31,6 +31,8 @@
 namespace Viry3D
 {
 	class RenderPass;
+	class RenderGraph;
+	class LightCluster;
 
 	enum class CameraRenderMode
 	{
@@ -38,6 +40,14 @@ namespace Viry3D
 		ShadowMap,
 	};
 
+	//	casters drawn by a shadow map camera
+	enum class CameraShadowCasters
+	{
+		All,
+		Static,
+		Dynamic,
+	};
+
 	class Camera: public Component
 	{
 		DECLARE_COM_CLASS(Camera, Component);
@@ -45,11 +55,16 @@ namespace Viry3D
 	public:
 		static void Init();
 		static void Deinit();
+		//	builds render graph and prepares passes of cameras, reads scene on main thread
+		static void PrepareAll();
+		//	records and submits passes prepared by PrepareAll
 		static void RenderAll();
 		static Camera* Current() { return m_current; }
 		static bool IsValidCamera(Camera* cam);
 		static void OnResize(int width, int height);
 		static void OnPause();
+		//	passes of cameras and image effects declared for last frame
+		static RenderGraph* GetRenderGraph() { return m_render_graph.get(); }
 
 		virtual ~Camera();
 		int GetDepth() const { return m_depth; }
@@ -59,17 +74,17 @@ namespace Viry3D
 		const Color& GetClearColor() const { return m_clear_color; }
 		void SetClearColor(const Color& color) { m_clear_color = color; }
 		bool IsOrthographic() const { return m_orthographic; }
-		void SetOrthographic(bool value) { m_orthographic = value; }
+		void SetOrthographic(bool value) { m_orthographic = value; this->SetMatrixDirty(); }
 		float GetOrthographicSize() const { return m_orthographic_size; }
-		void SetOrthographicSize(float size) { m_orthographic_size = size; }
+		void SetOrthographicSize(float size) { m_orthographic_size = size; this->SetMatrixDirty(); }
 		float GetFieldOfView() const { return m_field_of_view; }
-		void SetFieldOfView(float fov) { m_field_of_view = fov; }
+		void SetFieldOfView(float fov) { m_field_of_view = fov; this->SetMatrixDirty(); }
 		float GetClipNear() const { return m_clip_near; }
-		void SetClipNear(float value) { m_clip_near = value; }
+		void SetClipNear(float value) { m_clip_near = value; this->SetMatrixDirty(); }
 		float GetClipFar() const { return m_clip_far; }
-		void SetClipFar(float value) { m_clip_far = value; }
+		void SetClipFar(float value) { m_clip_far = value; this->SetMatrixDirty(); }
 		const Rect& GetRect() const { return m_rect; }
-		void SetRect(const Rect& rect) { m_rect = rect; }
+		void SetRect(const Rect& rect) { m_rect = rect; this->SetMatrixDirty(); }
 		int GetCullingMask() const { return m_culling_mask; }
 		void SetCullingMask(int mask);
 		bool IsHdr() const { return m_hdr; }
@@ -87,8 +102,13 @@ namespace Viry3D
 		void SetFrameBuffer(const Ref<FrameBuffer>& frame_buffer);
 		int GetTargetWidth() const;
 		int GetTargetHeight() const;
+		//	scene renders at target size times scale and is upscaled by post process, at most 1
+		float GetRenderScale() const { return m_render_scale; }
+		void SetRenderScale(float scale);
 		void SetPostRenderFunc(Action func) { m_post_render_func = func; }
 		void SetRenderMode(CameraRenderMode mode) { m_render_mode = mode; }
+		CameraShadowCasters GetShadowCasters() const { return m_shadow_casters; }
+		void SetShadowCasters(CameraShadowCasters casters);
 		CameraRenderMode GetRenderMode() { return m_render_mode; }
 		Vector3 ScreenToViewportPoint(const Vector3& position);
 		Vector3 ViewportToScreenPoint(const Vector3& position);
@@ -97,6 +117,8 @@ namespace Viry3D
 		Ray ScreenPointToRay(const Vector3& position);
 		void BeginRenderPass(bool post) const;
 		void EndRenderPass(bool post) const;
+		//	NULL until a point or spot light is shading
+		const LightCluster* GetLightCluster() const { return m_light_cluster.get(); }
 
 	protected:
 		virtual void OnTranformChanged();
@@ -105,20 +127,17 @@ namespace Viry3D
 		static bool Less(const Camera *c1, const Camera *c2);
 
 		Camera();
+		void AddPasses(RenderGraph* graph);
 		void Prepare();
+		void UpdateLightCluster();
 		void Render();
-		void DecideTarget();
-		void PostProcess();
 		void UpdateMatrix();
-		Ref<FrameBuffer> GetPostTargetFront();
-		Ref<FrameBuffer> GetPostTargetBack();
-		void SwapPostTargets();
+		void SetMatrixDirty();
 
 		static List<Camera*> m_cameras;
 		static Camera* m_current;
 		static int m_current_index;
-		static Ref<FrameBuffer> m_post_target_front;
-		static Ref<FrameBuffer> m_post_target_back;
+		static Ref<RenderGraph> m_render_graph;
 
 		int m_depth;
 		CameraClearFlags m_clear_flags;
@@ -147,5 +166,8 @@ namespace Viry3D
 		Ref<RenderPass> m_render_pass_post;
 		Action m_post_render_func;
 		CameraRenderMode m_render_mode;
+		CameraShadowCasters m_shadow_casters;
+		Ref<LightCluster> m_light_cluster;
+		float m_render_scale;
 	};
 }
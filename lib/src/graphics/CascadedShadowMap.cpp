@@ -0,0 +1,474 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "CascadedShadowMap.h"
+#include "Camera.h"
+#include "Light.h"
+#include "Material.h"
+#include "Shader.h"
+#include "Texture2D.h"
+#include "RenderTexture.h"
+#include "GameObject.h"
+#include "Debug.h"
+#include "math/Mathf.h"
+#include "renderer/Renderer.h"
+
+namespace Viry3D
+{
+	DEFINE_COM_CLASS(CascadedShadowMap);
+
+	List<CascadedShadowMap*> CascadedShadowMap::m_shadow_maps;
+
+	CascadedShadowMap::CascadedShadowMap():
+		m_cascade_count(4),
+		m_shadow_distance(50),
+		m_split_lambda(0.75f),
+		m_caster_distance(50),
+		m_map_size(2048),
+		m_culling_mask(-1),
+		m_bias(0.005f),
+		m_strength(0.7f),
+		m_static_cache(true),
+		m_static_valid(false),
+		m_static_dirty(false),
+		m_static_version(0),
+		m_static_render_count(0)
+	{
+		m_shadow_maps.AddLast(this);
+	}
+
+	CascadedShadowMap::~CascadedShadowMap()
+	{
+		m_shadow_maps.Remove(this);
+		this->DestroyCascades();
+	}
+
+	void CascadedShadowMap::DeepCopy(const Ref<Object>& source)
+	{
+		assert(!"not implemment!");
+	}
+
+	void CascadedShadowMap::SetCascadeCount(int count)
+	{
+		count = Mathf::Clamp(count, 1, SHADOW_CASCADE_MAX);
+		if (m_cascade_count != count)
+		{
+			m_cascade_count = count;
+			this->DestroyCascades();
+		}
+	}
+
+	void CascadedShadowMap::SetMapSize(int size)
+	{
+		if (m_map_size != size)
+		{
+			m_map_size = size;
+			this->DestroyCascades();
+		}
+	}
+
+	void CascadedShadowMap::SetStaticCache(bool enable)
+	{
+		if (m_static_cache != enable)
+		{
+			m_static_cache = enable;
+			this->DestroyCascades();
+		}
+	}
+
+	void CascadedShadowMap::SetCullingMask(int mask)
+	{
+		m_culling_mask = mask;
+		for (auto& i : m_cascades)
+		{
+			i->SetCullingMask(mask);
+		}
+		for (auto& i : m_static_cascades)
+		{
+			i->SetCullingMask(mask);
+		}
+		m_static_valid = false;
+	}
+
+	Ref<RenderTexture> CascadedShadowMap::GetStaticShadowMap() const
+	{
+		if (m_static_atlas)
+		{
+			return m_static_atlas->depth_texture;
+		}
+
+		return Ref<RenderTexture>();
+	}
+
+	int CascadedShadowMap::GetCasterCount(int cascade) const
+	{
+		if (cascade < m_cascades.Size())
+		{
+			return Renderer::GetCulledRendererCount(m_cascades[cascade].get());
+		}
+
+		return 0;
+	}
+
+	int CascadedShadowMap::GetStaticCasterCount(int cascade) const
+	{
+		if (cascade < m_static_cascades.Size())
+		{
+			return Renderer::GetCulledRendererCount(m_static_cascades[cascade].get());
+		}
+
+		return 0;
+	}
+
+	void CascadedShadowMap::LogStats() const
+	{
+		String casters;
+		String static_casters;
+		for (int i = 0; i < m_cascades.Size(); i++)
+		{
+			casters += String::Format(" %d", this->GetCasterCount(i));
+		}
+		for (int i = 0; i < m_static_cascades.Size(); i++)
+		{
+			static_casters += String::Format(" %d", this->GetStaticCasterCount(i));
+		}
+
+		Log("cascaded shadow cascades:%d map:%d splits:%.2f %.2f %.2f %.2f casters:%s static casters:%s static renders:%d",
+			m_cascade_count,
+			m_map_size,
+			m_splits.x, m_splits.y, m_splits.z, m_splits.w,
+			casters.CString(),
+			static_casters.CString(),
+			m_static_render_count);
+	}
+
+	void CascadedShadowMap::Start()
+	{
+		this->UpdateCascades();
+	}
+
+	void CascadedShadowMap::LateUpdate()
+	{
+		this->UpdateCascades();
+	}
+
+	void CascadedShadowMap::OnEnable()
+	{
+		for (auto& i : m_cascades)
+		{
+			i->GetGameObject()->SetActive(true);
+		}
+		for (auto& i : m_static_cascades)
+		{
+			i->GetGameObject()->SetActive(true);
+		}
+		m_static_valid = false;
+	}
+
+	void CascadedShadowMap::OnDisable()
+	{
+		for (auto& i : m_cascades)
+		{
+			i->GetGameObject()->SetActive(false);
+		}
+		for (auto& i : m_static_cascades)
+		{
+			i->GetGameObject()->SetActive(false);
+		}
+	}
+
+	static Ref<FrameBuffer> CreateAtlas(int size)
+	{
+		auto atlas = RefMake<FrameBuffer>();
+		atlas->color_texture = RenderTexture::Create(size, size, RenderTextureFormat::R8, DepthBuffer::Depth_0, FilterMode::Bilinear);
+		atlas->depth_texture = RenderTexture::Create(size, size, RenderTextureFormat::Depth, DepthBuffer::Depth_24, FilterMode::Bilinear);
+		return atlas;
+	}
+
+	Ref<Camera> CascadedShadowMap::CreateCascade(const String& name, int index, int depth, const Ref<FrameBuffer>& atlas, CameraShadowCasters casters)
+	{
+		// cascades are tiles of a 2x2 atlas, one render pass each
+		float tile_scale = m_cascade_count > 1 ? 0.5f : 1.0f;
+
+		auto cascade = GameObject::Create(name)->AddComponent<Camera>();
+		cascade->SetOrthographic(true);
+		cascade->SetDepth(depth);
+		cascade->SetCullingMask(m_culling_mask);
+		cascade->SetFrameBuffer(atlas);
+		cascade->SetRenderMode(CameraRenderMode::ShadowMap);
+		cascade->SetShadowCasters(casters);
+		cascade->SetRect(Rect((index % 2) * tile_scale, (index / 2) * tile_scale, tile_scale, tile_scale));
+		// pass clears whole atlas, only first cascade may clear
+		cascade->SetClearFlags(index == 0 ? CameraClearFlags::Color : CameraClearFlags::Nothing);
+		return cascade;
+	}
+
+	void CascadedShadowMap::CreateCascades()
+	{
+		auto camera = m_camera.lock();
+
+		m_atlas = CreateAtlas(m_map_size);
+		if (m_static_cache)
+		{
+			m_static_atlas = CreateAtlas(m_map_size);
+		}
+
+		for (int i = 0; i < m_cascade_count; i++)
+		{
+			if (m_static_cache)
+			{
+				int static_depth = camera->GetDepth() - (SHADOW_CASCADE_MAX * 2 - i);
+				m_static_cascades.Add(this->CreateCascade(String::Format("ShadowCascadeStatic%d", i), i, static_depth, m_static_atlas, CameraShadowCasters::Static));
+			}
+
+			int depth = camera->GetDepth() - (SHADOW_CASCADE_MAX - i);
+			auto casters = m_static_cache ? CameraShadowCasters::Dynamic : CameraShadowCasters::All;
+			m_cascades.Add(this->CreateCascade(String::Format("ShadowCascade%d", i), i, depth, m_atlas, casters));
+		}
+
+		m_static_valid = false;
+	}
+
+	void CascadedShadowMap::DestroyCascades()
+	{
+		for (auto& i : m_cascades)
+		{
+			GameObject::Destroy(i->GetGameObject());
+		}
+		m_cascades.Clear();
+		m_atlas.reset();
+
+		for (auto& i : m_static_cascades)
+		{
+			GameObject::Destroy(i->GetGameObject());
+		}
+		m_static_cascades.Clear();
+		m_static_atlas.reset();
+		m_static_valid = false;
+	}
+
+	void CascadedShadowMap::UpdateCascades()
+	{
+		auto camera = m_camera.lock();
+		if (!camera)
+		{
+			return;
+		}
+
+		if (m_cascades.Empty())
+		{
+			this->CreateCascades();
+		}
+
+		float clip_near = camera->GetClipNear();
+		float clip_far = Mathf::Min(camera->GetClipFar(), clip_near + m_shadow_distance);
+
+		// practical split scheme, blend of logarithmic and uniform splits
+		float splits[SHADOW_CASCADE_MAX + 1];
+		splits[0] = clip_near;
+		for (int i = 1; i <= m_cascade_count; i++)
+		{
+			float p = i / (float) m_cascade_count;
+			float split_log = clip_near * pow(clip_far / clip_near, p);
+			float split_uniform = clip_near + (clip_far - clip_near) * p;
+			splits[i] = m_split_lambda * split_log + (1 - m_split_lambda) * split_uniform;
+		}
+		for (int i = m_cascade_count + 1; i <= SHADOW_CASCADE_MAX; i++)
+		{
+			splits[i] = clip_far;
+		}
+		m_splits = Vector4(splits[1], splits[2], splits[3], splits[4]);
+
+		auto transform = camera->GetTransform();
+		Vector3 position = transform->GetPosition();
+		Vector3 forward = transform->GetForward();
+		Vector3 right = transform->GetRight();
+		Vector3 up = transform->GetUp();
+		float aspect = camera->GetTargetWidth() / (float) camera->GetTargetHeight();
+
+		const auto& view = camera->GetViewMatrix();
+		m_view_z = Vector4(view.m20, view.m21, view.m22, view.m23);
+
+		// regions compare against static atlas in FitCascade
+		const auto& light_rotation = this->GetTransform()->GetRotation();
+		m_static_dirty = !m_static_valid ||
+			m_static_version != Renderer::GetStaticVersion() ||
+			m_static_light_rotation != light_rotation;
+
+		Vector<Vector3> corners(8);
+		for (int i = 0; i < m_cascade_count; i++)
+		{
+			for (int j = 0; j < 2; j++)
+			{
+				float z = splits[i + j];
+				float h;
+				float w;
+				if (camera->IsOrthographic())
+				{
+					h = camera->GetOrthographicSize();
+				}
+				else
+				{
+					h = tan(camera->GetFieldOfView() * Mathf::Deg2Rad / 2) * z;
+				}
+				w = h * aspect;
+
+				Vector3 center = position + forward * z;
+				corners[j * 4 + 0] = center - right * w - up * h;
+				corners[j * 4 + 1] = center + right * w - up * h;
+				corners[j * 4 + 2] = center + right * w + up * h;
+				corners[j * 4 + 3] = center - right * w + up * h;
+			}
+
+			this->FitCascade(i, corners);
+		}
+
+		if (m_static_cache)
+		{
+			this->UpdateStaticCascades();
+		}
+	}
+
+	void CascadedShadowMap::FitCascade(int index, const Vector<Vector3>& corners)
+	{
+		auto light_transform = this->GetTransform();
+		Vector3 light_forward = light_transform->GetForward();
+		Vector3 light_right = light_transform->GetRight();
+		Vector3 light_up = light_transform->GetUp();
+
+		// bounding sphere of slice keeps cascade size constant when camera rotates
+		Vector3 center;
+		for (int i = 0; i < corners.Size(); i++)
+		{
+			center += corners[i];
+		}
+		center = center * (1.0f / corners.Size());
+
+		float radius = 0;
+		for (int i = 0; i < corners.Size(); i++)
+		{
+			radius = Mathf::Max(radius, (corners[i] - center).Magnitude());
+		}
+
+		// cached cascades cover a bigger region moving in steps of a quarter of slice radius,
+		// so static atlas is kept until the region scrolls a step
+		float margin = m_static_cache ? 1.25f : 1.0f;
+		float region = ceil(radius * margin * 16) / 16;
+
+		// move center by whole texels in light space, edges of shadows stay still when camera moves
+		float tile_size = m_map_size * (m_cascade_count > 1 ? 0.5f : 1.0f);
+		float texel = region * 2 / tile_size;
+		float step = texel;
+		if (m_static_cache)
+		{
+			step = Mathf::Max(texel, floor(radius * 0.25f / texel) * texel);
+		}
+		float x = floor(center.Dot(light_right) / step) * step;
+		float y = floor(center.Dot(light_up) / step) * step;
+		float z = center.Dot(light_forward);
+		if (m_static_cache)
+		{
+			z = floor(z / step) * step;
+		}
+		Vector3 snapped = light_right * x + light_up * y + light_forward * z;
+
+		Vector3 position = snapped - light_forward * (region + m_caster_distance);
+		const auto& rotation = light_transform->GetRotation();
+
+		auto& cascade = m_cascades[index];
+		cascade->GetTransform()->SetPosition(position);
+		cascade->GetTransform()->SetRotation(rotation);
+		cascade->SetOrthographicSize(region);
+		cascade->SetClipNear(0);
+		cascade->SetClipFar(m_caster_distance + region * 2);
+
+		m_view_projections[index] = cascade->GetProjectionMatrix() * cascade->GetViewMatrix();
+
+		if (m_static_cache)
+		{
+			if (m_static_centers[index] != snapped || m_static_radius[index] != region)
+			{
+				m_static_centers[index] = snapped;
+				m_static_radius[index] = region;
+				m_static_dirty = true;
+			}
+
+			// static cascade keeps the box it was rendered with until it is rendered again
+			auto& static_cascade = m_static_cascades[index];
+			if (m_static_dirty)
+			{
+				static_cascade->GetTransform()->SetPosition(position);
+				static_cascade->GetTransform()->SetRotation(rotation);
+				static_cascade->SetOrthographicSize(region);
+				static_cascade->SetClipNear(0);
+				static_cascade->SetClipFar(m_caster_distance + region * 2);
+			}
+		}
+	}
+
+	void CascadedShadowMap::UpdateStaticCascades()
+	{
+		// static cascades only render in frames their atlas changes
+		for (auto& i : m_static_cascades)
+		{
+			i->Enable(m_static_dirty);
+		}
+
+		if (m_static_dirty)
+		{
+			m_static_valid = true;
+			m_static_version = Renderer::GetStaticVersion();
+			m_static_light_rotation = this->GetTransform()->GetRotation();
+			m_static_render_count++;
+		}
+	}
+
+	void CascadedShadowMap::SetMaterialUniforms(Camera* camera, const Ref<Material>& material)
+	{
+		for (auto i : m_shadow_maps)
+		{
+			if (i->m_cascades.Empty() || i->m_camera.lock().get() != camera || !i->IsEnable())
+			{
+				continue;
+			}
+
+			float tile_scale = i->m_cascade_count > 1 ? 0.5f : 1.0f;
+			float texel = 1.0f / i->m_map_size;
+
+			material->SetTexture("_ShadowMap", i->m_atlas->depth_texture);
+			if (i->m_static_atlas)
+			{
+				material->SetTexture("_ShadowMapStatic", i->m_static_atlas->depth_texture);
+			}
+			else
+			{
+				material->SetTexture("_ShadowMapStatic", Shader::GetDefaultTexture("white"));
+			}
+			for (int j = 0; j < i->m_cascade_count; j++)
+			{
+				material->SetMatrix(String::Format("_ViewProjectionCascade%d", j), i->m_view_projections[j]);
+			}
+			material->SetVector("_CascadeSplits", i->m_splits);
+			material->SetVector("_CascadeViewZ", i->m_view_z);
+			material->SetVector("_CascadeParams", Vector4((float) i->m_cascade_count, tile_scale));
+			material->SetVector("_ShadowMapTexel", Vector4(texel, texel));
+			material->SetVector("_ShadowParam", Vector4(i->m_bias, i->m_strength));
+			break;
+		}
+	}
+}
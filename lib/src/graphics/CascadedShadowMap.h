@@ -0,0 +1,124 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include "Component.h"
+#include "Camera.h"
+#include "FrameBuffer.h"
+#include "RenderTexture.h"
+#include "math/Matrix4x4.h"
+#include "math/Vector4.h"
+#include "math/Quaternion.h"
+#include "container/List.h"
+#include "container/Vector.h"
+
+#define SHADOW_CASCADE_MAX 4
+
+namespace Viry3D
+{
+	class Material;
+
+	//	shadows of the directional light on this game object for one camera,
+	//	cascades are fitted to slices of camera view and share one atlas,
+	//	static casters may be cached in a second atlas only rendered when it changes
+	class CascadedShadowMap: public Component
+	{
+		DECLARE_COM_CLASS(CascadedShadowMap, Component);
+
+	public:
+		//	receiver uniforms of shadow map rendered for camera
+		static void SetMaterialUniforms(Camera* camera, const Ref<Material>& material);
+
+		virtual ~CascadedShadowMap();
+		Ref<Camera> GetCamera() const { return m_camera.lock(); }
+		void SetCamera(const Ref<Camera>& camera) { m_camera = camera; }
+		int GetCascadeCount() const { return m_cascade_count; }
+		void SetCascadeCount(int count);
+		float GetShadowDistance() const { return m_shadow_distance; }
+		void SetShadowDistance(float distance) { m_shadow_distance = distance; }
+		//	0 splits uniformly, 1 logarithmically
+		float GetSplitLambda() const { return m_split_lambda; }
+		void SetSplitLambda(float lambda) { m_split_lambda = lambda; }
+		//	distance towards light casters outside cascade still cast into it
+		float GetCasterDistance() const { return m_caster_distance; }
+		void SetCasterDistance(float distance) { m_caster_distance = distance; }
+		int GetMapSize() const { return m_map_size; }
+		void SetMapSize(int size);
+		int GetCullingMask() const { return m_culling_mask; }
+		void SetCullingMask(int mask);
+		float GetBias() const { return m_bias; }
+		void SetBias(float bias) { m_bias = bias; }
+		float GetStrength() const { return m_strength; }
+		void SetStrength(float strength) { m_strength = strength; }
+		//	static casters are drawn into their own atlas only when light, static renderers
+		//	or cascade regions change, other casters are drawn every frame
+		bool IsStaticCache() const { return m_static_cache; }
+		void SetStaticCache(bool enable);
+		const Ref<RenderTexture>& GetShadowMap() const { return m_atlas->depth_texture; }
+		Ref<RenderTexture> GetStaticShadowMap() const;
+		//	casters left after culling of cascade in last frame, dynamic only when static cache enabled
+		int GetCasterCount(int cascade) const;
+		int GetStaticCasterCount(int cascade) const;
+		//	times static atlas was rendered
+		int GetStaticRenderCount() const { return m_static_render_count; }
+		void LogStats() const;
+
+	protected:
+		virtual void Start();
+		virtual void LateUpdate();
+		virtual void OnEnable();
+		virtual void OnDisable();
+
+	private:
+		CascadedShadowMap();
+		Ref<Camera> CreateCascade(const String& name, int index, int depth, const Ref<FrameBuffer>& atlas, CameraShadowCasters casters);
+		void CreateCascades();
+		void DestroyCascades();
+		void UpdateCascades();
+		void FitCascade(int index, const Vector<Vector3>& corners);
+		void UpdateStaticCascades();
+
+		static List<CascadedShadowMap*> m_shadow_maps;
+		WeakRef<Camera> m_camera;
+		int m_cascade_count;
+		float m_shadow_distance;
+		float m_split_lambda;
+		float m_caster_distance;
+		int m_map_size;
+		int m_culling_mask;
+		float m_bias;
+		float m_strength;
+		bool m_static_cache;
+		Ref<FrameBuffer> m_atlas;
+		Vector<Ref<Camera>> m_cascades;
+		Ref<FrameBuffer> m_static_atlas;
+		Vector<Ref<Camera>> m_static_cascades;
+		//	state static atlas was rendered with
+		bool m_static_valid;
+		bool m_static_dirty;
+		uint32_t m_static_version;
+		Quaternion m_static_light_rotation;
+		Vector3 m_static_centers[SHADOW_CASCADE_MAX];
+		float m_static_radius[SHADOW_CASCADE_MAX];
+		int m_static_render_count;
+		Matrix4x4 m_view_projections[SHADOW_CASCADE_MAX];
+		Vector4 m_splits;
+		Vector4 m_view_z;
+	};
+}
@@ -18,9 +18,14 @@
 #pragma once
 
 #include "string/String.h"
+#include "memory/ByteBuffer.h"
+#include <functional>
 
 namespace Viry3D
 {
+	//	rgba rows top down, colors are empty when pixels could not be read
+	typedef std::function<void(const ByteBuffer& colors, int width, int height)> ReadPixelsComplete;
+
 	class DisplayBase
 	{
 	public:
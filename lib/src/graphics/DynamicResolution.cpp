@@ -0,0 +1,146 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "DynamicResolution.h"
+#include "Camera.h"
+#include "GameObject.h"
+#include "Application.h"
+#include "time/FramePacer.h"
+#include "math/Mathf.h"
+#include <math.h>
+
+#define DEFAULT_FPS 60
+// cost is averaged over about this many frames
+#define COST_SMOOTH 0.1f
+// frames after a change before scale changes again, new cost needs time to show
+#define COOLDOWN_FRAMES 15
+// scale grows back only when frames use less of budget than this
+#define GROW_THRESHOLD 0.8f
+
+namespace Viry3D
+{
+	DEFINE_COM_CLASS(DynamicResolution);
+
+	DynamicResolution::DynamicResolution():
+		m_min_scale(0.5f),
+		m_max_scale(1.0f),
+		m_target_fps(0),
+		m_step(0.05f),
+		m_scale(1.0f),
+		m_cost(0),
+		m_cooldown(0)
+	{
+	}
+
+	DynamicResolution::~DynamicResolution()
+	{
+	}
+
+	void DynamicResolution::DeepCopy(const Ref<Object>& source)
+	{
+		assert(!"not implemment!");
+	}
+
+	void DynamicResolution::SetScaleRange(float min_scale, float max_scale)
+	{
+		m_max_scale = Mathf::Clamp(max_scale, 0.1f, 1.0f);
+		m_min_scale = Mathf::Clamp(min_scale, 0.1f, m_max_scale);
+
+		this->ApplyScale(m_scale);
+	}
+
+	void DynamicResolution::OnEnable()
+	{
+		m_cost = 0;
+		m_cooldown = COOLDOWN_FRAMES;
+
+		this->ApplyScale(m_scale);
+	}
+
+	void DynamicResolution::OnDisable()
+	{
+		auto camera = this->GetGameObject()->GetComponent<Camera>();
+		if (camera)
+		{
+			camera->SetRenderScale(1);
+		}
+	}
+
+	void DynamicResolution::LateUpdate()
+	{
+		auto pacer = Application::Current()->GetFramePacer();
+
+		float budget;
+		if (m_target_fps > 0)
+		{
+			budget = 1000.0f / m_target_fps;
+		}
+		else
+		{
+			budget = pacer->GetFrameBudget();
+			if (budget <= 0)
+			{
+				budget = 1000.0f / DEFAULT_FPS;
+			}
+		}
+
+		float cost = pacer->GetGPUTime() > 0 ? pacer->GetGPUTime() : pacer->GetWorkTime();
+		if (cost <= 0)
+		{
+			return;
+		}
+
+		m_cost = m_cost > 0 ? m_cost + (cost - m_cost) * COST_SMOOTH : cost;
+
+		if (m_cooldown > 0)
+		{
+			m_cooldown--;
+			return;
+		}
+
+		float scale = m_scale;
+		if (m_cost > budget)
+		{
+			// cost follows pixel count, which goes with square of scale
+			scale = m_scale * sqrt(budget / m_cost);
+			scale = floor(scale / m_step + 0.001f) * m_step;
+		}
+		else if (m_cost < budget * GROW_THRESHOLD)
+		{
+			scale = m_scale + m_step;
+		}
+
+		float old_scale = m_scale;
+		this->ApplyScale(scale);
+
+		if (m_scale != old_scale)
+		{
+			m_cooldown = COOLDOWN_FRAMES;
+		}
+	}
+
+	void DynamicResolution::ApplyScale(float scale)
+	{
+		m_scale = Mathf::Clamp(scale, m_min_scale, m_max_scale);
+
+		auto camera = this->GetGameObject()->GetComponent<Camera>();
+		if (camera && this->IsEnable())
+		{
+			camera->SetRenderScale(m_scale);
+		}
+	}
+}
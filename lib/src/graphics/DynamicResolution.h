@@ -0,0 +1,65 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "Component.h"
+#include "math/Mathf.h"
+
+namespace Viry3D
+{
+	class Camera;
+
+	//	scales render target of camera on this game object to keep frames in budget,
+	//	gpu time is used when display measures it, else work time of frames
+	class DynamicResolution: public Component
+	{
+		DECLARE_COM_CLASS(DynamicResolution, Component);
+
+	public:
+		virtual ~DynamicResolution();
+		float GetMinScale() const { return m_min_scale; }
+		float GetMaxScale() const { return m_max_scale; }
+		void SetScaleRange(float min_scale, float max_scale);
+		//	budget of frame pacer is used when <= 0
+		int GetTargetFPS() const { return m_target_fps; }
+		void SetTargetFPS(int fps) { m_target_fps = fps; }
+		//	scale changes in steps, every change reallocates the scaled target
+		float GetStep() const { return m_step; }
+		void SetStep(float step) { m_step = Mathf::Max(step, 0.01f); }
+		float GetScale() const { return m_scale; }
+		//	smoothed ms the scale is decided by
+		float GetFrameCost() const { return m_cost; }
+
+	protected:
+		virtual void LateUpdate();
+		virtual void OnEnable();
+		virtual void OnDisable();
+
+	private:
+		DynamicResolution();
+		void ApplyScale(float scale);
+
+		float m_min_scale;
+		float m_max_scale;
+		int m_target_fps;
+		float m_step;
+		float m_scale;
+		float m_cost;
+		int m_cooldown;
+	};
+}
@@ -24,11 +24,15 @@
 #include "RenderPass.h"
 #include "RenderTexture.h"
 #include "DescriptorSet.h"
+#include "RenderThread.h"
+#include "Profiler.h"
+#include "Debug.h"
 
 namespace Viry3D
 {
 	int Graphics::draw_call = 0;
 	Ref<Display> Graphics::m_display;
+	Ref<RenderThread> Graphics::m_render_thread;
 	Ref<Mesh> Graphics::m_blit_mesh;
 	Vector<Ref<Material>> Graphics::m_blit_materials;
 	Vector<Ref<RenderPass>> Graphics::m_blit_render_passes;
@@ -48,6 +52,11 @@ namespace Viry3D
 
 	void Graphics::OnResize(int width, int height)
 	{
+		if (m_render_thread)
+		{
+			m_render_thread->Wait();
+		}
+
 		m_blit_render_passes.Clear();
 		Camera::OnResize(width, height);
 		m_display->OnResize(width, height);
@@ -55,6 +64,11 @@ namespace Viry3D
 
 	void Graphics::OnPause()
 	{
+		if (m_render_thread)
+		{
+			m_render_thread->Wait();
+		}
+
 		m_blit_render_passes.Clear();
 		Camera::OnPause();
 		m_display->OnPause();
@@ -67,6 +81,8 @@ namespace Viry3D
 
 	void Graphics::Deinit()
 	{
+		m_render_thread.reset();
+
 		m_draw_descriptor_set.reset();
 		m_draw_descriptor_set_buffer.reset();
 		m_blit_render_passes.Clear();
@@ -86,11 +102,25 @@ namespace Viry3D
 	}
 
 	void Graphics::Render()
+	{
+		Graphics::PrepareFrame();
+		Graphics::RenderFrame();
+	}
+
+	void Graphics::PrepareFrame()
 	{
 		Graphics::draw_call = 0;
 
+		// temporaries are pooled on main thread, render thread only takes them within a frame
+		RenderTexture::ReleaseUnusedTemporaries();
+
 		m_display->BeginFrame();
 
+		Camera::PrepareAll();
+	}
+
+	void Graphics::RenderFrame()
+	{
 		Camera::RenderAll();
 
 		m_display->EndFrame();
@@ -98,6 +128,38 @@ namespace Viry3D
 		m_display->SwapBuffers();
 	}
 
+	void Graphics::SetRenderThread(bool enable)
+	{
+#if VR_VULKAN
+		if (enable && !m_render_thread)
+		{
+			m_render_thread = RefMake<RenderThread>();
+		}
+		else if (!enable && m_render_thread)
+		{
+			m_render_thread.reset();
+		}
+#else
+		if (enable)
+		{
+			// gl context is current on main thread, every gl call would have to move
+			Log("render thread is not supported by gles backend");
+		}
+#endif
+	}
+
+	void Graphics::RunOnRenderThread(Action command)
+	{
+		if (m_render_thread)
+		{
+			m_render_thread->Post(command);
+		}
+		else
+		{
+			command();
+		}
+	}
+
 	void Graphics::DrawQuad(const Rect* rect, const Ref<Texture>& texture, bool reverse_uv_y)
 	{
 		Ref<Material> material;
@@ -212,12 +274,8 @@ namespace Viry3D
 				int index_count;
 				mesh->GetIndexRange(i, index_start, index_count);
 
-				GetDisplay()->BindVertexArray();
-				GetDisplay()->BindVertexBuffer(mesh->GetVertexBuffer().get());
-				GetDisplay()->BindIndexBuffer(mesh->GetIndexBuffer().get(), index_type);
-				GetDisplay()->BindVertexAttribArray(shader, j);
+				GetDisplay()->BindVertexArray(mesh->GetVertexBuffer().get(), mesh->GetIndexBuffer().get(), index_type, shader, j);
 				GetDisplay()->DrawIndexed(index_start, index_count, index_type);
-				GetDisplay()->DisableVertexArray(shader, j);
 
 				shader->EndPass(j);
 			}
@@ -229,6 +287,42 @@ namespace Viry3D
 		}
 	}
 
+	void Graphics::ReleaseBlitCache(const Ref<RenderTexture>& texture)
+	{
+		for (int i = m_blit_render_passes.Size() - 1; i >= 0; i--)
+		{
+			const auto& pass = m_blit_render_passes[i];
+			if (pass->HasFrameBuffer() && pass->GetFrameBuffer().color_texture == texture)
+			{
+				m_blit_render_passes.Remove(i);
+			}
+		}
+
+		for (int i = m_blit_materials.Size() - 1; i >= 0; i--)
+		{
+			if (m_blit_materials[i]->GetMainTexture() == RefCast<Texture>(texture))
+			{
+				m_blit_materials.Remove(i);
+			}
+		}
+	}
+
+	void Graphics::CaptureToPNGAsync(const Ref<RenderTexture>& texture, const String& file, Image::EncodeComplete callback)
+	{
+		GetDisplay()->ReadPixelsAsync(texture, [=](const ByteBuffer& colors, int width, int height) {
+			if (colors.Size() == 0)
+			{
+				if (callback)
+				{
+					callback(false);
+				}
+				return;
+			}
+
+			Image::EncodeToPNGAsync(colors, width, height, 32, file, callback);
+		});
+	}
+
 	void Graphics::Blit(const Ref<RenderTexture>& src, const Ref<RenderTexture>& dest, const Ref<Material>& material, int pass, const Rect* rect)
 	{
 		Ref<RenderPass> render_pass;
@@ -260,7 +354,7 @@ namespace Viry3D
 			m_blit_render_passes.Add(render_pass);
 		}
 
-		GetDisplay()->WaitQueueIdle();
+		Profiler::GPUSampleBegin("Graphics::Blit");
 		render_pass->Begin(Color(0, 0, 0, 1));
 
 #if VR_GLES
@@ -309,5 +403,6 @@ namespace Viry3D
 
 		render_pass->End();
 		GetDisplay()->SubmitQueue(render_pass->GetCommandBuffer());
+		Profiler::GPUSampleEnd();
 	}
 }
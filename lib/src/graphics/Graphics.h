@@ -18,9 +18,11 @@
 #pragma once
 
 #include "Display.h"
+#include "Image.h"
 #include "memory/Ref.h"
 #include "container/Vector.h"
 #include "math/Rect.h"
+#include "Action.h"
 
 namespace Viry3D
 {
@@ -41,6 +43,7 @@ namespace Viry3D
 	struct Matrix4x4;
 	class DescriptorSet;
 	class UniformBuffer;
+	class RenderThread;
 
 	class Graphics
 	{
@@ -52,6 +55,27 @@ namespace Viry3D
 		static void Deinit();
 		static Display* GetDisplay();
 		static void Render();
+		//	main thread, begins frame, culls and prepares passes of every camera
+		static void PrepareFrame();
+		//	records and submits prepared passes and presents, on render thread when enabled
+		static void RenderFrame();
+		//	frames are rendered on render thread while next one updates, vulkan only
+		static void SetRenderThread(bool enable);
+		static RenderThread* GetRenderThread() { return m_render_thread.get(); }
+		//	runs before render thread starts next frame, or at once without render thread,
+		//	e.g. to release resources a frame rendering may still use
+		static void RunOnRenderThread(Action command);
+		//	frame on render thread may still draw with object replaced by main thread
+		template <class T>
+		static void ReleaseAfterRender(Ref<T>& obj)
+		{
+			if (obj)
+			{
+				Ref<T> released = obj;
+				obj.reset();
+				RunOnRenderThread([released]() { });
+			}
+		}
 
 		//
 		//	rect in screen range (0, 0, 1, 1)
@@ -64,6 +88,11 @@ namespace Viry3D
 		static void DrawQuad(const Rect* rect, const Ref<Material>& material, int pass, bool reverse_uv_y = false);
 		static void DrawMesh(const Ref<Mesh>& mesh, const Matrix4x4& matrix, const Ref<Material>& material, int pass = -1);
 		static void Blit(const Ref<RenderTexture>& src, const Ref<RenderTexture>& dest, const Ref<Material>& material = Ref<Material>(), int pass = 0, const Rect* rect = NULL);
+		//	drop blit render passes and materials holding texture, so it can be freed
+		static void ReleaseBlitCache(const Ref<RenderTexture>& texture);
+		//	null texture captures back buffer, pixels are read back at end of frame without waiting gpu,
+		//	then written by Image::EncodeToPNGAsync, call on main thread, callback runs on main thread
+		static void CaptureToPNGAsync(const Ref<RenderTexture>& texture, const String& file, Image::EncodeComplete callback = NULL);
 
 		static CullFace GetGlobalCullFace() { return m_global_cull_face; }
 		static void SetGlobalCullFace(CullFace cull_face) { m_global_cull_face = cull_face; }
@@ -73,6 +102,7 @@ namespace Viry3D
 
 	private:
 		static Ref<Display> m_display;
+		static Ref<RenderThread> m_render_thread;
 		static Ref<Mesh> m_blit_mesh;
 		static Vector<Ref<Material>> m_blit_materials;
 		static Vector<Ref<RenderPass>> m_blit_render_passes;
@@ -19,21 +19,25 @@
 #include "Texture2D.h"
 #include "io/File.h"
 #include "memory/Memory.h"
+#include "math/Mathf.h"
+#include "thread/Thread.h"
+#include <atomic>
 
 extern "C"
 {
 #include "jpeg/jpeglib.h"
 #include "png/png.h"
 #include "png/pngstruct.h"
+#include "zlib/zlib.h"
 }
 
+// rows of a strip are filtered and deflated on one encode thread
+#define PNG_STRIP_SIZE_MIN (256 * 1024)
+#define PNG_ENCODE_THREAD_MAX 4
+
 namespace Viry3D
 {
-	struct PNGData
-	{
-		char *buffer;
-		int size;
-	};
+	Ref<ThreadPool> Image::m_encode_threads;
 
 	ByteBuffer Image::LoadJPEG(const ByteBuffer& jpeg, int& width, int& height, int& bpp)
 	{
@@ -89,27 +93,6 @@ namespace Viry3D
 		png_ptr->io_ptr = (char *) png_ptr->io_ptr + length;
 	}
 
-	static void user_png_write(png_structp png_ptr, png_bytep data, png_size_t length)
-	{
-		PNGData *png = (PNGData *) png_get_io_ptr(png_ptr);
-
-		if (png->buffer == 0)
-		{
-			png->buffer = (char *) malloc(length);
-		}
-		else
-		{
-			png->buffer = (char *) realloc(png->buffer, png->size + length);
-		}
-
-		memcpy(&png->buffer[png->size], data, length);
-		png->size += (int) length;
-	}
-
-	static void user_png_flush(png_structp png_ptr)
-	{
-	}
-
 	ByteBuffer Image::LoadPNG(const ByteBuffer& png, int& width, int& height, int& bpp)
 	{
 		ByteBuffer colors;
@@ -204,67 +187,315 @@ namespace Viry3D
 		return colors;
 	}
 
-	void Image::EncodeToPNG(Texture2D *tex, int bpp, const String& file)
+	static int png_color_type(int bpp)
 	{
-		int color_type = -1;
 		switch (bpp)
 		{
 			case 32:
-				color_type = PNG_COLOR_TYPE_RGBA;
-				break;
+				return PNG_COLOR_TYPE_RGBA;
 			case 24:
-				color_type = PNG_COLOR_TYPE_RGB;
-				break;
+				return PNG_COLOR_TYPE_RGB;
 			case 8:
-				color_type = PNG_COLOR_TYPE_GRAY;
-				break;
+				return PNG_COLOR_TYPE_GRAY;
 			default:
-				return;
+				return -1;
 		}
+	}
+
+	static int png_paeth(int a, int b, int c)
+	{
+		int p = a + b - c;
+		int pa = abs(p - a);
+		int pb = abs(p - b);
+		int pc = abs(p - c);
 
-		char *data = 0;
-		int width = tex->GetWidth();
-		int height = tex->GetHeight();
-		auto colors = tex->GetColors();
-		if (colors.Size() == 0)
+		if (pa <= pb && pa <= pc)
 		{
-			return;
+			return a;
+		}
+		else if (pb <= pc)
+		{
+			return b;
+		}
+		else
+		{
+			return c;
 		}
+	}
 
-		png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
-		png_infop info_ptr = png_create_info_struct(png_ptr);
-		setjmp(png_jmpbuf(png_ptr));
+	// filters each row with the filter of least absolute sum, like libpng adaptive filtering
+	static void png_filter_rows(const byte* colors, int width, int pixel_size, int row_begin, int row_end, byte* out)
+	{
+		int row_size = width * pixel_size;
+		ByteBuffer filtered(row_size * PNG_FILTER_VALUE_LAST);
+
+		for (int i = row_begin; i < row_end; i++)
+		{
+			const byte* row = &colors[i * row_size];
+			const byte* prev = i > 0 ? &colors[(i - 1) * row_size] : NULL;
+
+			int best_filter = 0;
+			int best_sum = 0x7fffffff;
+			for (int f = 0; f < PNG_FILTER_VALUE_LAST; f++)
+			{
+				byte* dest = &filtered[f * row_size];
+				int sum = 0;
+
+				for (int j = 0; j < row_size; j++)
+				{
+					int a = j >= pixel_size ? row[j - pixel_size] : 0;
+					int b = prev ? prev[j] : 0;
+					int c = prev && j >= pixel_size ? prev[j - pixel_size] : 0;
+					int predict;
+
+					switch (f)
+					{
+						case PNG_FILTER_VALUE_SUB:
+							predict = a;
+							break;
+						case PNG_FILTER_VALUE_UP:
+							predict = b;
+							break;
+						case PNG_FILTER_VALUE_AVG:
+							predict = (a + b) / 2;
+							break;
+						case PNG_FILTER_VALUE_PAETH:
+							predict = png_paeth(a, b, c);
+							break;
+						default:
+							predict = 0;
+							break;
+					}
+
+					dest[j] = (byte) (row[j] - predict);
+					sum += abs((int) (signed char) dest[j]);
+				}
 
-		PNGData png_data;
-		png_data.buffer = 0;
-		png_data.size = 0;
+				if (sum < best_sum)
+				{
+					best_sum = sum;
+					best_filter = f;
+				}
+			}
+
+			byte* out_row = &out[(i - row_begin) * (row_size + 1)];
+			out_row[0] = (byte) best_filter;
+			Memory::Copy(&out_row[1], &filtered[best_filter * row_size], row_size);
+		}
+	}
 
-		png_set_write_fn(png_ptr, &png_data, user_png_write, user_png_flush);
+	// raw deflate of a strip, strips before the last end on a byte boundary so they can be concatenated
+	static ByteBuffer png_deflate_strip(const byte* colors, int width, int pixel_size, int row_begin, int row_end, bool last, int& size, uLong& adler)
+	{
+		int raw_size = (row_end - row_begin) * (width * pixel_size + 1);
+		ByteBuffer raw(raw_size);
+		png_filter_rows(colors, width, pixel_size, row_begin, row_end, raw.Bytes());
+
+		adler = adler32(adler32(0, NULL, 0), raw.Bytes(), raw_size);
+
+		z_stream stream;
+		Memory::Zero(&stream, sizeof(stream));
+		deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
 
-		png_set_IHDR(png_ptr, info_ptr, width, height,
-			8, color_type, PNG_INTERLACE_NONE,
-			PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
-		png_write_info(png_ptr, info_ptr);
+		// sync flush marker is not counted by bound
+		int bound = (int) deflateBound(&stream, raw_size) + 16;
+		ByteBuffer out(bound);
 
-		png_bytepp row_pointers = new png_bytep[height];
-		for (int i = 0; i < height; i++)
+		stream.next_in = raw.Bytes();
+		stream.avail_in = raw_size;
+		stream.next_out = out.Bytes();
+		stream.avail_out = bound;
+		deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+
+		size = bound - (int) stream.avail_out;
+		deflateEnd(&stream);
+
+		return out;
+	}
+
+	static void png_write_uint(byte*& p, uint32_t value)
+	{
+		p[0] = (byte) (value >> 24);
+		p[1] = (byte) (value >> 16);
+		p[2] = (byte) (value >> 8);
+		p[3] = (byte) value;
+		p += 4;
+	}
+
+	static void png_write_chunk(byte*& p, const char* type, const byte* data, int size)
+	{
+		png_write_uint(p, size);
+		byte* crc_begin = p;
+		Memory::Copy(p, type, 4);
+		p += 4;
+		if (size > 0)
+		{
+			Memory::Copy(p, data, size);
+			p += size;
+		}
+		png_write_uint(p, (uint32_t) crc32(crc32(0, NULL, 0), crc_begin, size + 4));
+	}
+
+	// png file of one zlib stream made of independently deflated strips
+	static ByteBuffer png_assemble(int width, int height, int bpp, const Vector<ByteBuffer>& strips, const Vector<int>& strip_sizes, const Vector<uLong>& strip_adlers, const Vector<int>& strip_raw_sizes)
+	{
+		uLong adler = adler32(0, NULL, 0);
+		int idat_size = 2 + 4;
+		for (int i = 0; i < strips.Size(); i++)
+		{
+			adler = adler32_combine(adler, strip_adlers[i], strip_raw_sizes[i]);
+			idat_size += strip_sizes[i];
+		}
+
+		ByteBuffer idat(idat_size);
+		byte* p = idat.Bytes();
+		// deflate, 32k window, default level
+		p[0] = 0x78;
+		p[1] = 0x9c;
+		p += 2;
+		for (int i = 0; i < strips.Size(); i++)
 		{
-			row_pointers[i] = (png_bytep) &colors[i * width * bpp / 8];
+			Memory::Copy(p, strips[i].Bytes(), strip_sizes[i]);
+			p += strip_sizes[i];
 		}
-		png_write_image(png_ptr, row_pointers);
-		delete[] row_pointers;
+		png_write_uint(p, (uint32_t) adler);
+
+		byte ihdr[13];
+		p = ihdr;
+		png_write_uint(p, width);
+		png_write_uint(p, height);
+		p[0] = 8;
+		p[1] = (byte) png_color_type(bpp);
+		p[2] = PNG_COMPRESSION_TYPE_BASE;
+		p[3] = PNG_FILTER_TYPE_BASE;
+		p[4] = PNG_INTERLACE_NONE;
+
+		const int chunk_overhead = 12;
+		ByteBuffer png(8 + chunk_overhead * 3 + sizeof(ihdr) + idat_size);
+		p = png.Bytes();
+		const byte signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+		Memory::Copy(p, signature, 8);
+		p += 8;
+		png_write_chunk(p, "IHDR", ihdr, sizeof(ihdr));
+		png_write_chunk(p, "IDAT", idat.Bytes(), idat_size);
+		png_write_chunk(p, "IEND", NULL, 0);
+
+		return png;
+	}
 
-		png_write_end(png_ptr, 0);
-		png_destroy_write_struct(&png_ptr, &info_ptr);
+	static int png_strip_count(int width, int height, int bpp, int thread_count)
+	{
+		// small images are not worth splitting, every strip restarts the deflate window
+		int strip_count = (int) ((int64_t) width * height * bpp / 8 / PNG_STRIP_SIZE_MIN);
+		strip_count = Mathf::Min(strip_count, thread_count);
+		strip_count = Mathf::Min(strip_count, height);
+		return Mathf::Max(strip_count, 1);
+	}
 
-		data = png_data.buffer;
-		int size = png_data.size;
+	ByteBuffer Image::EncodePNG(const ByteBuffer& colors, int width, int height, int bpp)
+	{
+		if (png_color_type(bpp) < 0 || width <= 0 || height <= 0 || colors.Size() < width * height * bpp / 8)
+		{
+			return ByteBuffer();
+		}
 
-		ByteBuffer file_buffer(size);
-		Memory::Copy(file_buffer.Bytes(), data, size);
+		Vector<ByteBuffer> strips(1);
+		Vector<int> strip_sizes(1);
+		Vector<uLong> strip_adlers(1);
+		Vector<int> strip_raw_sizes(1);
+		strips[0] = png_deflate_strip(colors.Bytes(), width, bpp / 8, 0, height, true, strip_sizes[0], strip_adlers[0]);
+		strip_raw_sizes[0] = height * (width * bpp / 8 + 1);
 
-		File::WriteAllBytes(file, file_buffer);
+		return png_assemble(width, height, bpp, strips, strip_sizes, strip_adlers, strip_raw_sizes);
+	}
 
-		free(data);
+	void Image::EncodeToPNG(Texture2D *tex, int bpp, const String& file)
+	{
+		auto png = Image::EncodePNG(tex->GetColors(), tex->GetWidth(), tex->GetHeight(), bpp);
+		if (png.Size() == 0)
+		{
+			return;
+		}
+
+		File::WriteAllBytes(file, png);
+	}
+
+	void Image::EncodeToPNGAsync(const ByteBuffer& colors, int width, int height, int bpp, const String& file, EncodeComplete callback)
+	{
+		if (png_color_type(bpp) < 0 || width <= 0 || height <= 0 || colors.Size() < width * height * bpp / 8)
+		{
+			if (callback)
+			{
+				callback(false);
+			}
+			return;
+		}
+
+		if (!m_encode_threads)
+		{
+			int thread_count = Mathf::Clamp((int) std::thread::hardware_concurrency() - 1, 1, PNG_ENCODE_THREAD_MAX);
+			m_encode_threads = RefMake<ThreadPool>(thread_count);
+		}
+
+		struct EncodeState
+		{
+			ByteBuffer colors;
+			Vector<ByteBuffer> strips;
+			Vector<int> strip_sizes;
+			Vector<uLong> strip_adlers;
+			Vector<int> strip_raw_sizes;
+			std::atomic<int> remain;
+		};
+
+		// caller may change colors once this returns
+		auto state = RefMake<EncodeState>();
+		state->colors = ByteBuffer(width * height * bpp / 8);
+		Memory::Copy(state->colors.Bytes(), colors.Bytes(), state->colors.Size());
+
+		int strip_count = png_strip_count(width, height, bpp, m_encode_threads->GetThreadCount());
+		state->strips.Resize(strip_count);
+		state->strip_sizes.Resize(strip_count);
+		state->strip_adlers.Resize(strip_count);
+		state->strip_raw_sizes.Resize(strip_count);
+		state->remain = strip_count;
+
+		for (int i = 0; i < strip_count; i++)
+		{
+			int row_begin = height * i / strip_count;
+			int row_end = height * (i + 1) / strip_count;
+			state->strip_raw_sizes[i] = (row_end - row_begin) * (width * bpp / 8 + 1);
+
+			m_encode_threads->AddTask({
+				[=]() {
+					state->strips[i] = png_deflate_strip(state->colors.Bytes(), width, bpp / 8, row_begin, row_end, i == strip_count - 1, state->strip_sizes[i], state->strip_adlers[i]);
+
+					// strip finished last assembles and writes file
+					if (--state->remain > 0)
+					{
+						return RefMake<Any>(-1);
+					}
+
+					auto png = png_assemble(width, height, bpp, state->strips, state->strip_sizes, state->strip_adlers, state->strip_raw_sizes);
+					File::WriteAllBytes(file, png);
+					return RefMake<Any>(File::Exist(file) ? 1 : 0);
+				},
+				[=](Ref<Any> any) {
+					int result = any->Get<int>();
+					if (result >= 0 && callback)
+					{
+						callback(result == 1);
+					}
+				}
+			}, i);
+		}
+	}
+
+	void Image::Deinit()
+	{
+		if (m_encode_threads)
+		{
+			m_encode_threads->Wait();
+			m_encode_threads.reset();
+		}
 	}
 }
@@ -18,16 +18,30 @@
 #pragma once
 
 #include "string/String.h"
+#include "memory/Ref.h"
+#include <functional>
 
 namespace Viry3D
 {
 	class Texture2D;
+	class ThreadPool;
 
 	class Image
 	{
 	public:
+		typedef std::function<void(bool success)> EncodeComplete;
+
 		static ByteBuffer LoadJPEG(const ByteBuffer& jpeg, int& width, int& height, int& bpp);
 		static ByteBuffer LoadPNG(const ByteBuffer& png, int& width, int& height, int& bpp);
+		//	empty buffer when bpp is not 32, 24 or 8
+		static ByteBuffer EncodePNG(const ByteBuffer& colors, int width, int height, int bpp);
 		static void EncodeToPNG(Texture2D *tex, int bpp, const String& file);
+		//	colors are copied before return, strips of rows are deflated in parallel on encode threads,
+		//	call on main thread, callback runs on main thread after file written
+		static void EncodeToPNGAsync(const ByteBuffer& colors, int width, int height, int bpp, const String& file, EncodeComplete callback);
+		static void Deinit();
+
+	private:
+		static Ref<ThreadPool> m_encode_threads;
 	};
 }
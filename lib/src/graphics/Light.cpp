@@ -16,15 +16,33 @@
 */
 
 #include "Light.h"
+#include "GameObject.h"
 
 namespace Viry3D
 {
 	DEFINE_COM_CLASS(Light);
 
 	WeakRef<Light> Light::main;
+	List<Light*> Light::m_lights;
+
+	Light::Light():
+		type(LightType::Directional),
+		color(1, 1, 1, 1),
+		intensity(1),
+		range(10),
+		spot_angle(30)
+	{
+		m_lights.AddLast(this);
+	}
 
 	Light::~Light()
 	{
+		m_lights.Remove(this);
+	}
+
+	bool Light::IsShading() const
+	{
+		return this->IsEnable() && this->GetGameObject()->IsActiveInHierarchy() && intensity > 0;
 	}
 
 	void Light::DeepCopy(const Ref<Object>& source)
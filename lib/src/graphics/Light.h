@@ -19,6 +19,7 @@
 
 #include "Component.h"
 #include "Color.h"
+#include "container/List.h"
 
 namespace Viry3D
 {
@@ -34,20 +35,25 @@ namespace Viry3D
 		DECLARE_COM_CLASS(Light, Component);
 
 	public:
+		//	every light component alive, point and spot lights are shaded by clusters
+		static const List<Light*>& GetLights() { return m_lights; }
 		virtual ~Light();
+		bool IsShading() const;
 
 	private:
-		Light():
-			type(LightType::Directional),
-			color(1, 1, 1, 1),
-			intensity(1)
-		{
-		}
+		Light();
 
 	public:
 		static WeakRef<Light> main;
 		LightType type;
 		Color color;
 		float intensity;
+		//	distance attenuating to zero, point and spot
+		float range;
+		//	full cone angle in degrees, spot
+		float spot_angle;
+
+	private:
+		static List<Light*> m_lights;
 	};
 }
@@ -0,0 +1,432 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "LightCluster.h"
+#include "Camera.h"
+#include "Light.h"
+#include "Material.h"
+#include "Texture2D.h"
+#include "GameObject.h"
+#include "thread/Thread.h"
+#include "memory/Memory.h"
+#include "math/Mathf.h"
+#include "time/Time.h"
+#include "Debug.h"
+
+// fewer lights are binned faster than jobs are handed to threads
+#define PARALLEL_LIGHT_MIN 64
+#define THREAD_COUNT_MAX 4
+// textures are updated while previous frames may still sample them
+#define TEXTURE_FRAME_COUNT 3
+#define INDEX_TEXTURE_WIDTH 1024
+#define INDEX_TEXTURE_HEIGHT (LIGHT_CLUSTER_INDICES_MAX / 4 / INDEX_TEXTURE_WIDTH)
+
+namespace Viry3D
+{
+	Ref<ThreadPool> LightCluster::m_threads;
+
+	void LightCluster::Deinit()
+	{
+		m_threads.reset();
+	}
+
+	ThreadPool* LightCluster::GetThreads()
+	{
+		if (!m_threads)
+		{
+			int thread_count = Mathf::Clamp((int) std::thread::hardware_concurrency() - 1, 1, THREAD_COUNT_MAX);
+			m_threads = RefMake<ThreadPool>(thread_count);
+		}
+
+		return m_threads.get();
+	}
+
+	int LightCluster::GetSlice(const LightClusterView& view, float depth)
+	{
+		float slice;
+		if (view.orthographic)
+		{
+			slice = (depth - view.near_clip) / (view.far_clip - view.near_clip) * LIGHT_CLUSTER_Z;
+		}
+		else
+		{
+			slice = logf(depth / view.near_clip) / logf(view.far_clip / view.near_clip) * LIGHT_CLUSTER_Z;
+		}
+
+		return Mathf::Clamp((int) floorf(slice), 0, LIGHT_CLUSTER_Z - 1);
+	}
+
+	void LightCluster::AssignLights(const LightClusterView& view, const Vector<LightClusterBounds>& lights, LightClusterLists& lists, ThreadPool* threads)
+	{
+		int light_count = Mathf::Min(lights.Size(), LIGHT_CLUSTER_LIGHTS_MAX);
+
+		lists.offsets.Resize(LIGHT_CLUSTER_COUNT);
+		lists.counts.Resize(LIGHT_CLUSTER_COUNT);
+		lists.indices.Resize(LIGHT_CLUSTER_COUNT * LIGHT_CLUSTER_LIGHTS_PER_CLUSTER);
+		lists.overflow = lights.Size() - light_count;
+		Memory::Zero(&lists.counts[0], lists.counts.SizeInBytes());
+
+		// cluster ranges as arrays of x0 x1 y0 y1 z0 z1, empty range when z0 > z1
+		Vector<int> ranges(Mathf::Max(light_count, 1) * 6);
+		int* x0 = &ranges[light_count * 0];
+		int* x1 = &ranges[light_count * 1];
+		int* y0 = &ranges[light_count * 2];
+		int* y1 = &ranges[light_count * 3];
+		int* z0 = &ranges[light_count * 4];
+		int* z1 = &ranges[light_count * 5];
+
+		const Matrix4x4& p = view.projection;
+		for (int i = 0; i < light_count; i++)
+		{
+			Vector3 center = view.view.MultiplyPoint3x4(lights[i].position);
+			float r = lights[i].range;
+			float depth_min = Mathf::Max(-center.z - r, view.near_clip);
+			float depth_max = Mathf::Min(-center.z + r, view.far_clip);
+
+			z0[i] = 1;
+			z1[i] = 0;
+			if (depth_min > depth_max)
+			{
+				continue;
+			}
+
+			// box of sphere cut by depth range, projected corners bound it on screen
+			float ndc_min_x = Mathf::MaxFloatValue;
+			float ndc_min_y = Mathf::MaxFloatValue;
+			float ndc_max_x = Mathf::MinFloatValue;
+			float ndc_max_y = Mathf::MinFloatValue;
+			for (int j = 0; j < 8; j++)
+			{
+				float x = center.x + ((j & 1) ? r : -r);
+				float y = center.y + ((j & 2) ? r : -r);
+				float z = (j & 4) ? -depth_max : -depth_min;
+
+				float w = p.m30 * x + p.m31 * y + p.m32 * z + p.m33;
+				float ndc_x = (p.m00 * x + p.m01 * y + p.m02 * z + p.m03) / w;
+				float ndc_y = (p.m10 * x + p.m11 * y + p.m12 * z + p.m13) / w;
+
+				ndc_min_x = Mathf::Min(ndc_min_x, ndc_x);
+				ndc_min_y = Mathf::Min(ndc_min_y, ndc_y);
+				ndc_max_x = Mathf::Max(ndc_max_x, ndc_x);
+				ndc_max_y = Mathf::Max(ndc_max_y, ndc_y);
+			}
+
+			if (ndc_max_x < -1 || ndc_min_x > 1 || ndc_max_y < -1 || ndc_min_y > 1)
+			{
+				continue;
+			}
+
+			x0[i] = Mathf::Clamp((int) floorf((ndc_min_x * 0.5f + 0.5f) * LIGHT_CLUSTER_X), 0, LIGHT_CLUSTER_X - 1);
+			x1[i] = Mathf::Clamp((int) floorf((ndc_max_x * 0.5f + 0.5f) * LIGHT_CLUSTER_X), 0, LIGHT_CLUSTER_X - 1);
+			y0[i] = Mathf::Clamp((int) floorf((ndc_min_y * 0.5f + 0.5f) * LIGHT_CLUSTER_Y), 0, LIGHT_CLUSTER_Y - 1);
+			y1[i] = Mathf::Clamp((int) floorf((ndc_max_y * 0.5f + 0.5f) * LIGHT_CLUSTER_Y), 0, LIGHT_CLUSTER_Y - 1);
+			z0[i] = GetSlice(view, depth_min);
+			z1[i] = GetSlice(view, depth_max);
+		}
+
+		// every job owns a range of depth slices, no cluster is written by two jobs
+		int job_count = 1;
+		if (threads && light_count >= PARALLEL_LIGHT_MIN)
+		{
+			job_count = Mathf::Min(threads->GetThreadCount() * 2, LIGHT_CLUSTER_Z);
+		}
+
+		Vector<int> overflows(job_count, 0);
+		if (job_count == 1)
+		{
+			AssignSlices(ranges, light_count, 0, LIGHT_CLUSTER_Z, lists, &overflows[0]);
+		}
+		else
+		{
+			for (int i = 0; i < job_count; i++)
+			{
+				int z_begin = LIGHT_CLUSTER_Z * i / job_count;
+				int z_end = LIGHT_CLUSTER_Z * (i + 1) / job_count;
+				int* overflow = &overflows[i];
+
+				threads->AddTask({
+					[&ranges, &lists, light_count, z_begin, z_end, overflow]() {
+						AssignSlices(ranges, light_count, z_begin, z_end, lists, overflow);
+						return Ref<Any>();
+					},
+					NULL
+				}, i % threads->GetThreadCount());
+			}
+			threads->Wait();
+		}
+
+		for (int i = 0; i < job_count; i++)
+		{
+			lists.overflow += overflows[i];
+		}
+
+		// pack fixed size cluster slots in place, every list moves towards the front
+		int total = 0;
+		for (int i = 0; i < LIGHT_CLUSTER_COUNT; i++)
+		{
+			int count = lists.counts[i];
+			if (total + count > LIGHT_CLUSTER_INDICES_MAX)
+			{
+				lists.overflow += total + count - LIGHT_CLUSTER_INDICES_MAX;
+				count = LIGHT_CLUSTER_INDICES_MAX - total;
+				lists.counts[i] = count;
+			}
+
+			int slot = i * LIGHT_CLUSTER_LIGHTS_PER_CLUSTER;
+			for (int j = 0; j < count; j++)
+			{
+				lists.indices[total + j] = lists.indices[slot + j];
+			}
+
+			lists.offsets[i] = total;
+			total += count;
+		}
+		lists.indices.Resize(total);
+	}
+
+	void LightCluster::AssignSlices(const Vector<int>& ranges, int light_count, int z_begin, int z_end, LightClusterLists& lists, int* overflow)
+	{
+		const int* x0 = &ranges[light_count * 0];
+		const int* x1 = &ranges[light_count * 1];
+		const int* y0 = &ranges[light_count * 2];
+		const int* y1 = &ranges[light_count * 3];
+		const int* z0 = &ranges[light_count * 4];
+		const int* z1 = &ranges[light_count * 5];
+		int* counts = &lists.counts[0];
+		int* slots = &lists.indices[0];
+
+		for (int i = 0; i < light_count; i++)
+		{
+			int z_min = Mathf::Max(z0[i], z_begin);
+			int z_max = Mathf::Min(z1[i], z_end - 1);
+
+			for (int z = z_min; z <= z_max; z++)
+			{
+				for (int y = y0[i]; y <= y1[i]; y++)
+				{
+					int cluster = (z * LIGHT_CLUSTER_Y + y) * LIGHT_CLUSTER_X;
+					for (int x = x0[i]; x <= x1[i]; x++)
+					{
+						int& count = counts[cluster + x];
+						if (count < LIGHT_CLUSTER_LIGHTS_PER_CLUSTER)
+						{
+							slots[(cluster + x) * LIGHT_CLUSTER_LIGHTS_PER_CLUSTER + count] = i;
+							count++;
+						}
+						else
+						{
+							(*overflow)++;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void LightCluster::Benchmark(int light_count, int runs)
+	{
+		LightClusterView view;
+		view.view = Matrix4x4::LookTo(Vector3(0, 0, 0), Vector3(0, 0, 1), Vector3(0, 1, 0));
+		view.projection = Matrix4x4::Perspective(60, 16 / 9.0f, 0.3f, 1000);
+		view.near_clip = 0.3f;
+		view.far_clip = 1000;
+		view.orthographic = false;
+
+		Vector<LightClusterBounds> lights(light_count);
+		for (int i = 0; i < light_count; i++)
+		{
+			lights[i].position = Vector3(Mathf::RandomRange(-50.0f, 50.0f), Mathf::RandomRange(-20.0f, 20.0f), Mathf::RandomRange(1.0f, 100.0f));
+			lights[i].range = Mathf::RandomRange(1.0f, 8.0f);
+		}
+
+		LightClusterLists lists;
+		for (int i = 0; i < 2; i++)
+		{
+			AssignLights(view, lights, lists, GetThreads());
+		}
+
+		long long single_start = Time::GetTimeMS();
+		for (int i = 0; i < runs; i++)
+		{
+			AssignLights(view, lights, lists, NULL);
+		}
+		long long single_time = Time::GetTimeMS() - single_start;
+
+		long long threads_start = Time::GetTimeMS();
+		for (int i = 0; i < runs; i++)
+		{
+			AssignLights(view, lights, lists, GetThreads());
+		}
+		long long threads_time = Time::GetTimeMS() - threads_start;
+
+		Log("light cluster binning lights:%d references:%d overflow:%d single thread:%.3fms threads:%d %.3fms",
+			light_count,
+			lists.indices.Size(),
+			lists.overflow,
+			single_time / (float) runs,
+			GetThreads()->GetThreadCount(),
+			threads_time / (float) runs);
+	}
+
+	LightCluster::LightCluster():
+		m_texture_index(0),
+		m_light_count(0)
+	{
+		m_lists.overflow = 0;
+	}
+
+	void LightCluster::Update(Camera* camera)
+	{
+		Vector<Light*> lights;
+		Vector<LightClusterBounds> bounds;
+		for (auto i : Light::GetLights())
+		{
+			if (i->type != LightType::Directional && i->IsShading() && lights.Size() < LIGHT_CLUSTER_LIGHTS_MAX)
+			{
+				LightClusterBounds light;
+				light.position = i->GetTransform()->GetPosition();
+				light.range = i->range;
+
+				lights.Add(i);
+				bounds.Add(light);
+			}
+		}
+
+		m_view.view = camera->GetViewMatrix();
+		m_view.projection = camera->GetProjectionMatrix();
+		m_view.near_clip = camera->GetClipNear();
+		m_view.far_clip = camera->GetClipFar();
+		m_view.orthographic = camera->IsOrthographic();
+		m_light_count = lights.Size();
+
+		AssignLights(m_view, bounds, m_lists, GetThreads());
+
+		this->Upload(lights);
+	}
+
+	void LightCluster::Upload(const Vector<Light*>& lights)
+	{
+		if (m_textures.Empty())
+		{
+			m_textures.Resize(TEXTURE_FRAME_COUNT);
+			for (auto& i : m_textures)
+			{
+				i.grid = Texture2D::Create(LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y, LIGHT_CLUSTER_Z, TextureFormat::RGBAFloat, TextureWrapMode::Clamp, FilterMode::Point, false,
+					ByteBuffer(LIGHT_CLUSTER_COUNT * 16));
+				i.lights = Texture2D::Create(LIGHT_CLUSTER_LIGHTS_MAX, 3, TextureFormat::RGBAFloat, TextureWrapMode::Clamp, FilterMode::Point, false,
+					ByteBuffer(LIGHT_CLUSTER_LIGHTS_MAX * 3 * 16));
+				i.indices = Texture2D::Create(INDEX_TEXTURE_WIDTH, INDEX_TEXTURE_HEIGHT, TextureFormat::RGBAFloat, TextureWrapMode::Clamp, FilterMode::Point, false,
+					ByteBuffer(LIGHT_CLUSTER_INDICES_MAX * 4));
+			}
+		}
+
+		m_texture_index = (m_texture_index + 1) % m_textures.Size();
+		auto& textures = m_textures[m_texture_index];
+
+		// offset and count per cluster
+		m_upload.Resize(LIGHT_CLUSTER_COUNT * 4);
+		for (int i = 0; i < LIGHT_CLUSTER_COUNT; i++)
+		{
+			m_upload[i * 4 + 0] = (float) m_lists.offsets[i];
+			m_upload[i * 4 + 1] = (float) m_lists.counts[i];
+			m_upload[i * 4 + 2] = 0;
+			m_upload[i * 4 + 3] = 0;
+		}
+		textures.grid->UpdateTexture(0, 0, LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y, LIGHT_CLUSTER_Z, ByteBuffer(m_upload.Bytes(), m_upload.SizeInBytes()));
+
+		if (m_light_count == 0)
+		{
+			return;
+		}
+
+		// rows of position and range, color and type, direction and spot cosine
+		int light_count = m_light_count;
+		m_upload.Resize(light_count * 3 * 4);
+		for (int i = 0; i < light_count; i++)
+		{
+			auto light = lights[i];
+			Vector3 position = light->GetTransform()->GetPosition();
+			Vector3 forward = light->GetTransform()->GetForward();
+			Color color = light->color * light->intensity;
+			float* row0 = &m_upload[(light_count * 0 + i) * 4];
+			float* row1 = &m_upload[(light_count * 1 + i) * 4];
+			float* row2 = &m_upload[(light_count * 2 + i) * 4];
+
+			row0[0] = position.x;
+			row0[1] = position.y;
+			row0[2] = position.z;
+			row0[3] = light->range;
+			row1[0] = color.r;
+			row1[1] = color.g;
+			row1[2] = color.b;
+			row1[3] = light->type == LightType::Spot ? 1.0f : 0.0f;
+			row2[0] = forward.x;
+			row2[1] = forward.y;
+			row2[2] = forward.z;
+			row2[3] = cosf(light->spot_angle * 0.5f * Mathf::Deg2Rad);
+		}
+		textures.lights->UpdateTexture(0, 0, light_count, 3, ByteBuffer(m_upload.Bytes(), m_upload.SizeInBytes()));
+
+		// four indices per texel, whole rows
+		int index_count = m_lists.indices.Size();
+		if (index_count > 0)
+		{
+			int rows = (index_count + INDEX_TEXTURE_WIDTH * 4 - 1) / (INDEX_TEXTURE_WIDTH * 4);
+			m_upload.Resize(rows * INDEX_TEXTURE_WIDTH * 4);
+			for (int i = 0; i < m_upload.Size(); i++)
+			{
+				m_upload[i] = i < index_count ? (float) m_lists.indices[i] : 0.0f;
+			}
+			textures.indices->UpdateTexture(0, 0, INDEX_TEXTURE_WIDTH, rows, ByteBuffer(m_upload.Bytes(), m_upload.SizeInBytes()));
+		}
+	}
+
+	void LightCluster::SetMaterialUniforms(const Ref<Material>& material) const
+	{
+		if (m_textures.Empty())
+		{
+			return;
+		}
+
+		const auto& textures = m_textures[m_texture_index];
+		float near_clip = m_view.near_clip;
+		float far_clip = m_view.far_clip;
+
+		// slice = floor(f(depth) * scale + bias), f is log with perspective
+		float scale;
+		float bias;
+		if (m_view.orthographic)
+		{
+			scale = LIGHT_CLUSTER_Z / (far_clip - near_clip);
+			bias = -near_clip * scale;
+		}
+		else
+		{
+			scale = LIGHT_CLUSTER_Z / logf(far_clip / near_clip);
+			bias = -logf(near_clip) * scale;
+		}
+
+		const Matrix4x4& view = m_view.view;
+		material->SetVector("_ClusterParams", Vector4(LIGHT_CLUSTER_X, LIGHT_CLUSTER_Y, LIGHT_CLUSTER_Z, scale));
+		material->SetVector("_ClusterParams2", Vector4(bias, m_view.orthographic ? 1.0f : 0.0f, (float) m_light_count, INDEX_TEXTURE_WIDTH));
+		material->SetVector("_ClusterViewZ", Vector4(view.m20, view.m21, view.m22, view.m23));
+		material->SetTexture("_ClusterGrid", RefCast<Texture>(textures.grid));
+		material->SetTexture("_ClusterLights", RefCast<Texture>(textures.lights));
+		material->SetTexture("_ClusterIndices", RefCast<Texture>(textures.indices));
+	}
+}
@@ -0,0 +1,109 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include "math/Vector3.h"
+#include "math/Vector4.h"
+#include "math/Matrix4x4.h"
+#include "container/Vector.h"
+#include "memory/Ref.h"
+
+#define LIGHT_CLUSTER_X 16
+#define LIGHT_CLUSTER_Y 8
+#define LIGHT_CLUSTER_Z 24
+#define LIGHT_CLUSTER_COUNT (LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y * LIGHT_CLUSTER_Z)
+#define LIGHT_CLUSTER_LIGHTS_MAX 1024
+#define LIGHT_CLUSTER_LIGHTS_PER_CLUSTER 64
+#define LIGHT_CLUSTER_INDICES_MAX (64 * 1024)
+
+namespace Viry3D
+{
+	class Camera;
+	class Light;
+	class Material;
+	class Texture2D;
+	class ThreadPool;
+
+	//	view lights are binned for, depth slices are exponential with perspective
+	struct LightClusterView
+	{
+		Matrix4x4 view;
+		Matrix4x4 projection;
+		float near_clip;
+		float far_clip;
+		bool orthographic;
+	};
+
+	//	bounding sphere of a point or spot light in world space
+	struct LightClusterBounds
+	{
+		Vector3 position;
+		float range;
+	};
+
+	struct LightClusterLists
+	{
+		//	per cluster, x fastest then y then z
+		Vector<int> offsets;
+		Vector<int> counts;
+		//	light indices of all clusters packed
+		Vector<int> indices;
+		//	references dropped by full clusters or full index list
+		int overflow;
+	};
+
+	//	grid of view frustum clusters with lists of point and spot lights touching them,
+	//	lists are built on cpu and uploaded to textures once per frame
+	class LightCluster
+	{
+	public:
+		//	threads may be NULL to bin on calling thread
+		static void AssignLights(const LightClusterView& view, const Vector<LightClusterBounds>& lights, LightClusterLists& lists, ThreadPool* threads);
+		static int GetSlice(const LightClusterView& view, float depth);
+		//	bin light_count random lights runs times and log time per run
+		static void Benchmark(int light_count, int runs);
+		static void Deinit();
+
+		LightCluster();
+		void Update(Camera* camera);
+		void SetMaterialUniforms(const Ref<Material>& material) const;
+		int GetLightCount() const { return m_light_count; }
+		int GetOverflow() const { return m_lists.overflow; }
+
+	private:
+		struct Textures
+		{
+			Ref<Texture2D> grid;
+			Ref<Texture2D> lights;
+			Ref<Texture2D> indices;
+		};
+
+		static ThreadPool* GetThreads();
+		static void AssignSlices(const Vector<int>& ranges, int light_count, int z_begin, int z_end, LightClusterLists& lists, int* overflow);
+		void Upload(const Vector<Light*>& lights);
+
+		static Ref<ThreadPool> m_threads;
+		LightClusterView m_view;
+		LightClusterLists m_lists;
+		Vector<Textures> m_textures;
+		int m_texture_index;
+		int m_light_count;
+		Vector<float> m_upload;
+	};
+}
@@ -17,6 +17,7 @@
 
 #include "Material.h"
 #include "Camera.h"
+#include "renderer/Renderer.h"
 
 namespace Viry3D
 {
@@ -31,14 +32,40 @@ namespace Viry3D
 		mat = Ref<Material>(new Material());
 		mat->SetName(shader_name);
 
-		auto shader = Shader::Find(shader_name);
-		if (shader)
+		if (Shader::IsAsyncCompile() && !Shader::IsCompiled(shader_name))
 		{
-			mat->m_shader = shader;
+			mat->m_shader = Shader::GetFallbackShader();
+
+			WeakRef<Material> weak = mat;
+			Shader::FindAsync(shader_name, [=](const Ref<Shader>& shader) {
+				auto mat = weak.lock();
+				if (mat)
+				{
+					if (shader)
+					{
+						mat->SetShader(shader);
+					}
+					else
+					{
+						mat->SetShader(Shader::Find("Error"));
+					}
+
+					// queue and pass count may differ from fallback
+					Renderer::SetRenderersDirty(true);
+				}
+			});
 		}
 		else
 		{
-			mat->m_shader = Shader::Find("Error");
+			auto shader = Shader::Find(shader_name);
+			if (shader)
+			{
+				mat->m_shader = shader;
+			}
+			else
+			{
+				mat->m_shader = Shader::Find("Error");
+			}
 		}
 
 		return mat;
@@ -18,6 +18,7 @@
 #include "Mesh.h"
 #include "io/MemoryStream.h"
 #include "VertexAttribute.h"
+#include "Graphics.h"
 
 namespace Viry3D
 {
@@ -41,15 +42,8 @@ namespace Viry3D
 	{
 		if(!this->IsDynamic() && dynamic)
 		{
-			if (m_vertex_buffer)
-			{
-				m_vertex_buffer.reset();
-			}
-
-			if (m_index_buffer)
-			{
-				m_index_buffer.reset();
-			}
+			Graphics::ReleaseAfterRender(m_vertex_buffer);
+			Graphics::ReleaseAfterRender(m_index_buffer);
 
 			this->m_dynamic = dynamic;
 		}
@@ -150,7 +144,8 @@ namespace Viry3D
 
 		if (!m_vertex_buffer || m_vertex_buffer->GetSize() < buffer_size)
 		{
-			m_vertex_buffer = VertexBuffer::Create(buffer_size, dynamic);
+			Graphics::ReleaseAfterRender(m_vertex_buffer);
+			m_vertex_buffer = VertexBuffer::Create(dynamic ? DYNAMIC_BUFFER_CAPACITY(buffer_size) : buffer_size, dynamic);
 		}
 		m_vertex_buffer->Fill(this, Mesh::FillVertexBuffer);
 	}
@@ -162,7 +157,8 @@ namespace Viry3D
 
 		if (!m_index_buffer || m_index_buffer->GetSize() < buffer_size)
 		{
-			m_index_buffer = IndexBuffer::Create(buffer_size, dynamic);
+			Graphics::ReleaseAfterRender(m_index_buffer);
+			m_index_buffer = IndexBuffer::Create(dynamic ? DYNAMIC_BUFFER_CAPACITY(buffer_size) : buffer_size, dynamic);
 		}
 		m_index_buffer->Fill(this, Mesh::FillIndexBuffer);
 	}
@@ -0,0 +1,591 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "RenderGraph.h"
+#include "Graphics.h"
+#include "Display.h"
+#include "Debug.h"
+#include "memory/Memory.h"
+
+// pooled render textures not used by any frame for a while are released
+#define POOL_IDLE_FRAMES 60
+
+namespace Viry3D
+{
+	static bool is_desc_compatible(const RenderGraphTextureDesc& a, const RenderGraphTextureDesc& b)
+	{
+		return a.width == b.width &&
+			a.height == b.height &&
+			a.format == b.format &&
+			a.depth == b.depth;
+	}
+
+	static bool contains(const Vector<int>& list, int value)
+	{
+		for (auto i : list)
+		{
+			if (i == value)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	RenderGraph::RenderGraph():
+		m_frame(0)
+	{
+		Memory::Zero(&m_stats, sizeof(m_stats));
+	}
+
+	void RenderGraph::Reset()
+	{
+		m_textures.Clear();
+		m_passes.Clear();
+		m_order.Clear();
+
+		// read flags stay, next frame must not render into them before last frame sampled them
+		for (auto& i : m_physicals)
+		{
+			i.in_use = false;
+		}
+	}
+
+	void RenderGraph::Clear()
+	{
+		this->Reset();
+
+		for (const auto& i : m_physicals)
+		{
+			Graphics::ReleaseBlitCache(i.texture);
+		}
+		m_physicals.Clear();
+	}
+
+	int RenderGraph::CreateTexture(const String& name, const RenderGraphTextureDesc& desc)
+	{
+		TextureNode node;
+		node.name = name;
+		node.desc = desc;
+		node.imported = false;
+		node.ref_count = 0;
+		node.physical = -1;
+		node.first_pass = -1;
+		node.last_pass = -1;
+		node.writer = -1;
+		node.read = false;
+		m_textures.Add(node);
+
+		return m_textures.Size() - 1;
+	}
+
+	int RenderGraph::ImportTexture(const String& name, const Ref<RenderTexture>& texture)
+	{
+		for (int i = 0; i < m_textures.Size(); i++)
+		{
+			if (m_textures[i].imported && m_textures[i].texture == texture)
+			{
+				return i;
+			}
+		}
+
+		TextureNode node;
+		node.name = name;
+		Memory::Zero(&node.desc, sizeof(node.desc));
+		node.imported = true;
+		node.texture = texture;
+		node.ref_count = 0;
+		node.physical = -1;
+		node.first_pass = -1;
+		node.last_pass = -1;
+		node.writer = -1;
+		node.read = false;
+		m_textures.Add(node);
+
+		return m_textures.Size() - 1;
+	}
+
+	int RenderGraph::AddPass(const String& name, Action execute)
+	{
+		PassNode node;
+		node.name = name;
+		node.execute = execute;
+		node.side_effect = false;
+		node.ref_count = 0;
+		node.culled = false;
+		m_passes.Add(node);
+
+		return m_passes.Size() - 1;
+	}
+
+	void RenderGraph::SetPrepare(int pass, Action prepare)
+	{
+		m_passes[pass].prepare = prepare;
+	}
+
+	void RenderGraph::Read(int pass, int texture)
+	{
+		auto& reads = m_passes[pass].reads;
+		if (!contains(reads, texture))
+		{
+			reads.Add(texture);
+		}
+	}
+
+	void RenderGraph::Write(int pass, int texture)
+	{
+		auto& writes = m_passes[pass].writes;
+		if (!contains(writes, texture))
+		{
+			writes.Add(texture);
+		}
+	}
+
+	void RenderGraph::SetSideEffect(int pass)
+	{
+		m_passes[pass].side_effect = true;
+	}
+
+	const Ref<RenderTexture>& RenderGraph::GetTexture(int texture) const
+	{
+		return m_textures[texture].texture;
+	}
+
+	void RenderGraph::Compile()
+	{
+		m_frame++;
+
+		this->Cull();
+		this->Sort();
+		this->Allocate();
+	}
+
+	void RenderGraph::Cull()
+	{
+		for (auto& i : m_textures)
+		{
+			i.ref_count = 0;
+		}
+
+		for (auto& i : m_passes)
+		{
+			i.culled = false;
+			i.ref_count = i.writes.Size();
+
+			for (auto j : i.writes)
+			{
+				// outputs leaving the graph are always used
+				if (m_textures[j].imported)
+				{
+					i.ref_count++;
+				}
+			}
+			if (i.side_effect)
+			{
+				i.ref_count++;
+			}
+
+			for (auto j : i.reads)
+			{
+				m_textures[j].ref_count++;
+			}
+		}
+
+		Vector<int> unused;
+		for (int i = 0; i < m_textures.Size(); i++)
+		{
+			if (!m_textures[i].imported && m_textures[i].ref_count == 0)
+			{
+				unused.Add(i);
+			}
+		}
+
+		while (!unused.Empty())
+		{
+			int texture = unused[unused.Size() - 1];
+			unused.Remove(unused.Size() - 1);
+
+			for (auto& i : m_passes)
+			{
+				if (i.culled || !contains(i.writes, texture))
+				{
+					continue;
+				}
+
+				i.ref_count--;
+				if (i.ref_count == 0)
+				{
+					i.culled = true;
+
+					for (auto j : i.reads)
+					{
+						auto& read = m_textures[j];
+						read.ref_count--;
+						if (!read.imported && read.ref_count == 0)
+						{
+							unused.Add(j);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void RenderGraph::Sort()
+	{
+		int pass_count = m_passes.Size();
+		Vector<Vector<int>> edges(pass_count);
+		Vector<int> in_degree(pass_count, 0);
+
+		auto add_edge = [&](int from, int to) {
+			if (from != to && !contains(edges[from], to))
+			{
+				edges[from].Add(to);
+				in_degree[to]++;
+			}
+		};
+
+		// passes touching same texture keep declaration order,
+		// except reads of a transient declared before its writer move after the writer
+		for (int t = 0; t < m_textures.Size(); t++)
+		{
+			int last_writer = -1;
+			Vector<int> readers;
+			Vector<int> early_readers;
+
+			for (int p = 0; p < pass_count; p++)
+			{
+				const auto& pass = m_passes[p];
+				if (pass.culled)
+				{
+					continue;
+				}
+
+				bool read = contains(pass.reads, t);
+				bool write = contains(pass.writes, t);
+
+				if (read)
+				{
+					if (last_writer >= 0)
+					{
+						add_edge(last_writer, p);
+						readers.Add(p);
+					}
+					else if (!m_textures[t].imported)
+					{
+						early_readers.Add(p);
+					}
+					else
+					{
+						readers.Add(p);
+					}
+				}
+
+				if (write)
+				{
+					if (last_writer >= 0)
+					{
+						add_edge(last_writer, p);
+					}
+					else
+					{
+						for (auto i : early_readers)
+						{
+							add_edge(p, i);
+						}
+					}
+					for (auto i : readers)
+					{
+						add_edge(i, p);
+					}
+					readers.Clear();
+					last_writer = p;
+				}
+			}
+		}
+
+		m_order.Clear();
+
+		Vector<int> done(pass_count, 0);
+		while (true)
+		{
+			int next = -1;
+			for (int i = 0; i < pass_count; i++)
+			{
+				if (!m_passes[i].culled && !done[i] && in_degree[i] == 0)
+				{
+					next = i;
+					break;
+				}
+			}
+
+			if (next < 0)
+			{
+				break;
+			}
+
+			done[next] = 1;
+			m_order.Add(next);
+
+			for (auto i : edges[next])
+			{
+				in_degree[i]--;
+			}
+		}
+
+		for (int i = 0; i < pass_count; i++)
+		{
+			if (!m_passes[i].culled && !done[i])
+			{
+				Log("render graph pass %s in dependency cycle, run in declaration order", m_passes[i].name.CString());
+				m_order.Add(i);
+			}
+		}
+	}
+
+	int RenderGraph::AcquirePhysical(const RenderGraphTextureDesc& desc)
+	{
+		for (int i = 0; i < m_physicals.Size(); i++)
+		{
+			auto& physical = m_physicals[i];
+			if (!physical.in_use && is_desc_compatible(physical.desc, desc))
+			{
+				physical.in_use = true;
+				physical.used_frame = m_frame;
+
+				if (physical.texture->GetFilterMode() != desc.filter_mode)
+				{
+					physical.texture->SetFilterMode(desc.filter_mode);
+					physical.texture->UpdateSampler();
+				}
+				physical.desc.filter_mode = desc.filter_mode;
+
+				return i;
+			}
+		}
+
+		Physical physical;
+		physical.texture = RenderTexture::Create(desc.width, desc.height, desc.format, desc.depth, desc.filter_mode);
+		physical.desc = desc;
+		physical.bytes = physical.texture->GetByteSize();
+		physical.in_use = true;
+		physical.read = false;
+		physical.used_frame = m_frame;
+		m_physicals.Add(physical);
+
+		return m_physicals.Size() - 1;
+	}
+
+	void RenderGraph::Allocate()
+	{
+		for (auto& i : m_textures)
+		{
+			i.first_pass = -1;
+			i.last_pass = -1;
+		}
+
+		for (int i = 0; i < m_order.Size(); i++)
+		{
+			const auto& pass = m_passes[m_order[i]];
+
+			for (int j = 0; j < 2; j++)
+			{
+				const auto& list = j == 0 ? pass.reads : pass.writes;
+				for (auto k : list)
+				{
+					auto& texture = m_textures[k];
+					if (texture.first_pass < 0)
+					{
+						texture.first_pass = i;
+					}
+					texture.last_pass = i;
+				}
+			}
+		}
+
+		Memory::Zero(&m_stats, sizeof(m_stats));
+
+		// transients of a pass are acquired before ones ended in it are released,
+		// so textures of the same pass never alias
+		int alive_bytes = 0;
+		for (int i = 0; i < m_order.Size(); i++)
+		{
+			for (auto& j : m_textures)
+			{
+				if (!j.imported && j.first_pass == i)
+				{
+					j.physical = this->AcquirePhysical(j.desc);
+					j.texture = m_physicals[j.physical].texture;
+
+					alive_bytes += m_physicals[j.physical].bytes;
+					m_stats.transient_count++;
+					m_stats.transient_bytes += m_physicals[j.physical].bytes;
+				}
+			}
+
+			if (alive_bytes > m_stats.peak_bytes)
+			{
+				m_stats.peak_bytes = alive_bytes;
+			}
+
+			for (auto& j : m_textures)
+			{
+				if (!j.imported && j.last_pass == i)
+				{
+					m_physicals[j.physical].in_use = false;
+					alive_bytes -= m_physicals[j.physical].bytes;
+				}
+			}
+		}
+
+		for (int i = m_physicals.Size() - 1; i >= 0; i--)
+		{
+			if (m_physicals[i].used_frame + POOL_IDLE_FRAMES < m_frame)
+			{
+				Graphics::ReleaseBlitCache(m_physicals[i].texture);
+				m_physicals.Remove(i);
+
+				for (auto& j : m_textures)
+				{
+					if (j.physical > i)
+					{
+						j.physical--;
+					}
+				}
+			}
+		}
+
+		m_stats.pass_count = m_order.Size();
+		m_stats.culled_pass_count = m_passes.Size() - m_order.Size();
+		for (const auto& i : m_physicals)
+		{
+			if (i.used_frame == m_frame)
+			{
+				m_stats.physical_count++;
+			}
+			m_stats.pool_count++;
+			m_stats.pool_bytes += i.bytes;
+		}
+	}
+
+	void RenderGraph::BarrierPass(int pass)
+	{
+#if VR_VULKAN
+		const auto& node = m_passes[pass];
+		VkPipelineStageFlags src_stage = 0;
+		VkPipelineStageFlags dst_stage = 0;
+		VkAccessFlags src_access = 0;
+		VkAccessFlags dst_access = 0;
+
+		// sampling a texture rendered by an earlier pass
+		for (auto i : node.reads)
+		{
+			if (m_textures[i].writer >= 0)
+			{
+				src_stage |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+				dst_stage |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+				src_access |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+				dst_access |= VK_ACCESS_SHADER_READ_BIT;
+			}
+		}
+
+		// rendering into a texture an earlier pass sampled, also aliased transients
+		for (auto i : node.writes)
+		{
+			const auto& texture = m_textures[i];
+			bool read = texture.imported ? texture.read : m_physicals[texture.physical].read;
+			if (read)
+			{
+				src_stage |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+				dst_stage |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+			}
+		}
+
+		if (src_stage != 0)
+		{
+			Graphics::GetDisplay()->AddPassBarrier(src_stage, dst_stage, src_access, dst_access);
+		}
+#endif
+	}
+
+	void RenderGraph::Prepare()
+	{
+		for (auto i : m_order)
+		{
+			auto& pass = m_passes[i];
+			if (pass.prepare)
+			{
+				pass.prepare();
+			}
+		}
+	}
+
+	void RenderGraph::Execute()
+	{
+		for (auto i : m_order)
+		{
+			auto& pass = m_passes[i];
+
+			this->BarrierPass(i);
+
+			if (pass.execute)
+			{
+				pass.execute();
+			}
+
+			for (auto j : pass.reads)
+			{
+				auto& texture = m_textures[j];
+				if (texture.imported)
+				{
+					texture.read = true;
+				}
+				else
+				{
+					m_physicals[texture.physical].read = true;
+				}
+			}
+
+			for (auto j : pass.writes)
+			{
+				auto& texture = m_textures[j];
+				texture.writer = i;
+				if (texture.imported)
+				{
+					texture.read = false;
+				}
+				else
+				{
+					m_physicals[texture.physical].read = false;
+				}
+			}
+		}
+	}
+
+	void RenderGraph::LogStats() const
+	{
+		Log("render graph passes:%d culled:%d transients:%d render textures:%d peak:%dKB unaliased:%dKB pool:%d %dKB",
+			m_stats.pass_count,
+			m_stats.culled_pass_count,
+			m_stats.transient_count,
+			m_stats.physical_count,
+			m_stats.peak_bytes / 1024,
+			m_stats.transient_bytes / 1024,
+			m_stats.pool_count,
+			m_stats.pool_bytes / 1024);
+	}
+}
@@ -0,0 +1,132 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "RenderTexture.h"
+#include "Action.h"
+#include "string/String.h"
+#include "container/Vector.h"
+
+namespace Viry3D
+{
+	struct RenderGraphTextureDesc
+	{
+		int width;
+		int height;
+		RenderTextureFormat format;
+		DepthBuffer depth;
+		FilterMode filter_mode;
+	};
+
+	struct RenderGraphStats
+	{
+		int pass_count;
+		int culled_pass_count;
+		int transient_count;
+		//	render textures backing transients of last frame
+		int physical_count;
+		//	render target bytes alive at once, without aliasing it would be transient_bytes
+		int peak_bytes;
+		int transient_bytes;
+		//	render textures kept for next frames
+		int pool_count;
+		int pool_bytes;
+	};
+
+	//	passes declare render textures they read and write every frame,
+	//	passes nothing reads are culled, transients with disjoint lifetimes share render textures
+	class RenderGraph
+	{
+	public:
+		RenderGraph();
+		//	drop declarations of last frame, pooled render textures are kept
+		void Reset();
+		//	release pooled render textures too, e.g. on resize
+		void Clear();
+		int CreateTexture(const String& name, const RenderGraphTextureDesc& desc);
+		//	texture created out of graph, NULL for display back buffer, passes writing it are never culled
+		int ImportTexture(const String& name, const Ref<RenderTexture>& texture);
+		int AddPass(const String& name, Action execute);
+		//	runs in Prepare on main thread, before any pass executes, e.g. culling
+		void SetPrepare(int pass, Action prepare);
+		void Read(int pass, int texture);
+		void Write(int pass, int texture);
+		//	keep pass without used outputs, e.g. readback
+		void SetSideEffect(int pass);
+		void Compile();
+		void Prepare();
+		void Execute();
+		//	valid from Compile until Reset, transients are only for use in passes within their lifetime
+		const Ref<RenderTexture>& GetTexture(int texture) const;
+		RenderGraphStats GetStats() const { return m_stats; }
+		void LogStats() const;
+
+	private:
+		struct TextureNode
+		{
+			String name;
+			RenderGraphTextureDesc desc;
+			bool imported;
+			Ref<RenderTexture> texture;
+			int ref_count;
+			int physical;
+			int first_pass;
+			int last_pass;
+			//	last pass written the texture in execution
+			int writer;
+			bool read;
+		};
+
+		struct PassNode
+		{
+			String name;
+			Action prepare;
+			Action execute;
+			Vector<int> reads;
+			Vector<int> writes;
+			bool side_effect;
+			int ref_count;
+			bool culled;
+		};
+
+		struct Physical
+		{
+			Ref<RenderTexture> texture;
+			RenderGraphTextureDesc desc;
+			int bytes;
+			bool in_use;
+			//	read by a pass before next transient writes it
+			bool read;
+			uint64_t used_frame;
+		};
+
+		void Cull();
+		void Sort();
+		void Allocate();
+		int AcquirePhysical(const RenderGraphTextureDesc& desc);
+		void BarrierPass(int pass);
+
+		Vector<TextureNode> m_textures;
+		Vector<PassNode> m_passes;
+		//	execution order of passes not culled
+		Vector<int> m_order;
+		Vector<Physical> m_physicals;
+		uint64_t m_frame;
+		RenderGraphStats m_stats;
+	};
+}
@@ -16,19 +16,40 @@
 */
 
 #include "RenderTexture.h"
+#include "Graphics.h"
+#include "Debug.h"
 #include "time/Time.h"
+#include "memory/Memory.h"
+
+#define TEMPORARY_BUDGET_DEFAULT (64 * 1024 * 1024)
+#define TEMPORARY_IDLE_FRAMES_DEFAULT 60
 
 namespace Viry3D
 {
 	Map<long long, List<RenderTexture::Temporary>> RenderTexture::m_temporarys;
+	int RenderTexture::m_temporary_budget = TEMPORARY_BUDGET_DEFAULT;
+	int RenderTexture::m_temporary_idle_frames = TEMPORARY_IDLE_FRAMES_DEFAULT;
+	RenderTextureTemporaryStats RenderTexture::m_temporary_stats;
+	Mutex RenderTexture::m_temporary_mutex;
+
+	static long long get_temporary_key(int width, int height, RenderTextureFormat format, DepthBuffer depth)
+	{
+		long long w = width;
+		long long h = height;
+		long long f = (long long) format;
+		long long d = (long long) depth;
+		return (w << 0) | (h << 16) | (f << 32) | (d << 48);
+	}
 
 	void RenderTexture::Init()
 	{
+		Memory::Zero(&m_temporary_stats, sizeof(m_temporary_stats));
 	}
 
 	void RenderTexture::Deinit()
 	{
 		m_temporarys.Clear();
+		Memory::Zero(&m_temporary_stats, sizeof(m_temporary_stats));
 	}
 
 	Ref<RenderTexture> RenderTexture::GetTemporary(int width,
@@ -37,15 +58,12 @@ namespace Viry3D
 		DepthBuffer depth,
 		FilterMode filter_mode)
 	{
-		Ref<RenderTexture> texture;
+		std::lock_guard<Mutex> lock(m_temporary_mutex);
 
-		long long w = width;
-		long long h = height;
-		long long f = (long long) format;
-		long long d = (long long) depth;
-		long long key = (w << 0) | (h << 16) | (f << 32) | (d << 48);
+		Ref<RenderTexture> texture;
+		long long key = get_temporary_key(width, height, format, depth);
 
-		List<Temporary> *list;
+		List<Temporary>* list = NULL;
 		if (m_temporarys.TryGet(key, &list))
 		{
 			for (auto& i : *list)
@@ -65,13 +83,23 @@ namespace Viry3D
 			}
 		}
 
-		if (!texture)
+		if (texture)
+		{
+			m_temporary_stats.hits++;
+		}
+		else
 		{
 			texture = Create(width, height, format, depth, filter_mode);
 
+			// make room in budget, list may be freed by it
+			EvictTemporaries(texture->GetByteSize());
+			list = NULL;
+			m_temporarys.TryGet(key, &list);
+
 			Temporary t;
 			t.texture = texture;
 			t.in_use = true;
+			t.used_frame = Time::GetFrameCount();
 
 			if (list != NULL)
 			{
@@ -83,32 +111,161 @@ namespace Viry3D
 				new_list.AddLast(t);
 				m_temporarys.Add(key, new_list);
 			}
+
+			m_temporary_stats.misses++;
+			m_temporary_stats.resident_count++;
+			m_temporary_stats.resident_bytes += texture->GetByteSize();
 		}
 
+		m_temporary_stats.in_use_count++;
+
 		return texture;
 	}
 
 	void RenderTexture::ReleaseTemporary(Ref<RenderTexture> texture)
 	{
-		long long w = texture->GetWidth();
-		long long h = texture->GetHeight();
-		long long f = (long long) texture->GetFormat();
-		long long d = (long long) texture->GetDepth();
-		long long key = (w << 0) | (h << 16) | (f << 32) | (d << 48);
+		std::lock_guard<Mutex> lock(m_temporary_mutex);
 
-		List<Temporary> *list;
+		long long key = get_temporary_key(texture->GetWidth(), texture->GetHeight(), texture->GetFormat(), texture->GetDepth());
+
+		List<Temporary>* list;
 		if (m_temporarys.TryGet(key, &list))
 		{
 			for (auto& i : *list)
 			{
 				if (i.texture == texture)
 				{
-					i.in_use = false;
-					i.used_time = Time::GetRealTimeSinceStartup();
+					if (i.in_use)
+					{
+						i.in_use = false;
+						i.used_frame = Time::GetFrameCount();
+						m_temporary_stats.in_use_count--;
+					}
+					break;
+				}
+			}
+		}
+	}
+
+	void RenderTexture::ReleaseUnusedTemporaries()
+	{
+		std::lock_guard<Mutex> lock(m_temporary_mutex);
+
+		int frame = Time::GetFrameCount();
+
+		Vector<long long> keys;
+		Vector<Ref<RenderTexture>> textures;
+		for (const auto& i : m_temporarys)
+		{
+			for (const auto& j : i.second)
+			{
+				if (!j.in_use && frame - j.used_frame > m_temporary_idle_frames)
+				{
+					keys.Add(i.first);
+					textures.Add(j.texture);
+				}
+			}
+		}
+
+		for (int i = 0; i < textures.Size(); i++)
+		{
+			EvictTemporary(keys[i], textures[i]);
+		}
+
+		EvictTemporaries(0);
+	}
+
+	void RenderTexture::EvictTemporaries(int size)
+	{
+		// least recently used first
+		while (m_temporary_stats.resident_bytes + size > m_temporary_budget)
+		{
+			long long lru_key = 0;
+			Ref<RenderTexture> lru;
+			int lru_frame = 0;
+
+			for (const auto& i : m_temporarys)
+			{
+				for (const auto& j : i.second)
+				{
+					if (!j.in_use && (!lru || j.used_frame < lru_frame))
+					{
+						lru_key = i.first;
+						lru = j.texture;
+						lru_frame = j.used_frame;
+					}
+				}
+			}
+
+			if (!lru)
+			{
+				break;
+			}
+
+			EvictTemporary(lru_key, lru);
+		}
+	}
+
+	void RenderTexture::EvictTemporary(long long key, const Ref<RenderTexture>& texture)
+	{
+		List<Temporary>* list;
+		if (m_temporarys.TryGet(key, &list))
+		{
+			for (auto i = list->begin(); i != list->end(); i++)
+			{
+				if (i->texture == texture)
+				{
+					list->Remove(i);
 					break;
 				}
 			}
+
+			if (list->Empty())
+			{
+				m_temporarys.Remove(key);
+			}
+		}
+
+		m_temporary_stats.evictions++;
+		m_temporary_stats.resident_count--;
+		m_temporary_stats.resident_bytes -= texture->GetByteSize();
+
+		// blit caches would keep it alive
+		Graphics::ReleaseBlitCache(texture);
+	}
+
+	void RenderTexture::LogTemporaryStats()
+	{
+		Log("render texture temporaries hits:%d misses:%d evictions:%d resident:%d %dKB in use:%d budget:%dKB",
+			m_temporary_stats.hits,
+			m_temporary_stats.misses,
+			m_temporary_stats.evictions,
+			m_temporary_stats.resident_count,
+			m_temporary_stats.resident_bytes / 1024,
+			m_temporary_stats.in_use_count,
+			m_temporary_budget / 1024);
+	}
+
+	int RenderTexture::GetByteSize() const
+	{
+		int pixel_bytes = 4;
+
+		switch (m_format)
+		{
+			case RenderTextureFormat::R8:
+				pixel_bytes = 1;
+				break;
+			case RenderTextureFormat::RGBAHalf:
+				pixel_bytes = 8;
+				break;
+			case RenderTextureFormat::Depth:
+				pixel_bytes = m_depth == DepthBuffer::Depth_16 ? 2 : 4;
+				break;
+			default:
+				break;
 		}
+
+		return this->GetWidth() * this->GetHeight() * pixel_bytes;
 	}
 
 	Ref<RenderTexture> RenderTexture::Create(
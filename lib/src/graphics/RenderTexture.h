@@ -21,9 +21,20 @@
 #include "RenderTextureFormat.h"
 #include "DepthBuffer.h"
 #include "container/List.h"
+#include "thread/Thread.h"
 
 namespace Viry3D
 {
+	struct RenderTextureTemporaryStats
+	{
+		int hits;
+		int misses;
+		int evictions;
+		int resident_count;
+		int resident_bytes;
+		int in_use_count;
+	};
+
 	class RenderTexture: public Texture
 	{
 	public:
@@ -41,22 +52,40 @@ namespace Viry3D
 			DepthBuffer depth,
 			FilterMode filter_mode);
 		static void ReleaseTemporary(Ref<RenderTexture> texture);
+		//	free temporaries not used for some frames or over budget, call once a frame
+		static void ReleaseUnusedTemporaries();
+		//	idle temporaries are freed before pool grows over budget, temporaries in use are never freed
+		static void SetTemporaryBudget(int bytes) { m_temporary_budget = bytes; }
+		static int GetTemporaryBudget() { return m_temporary_budget; }
+		static void SetTemporaryIdleFrames(int frames) { m_temporary_idle_frames = frames; }
+		static int GetTemporaryIdleFrames() { return m_temporary_idle_frames; }
+		static RenderTextureTemporaryStats GetTemporaryStats() { return m_temporary_stats; }
+		static void LogTemporaryStats();
 
 		RenderTextureFormat GetFormat() const { return m_format; }
 		DepthBuffer GetDepth() const { return m_depth; }
+		//	estimated gpu memory
+		int GetByteSize() const;
 
 	private:
 		RenderTexture();
+		static void EvictTemporaries(int size);
+		static void EvictTemporary(long long key, const Ref<RenderTexture>& texture);
 
 	private:
 		struct Temporary
 		{
 			Ref<RenderTexture> texture;
 			bool in_use;
-			float used_time;
+			int used_frame;
 		};
 
 		static Map<long long, List<Temporary>> m_temporarys;
+		static int m_temporary_budget;
+		static int m_temporary_idle_frames;
+		static RenderTextureTemporaryStats m_temporary_stats;
+		//	image effects take temporaries on render thread
+		static Mutex m_temporary_mutex;
 
 		RenderTextureFormat m_format;
 		DepthBuffer m_depth;
@@ -0,0 +1,103 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "RenderThread.h"
+#include "Profiler.h"
+
+namespace Viry3D
+{
+	RenderThread::RenderThread():
+		m_frame_count(0)
+	{
+		ThreadInfo info;
+		info.init = [this]() {
+			m_thread_id = std::this_thread::get_id();
+		};
+		m_thread = RefMake<Thread>(0, info);
+	}
+
+	RenderThread::~RenderThread()
+	{
+		this->Wait();
+		m_thread.reset();
+
+		// commands posted after last frame, e.g. releases
+		for (auto& i : m_commands)
+		{
+			i();
+		}
+		m_commands.Clear();
+		m_rendering.Clear();
+		m_retained.Clear();
+	}
+
+	void RenderThread::Render(Action frame)
+	{
+		// objects of last frame are no longer used
+		m_rendering = m_retained;
+		m_retained.Clear();
+		m_frame_count++;
+
+		m_thread->AddTask({
+			[=]() {
+				Vector<Action> commands;
+				m_mutex.lock();
+				commands = m_commands;
+				m_commands.Clear();
+				m_mutex.unlock();
+
+				for (auto& i : commands)
+				{
+					i();
+				}
+				commands.Clear();
+
+				Profiler::SampleBegin("RenderThread::Render");
+				frame();
+				Profiler::SampleEnd();
+
+				return Ref<Any>();
+			},
+			nullptr
+		});
+	}
+
+	void RenderThread::Wait()
+	{
+		Profiler::SampleBegin("RenderThread::Wait");
+		m_thread->Wait();
+		Profiler::SampleEnd();
+	}
+
+	void RenderThread::Post(Action command)
+	{
+		m_mutex.lock();
+		m_commands.Add(command);
+		m_mutex.unlock();
+	}
+
+	void RenderThread::Retain(const Ref<Object>& obj)
+	{
+		m_retained.Add(obj);
+	}
+
+	bool RenderThread::IsRenderThread() const
+	{
+		return std::this_thread::get_id() == m_thread_id;
+	}
+}
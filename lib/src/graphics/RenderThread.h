@@ -0,0 +1,57 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include "Object.h"
+#include "Action.h"
+#include "container/Vector.h"
+#include "thread/Thread.h"
+
+namespace Viry3D
+{
+	//	renders a frame on its own thread while main thread updates the next one,
+	//	frame is prepared on main thread first, so rendering reads culled passes,
+	//	uniforms and camera state of that frame instead of the live scene
+	class RenderThread
+	{
+	public:
+		RenderThread();
+		~RenderThread();
+		//	frame starts after commands posted before it, call Wait first
+		void Render(Action frame);
+		//	returns when rendering of last frame finished
+		void Wait();
+		//	runs on render thread before next frame, in posted order
+		void Post(Action command);
+		//	keeps object alive until frame being prepared is rendered,
+		//	released on main thread so destructors never run on render thread
+		void Retain(const Ref<Object>& obj);
+		bool IsRenderThread() const;
+		int GetFrameCount() const { return m_frame_count; }
+
+	private:
+		Ref<Thread> m_thread;
+		std::thread::id m_thread_id;
+		Mutex m_mutex;
+		Vector<Action> m_commands;
+		Vector<Ref<Object>> m_retained;
+		Vector<Ref<Object>> m_rendering;
+		int m_frame_count;
+	};
+}
@@ -16,8 +16,11 @@
 */
 
 #include "Shader.h"
+#include "ShaderPackage.h"
 #include "Application.h"
+#include "Graphics.h"
 #include "Texture2D.h"
+#include "Resource.h"
 #include "Debug.h"
 #include "io/Directory.h"
 
@@ -29,8 +32,12 @@ namespace Viry3D
 {
 	Map<String, Ref<Shader>> Shader::m_shaders;
 	Mutex Shader::m_mutex;
+	std::condition_variable Shader::m_compile_condition;
+	bool Shader::m_async_compile = false;
 	Map<String, Ref<Texture2D>> Shader::m_default_textures;
 
+	static const String FALLBACK_SHADER_NAME = "Base";
+
 	static String get_shader_path(const String& name)
 	{
 		static Map<String, String> s_path_map;
@@ -64,6 +71,16 @@ namespace Viry3D
 #if VR_VULKAN
 		init_compiler();
 #endif
+
+		auto shader_dir = Application::DataPath() + "/shader";
+		auto package_path = shader_dir + "/shader.pkg";
+#if VR_WINDOWS
+		// desktop runs on source assets, package written here is shipped to device by copy_assets.py
+		ShaderPackage::Update(shader_dir, package_path);
+#else
+		// optional, falls back to shader xml files when not exist
+		ShaderPackage::Open(package_path);
+#endif
 	}
 
 	void Shader::Deinit()
@@ -73,6 +90,8 @@ namespace Viry3D
 		m_mutex.unlock();
 		m_default_textures.Clear();
 
+		ShaderPackage::Close();
+
 #if VR_VULKAN
 		deinit_compiler();
 #endif
@@ -80,10 +99,15 @@ namespace Viry3D
 
 	void Shader::ClearAllPipelines()
 	{
+		m_mutex.lock();
 		for (auto& i : m_shaders)
 		{
-			i.second->ClearPipelines();
+			if (i.second->m_compiled)
+			{
+				i.second->ClearPipelines();
+			}
 		}
+		m_mutex.unlock();
 	}
 
 	const Ref<Texture2D>& Shader::GetDefaultTexture(const String& name)
@@ -136,12 +160,14 @@ namespace Viry3D
 		return m_default_textures[name];
 	}
 
-	Shader::Shader(const String& name)
+	Shader::Shader(const String& name):
+		m_compile_started(false),
+		m_compiled(false)
 	{
 		SetName(name);
 	}
 
-	Ref<Shader> Shader::Find(const String& name)
+	Ref<Shader> Shader::GetOrAdd(const String& name)
 	{
 		Ref<Shader> shader;
 
@@ -154,12 +180,13 @@ namespace Viry3D
 		}
 		else
 		{
-			String path = get_shader_path(name);
-			if (!path.Empty())
+			// packed shader has empty path, no directory scan needed
+			bool packed = ShaderPackage::Contains(name);
+			String path = packed ? String() : get_shader_path(name);
+			if (packed || !path.Empty())
 			{
 				shader = Ref<Shader>(new Shader(name));
-				shader->m_xml.Load(path);
-				shader->Compile();
+				shader->m_path = path;
 
 				m_shaders.Add(name, shader);
 			}
@@ -174,6 +201,179 @@ namespace Viry3D
 		return shader;
 	}
 
+	// run without m_mutex held, other threads only wait on this shader
+	void Shader::LoadAndCompile()
+	{
+		if (!m_source.Empty())
+		{
+			m_xml.LoadSource(m_source);
+		}
+		else
+		{
+			if (m_path.Empty() && !ShaderPackage::Load(this->GetName(), m_xml))
+			{
+				// package entry out of date, source xml edited after package built
+				m_mutex.lock();
+				m_path = get_shader_path(this->GetName());
+				m_mutex.unlock();
+			}
+
+			if (!m_path.Empty())
+			{
+				m_xml.Load(m_path);
+			}
+		}
+		this->Compile();
+
+		m_mutex.lock();
+		m_compiled = true;
+		m_mutex.unlock();
+
+		m_compile_condition.notify_all();
+	}
+
+	void Shader::EnsureCompiled()
+	{
+		bool compile = false;
+
+		m_mutex.lock();
+		if (!m_compile_started)
+		{
+			m_compile_started = true;
+			compile = true;
+		}
+		m_mutex.unlock();
+
+		if (compile)
+		{
+			this->LoadAndCompile();
+		}
+		else
+		{
+			this->WaitCompiled();
+		}
+	}
+
+	void Shader::WaitCompiled()
+	{
+		std::unique_lock<Mutex> lock(m_mutex);
+		m_compile_condition.wait(lock, [this]() {
+			return m_compiled;
+		});
+	}
+
+	Ref<Shader> Shader::Find(const String& name)
+	{
+		auto shader = GetOrAdd(name);
+
+		if (shader)
+		{
+			// takes over compile FindAsync queued but load thread not started yet
+			shader->EnsureCompiled();
+		}
+
+		return shader;
+	}
+
+	Ref<Shader> Shader::FindOrCreate(const String& name, const String& xml)
+	{
+		Ref<Shader> shader;
+
+		m_mutex.lock();
+
+		Ref<Shader>* find;
+		if (m_shaders.TryGet(name, &find))
+		{
+			shader = *find;
+		}
+		else
+		{
+			shader = Ref<Shader>(new Shader(name));
+			shader->m_source = xml;
+
+			m_shaders.Add(name, shader);
+		}
+
+		m_mutex.unlock();
+
+		shader->EnsureCompiled();
+
+		return shader;
+	}
+
+	void Shader::FindAsync(const String& name, FindComplete callback)
+	{
+		auto shader = GetOrAdd(name);
+
+		if (!shader || Shader::IsCompiled(name))
+		{
+			if (callback)
+			{
+				callback(shader);
+			}
+			return;
+		}
+
+		// compiles here unless Find took it over or another thread is compiling it
+		Resource::AddAsyncLoadTask({
+			[=]() {
+			shader->EnsureCompiled();
+			Graphics::GetDisplay()->FlushContext();
+			return Ref<Any>();
+		},
+			[=](Ref<Any> any) {
+			if (callback)
+			{
+				callback(shader);
+			}
+		}
+		});
+	}
+
+	void Shader::Prewarm(const Vector<String>& names, Action done)
+	{
+		if (names.Empty())
+		{
+			if (done)
+			{
+				done();
+			}
+			return;
+		}
+
+		auto remain = RefMake<int>(names.Size());
+		for (const auto& i : names)
+		{
+			Shader::FindAsync(i, [=](const Ref<Shader>& shader) {
+				(*remain)--;
+				if (*remain == 0 && done)
+				{
+					done();
+				}
+			});
+		}
+	}
+
+	bool Shader::IsCompiled(const String& name)
+	{
+		bool compiled = false;
+
+		m_mutex.lock();
+		Ref<Shader>* find;
+		if (m_shaders.TryGet(name, &find))
+		{
+			compiled = (*find)->m_compiled;
+		}
+		m_mutex.unlock();
+
+		return compiled;
+	}
+
+	Ref<Shader> Shader::GetFallbackShader()
+	{
+		return Shader::Find(FALLBACK_SHADER_NAME);
+	}
+
 	Ref<Shader> Shader::ReplaceToShadowMapShader(const Ref<Shader>& shader)
 	{
 		if (shader->GetName().StartsWith("SkinnedMesh"))
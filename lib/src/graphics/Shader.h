@@ -42,21 +42,47 @@ namespace Viry3D
 		friend class ShaderGLES;
 #endif
 	public:
+		typedef std::function<void(const Ref<Shader>& shader)> FindComplete;
+
 		static void Init();
 		static void Deinit();
 		static void ClearAllPipelines();
 		static Ref<Shader> Find(const String& name);
+		//	shader from xml text built at runtime, name must identify the text
+		static Ref<Shader> FindOrCreate(const String& name, const String& xml);
+		//	load and compile on resource load thread, callback run on main thread
+		static void FindAsync(const String& name, FindComplete callback);
+		//	compile shaders before use, e.g. on loading screen, done run on main thread
+		static void Prewarm(const Vector<String>& names, Action done = NULL);
+		static bool IsCompiled(const String& name);
+		//	materials created when enabled render with fallback shader until compile finish
+		static void SetAsyncCompile(bool enable) { m_async_compile = enable; }
+		static bool IsAsyncCompile() { return m_async_compile; }
+		static Ref<Shader> GetFallbackShader();
 		static Ref<Shader> ReplaceToShadowMapShader(const Ref<Shader>& shader);
 		static const Ref<Texture2D>& GetDefaultTexture(const String& name);
 
 		int GetQueue() const;
+		bool IsGenerated() const { return !m_source.Empty(); }
 
 	private:
 		Shader(const String& name);
+		static Ref<Shader> GetOrAdd(const String& name);
+		//	compiles on this thread unless another thread started, then waits it,
+		//	so a load task never waits a compile queued behind it
+		void EnsureCompiled();
+		void LoadAndCompile();
+		void WaitCompiled();
 
 		static Map<String, Ref<Shader>> m_shaders;
 		static Mutex m_mutex;
+		static std::condition_variable m_compile_condition;
+		static bool m_async_compile;
 		static Map<String, Ref<Texture2D>> m_default_textures;
 		XMLShader m_xml;
+		String m_path;
+		String m_source;
+		bool m_compile_started;
+		bool m_compiled;
 	};
 }
@@ -0,0 +1,631 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "ShaderPackage.h"
+#include "io/File.h"
+#include "io/Directory.h"
+#include "io/MemoryStream.h"
+#include "Debug.h"
+
+#if VR_VULKAN
+#include "vulkan/ShaderVulkan.h"
+#endif
+
+extern "C"
+{
+#include "crypto/md5/md5.h"
+}
+
+#if VR_WINDOWS
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define SHADER_PACKAGE_MAGIC 0x4b505356 // VSPK
+#define SHADER_PACKAGE_VERSION 2
+
+namespace Viry3D
+{
+	String ShaderPackage::m_shader_dir;
+	ByteBuffer ShaderPackage::m_data;
+	Map<String, ShaderPackage::Entry> ShaderPackage::m_entries;
+
+#if VR_WINDOWS
+	static HANDLE g_package_file = INVALID_HANDLE_VALUE;
+	static HANDLE g_package_mapping = NULL;
+#endif
+	static void* g_package_view = NULL;
+	static int g_package_size = 0;
+
+	static bool map_file(const String& path)
+	{
+#if VR_WINDOWS
+		g_package_file = CreateFileA(path.CString(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (g_package_file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		g_package_size = (int) GetFileSize(g_package_file, NULL);
+		g_package_mapping = CreateFileMappingA(g_package_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (g_package_mapping != NULL)
+		{
+			g_package_view = MapViewOfFile(g_package_mapping, FILE_MAP_READ, 0, 0, 0);
+		}
+#else
+		int fd = open(path.CString(), O_RDONLY);
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			g_package_size = (int) st.st_size;
+			g_package_view = mmap(NULL, g_package_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (g_package_view == MAP_FAILED)
+			{
+				g_package_view = NULL;
+			}
+		}
+		close(fd);
+#endif
+
+		return g_package_view != NULL;
+	}
+
+	static void unmap_file()
+	{
+#if VR_WINDOWS
+		if (g_package_view != NULL)
+		{
+			UnmapViewOfFile(g_package_view);
+		}
+		if (g_package_mapping != NULL)
+		{
+			CloseHandle(g_package_mapping);
+			g_package_mapping = NULL;
+		}
+		if (g_package_file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(g_package_file);
+			g_package_file = INVALID_HANDLE_VALUE;
+		}
+#else
+		if (g_package_view != NULL)
+		{
+			munmap(g_package_view, g_package_size);
+		}
+#endif
+		g_package_view = NULL;
+		g_package_size = 0;
+	}
+
+	static String read_string(MemoryStream& ms)
+	{
+		auto size = ms.Read<int>();
+		return ms.ReadString(size);
+	}
+
+	// empty when source xml not exists, e.g. only package shipped
+	static String hash_source(const String& shader_dir, const String& name, const Vector<String>& includes)
+	{
+		auto xml_path = shader_dir + "/" + name + ".shader.xml";
+		if (!File::Exist(xml_path))
+		{
+			return "";
+		}
+
+		unsigned char hash_bytes[16];
+		MD5_CTX md5_context;
+		MD5_Init(&md5_context);
+		auto bytes = File::ReadAllBytes(xml_path);
+		MD5_Update(&md5_context, (void*) bytes.Bytes(), bytes.Size());
+		for (const auto& i : includes)
+		{
+			bytes = File::ReadAllBytes(shader_dir + "/Include/" + i);
+			MD5_Update(&md5_context, (void*) bytes.Bytes(), bytes.Size());
+		}
+		MD5_Final(hash_bytes, &md5_context);
+		String md5_str;
+		for (int i = 0; i < (int) sizeof(hash_bytes); i++)
+		{
+			md5_str += String::Format("%02x", hash_bytes[i]);
+		}
+
+		return md5_str;
+	}
+
+	static void read_source_info(MemoryStream& ms, String& hash, Vector<String>& includes)
+	{
+		hash = read_string(ms);
+		includes.Resize(ms.Read<int>());
+		for (auto& i : includes)
+		{
+			i = read_string(ms);
+		}
+	}
+
+	static void read_uniform_buffer(MemoryStream& ms, XMLUniformBuffer& ub)
+	{
+		ub.name = read_string(ms);
+		ub.binding = ms.Read<int>();
+		ub.size = ms.Read<int>();
+		ub.offset = ms.Read<int>();
+		ub.uniforms.Resize(ms.Read<int>());
+		for (auto& i : ub.uniforms)
+		{
+			i.name = read_string(ms);
+			i.offset = ms.Read<int>();
+			i.size = ms.Read<int>();
+		}
+	}
+
+	static void read_spirv(MemoryStream& ms, Vector<unsigned int>& spirv)
+	{
+		int size = ms.Read<int>();
+		if (size > 0)
+		{
+			spirv.Resize(size);
+			ms.Read(&spirv[0], spirv.SizeInBytes());
+		}
+	}
+
+	static void read_shader(MemoryStream& ms, XMLShader& xml)
+	{
+		xml.name = read_string(ms);
+		xml.queue = ms.Read<int>();
+
+		xml.passes.Resize(ms.Read<int>());
+		for (auto& i : xml.passes)
+		{
+			i.name = read_string(ms);
+			i.vs = read_string(ms);
+			i.ps = read_string(ms);
+			i.rs = read_string(ms);
+		}
+
+		xml.vss.Resize(ms.Read<int>());
+		for (auto& i : xml.vss)
+		{
+			i.name = read_string(ms);
+			i.src = read_string(ms);
+			read_uniform_buffer(ms, i.uniform_buffer);
+			i.attrs.Resize(ms.Read<int>());
+			for (auto& j : i.attrs)
+			{
+				j.name = read_string(ms);
+				j.type = (VertexAttributeType) ms.Read<int>();
+				j.location = ms.Read<int>();
+				j.size = ms.Read<int>();
+				j.offset = ms.Read<int>();
+			}
+			i.stride = ms.Read<int>();
+			read_spirv(ms, i.spirv);
+		}
+
+		xml.pss.Resize(ms.Read<int>());
+		for (auto& i : xml.pss)
+		{
+			i.name = read_string(ms);
+			i.src = read_string(ms);
+			read_uniform_buffer(ms, i.uniform_buffer);
+			i.samplers.Resize(ms.Read<int>());
+			for (auto& j : i.samplers)
+			{
+				j.name = read_string(ms);
+				j.type = read_string(ms);
+				j.binding = ms.Read<int>();
+				j.default_tex = read_string(ms);
+			}
+			read_spirv(ms, i.spirv);
+		}
+
+		xml.rss.Resize(ms.Read<int>());
+		for (auto& i : xml.rss)
+		{
+			i.name = read_string(ms);
+			i.Cull = read_string(ms);
+			i.ZTest = read_string(ms);
+			i.ZWrite = read_string(ms);
+			i.AlphaTest = read_string(ms);
+			i.Blend.enable = ms.Read<int>() != 0;
+			i.Blend.src = read_string(ms);
+			i.Blend.dst = read_string(ms);
+			i.Blend.src_a = read_string(ms);
+			i.Blend.dst_a = read_string(ms);
+			i.ColorMask = read_string(ms);
+			i.Offset.enable = ms.Read<int>() != 0;
+			i.Offset.factor = ms.Read<float>();
+			i.Offset.units = ms.Read<float>();
+			i.Stencil.enable = ms.Read<int>() != 0;
+			i.Stencil.RefValue = ms.Read<int>();
+			i.Stencil.ReadMask = ms.Read<int>();
+			i.Stencil.WriteMask = ms.Read<int>();
+			i.Stencil.Comp = read_string(ms);
+			i.Stencil.Pass = read_string(ms);
+			i.Stencil.Fail = read_string(ms);
+			i.Stencil.ZFail = read_string(ms);
+		}
+	}
+
+	template<class T>
+	static void write(Vector<byte>& buffer, const T& t)
+	{
+		buffer.AddRange((const byte*) &t, sizeof(T));
+	}
+
+	static void write_string(Vector<byte>& buffer, const String& str)
+	{
+		write<int>(buffer, str.Size());
+		buffer.AddRange((const byte*) str.CString(), str.Size());
+	}
+
+	static void write_uniform_buffer(Vector<byte>& buffer, const XMLUniformBuffer& ub)
+	{
+		write_string(buffer, ub.name);
+		write<int>(buffer, ub.binding);
+		write<int>(buffer, ub.size);
+		write<int>(buffer, ub.offset);
+		write<int>(buffer, ub.uniforms.Size());
+		for (const auto& i : ub.uniforms)
+		{
+			write_string(buffer, i.name);
+			write<int>(buffer, i.offset);
+			write<int>(buffer, i.size);
+		}
+	}
+
+	static void write_spirv(Vector<byte>& buffer, const Vector<unsigned int>& spirv)
+	{
+		write<int>(buffer, spirv.Size());
+		if (spirv.Size() > 0)
+		{
+			buffer.AddRange(spirv.Bytes(), spirv.SizeInBytes());
+		}
+	}
+
+	static void write_shader(Vector<byte>& buffer, const XMLShader& xml)
+	{
+		write_string(buffer, xml.name);
+		write<int>(buffer, xml.queue);
+
+		write<int>(buffer, xml.passes.Size());
+		for (const auto& i : xml.passes)
+		{
+			write_string(buffer, i.name);
+			write_string(buffer, i.vs);
+			write_string(buffer, i.ps);
+			write_string(buffer, i.rs);
+		}
+
+		write<int>(buffer, xml.vss.Size());
+		for (const auto& i : xml.vss)
+		{
+			write_string(buffer, i.name);
+			write_string(buffer, i.src);
+			write_uniform_buffer(buffer, i.uniform_buffer);
+			write<int>(buffer, i.attrs.Size());
+			for (const auto& j : i.attrs)
+			{
+				write_string(buffer, j.name);
+				write<int>(buffer, (int) j.type);
+				write<int>(buffer, j.location);
+				write<int>(buffer, j.size);
+				write<int>(buffer, j.offset);
+			}
+			write<int>(buffer, i.stride);
+			write_spirv(buffer, i.spirv);
+		}
+
+		write<int>(buffer, xml.pss.Size());
+		for (const auto& i : xml.pss)
+		{
+			write_string(buffer, i.name);
+			write_string(buffer, i.src);
+			write_uniform_buffer(buffer, i.uniform_buffer);
+			write<int>(buffer, i.samplers.Size());
+			for (const auto& j : i.samplers)
+			{
+				write_string(buffer, j.name);
+				write_string(buffer, j.type);
+				write<int>(buffer, j.binding);
+				write_string(buffer, j.default_tex);
+			}
+			write_spirv(buffer, i.spirv);
+		}
+
+		write<int>(buffer, xml.rss.Size());
+		for (const auto& i : xml.rss)
+		{
+			write_string(buffer, i.name);
+			write_string(buffer, i.Cull);
+			write_string(buffer, i.ZTest);
+			write_string(buffer, i.ZWrite);
+			write_string(buffer, i.AlphaTest);
+			write<int>(buffer, i.Blend.enable ? 1 : 0);
+			write_string(buffer, i.Blend.src);
+			write_string(buffer, i.Blend.dst);
+			write_string(buffer, i.Blend.src_a);
+			write_string(buffer, i.Blend.dst_a);
+			write_string(buffer, i.ColorMask);
+			write<int>(buffer, i.Offset.enable ? 1 : 0);
+			write<float>(buffer, i.Offset.factor);
+			write<float>(buffer, i.Offset.units);
+			write<int>(buffer, i.Stencil.enable ? 1 : 0);
+			write<int>(buffer, i.Stencil.RefValue);
+			write<int>(buffer, i.Stencil.ReadMask);
+			write<int>(buffer, i.Stencil.WriteMask);
+			write_string(buffer, i.Stencil.Comp);
+			write_string(buffer, i.Stencil.Pass);
+			write_string(buffer, i.Stencil.Fail);
+			write_string(buffer, i.Stencil.ZFail);
+		}
+	}
+
+	static String merge_includes(const String& shader_dir, Vector<String>& includes, const String& src)
+	{
+		String source;
+		for (const auto& i : includes)
+		{
+			auto bytes = File::ReadAllBytes(shader_dir + "/Include/" + i);
+			source += String(bytes) + "\n";
+		}
+		source += src;
+		includes.Clear();
+
+		return source;
+	}
+
+	bool ShaderPackage::Open(const String& path)
+	{
+		Close();
+
+		if (!map_file(path))
+		{
+			unmap_file();
+			return false;
+		}
+
+		m_shader_dir = path.Substring(0, path.LastIndexOf("/"));
+		m_data = ByteBuffer((byte*) g_package_view, g_package_size);
+		MemoryStream ms(m_data);
+
+		int magic = ms.Read<int>();
+		int version = ms.Read<int>();
+		if (magic != SHADER_PACKAGE_MAGIC || version != SHADER_PACKAGE_VERSION)
+		{
+			Log("invalid shader package:%s", path.CString());
+			Close();
+			return false;
+		}
+
+		int count = ms.Read<int>();
+		for (int i = 0; i < count; i++)
+		{
+			auto name = read_string(ms);
+			Entry entry;
+			entry.offset = ms.Read<int>();
+			entry.size = ms.Read<int>();
+			m_entries.Add(name, entry);
+		}
+
+		return true;
+	}
+
+	void ShaderPackage::Close()
+	{
+		m_entries.Clear();
+		m_shader_dir = String();
+		m_data = ByteBuffer();
+		unmap_file();
+	}
+
+	bool ShaderPackage::Contains(const String& name)
+	{
+		return m_entries.Contains(name);
+	}
+
+	bool ShaderPackage::Load(const String& name, XMLShader& xml)
+	{
+		Entry* entry;
+		if (!m_entries.TryGet(name, &entry))
+		{
+			return false;
+		}
+
+		MemoryStream ms(ByteBuffer(m_data.Bytes() + entry->offset, entry->size));
+
+		String hash;
+		Vector<String> includes;
+		read_source_info(ms, hash, includes);
+
+		auto source_hash = hash_source(m_shader_dir, name, includes);
+		if (!source_hash.Empty() && source_hash != hash)
+		{
+			Log("shader package entry out of date:%s", name.CString());
+			return false;
+		}
+
+		read_shader(ms, xml);
+
+		return true;
+	}
+
+	bool ShaderPackage::IsStale(const String& shader_dir)
+	{
+		int count = 0;
+
+		auto files = Directory::GetFiles(shader_dir, true);
+		for (const auto& i : files)
+		{
+			if (!i.EndsWith(".shader.xml"))
+			{
+				continue;
+			}
+
+			auto name = i.Substring(shader_dir.Size() + 1);
+			name = name.Substring(0, name.IndexOf("."));
+
+			Entry* entry;
+			if (!m_entries.TryGet(name, &entry))
+			{
+				return true;
+			}
+
+			MemoryStream ms(ByteBuffer(m_data.Bytes() + entry->offset, entry->size));
+			String hash;
+			Vector<String> includes;
+			read_source_info(ms, hash, includes);
+			if (hash_source(shader_dir, name, includes) != hash)
+			{
+				return true;
+			}
+
+			count++;
+		}
+
+		return count != m_entries.Size();
+	}
+
+	bool ShaderPackage::Update(const String& shader_dir, const String& path)
+	{
+		if (Open(path) && !IsStale(shader_dir))
+		{
+			return true;
+		}
+
+		// mapped file must be closed before it is written
+		Close();
+
+		Log("build shader package:%s", path.CString());
+		if (!Build(shader_dir, path))
+		{
+			return false;
+		}
+
+		return Open(path);
+	}
+
+	bool ShaderPackage::Build(const String& shader_dir, const String& path)
+	{
+		Vector<String> names;
+		Vector<Vector<byte>> blobs;
+
+		auto files = Directory::GetFiles(shader_dir, true);
+		for (const auto& i : files)
+		{
+			if (!i.EndsWith(".shader.xml"))
+			{
+				continue;
+			}
+
+			auto name = i.Substring(shader_dir.Size() + 1);
+			name = name.Substring(0, name.IndexOf("."));
+
+			XMLShader xml;
+			xml.Load(i);
+
+			// merged into source below, kept to detect include changes
+			Vector<String> includes;
+			for (const auto& j : xml.vss)
+			{
+				for (const auto& k : j.includes)
+				{
+					includes.Add(k);
+				}
+			}
+			for (const auto& j : xml.pss)
+			{
+				for (const auto& k : j.includes)
+				{
+					includes.Add(k);
+				}
+			}
+
+			for (auto& j : xml.vss)
+			{
+				j.src = merge_includes(shader_dir, j.includes, j.src);
+#if VR_VULKAN
+				if (!ShaderVulkan::CompileSpirv(j.spirv, j.src, VK_SHADER_STAGE_VERTEX_BIT))
+				{
+					Log("shader package compile failed:%s %s", name.CString(), j.name.CString());
+					return false;
+				}
+#endif
+			}
+
+			for (auto& j : xml.pss)
+			{
+				j.src = merge_includes(shader_dir, j.includes, j.src);
+#if VR_VULKAN
+				if (!ShaderVulkan::CompileSpirv(j.spirv, j.src, VK_SHADER_STAGE_FRAGMENT_BIT))
+				{
+					Log("shader package compile failed:%s %s", name.CString(), j.name.CString());
+					return false;
+				}
+#endif
+			}
+
+			Vector<byte> blob;
+			write_string(blob, hash_source(shader_dir, name, includes));
+			write<int>(blob, includes.Size());
+			for (const auto& j : includes)
+			{
+				write_string(blob, j);
+			}
+			write_shader(blob, xml);
+
+			names.Add(name);
+			blobs.Add(blob);
+		}
+
+		int header_size = sizeof(int) * 3;
+		for (const auto& i : names)
+		{
+			header_size += sizeof(int) * 3 + i.Size();
+		}
+
+		Vector<byte> buffer;
+		write<int>(buffer, SHADER_PACKAGE_MAGIC);
+		write<int>(buffer, SHADER_PACKAGE_VERSION);
+		write<int>(buffer, names.Size());
+
+		int offset = header_size;
+		for (int i = 0; i < names.Size(); i++)
+		{
+			write_string(buffer, names[i]);
+			write<int>(buffer, offset);
+			write<int>(buffer, blobs[i].Size());
+			offset += blobs[i].Size();
+		}
+
+		for (const auto& i : blobs)
+		{
+			buffer.AddRange(i.Bytes(), i.Size());
+		}
+
+		File::WriteAllBytes(path, ByteBuffer(buffer.Bytes(), buffer.Size()));
+
+		return true;
+	}
+}
@@ -0,0 +1,55 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "XMLShader.h"
+#include "container/Map.h"
+#include "memory/ByteBuffer.h"
+
+namespace Viry3D
+{
+	//	offline built file with every shader's parsed xml, includes merged into source,
+	//	and spirv when built by vulkan backend, indexed by shader name and read through file mapping,
+	//	entries keep a hash of source xml and includes so edited shaders are not loaded from package
+	class ShaderPackage
+	{
+	public:
+		static bool Open(const String& path);
+		static void Close();
+		static bool Contains(const String& name);
+		//	false when not packed or source xml changed since package was built
+		static bool Load(const String& name, XMLShader& xml);
+		//	parse all .shader.xml under shader_dir and write package to path, needs vulkan compiler initialized
+		static bool Build(const String& shader_dir, const String& path);
+		//	open package at path, build it again first when a shader xml was added, removed or changed
+		static bool Update(const String& shader_dir, const String& path);
+
+	private:
+		struct Entry
+		{
+			int offset;
+			int size;
+		};
+
+		static bool IsStale(const String& shader_dir);
+
+		static String m_shader_dir;
+		static ByteBuffer m_data;
+		static Map<String, Entry> m_entries;
+	};
+}
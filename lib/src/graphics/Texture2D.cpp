@@ -148,7 +148,7 @@ namespace Viry3D
 		SetName("Texture2D");
 	}
 
-	void Texture2D::EncodeToPNG(const String& file)
+	int Texture2D::GetBitsPerPixel() const
 	{
 		int bpp;
 		auto format = this->GetFormat();
@@ -168,7 +168,17 @@ namespace Viry3D
 				break;
 		}
 
-		Image::EncodeToPNG(this, bpp, file);
+		return bpp;
+	}
+
+	void Texture2D::EncodeToPNG(const String& file)
+	{
+		Image::EncodeToPNG(this, this->GetBitsPerPixel(), file);
+	}
+
+	void Texture2D::EncodeToPNGAsync(const String& file, Image::EncodeComplete callback)
+	{
+		Image::EncodeToPNGAsync(m_colors, this->GetWidth(), this->GetHeight(), this->GetBitsPerPixel(), file, callback);
 	}
     
     void Texture2D::UpdateExternalTexture(void* external_texture)
@@ -19,6 +19,7 @@
 
 #include "Texture.h"
 #include "TextureFormat.h"
+#include "Image.h"
 
 namespace Viry3D
 {
@@ -57,10 +58,13 @@ namespace Viry3D
 		ByteBuffer& GetColors() { return m_colors; }
 		void UpdateTexture(int x, int y, int w, int h, const ByteBuffer& colors);
 		void EncodeToPNG(const String& file);
+		//	snapshot of colors is encoded and written on encode threads
+		void EncodeToPNGAsync(const String& file, Image::EncodeComplete callback = NULL);
 		TextureFormat GetFormat() const { return m_format; }
 
 	private:
 		Texture2D();
+		int GetBitsPerPixel() const;
 
 	private:
 		TextureFormat m_format;
@@ -0,0 +1,321 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "VideoEncoder.h"
+#include "thread/Thread.h"
+#include "Debug.h"
+
+#if VR_WINDOWS
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+#include "libswscale/swscale.h"
+}
+#pragma warning(disable: 4996)
+#endif
+
+namespace Viry3D
+{
+	class VideoEncoderPrivate
+	{
+	public:
+		VideoEncoderPrivate()
+		{
+#if VR_WINDOWS
+			video_out_context = NULL;
+			video_out_stream = NULL;
+			video_codec_context = NULL;
+			video_frame = NULL;
+			yuv_convert_context = NULL;
+			audio_out_stream = NULL;
+			audio_codec_context = NULL;
+			audio_frame = NULL;
+			audio_samples_count = 0;
+#endif
+		}
+
+#if VR_WINDOWS
+		AVFormatContext* video_out_context;
+		AVStream* video_out_stream;
+		AVCodecContext* video_codec_context;
+		AVFrame* video_frame;
+		SwsContext* yuv_convert_context;
+		AVStream* audio_out_stream;
+		AVCodecContext* audio_codec_context;
+		AVFrame* audio_frame;
+		int audio_samples_count;
+#endif
+	};
+
+	VideoEncoder::VideoEncoder(const String& file, int width, int height, int fps, int queue_max):
+		m_private(RefMake<VideoEncoderPrivate>()),
+		m_width(width),
+		m_height(height),
+		m_fps(fps),
+		m_queue_max(queue_max),
+		m_encoded_count(0),
+		m_dropped_count(0)
+	{
+#if VR_WINDOWS
+		// ffmpeg contexts are only touched by encoder thread
+		m_thread = RefMake<Thread>(0, ThreadInfo({
+			[=]() {
+				this->Open(file);
+			},
+			[=]() {
+				this->Close();
+			}
+		}));
+#endif
+	}
+
+	VideoEncoder::~VideoEncoder()
+	{
+		m_thread.reset();
+
+		if (m_dropped_count > 0)
+		{
+			Log("video encoder dropped %d frames, encoded %d", (int) m_dropped_count, (int) m_encoded_count);
+		}
+	}
+
+	bool VideoEncoder::IsSupported() const
+	{
+#if VR_WINDOWS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	bool VideoEncoder::PushFrame(const ByteBuffer& rgb, int frame_index, bool bottom_up)
+	{
+		if (!m_thread || rgb.Size() < m_width * m_height * 3)
+		{
+			return false;
+		}
+
+		// queue length counts frame being encoded
+		if (m_thread->QueueLength() >= m_queue_max)
+		{
+			m_dropped_count++;
+			return false;
+		}
+
+		m_thread->AddTask({ [=]() {
+			this->Encode(rgb, frame_index, bottom_up);
+			return Ref<Any>();
+		}, NULL });
+
+		return true;
+	}
+
+	void VideoEncoder::Open(const String& file)
+	{
+#if VR_WINDOWS
+		av_register_all();
+
+		AVFormatContext* oc;
+		auto ret = avformat_alloc_output_context2(&oc, NULL, NULL, file.CString());
+
+		AVPixelFormat pix_fmt = AV_PIX_FMT_YUV420P;
+
+		// setup video stream
+		{
+			auto codec_id = oc->oformat->video_codec;
+			auto stream = avformat_new_stream(oc, NULL);
+			stream->id = oc->nb_streams - 1;
+			stream->time_base = { 1, m_fps };
+
+			auto c = stream->codec;
+			c->qmin = 1;
+			c->qmax = 50;
+			c->qcompress = 1;
+			c->gop_size = 12; /* emit one intra frame every twelve frames at most */
+			c->bit_rate = 4000 * m_fps / 30 * 1000;
+			c->pix_fmt = pix_fmt;
+			c->codec_type = AVMEDIA_TYPE_VIDEO;
+			c->codec_id = codec_id;
+			c->width = m_width;
+			c->height = m_height;
+			c->time_base = stream->time_base;
+
+			if (oc->oformat->flags & AVFMT_GLOBALHEADER)
+			{
+				c->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+			}
+
+			auto codec = avcodec_find_encoder(codec_id);
+			ret = avcodec_open2(c, codec, NULL);
+
+			auto frame = av_frame_alloc();
+			frame->format = pix_fmt;
+			frame->width = m_width;
+			frame->height = m_height;
+			ret = av_frame_get_buffer(frame, 32);
+
+			m_private->video_out_stream = stream;
+			m_private->video_codec_context = c;
+			m_private->video_frame = frame;
+		}
+
+		// setup audio stream
+		{
+			auto codec_id = oc->oformat->audio_codec;
+			auto stream = avformat_new_stream(oc, NULL);
+			stream->id = oc->nb_streams - 1;
+
+			auto codec = avcodec_find_encoder(codec_id);
+
+			auto c = stream->codec;
+			c->sample_fmt = AV_SAMPLE_FMT_FLTP;
+			c->bit_rate = 64000;
+			c->sample_rate = 44100;
+			c->channel_layout = AV_CH_LAYOUT_STEREO;
+			c->channels = av_get_channel_layout_nb_channels(c->channel_layout);
+			c->codec_type = AVMEDIA_TYPE_AUDIO;
+
+			stream->time_base = { 1, c->sample_rate };
+
+			ret = avcodec_open2(c, codec, NULL);
+
+			int nb_samples;
+			if (codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE)
+				nb_samples = 10000;
+			else
+				nb_samples = c->frame_size;
+
+			auto frame = av_frame_alloc();
+			frame->format = c->sample_fmt;
+			frame->channel_layout = c->channel_layout;
+			frame->sample_rate = c->sample_rate;
+			frame->nb_samples = nb_samples;
+			ret = av_frame_get_buffer(frame, 0);
+			av_samples_set_silence(frame->extended_data, 0, frame->nb_samples, c->channels, c->sample_fmt);
+
+			m_private->audio_out_stream = stream;
+			m_private->audio_codec_context = c;
+			m_private->audio_frame = frame;
+		}
+
+		// converts from rgb rows directly, no intermediate frame
+		m_private->yuv_convert_context = sws_getContext(
+			m_width, m_height,
+			AV_PIX_FMT_RGB24,
+			m_width, m_height,
+			pix_fmt,
+			0, NULL, NULL, NULL);
+
+		ret = avio_open(&oc->pb, file.CString(), AVIO_FLAG_WRITE);
+		ret = avformat_write_header(oc, NULL);
+
+		m_private->video_out_context = oc;
+#endif
+	}
+
+	void VideoEncoder::Close()
+	{
+#if VR_WINDOWS
+		av_write_trailer(m_private->video_out_context);
+
+		avcodec_close(m_private->video_codec_context);
+		av_frame_free(&m_private->video_frame);
+		avcodec_close(m_private->audio_codec_context);
+		av_frame_free(&m_private->audio_frame);
+		avio_closep(&m_private->video_out_context->pb);
+		avformat_free_context(m_private->video_out_context);
+		sws_freeContext(m_private->yuv_convert_context);
+
+		m_private->video_out_context = NULL;
+		m_private->video_out_stream = NULL;
+		m_private->video_codec_context = NULL;
+		m_private->video_frame = NULL;
+		m_private->yuv_convert_context = NULL;
+		m_private->audio_out_stream = NULL;
+		m_private->audio_codec_context = NULL;
+		m_private->audio_frame = NULL;
+#endif
+	}
+
+	void VideoEncoder::Encode(const ByteBuffer& rgb, int frame_index, bool bottom_up)
+	{
+#if VR_WINDOWS
+		auto oc = m_private->video_out_context;
+		auto vs = m_private->video_out_stream;
+		auto vc = m_private->video_codec_context;
+		auto output_frame = m_private->video_frame;
+		auto yuv_convert_context = m_private->yuv_convert_context;
+		auto audio_frame = m_private->audio_frame;
+		auto ac = m_private->audio_codec_context;
+		auto as = m_private->audio_out_stream;
+
+		auto ret = av_frame_make_writable(output_frame);
+
+		// negative stride flips bottom up rows while converting
+		int row_size = m_width * 3;
+		const uint8_t* src_data[1] = { rgb.Bytes() };
+		int src_stride[1] = { row_size };
+		if (bottom_up)
+		{
+			src_data[0] = rgb.Bytes() + (m_height - 1) * row_size;
+			src_stride[0] = -row_size;
+		}
+
+		sws_scale(yuv_convert_context, src_data, src_stride,
+			0, vc->height, output_frame->data, output_frame->linesize);
+
+		output_frame->pts = frame_index;
+
+		AVPacket pkt;
+		pkt.data = NULL;
+		pkt.size = 0;
+		av_init_packet(&pkt);
+
+		int got_packet;
+		ret = avcodec_encode_video2(vc, &pkt, output_frame, &got_packet);
+
+		if (got_packet)
+		{
+			av_packet_rescale_ts(&pkt, vc->time_base, vs->time_base);
+			pkt.stream_index = vs->index;
+			ret = av_interleaved_write_frame(oc, &pkt);
+		}
+
+		// silent audio keeps up with video
+		while (av_compare_ts(frame_index, vc->time_base, m_private->audio_samples_count, ac->time_base) > 0)
+		{
+			pkt.data = NULL;
+			pkt.size = 0;
+			av_init_packet(&pkt);
+
+			audio_frame->pts = av_rescale_q(m_private->audio_samples_count, { 1, ac->sample_rate }, ac->time_base);
+			m_private->audio_samples_count += audio_frame->nb_samples;
+
+			ret = avcodec_encode_audio2(ac, &pkt, audio_frame, &got_packet);
+
+			if (got_packet)
+			{
+				av_packet_rescale_ts(&pkt, ac->time_base, as->time_base);
+				pkt.stream_index = as->index;
+				ret = av_interleaved_write_frame(oc, &pkt);
+			}
+		}
+
+		m_encoded_count++;
+#endif
+	}
+}
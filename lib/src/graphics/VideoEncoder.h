@@ -0,0 +1,61 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "string/String.h"
+#include "memory/ByteBuffer.h"
+#include "memory/Ref.h"
+#include <atomic>
+
+namespace Viry3D
+{
+	class Thread;
+	class VideoEncoderPrivate;
+
+	//	encodes rgb frames into a video file on own thread,
+	//	frames pushed while its queue is full are dropped instead of waiting encoder
+	class VideoEncoder
+	{
+	public:
+		VideoEncoder(const String& file, int width, int height, int fps, int queue_max);
+		//	encodes queued frames and closes file
+		~VideoEncoder();
+		bool IsSupported() const;
+		int GetWidth() const { return m_width; }
+		int GetHeight() const { return m_height; }
+		//	rgb24 rows without padding, bottom_up for rows read from gl,
+		//	frame_index is pts in 1 / fps and increases, false when frame dropped
+		bool PushFrame(const ByteBuffer& rgb, int frame_index, bool bottom_up);
+		int GetEncodedCount() const { return m_encoded_count; }
+		int GetDroppedCount() const { return m_dropped_count; }
+
+	private:
+		void Open(const String& file);
+		void Close();
+		void Encode(const ByteBuffer& rgb, int frame_index, bool bottom_up);
+
+		Ref<VideoEncoderPrivate> m_private;
+		Ref<Thread> m_thread;
+		int m_width;
+		int m_height;
+		int m_fps;
+		int m_queue_max;
+		std::atomic<int> m_encoded_count;
+		std::atomic<int> m_dropped_count;
+	};
+}
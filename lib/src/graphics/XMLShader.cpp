@@ -71,12 +71,28 @@ namespace Viry3D
 	}
 
 	void XMLShader::Load(const String& path)
+	{
+		auto bytes = File::ReadAllBytes(path);
+		if (!this->Parse((const char*) bytes.Bytes(), bytes.Size()))
+		{
+			Log("shader xml parse error, xml path:%s", path.CString());
+		}
+	}
+
+	void XMLShader::LoadSource(const String& source)
+	{
+		if (!this->Parse(source.CString(), source.Size()))
+		{
+			Log("shader xml parse error, generated source:\n%s", source.CString());
+		}
+	}
+
+	bool XMLShader::Parse(const char* xml, int size)
 	{
 		Clear();
 
-		auto bytes = File::ReadAllBytes(path);
 		tinyxml2::XMLDocument doc;
-		auto error = doc.Parse((const char*) bytes.Bytes(), bytes.Size());
+		auto error = doc.Parse(xml, size);
 		if (error == tinyxml2::XML_SUCCESS)
 		{
 			auto shader_ele = doc.FirstChildElement();
@@ -332,10 +348,10 @@ namespace Viry3D
 					rss.Add(rs);
 				}
 			}
+
+			return true;
 		}
-        else
-        {
-            Log("shader xml parse error, xml path:%s", path.CString());
-        }
+
+		return false;
 	}
 }
@@ -101,6 +101,7 @@ namespace Viry3D
 		XMLUniformBuffer uniform_buffer;
 		Vector<XMLVertexAttribute> attrs;
 		int stride;
+		Vector<unsigned int> spirv; // precompiled, only from shader package
 
 		XMLVertexShader():
 			stride(0)
@@ -115,6 +116,7 @@ namespace Viry3D
 		String src;
 		XMLUniformBuffer uniform_buffer;
 		Vector<XMLSampler> samplers;
+		Vector<unsigned int> spirv; // precompiled, only from shader package
 	};
 
 	struct XMLBlend
@@ -202,6 +204,9 @@ namespace Viry3D
 		Vector<XMLRenderState> rss;
 
 		void Load(const String& path);
+		//	xml text of a generated shader
+		void LoadSource(const String& source);
+		bool Parse(const char* xml, int size);
 		void Clear();
 	};
 }
@@ -0,0 +1,320 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "TLSFAllocator.h"
+#include "memory/Memory.h"
+#include <assert.h>
+
+namespace Viry3D
+{
+	static int floor_log2(uint64_t v)
+	{
+		int n = 0;
+		while (v >>= 1)
+		{
+			n++;
+		}
+		return n;
+	}
+
+	static int lowest_bit(uint32_t v)
+	{
+		int n = 0;
+		while ((v & 1) == 0)
+		{
+			v >>= 1;
+			n++;
+		}
+		return n;
+	}
+
+	static int highest_bit(uint32_t v)
+	{
+		return floor_log2(v);
+	}
+
+	TLSFAllocator::TLSFAllocator(uint64_t size):
+		m_size(size),
+		m_used_size(0),
+		m_free_count(0),
+		m_first(NULL),
+		m_fl_bitmap(0)
+	{
+		Memory::Zero(m_sl_bitmap, sizeof(m_sl_bitmap));
+		Memory::Zero(m_free_heads, sizeof(m_free_heads));
+
+		m_first = new Range();
+		m_first->offset = 0;
+		m_first->size = size;
+		m_first->free = true;
+		m_first->prev_phys = NULL;
+		m_first->next_phys = NULL;
+		this->InsertFree(m_first);
+	}
+
+	TLSFAllocator::~TLSFAllocator()
+	{
+		Range* range = m_first;
+		while (range)
+		{
+			Range* next = range->next_phys;
+			delete range;
+			range = next;
+		}
+	}
+
+	void TLSFAllocator::Mapping(uint64_t size, int* fl, int* sl)
+	{
+		if (size < SMALL_SIZE)
+		{
+			*fl = 0;
+			*sl = (int) (size / (SMALL_SIZE / SL_COUNT));
+		}
+		else
+		{
+			int log2 = floor_log2(size);
+			*fl = log2 - SMALL_SIZE_LOG2 + 1;
+			*sl = (int) (size >> (log2 - SL_COUNT_LOG2)) - SL_COUNT;
+		}
+	}
+
+	TLSFAllocator::Range* TLSFAllocator::FindFree(uint64_t size)
+	{
+		// round up to the next list, every range in it is big enough
+		if (size < SMALL_SIZE)
+		{
+			size += (SMALL_SIZE / SL_COUNT) - 1;
+		}
+		else
+		{
+			size += (1ULL << (floor_log2(size) - SL_COUNT_LOG2)) - 1;
+		}
+
+		int fl;
+		int sl;
+		Mapping(size, &fl, &sl);
+		if (fl >= FL_COUNT)
+		{
+			return NULL;
+		}
+
+		uint32_t sl_map = m_sl_bitmap[fl] & (~0U << sl);
+		if (sl_map == 0)
+		{
+			uint32_t fl_map = fl + 1 < FL_COUNT ? m_fl_bitmap & (~0U << (fl + 1)) : 0;
+			if (fl_map == 0)
+			{
+				return NULL;
+			}
+
+			fl = lowest_bit(fl_map);
+			sl_map = m_sl_bitmap[fl];
+		}
+		sl = lowest_bit(sl_map);
+
+		return m_free_heads[fl][sl];
+	}
+
+	void TLSFAllocator::InsertFree(Range* range)
+	{
+		int fl;
+		int sl;
+		Mapping(range->size, &fl, &sl);
+
+		Range* head = m_free_heads[fl][sl];
+		range->prev_free = NULL;
+		range->next_free = head;
+		if (head)
+		{
+			head->prev_free = range;
+		}
+		m_free_heads[fl][sl] = range;
+		m_fl_bitmap |= 1U << fl;
+		m_sl_bitmap[fl] |= 1U << sl;
+		m_free_count++;
+	}
+
+	void TLSFAllocator::RemoveFree(Range* range)
+	{
+		int fl;
+		int sl;
+		Mapping(range->size, &fl, &sl);
+
+		if (range->prev_free)
+		{
+			range->prev_free->next_free = range->next_free;
+		}
+		else
+		{
+			m_free_heads[fl][sl] = range->next_free;
+		}
+		if (range->next_free)
+		{
+			range->next_free->prev_free = range->prev_free;
+		}
+
+		if (m_free_heads[fl][sl] == NULL)
+		{
+			m_sl_bitmap[fl] &= ~(1U << sl);
+			if (m_sl_bitmap[fl] == 0)
+			{
+				m_fl_bitmap &= ~(1U << fl);
+			}
+		}
+		m_free_count--;
+	}
+
+	TLSFAllocator::Range* TLSFAllocator::SplitFront(Range* range, uint64_t size)
+	{
+		Range* front = new Range();
+		front->offset = range->offset;
+		front->size = size;
+		front->free = range->free;
+		front->prev_phys = range->prev_phys;
+		front->next_phys = range;
+		if (range->prev_phys)
+		{
+			range->prev_phys->next_phys = front;
+		}
+		else
+		{
+			m_first = front;
+		}
+		range->prev_phys = front;
+		range->offset += size;
+		range->size -= size;
+
+		return front;
+	}
+
+	uint64_t TLSFAllocator::Allocate(uint64_t size, uint64_t alignment)
+	{
+		if (size == 0)
+		{
+			size = 1;
+		}
+		if (alignment == 0)
+		{
+			alignment = 1;
+		}
+
+		Range* range = this->FindFree(size + alignment - 1);
+		if (range == NULL)
+		{
+			return INVALID_OFFSET;
+		}
+		this->RemoveFree(range);
+
+		uint64_t padding = (alignment - range->offset % alignment) % alignment;
+		if (padding > 0)
+		{
+			Range* front = this->SplitFront(range, padding);
+			this->InsertFree(front);
+		}
+
+		Range* used = range;
+		if (range->size > size)
+		{
+			used = this->SplitFront(range, size);
+			this->InsertFree(range);
+		}
+		used->free = false;
+
+		m_used.Add(used->offset, used);
+		m_used_size += used->size;
+
+		return used->offset;
+	}
+
+	void TLSFAllocator::Free(uint64_t offset)
+	{
+		Range** find;
+		if (!m_used.TryGet(offset, &find))
+		{
+			assert(!"free offset not allocated");
+			return;
+		}
+
+		Range* range = *find;
+		m_used.Remove(offset);
+		m_used_size -= range->size;
+		range->free = true;
+
+		// merge with free neighbours, neighbours of a free range are never free
+		Range* prev = range->prev_phys;
+		if (prev && prev->free)
+		{
+			this->RemoveFree(prev);
+			prev->size += range->size;
+			prev->next_phys = range->next_phys;
+			if (range->next_phys)
+			{
+				range->next_phys->prev_phys = prev;
+			}
+			delete range;
+			range = prev;
+		}
+
+		Range* next = range->next_phys;
+		if (next && next->free)
+		{
+			this->RemoveFree(next);
+			range->size += next->size;
+			range->next_phys = next->next_phys;
+			if (next->next_phys)
+			{
+				next->next_phys->prev_phys = range;
+			}
+			delete next;
+		}
+
+		this->InsertFree(range);
+	}
+
+	uint64_t TLSFAllocator::GetLargestFreeRange() const
+	{
+		if (m_fl_bitmap == 0)
+		{
+			return 0;
+		}
+
+		int fl = highest_bit(m_fl_bitmap);
+		int sl = highest_bit(m_sl_bitmap[fl]);
+
+		uint64_t largest = 0;
+		for (Range* i = m_free_heads[fl][sl]; i; i = i->next_free)
+		{
+			if (i->size > largest)
+			{
+				largest = i->size;
+			}
+		}
+
+		return largest;
+	}
+
+	float TLSFAllocator::GetFragmentation() const
+	{
+		uint64_t free_size = this->GetFreeSize();
+		if (free_size == 0)
+		{
+			return 0;
+		}
+
+		return 1.0f - this->GetLargestFreeRange() / (float) free_size;
+	}
+}
@@ -0,0 +1,83 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "container/Map.h"
+#include <stdint.h>
+
+namespace Viry3D
+{
+	//	two level segregated fit allocator over an offset range,
+	//	manages offsets only and never touches the memory itself
+	class TLSFAllocator
+	{
+	public:
+		static const uint64_t INVALID_OFFSET = ~0ULL;
+
+		TLSFAllocator(uint64_t size);
+		~TLSFAllocator();
+		//	return INVALID_OFFSET when no free range fits
+		uint64_t Allocate(uint64_t size, uint64_t alignment = 1);
+		void Free(uint64_t offset);
+		uint64_t GetSize() const { return m_size; }
+		uint64_t GetUsedSize() const { return m_used_size; }
+		uint64_t GetFreeSize() const { return m_size - m_used_size; }
+		int GetAllocationCount() const { return m_used.Size(); }
+		int GetFreeRangeCount() const { return m_free_count; }
+		bool IsEmpty() const { return m_used.Empty(); }
+		uint64_t GetLargestFreeRange() const;
+		//	0 when all free space is one range, close to 1 when scattered
+		float GetFragmentation() const;
+
+	private:
+		enum
+		{
+			SL_COUNT_LOG2 = 5,
+			SL_COUNT = 1 << SL_COUNT_LOG2,
+			SMALL_SIZE_LOG2 = 8,
+			SMALL_SIZE = 1 << SMALL_SIZE_LOG2,
+			FL_COUNT = 32,
+		};
+
+		struct Range
+		{
+			uint64_t offset;
+			uint64_t size;
+			bool free;
+			Range* prev_phys;
+			Range* next_phys;
+			Range* prev_free;
+			Range* next_free;
+		};
+
+		static void Mapping(uint64_t size, int* fl, int* sl);
+		Range* FindFree(uint64_t size);
+		void InsertFree(Range* range);
+		void RemoveFree(Range* range);
+		Range* SplitFront(Range* range, uint64_t size);
+
+		uint64_t m_size;
+		uint64_t m_used_size;
+		int m_free_count;
+		Range* m_first;
+		uint32_t m_fl_bitmap;
+		uint32_t m_sl_bitmap[FL_COUNT];
+		Range* m_free_heads[FL_COUNT][SL_COUNT];
+		Map<uint64_t, Range*> m_used;
+	};
+}
@@ -18,6 +18,7 @@
 #include "ImageEffect.h"
 #include "graphics/Material.h"
 #include "graphics/Graphics.h"
+#include "graphics/Shader.h"
 
 namespace Viry3D
 {
@@ -30,6 +31,156 @@ namespace Viry3D
 
 	void ImageEffect::OnRenderImage(Ref<RenderTexture> src, Ref<RenderTexture> dest)
 	{
-		Graphics::Blit(src, dest, m_material, -1);
+		if (this->IsComposable())
+		{
+			Vector<ImageEffect*> effects;
+			effects.Add(this);
+			ImageEffect::RenderComposed(effects, src, dest);
+		}
+		else
+		{
+			Graphics::Blit(src, dest, m_material, -1);
+		}
+	}
+
+	String ImageEffect::BuildComposedShader(const String& name, const Vector<ImageEffectColorOp>& ops)
+	{
+		int uniform_count = 0;
+		for (const auto& i : ops)
+		{
+			uniform_count += i.uniforms.Size();
+		}
+
+		// same vertex shader and render state as Blit
+		String xml = String::Format("<Shader name=\"%s\" queue=\"Geometry\">\n", name.CString());
+		xml += "<VertexShader name=\"vs\">\n"
+			"<VertexAttribute name=\"Vertex\" location=\"0\"/>\n"
+			"<VertexAttribute name=\"Texcoord\" location=\"1\"/>\n"
+			"<Include name=\"Base.in\"/>\n"
+			"<Source><![CDATA[\n"
+			"UniformBuffer(1, 0) uniform buf_vs_obj {\n"
+			"	mat4 _World;\n"
+			"} u_buf_obj;\n"
+			"layout (location = 0) in vec4 a_pos;\n"
+			"layout (location = 1) in vec2 a_uv;\n"
+			"Varying(0) out vec2 v_uv;\n"
+			"void main() {\n"
+			"	gl_Position = a_pos * u_buf_obj._World;\n"
+			"	v_uv = a_uv;\n"
+			"	vulkan_convert();\n"
+			"}\n"
+			"]]></Source>\n"
+			"</VertexShader>\n";
+
+		// samplers first, uniform buffer binding follows them
+		int binding = 2;
+		String samplers_xml = String::Format("<Sampler name=\"_MainTex\" binding=\"%d\"/>\n", binding);
+		String samplers_src = String::Format("UniformTexture(0, %d) uniform sampler2D _MainTex;\n", binding);
+		binding++;
+		for (int i = 0; i < ops.Size(); i++)
+		{
+			for (const auto& j : ops[i].samplers)
+			{
+				String sampler = String::Format("_Op%d", i) + j;
+				samplers_xml += String::Format("<Sampler name=\"%s\" binding=\"%d\"/>\n", sampler.CString(), binding);
+				samplers_src += String::Format("UniformTexture(0, %d) uniform sampler2D %s;\n", binding, sampler.CString());
+				binding++;
+			}
+		}
+
+		String uniforms_xml;
+		String uniforms_src;
+		if (uniform_count > 0)
+		{
+			uniforms_xml = String::Format("<UniformBuffer name=\"buf_ps\" binding=\"%d\">\n", binding);
+			uniforms_src = String::Format("UniformBuffer(0, %d) uniform buf_ps {\n", binding);
+			for (int i = 0; i < ops.Size(); i++)
+			{
+				for (const auto& j : ops[i].uniforms)
+				{
+					String uniform = String::Format("_Op%d", i) + j;
+					uniforms_xml += String::Format("<Uniform name=\"%s\" size=\"16\"/>\n", uniform.CString());
+					uniforms_src += String::Format("	vec4 %s;\n", uniform.CString());
+				}
+			}
+			uniforms_xml += "</UniformBuffer>\n";
+			uniforms_src += "} u_buf_ps;\n";
+		}
+
+		// one function per op, called in effect order on the sampled color
+		String funcs_src;
+		String calls_src;
+		for (int i = 0; i < ops.Size(); i++)
+		{
+			const auto& op = ops[i];
+			String params = "vec4 color, vec2 uv";
+			String args = "color, v_uv";
+			for (const auto& j : op.uniforms)
+			{
+				params += ", vec4 " + j;
+				args += String::Format(", u_buf_ps._Op%d", i) + j;
+			}
+			for (const auto& j : op.samplers)
+			{
+				params += ", sampler2D " + j;
+				args += String::Format(", _Op%d", i) + j;
+			}
+
+			funcs_src += String::Format("vec4 op%d(", i) + params + ") {\n" + op.source + "\n}\n";
+			calls_src += String::Format("	color = op%d(", i) + args + ");\n";
+		}
+
+		xml += "<PixelShader name=\"ps\">\n" + samplers_xml + uniforms_xml +
+			"<Source><![CDATA[\n"
+			"precision mediump float;\n" + samplers_src + uniforms_src +
+			"Varying(0) in vec2 v_uv;\n"
+			"layout (location = 0) out vec4 o_frag;\n" + funcs_src +
+			"void main() {\n"
+			"	vec4 color = texture(_MainTex, v_uv);\n" + calls_src +
+			"	o_frag = color;\n"
+			"}\n"
+			"]]></Source>\n"
+			"</PixelShader>\n";
+
+		xml += "<RenderState name=\"rs\">\n"
+			"<Cull value=\"Off\"/>\n"
+			"<ZTest value=\"Always\"/>\n"
+			"<ZWrite value=\"Off\"/>\n"
+			"</RenderState>\n"
+			"<Pass name=\"pass\" vs=\"vs\" ps=\"ps\" rs=\"rs\"/>\n"
+			"</Shader>\n";
+
+		return xml;
+	}
+
+	void ImageEffect::RenderComposed(const Vector<ImageEffect*>& effects, Ref<RenderTexture> src, Ref<RenderTexture> dest)
+	{
+		Vector<ImageEffectColorOp> ops(effects.Size());
+		String name = "ImageEffect/Composed";
+		for (int i = 0; i < effects.Size(); i++)
+		{
+			effects[i]->GetColorOp(ops[i]);
+			name += "/" + ops[i].name;
+		}
+
+		// generated shader is shared by every run of same ops, material by the run owner
+		auto owner = effects[0];
+		if (!owner->m_composed_material || owner->m_composed_material->GetName() != name)
+		{
+			Shader::FindOrCreate(name, BuildComposedShader(name, ops));
+			owner->m_composed_material = Material::Create(name);
+		}
+
+		auto& material = owner->m_composed_material;
+		for (int i = 0; i < effects.Size(); i++)
+		{
+			effects[i]->SetColorOpUniforms(material, String::Format("_Op%d", i));
+		}
+
+		// Blit only updates uniforms when main texture changed, op uniforms may change every frame
+		material->SetMainTexture(RefCast<Texture>(src));
+		material->UpdateUniforms(0);
+
+		Graphics::Blit(src, dest, material, 0);
 	}
 }
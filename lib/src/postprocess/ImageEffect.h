@@ -19,18 +19,43 @@
 
 #include "Component.h"
 #include "graphics/RenderTexture.h"
+#include "container/Vector.h"
 
 namespace Viry3D
 {
 	class Material;
 
+	//	per pixel color transform merged with neighbours into one pass,
+	//	source is body of vec4 op(vec4 color, vec2 uv, vec4 <uniforms>..., sampler2D <samplers>...)
+	struct ImageEffectColorOp
+	{
+		String name;
+		String source;
+		Vector<String> uniforms;
+		Vector<String> samplers;
+	};
+
 	class ImageEffect: public Component
 	{
 		DECLARE_COM_CLASS(ImageEffect, Component)
 	public:
 		virtual void OnRenderImage(Ref<RenderTexture> src, Ref<RenderTexture> dest);
+		//	composable effects only read the source pixel at own uv
+		virtual bool IsComposable() const { return false; }
+		virtual void GetColorOp(ImageEffectColorOp& op) const { }
+		//	uniform and sampler names of op are prefixed with prefix in material
+		virtual void SetColorOpUniforms(const Ref<Material>& material, const String& prefix) const { }
+		//	apply composable effects in order with one full screen pass
+		static void RenderComposed(const Vector<ImageEffect*>& effects, Ref<RenderTexture> src, Ref<RenderTexture> dest);
 
 	protected:
 		Ref<Material> m_material;
+
+	private:
+		static String BuildComposedShader(const String& name, const Vector<ImageEffectColorOp>& ops);
+
+	private:
+		//	owned by first effect of a composed run
+		Ref<Material> m_composed_material;
 	};
 }
@@ -20,6 +20,14 @@
 #include "graphics/Graphics.h"
 #include "graphics/RenderTexture.h"
 #include "graphics/FrameBuffer.h"
+#include "math/Mathf.h"
+
+#define PASS_DOWNSAMPLE 0
+#define PASS_BLUR_HORIZONTAL 1
+#define PASS_BLUR_VERTICAL 2
+#define PASS_DUAL_DOWN 3
+#define PASS_DUAL_UP 4
+#define DUAL_FILTER_MIN_SIZE 2
 
 namespace Viry3D
 {
@@ -30,6 +38,7 @@ namespace Viry3D
 		this->SetDownSample(2);
 		this->SetBlurSize(4);
 		this->SetBlurIterations(3);
+		this->SetDualFilter(true);
 	}
 
 	void ImageEffectBlur::DeepCopy(const Ref<Object>& source)
@@ -50,6 +59,121 @@ namespace Viry3D
 			src->UpdateSampler();
 		}
 
+		if (this->IsDualFilter())
+		{
+			this->RenderDualFilter(src, dest);
+		}
+		else
+		{
+			this->RenderIterative(src, dest);
+		}
+	}
+
+	// blur radius in source texels, each separable pass spans 3 taps each side
+	float ImageEffectBlur::GetIterativeRadius() const
+	{
+		int downsample = this->GetDownSample();
+		float width_mod = 1.0f / (1.0f * (1 << downsample));
+
+		float radius = 0;
+		for (int i = 0; i < this->GetBlurIterations(); i++)
+		{
+			radius += 3 * (this->GetBlurSize() * width_mod + i);
+		}
+
+		return Mathf::Max(radius, 1.0f) * (1 << downsample);
+	}
+
+	int ImageEffectBlur::GetPyramidDepth(int width, int height) const
+	{
+		int downsample = this->GetDownSample();
+
+		// every level of the pyramid about doubles the radius
+		int depth = Mathf::RoundToInt(Mathf::Log2(this->GetIterativeRadius())) - downsample;
+		depth = Mathf::Max(depth, 1);
+
+		int size = Mathf::Min(width, height) >> downsample;
+		while (depth > 1 && (size >> depth) < DUAL_FILTER_MIN_SIZE)
+		{
+			depth--;
+		}
+
+		return depth;
+	}
+
+	long long ImageEffectBlur::GetSampleCost(int width, int height, bool dual_filter) const
+	{
+		int downsample = this->GetDownSample();
+		long long cost = 0;
+
+		if (dual_filter)
+		{
+			// 5 taps per texel going down, 8 going up to level 0, 1 tap bilinear blit to dest
+			int depth = this->GetPyramidDepth(width, height);
+			for (int i = 0; i <= depth; i++)
+			{
+				long long texels = (long long) (width >> (downsample + i)) * (height >> (downsample + i));
+				cost += texels * 5;
+				if (i < depth)
+				{
+					cost += texels * 8;
+				}
+			}
+			cost += (long long) width * height;
+		}
+		else
+		{
+			// 4 taps down sample, 7 taps each blur pass, 1 tap final blit
+			long long texels = (long long) (width >> downsample) * (height >> downsample);
+			cost += texels * 4;
+			cost += texels * 7 * 2 * this->GetBlurIterations();
+			cost += (long long) width * height;
+		}
+
+		return cost;
+	}
+
+	void ImageEffectBlur::RenderDualFilter(Ref<RenderTexture> src, Ref<RenderTexture> dest)
+	{
+		int downsample = this->GetDownSample();
+		int depth = this->GetPyramidDepth(src->GetWidth(), src->GetHeight());
+
+		// spread of taps in half texels, blur size 4 samples one texel away
+		m_material->SetVector("_Parameter", Vector4(this->GetBlurSize() * 0.25f, 0, 0, 0));
+
+		Vector<Ref<RenderTexture>> levels(depth + 1);
+		Ref<RenderTexture> level_src = src;
+		for (int i = 0; i <= depth; i++)
+		{
+			int w = Mathf::Max(src->GetWidth() >> (downsample + i), 1);
+			int h = Mathf::Max(src->GetHeight() >> (downsample + i), 1);
+			levels[i] = RenderTexture::GetTemporary(w, h, src->GetFormat(), DepthBuffer::Depth_0, FilterMode::Bilinear);
+
+			m_material->SetMainTexTexelSize(level_src);
+			Graphics::Blit(level_src, levels[i], m_material, PASS_DUAL_DOWN);
+			level_src = levels[i];
+		}
+
+		for (int i = depth; i > 0; i--)
+		{
+			auto up = RenderTexture::GetTemporary(levels[i - 1]->GetWidth(), levels[i - 1]->GetHeight(), src->GetFormat(), DepthBuffer::Depth_0, FilterMode::Bilinear);
+
+			m_material->SetMainTexTexelSize(levels[i]);
+			Graphics::Blit(levels[i], up, m_material, PASS_DUAL_UP);
+
+			RenderTexture::ReleaseTemporary(levels[i]);
+			RenderTexture::ReleaseTemporary(levels[i - 1]);
+			levels[i - 1] = up;
+		}
+
+		// up chain ends at level 0, full resolution only takes a bilinear blit
+		Graphics::Blit(levels[0], dest);
+
+		RenderTexture::ReleaseTemporary(levels[0]);
+	}
+
+	void ImageEffectBlur::RenderIterative(Ref<RenderTexture> src, Ref<RenderTexture> dest)
+	{
 		int downsample = this->GetDownSample();
 		int rt_w = src->GetWidth() >> downsample;
 		int rt_h = src->GetHeight() >> downsample;
@@ -57,7 +181,7 @@ namespace Viry3D
 		auto rt = RenderTexture::GetTemporary(rt_w, rt_h, src->GetFormat(), DepthBuffer::Depth_0, FilterMode::Bilinear);
 
 		m_material->SetMainTexTexelSize(src);
-		Graphics::Blit(src, rt, m_material, 0);
+		Graphics::Blit(src, rt, m_material, PASS_DOWNSAMPLE);
 
 		float blur_size = this->GetBlurSize();
 		float width_mod = 1.0f / (1.0f * (1 << downsample));
@@ -71,12 +195,12 @@ namespace Viry3D
 			m_material->SetVector("_Parameter", Vector4(blur_size * width_mod + offset, -blur_size * width_mod - offset, 0, 0));
 
 			auto rt2 = RenderTexture::GetTemporary(rt_w, rt_h, src->GetFormat(), DepthBuffer::Depth_0, FilterMode::Bilinear);
-			Graphics::Blit(rt, rt2, m_material, 1);
+			Graphics::Blit(rt, rt2, m_material, PASS_BLUR_HORIZONTAL);
 			RenderTexture::ReleaseTemporary(rt);
 			rt = rt2;
 
 			rt2 = RenderTexture::GetTemporary(rt_w, rt_h, src->GetFormat(), DepthBuffer::Depth_0, FilterMode::Bilinear);
-			Graphics::Blit(rt, rt2, m_material, 2);
+			Graphics::Blit(rt, rt2, m_material, PASS_BLUR_VERTICAL);
 			RenderTexture::ReleaseTemporary(rt);
 			rt = rt2;
 		}
@@ -33,13 +33,24 @@ namespace Viry3D
 		void SetBlurSize(float size) { m_blur_size = size; }
 		int GetBlurIterations() const { return m_blur_iterations; }
 		void SetBlurIterations(int iter) { m_blur_iterations = iter; }
+		//	dual filter pyramid by default, false keeps iterative separable blur
+		bool IsDualFilter() const { return m_dual_filter; }
+		void SetDualFilter(bool dual_filter) { m_dual_filter = dual_filter; }
+		//	halvings below down sample level covering radius of blur size and iterations
+		int GetPyramidDepth(int width, int height) const;
+		//	texels fetched by one blur of a width x height source
+		long long GetSampleCost(int width, int height, bool dual_filter) const;
 
 	private:
 		ImageEffectBlur();
+		void RenderIterative(Ref<RenderTexture> src, Ref<RenderTexture> dest);
+		void RenderDualFilter(Ref<RenderTexture> src, Ref<RenderTexture> dest);
+		float GetIterativeRadius() const;
 
 	private:
 		int m_down_sample;
 		float m_blur_size;
 		int m_blur_iterations;
+		bool m_dual_filter;
 	};
 }
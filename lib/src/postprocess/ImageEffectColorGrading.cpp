@@ -0,0 +1,59 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "ImageEffectColorGrading.h"
+#include "graphics/Material.h"
+#include "graphics/Texture2D.h"
+
+namespace Viry3D
+{
+	DEFINE_COM_CLASS(ImageEffectColorGrading);
+
+	ImageEffectColorGrading::ImageEffectColorGrading():
+		m_intensity(1.0f)
+	{
+	}
+
+	void ImageEffectColorGrading::DeepCopy(const Ref<Object>& source)
+	{
+		assert(!"can not copy this component");
+	}
+
+	void ImageEffectColorGrading::GetColorOp(ImageEffectColorOp& op) const
+	{
+		op.name = "ColorGrading";
+		op.uniforms.Add("_Parameter");
+		op.samplers.Add("_Lut");
+		op.source =
+			"vec3 c = clamp(color.rgb, 0.0, 1.0);\n"
+			"float size = _Parameter.y;\n"
+			"float slice = c.b * (size - 1.0);\n"
+			"float slice0 = floor(slice);\n"
+			"vec2 st = (c.rg * (size - 1.0) + 0.5) / vec2(size * size, size);\n"
+			"vec3 c0 = texture(_Lut, st + vec2(slice0 / size, 0.0)).rgb;\n"
+			"vec3 c1 = texture(_Lut, st + vec2(min(slice0 + 1.0, size - 1.0) / size, 0.0)).rgb;\n"
+			"vec3 graded = mix(c0, c1, slice - slice0);\n"
+			"return vec4(mix(color.rgb, graded, _Parameter.x), color.a);";
+	}
+
+	void ImageEffectColorGrading::SetColorOpUniforms(const Ref<Material>& material, const String& prefix) const
+	{
+		material->SetVector(prefix + "_Parameter", Vector4(m_intensity, (float) m_lut->GetHeight(), 0, 0));
+		material->SetTexture(prefix + "_Lut", RefCast<Texture>(m_lut));
+	}
+}
@@ -0,0 +1,47 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include "ImageEffect.h"
+
+namespace Viry3D
+{
+	class Texture2D;
+
+	//	lut is a strip of size * size slices of size * size texels, blue selects slice
+	class ImageEffectColorGrading: public ImageEffect
+	{
+		DECLARE_COM_CLASS(ImageEffectColorGrading, ImageEffect)
+	public:
+		virtual bool IsComposable() const { return (bool) m_lut; }
+		virtual void GetColorOp(ImageEffectColorOp& op) const;
+		virtual void SetColorOpUniforms(const Ref<Material>& material, const String& prefix) const;
+		const Ref<Texture2D>& GetLut() const { return m_lut; }
+		void SetLut(const Ref<Texture2D>& lut) { m_lut = lut; }
+		float GetIntensity() const { return m_intensity; }
+		void SetIntensity(float intensity) { m_intensity = intensity; }
+
+	private:
+		ImageEffectColorGrading();
+
+	private:
+		Ref<Texture2D> m_lut;
+		float m_intensity;
+	};
+}
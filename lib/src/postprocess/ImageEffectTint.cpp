@@ -0,0 +1,47 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "ImageEffectTint.h"
+#include "graphics/Material.h"
+
+namespace Viry3D
+{
+	DEFINE_COM_CLASS(ImageEffectTint);
+
+	ImageEffectTint::ImageEffectTint():
+		m_color(1, 1, 1, 1)
+	{
+	}
+
+	void ImageEffectTint::DeepCopy(const Ref<Object>& source)
+	{
+		assert(!"can not copy this component");
+	}
+
+	void ImageEffectTint::GetColorOp(ImageEffectColorOp& op) const
+	{
+		op.name = "Tint";
+		op.uniforms.Add("_Color");
+		op.source = "return color * _Color;";
+	}
+
+	void ImageEffectTint::SetColorOpUniforms(const Ref<Material>& material, const String& prefix) const
+	{
+		material->SetColor(prefix + "_Color", m_color);
+	}
+}
@@ -0,0 +1,50 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "ImageEffectTonemap.h"
+#include "graphics/Material.h"
+
+namespace Viry3D
+{
+	DEFINE_COM_CLASS(ImageEffectTonemap);
+
+	ImageEffectTonemap::ImageEffectTonemap():
+		m_exposure(1.0f)
+	{
+	}
+
+	void ImageEffectTonemap::DeepCopy(const Ref<Object>& source)
+	{
+		assert(!"can not copy this component");
+	}
+
+	void ImageEffectTonemap::GetColorOp(ImageEffectColorOp& op) const
+	{
+		op.name = "Tonemap";
+		op.uniforms.Add("_Parameter");
+		op.source =
+			"vec3 x = color.rgb * _Parameter.x;\n"
+			"x = clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);\n"
+			"return vec4(x, color.a);";
+	}
+
+	void ImageEffectTonemap::SetColorOpUniforms(const Ref<Material>& material, const String& prefix) const
+	{
+		material->SetVector(prefix + "_Parameter", Vector4(m_exposure, 0, 0, 0));
+	}
+}
@@ -0,0 +1,42 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include "ImageEffect.h"
+
+namespace Viry3D
+{
+	//	filmic curve fitted to aces, maps exposed hdr color into [0, 1]
+	class ImageEffectTonemap: public ImageEffect
+	{
+		DECLARE_COM_CLASS(ImageEffectTonemap, ImageEffect)
+	public:
+		virtual bool IsComposable() const { return true; }
+		virtual void GetColorOp(ImageEffectColorOp& op) const;
+		virtual void SetColorOpUniforms(const Ref<Material>& material, const String& prefix) const;
+		float GetExposure() const { return m_exposure; }
+		void SetExposure(float exposure) { m_exposure = exposure; }
+
+	private:
+		ImageEffectTonemap();
+
+	private:
+		float m_exposure;
+	};
+}
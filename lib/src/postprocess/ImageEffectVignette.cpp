@@ -0,0 +1,56 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include "ImageEffectVignette.h"
+#include "graphics/Material.h"
+
+namespace Viry3D
+{
+	DEFINE_COM_CLASS(ImageEffectVignette);
+
+	ImageEffectVignette::ImageEffectVignette():
+		m_color(0, 0, 0, 1),
+		m_intensity(0.45f),
+		m_smoothness(0.4f)
+	{
+	}
+
+	void ImageEffectVignette::DeepCopy(const Ref<Object>& source)
+	{
+		assert(!"can not copy this component");
+	}
+
+	void ImageEffectVignette::GetColorOp(ImageEffectColorOp& op) const
+	{
+		op.name = "Vignette";
+		op.uniforms.Add("_Color");
+		op.uniforms.Add("_Parameter");
+		op.source =
+			"vec2 d = (uv - vec2(0.5)) * _Parameter.x;\n"
+			"float v = pow(clamp(1.0 - dot(d, d), 0.0, 1.0), _Parameter.y);\n"
+			"return vec4(mix(_Color.rgb, color.rgb, v), color.a);";
+	}
+
+	void ImageEffectVignette::SetColorOpUniforms(const Ref<Material>& material, const String& prefix) const
+	{
+		// smoothness maps to falloff exponent, larger is softer
+		float smoothness = m_smoothness > 0.01f ? m_smoothness : 0.01f;
+		material->SetColor(prefix + "_Color", m_color);
+		material->SetVector(prefix + "_Parameter", Vector4(m_intensity * 3.0f, 1.0f / smoothness, 0, 0));
+	}
+}
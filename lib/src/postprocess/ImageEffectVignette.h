@@ -0,0 +1,48 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#pragma once
+
+#include "ImageEffect.h"
+#include "graphics/Color.h"
+
+namespace Viry3D
+{
+	class ImageEffectVignette: public ImageEffect
+	{
+		DECLARE_COM_CLASS(ImageEffectVignette, ImageEffect)
+	public:
+		virtual bool IsComposable() const { return true; }
+		virtual void GetColorOp(ImageEffectColorOp& op) const;
+		virtual void SetColorOpUniforms(const Ref<Material>& material, const String& prefix) const;
+		const Color& GetColor() const { return m_color; }
+		void SetColor(const Color& color) { m_color = color; }
+		float GetIntensity() const { return m_intensity; }
+		void SetIntensity(float intensity) { m_intensity = intensity; }
+		float GetSmoothness() const { return m_smoothness; }
+		void SetSmoothness(float smoothness) { m_smoothness = smoothness; }
+
+	private:
+		ImageEffectVignette();
+
+	private:
+		Color m_color;
+		float m_intensity;
+		float m_smoothness;
+	};
+}
@@ -24,6 +24,7 @@
 #include "math/Mathf.h"
 #include "graphics/VertexAttribute.h"
 #include "graphics/Camera.h"
+#include "graphics/Graphics.h"
 
 namespace Viry3D
 {
@@ -84,13 +85,26 @@ namespace Viry3D
 		m_renderer = this->GetGameObject()->GetComponent<ParticleSystemRenderer>();
 	}
 
-	void ParticleSystem::Update()
+	bool ParticleSystem::PrepareSimulate()
 	{
+		if (!this->IsEnable() || !this->IsStarted() || !this->GetGameObject()->IsActiveInHierarchy())
+		{
+			return false;
+		}
+
 		if (!m_renderer || !emission.enabled)
 		{
-			return;
+			return false;
 		}
 
+		// world transform is applied lazily, workers only read it after this
+		this->GetTransform()->GetLocalToWorldMatrix();
+
+		return true;
+	}
+
+	void ParticleSystem::Simulate()
+	{
 		UpdateEmission();
 		UpdateParticles();
 	}
@@ -559,7 +573,8 @@ namespace Viry3D
 		int vertex_buffer_size = vertex_count * VERTEX_STRIDE;
 		if (!m_vertex_buffer || m_vertex_buffer->GetSize() < vertex_buffer_size)
 		{
-			m_vertex_buffer = VertexBuffer::Create(vertex_buffer_size, true);
+			Graphics::ReleaseAfterRender(m_vertex_buffer);
+			m_vertex_buffer = VertexBuffer::Create(DYNAMIC_BUFFER_CAPACITY(vertex_buffer_size), true);
 		}
 		m_vertex_buffer->Fill(this, ParticleSystem::FillVertexBuffer);
 
@@ -567,6 +582,7 @@ namespace Viry3D
 		int index_buffer_size = index_count * sizeof(unsigned short);
 		if (!m_index_buffer || m_index_buffer->GetSize() < index_buffer_size)
 		{
+			Graphics::ReleaseAfterRender(m_index_buffer);
 			m_index_buffer = IndexBuffer::Create(index_buffer_size, false);
 			m_index_buffer->Fill(this, ParticleSystem::FillIndexBuffer);
 		}
@@ -405,6 +405,10 @@ namespace Viry3D
 		const Ref<VertexBuffer>& GetVertexBuffer() const { return m_vertex_buffer; }
 		const Ref<IndexBuffer>& GetIndexBuffer() const { return m_index_buffer; }
 		void GetIndexRange(int submesh_index, int& start, int& count);
+		//	main thread, resolves transform simulation reads, false when nothing to simulate
+		bool PrepareSimulate();
+		//	any thread after PrepareSimulate, no other system shares the state it writes
+		void Simulate();
 
 	public:
 		MainModule main;
@@ -425,7 +429,6 @@ namespace Viry3D
 
 	protected:
 		virtual void Start();
-		virtual void Update();
 
 	private:
 		static void FillVertexBuffer(void* param, const ByteBuffer& buffer);
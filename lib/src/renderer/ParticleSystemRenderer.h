@@ -57,6 +57,7 @@ namespace Viry3D
 		virtual const VertexBuffer* GetVertexBuffer() const;
 		virtual const IndexBuffer* GetIndexBuffer() const;
 		virtual void GetIndexRange(int material_index, int& start, int& count) const;
+		WeakRef<ParticleSystem> GetParticleSystem() const { return m_particle_system; }
 
 	public:
 		ParticleSystemRenderMode render_mode;
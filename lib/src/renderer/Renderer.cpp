@@ -22,6 +22,9 @@
 #include "graphics/Camera.h"
 #include "graphics/LightmapSettings.h"
 #include "graphics/Light.h"
+#include "graphics/LightCluster.h"
+#include "graphics/CascadedShadowMap.h"
+#include "graphics/RenderThread.h"
 #include "graphics/RenderPass.h"
 #include "graphics/RenderQueue.h"
 #include "ui/UICanvasRenderer.h"
@@ -33,6 +36,10 @@
 #include "Profiler.h"
 #include "Debug.h"
 
+// fewer passes are cheaper to record inline than to hand to worker threads
+#define PARALLEL_RECORD_PASS_MIN 16
+#define PARALLEL_RECORD_CHUNKS_PER_THREAD 4
+
 namespace Viry3D
 {
 	DEFINE_COM_CLASS(Renderer);
@@ -40,37 +47,43 @@ namespace Viry3D
 	List<Renderer*> Renderer::m_renderers;
 	Map<Camera*, Renderer::Passes> Renderer::m_passes;
 	bool Renderer::m_renderers_dirty = true;
+	bool Renderer::m_passes_clear = false;
+	uint32_t Renderer::m_static_version = 0;
+	Ref<TaskGraph> Renderer::m_culling_graph;
 	Mutex Renderer::m_mutex;
 	Ref<VertexBuffer> Renderer::m_static_vertex_buffer;
 	Ref<IndexBuffer> Renderer::m_static_index_buffer;
-	bool Renderer::m_static_buffers_binding = false;
-	int Renderer::m_batching_start = -1;
-	int Renderer::m_batching_count = -1;
+	thread_local bool Renderer::m_static_buffers_binding = false;
+	thread_local int Renderer::m_batching_start = -1;
+	thread_local int Renderer::m_batching_count = -1;
 
 	void Renderer::Init()
 	{
+		m_culling_graph = RefMake<TaskGraph>("Renderer::Culling");
 	}
 
 	void Renderer::Deinit()
 	{
 		m_renderers.Clear();
 		m_passes.Clear();
+		m_passes_clear = false;
 		m_renderers_dirty = true;
 		m_static_vertex_buffer.reset();
 		m_static_index_buffer.reset();
 		m_static_buffers_binding = false;
 		m_batching_start = -1;
 		m_batching_count = -1;
+		m_culling_graph.reset();
 	}
 
+	// pipelines are keyed by render pass compatibility and use dynamic viewport and scissor,
+	// so they stay valid across resize and pause
 	void Renderer::OnResize(int width, int height)
 	{
-		Shader::ClearAllPipelines();
 	}
 
 	void Renderer::OnPause()
 	{
-		Shader::ClearAllPipelines();
 	}
 
 	void Renderer::PreRenderByMaterial(int material_index)
@@ -87,6 +100,14 @@ namespace Viry3D
 			mat->SetVector("_WorldSpaceLightPos", -light->GetTransform()->GetForward());
 			mat->SetColor("_LightColor", light->color * light->intensity);
 		}
+
+		auto light_cluster = Camera::Current()->GetLightCluster();
+		if (light_cluster)
+		{
+			light_cluster->SetMaterialUniforms(mat);
+		}
+
+		CascadedShadowMap::SetMaterialUniforms(Camera::Current(), mat);
 	}
 
 	void Renderer::PreRenderByRenderer(int material_index)
@@ -133,8 +154,9 @@ namespace Viry3D
 		return GetTransform()->GetLocalToWorldMatrix();
 	}
 
-	void Renderer::Render(int material_index, int pass_index)
+	void Renderer::Render(const MaterialPass& item, int pass_index)
 	{
+		int material_index = item.material_index;
 		auto& mat = this->GetSharedMaterials()[material_index];
 		auto shader = mat->GetShader();
 		if (Camera::Current()->GetRenderMode() == CameraRenderMode::ShadowMap)
@@ -150,14 +172,12 @@ namespace Viry3D
 			index_type = IndexType::UnsignedInt;
 		}
 
-		if (this->GetVertexBuffer() || static_batch)
+		if (item.buffer.vb || static_batch)
 		{
 			if (!static_batch)
 			{
 				m_static_buffers_binding = false;
-				Graphics::GetDisplay()->BindVertexArray();
-				Graphics::GetDisplay()->BindVertexBuffer(this->GetVertexBuffer());
-				Graphics::GetDisplay()->BindIndexBuffer(this->GetIndexBuffer(), index_type);
+				Graphics::GetDisplay()->BindVertexArray(item.buffer.vb, item.buffer.ib, index_type, shader, pass_index, item.buffer.vb_version, item.buffer.ib_version);
 			}
 			else
 			{
@@ -166,11 +186,11 @@ namespace Viry3D
 					m_static_buffers_binding = true;
 					BindStaticBuffers();
 				}
-			}
 
-			if (!static_batch || !batching)
-			{
-				Graphics::GetDisplay()->BindVertexAttribArray(shader, pass_index);
+				if (!batching)
+				{
+					Graphics::GetDisplay()->BindVertexAttribArray(shader, pass_index);
+				}
 			}
 
 			int start, count;
@@ -181,7 +201,8 @@ namespace Viry3D
 			}
 			else
 			{
-				this->GetIndexRange(material_index, start, count);
+				start = item.buffer.start;
+				count = item.buffer.count;
 			}
 
 			if (static_batch)
@@ -196,7 +217,6 @@ namespace Viry3D
 			else
 			{
 				Graphics::GetDisplay()->DrawIndexed(start, count, index_type);
-				Graphics::GetDisplay()->DisableVertexArray(shader, pass_index);
 			}
 		}
 	}
@@ -210,6 +230,13 @@ namespace Viry3D
 			shader = Shader::ReplaceToShadowMapShader(shader);
 		}
 
+		// name is only built when timestamps are written
+		bool gpu_sampling = Profiler::IsGPUSampling();
+		if (gpu_sampling)
+		{
+			Profiler::GPUSampleBegin("CommitPass:" + shader->GetName());
+		}
+
 		if (first.shader_pass_count == 1)
 		{
 			shader->BeginPass(0);
@@ -290,7 +317,7 @@ namespace Viry3D
 					shader->BindRendererDescriptorSet(0, i.renderer->m_descriptor_set_buffer, i.renderer->m_lightmap_index);
 				}
 
-				i.renderer->Render(i.material_index, 0);
+				i.renderer->Render(i, 0);
 			}
 
 			// passɣύʣ
@@ -325,15 +352,33 @@ namespace Viry3D
 				shader->BindMaterial(pass_index, mat, i.renderer->m_descriptor_set);
 				shader->BindRendererDescriptorSet(pass_index, i.renderer->m_descriptor_set_buffer, i.renderer->m_lightmap_index);
 
-				i.renderer->Render(i.material_index, pass_index);
+				i.renderer->Render(i, pass_index);
 
 				shader->EndPass(pass_index);
 			}
 		}
+
+		if (gpu_sampling)
+		{
+			Profiler::GPUSampleEnd();
+		}
 	}
 
 	void Renderer::PreparePass(List<MaterialPass>& pass)
 	{
+		for (auto& i : pass)
+		{
+			i.buffer = RenderBuffer();
+			i.buffer.vb = i.renderer->GetVertexBuffer();
+			i.buffer.ib = i.renderer->GetIndexBuffer();
+			if (i.buffer.vb)
+			{
+				i.buffer.vb_version = i.buffer.vb->CaptureVersion();
+				i.buffer.ib_version = i.buffer.ib->CaptureVersion();
+				i.renderer->GetIndexRange(i.material_index, i.buffer.start, i.buffer.count);
+			}
+		}
+
 		auto& first = pass.First();
 		auto shader = first.renderer->GetSharedMaterials()[first.material_index]->GetShader();
 		if (Camera::Current()->GetRenderMode() == CameraRenderMode::ShadowMap)
@@ -400,7 +445,16 @@ namespace Viry3D
 
 	void Renderer::ClearPasses()
 	{
-		m_passes.Clear();
+		m_passes_clear = true;
+	}
+
+	void Renderer::BeginFrame()
+	{
+		if (m_passes_clear)
+		{
+			m_passes_clear = false;
+			m_passes.Clear();
+		}
 	}
 
 	void Renderer::SetCullingDirty(Camera* cam)
@@ -438,6 +492,17 @@ namespace Viry3D
 		return m_renderers;
 	}
 
+	int Renderer::GetCulledRendererCount(Camera* cam)
+	{
+		Passes* passes;
+		if (m_passes.TryGet(cam, &passes))
+		{
+			return passes->culled_renderers.Size();
+		}
+
+		return 0;
+	}
+
 	void Renderer::HandleUIEvent()
 	{
 		List<UICanvasRenderer*> canvas_list;
@@ -463,7 +528,7 @@ namespace Viry3D
 		UICanvasRenderer::HandleUIEvent(canvas_list);
 	}
 
-	void Renderer::CheckPasses()
+	void Renderer::CheckPasses(Camera* cam)
 	{
 		Vector<Camera*> invalid_cams;
 		for (auto& i : m_passes)
@@ -478,17 +543,14 @@ namespace Viry3D
 			m_passes.Remove(i);
 		}
 
-		auto cam = Camera::Current();
 		if (!m_passes.Contains(cam))
 		{
 			m_passes.Add(cam, Passes());
 		}
 	}
 
-	void Renderer::CameraCulling()
+	void Renderer::CameraCulling(Camera* cam)
 	{
-		auto cam = Camera::Current();
-
 		if (m_passes[cam].culling_dirty)
 		{
 			m_passes[cam].culling_dirty = false;
@@ -508,7 +570,19 @@ namespace Viry3D
 					continue;
 				}
 
-				if (cam->IsOrthographic() || cam->IsFrustumCulling() == false)
+				if (cam->GetRenderMode() == CameraRenderMode::ShadowMap)
+				{
+					auto casters = cam->GetShadowCasters();
+					if ((casters == CameraShadowCasters::Static && !i->IsStatic()) ||
+						(casters == CameraShadowCasters::Dynamic && i->IsStatic()))
+					{
+						continue;
+					}
+				}
+
+				// shadow map cameras cull casters by their light space box
+				bool frustum_culling = cam->IsFrustumCulling() && (!cam->IsOrthographic() || cam->GetRenderMode() == CameraRenderMode::ShadowMap);
+				if (!frustum_culling)
 				{
 					renderers.AddLast(i);
 				}
@@ -686,10 +760,8 @@ namespace Viry3D
 		}
 	}
 
-	void Renderer::BuildPasses()
+	void Renderer::BuildPasses(Camera* cam)
 	{
-		auto cam = Camera::Current();
-
 		if (m_passes[cam].passes_dirty)
 		{
 			m_passes[cam].passes_dirty = false;
@@ -698,23 +770,71 @@ namespace Viry3D
 		}
 	}
 
+	void Renderer::CullingAll(const List<Camera*>& cameras)
+	{
+		if (cameras.Empty())
+		{
+			return;
+		}
+
+		m_culling_graph->Clear();
+
+		for (auto i : cameras)
+		{
+			// pass lists are added and camera matrices applied before tasks read them
+			CheckPasses(i);
+			i->GetFrustum();
+
+			m_culling_graph->AddTask("Camera", [=]() {
+				CameraCulling(i);
+				BuildPasses(i);
+			});
+		}
+
+		m_culling_graph->Run();
+	}
+
 	void Renderer::PrepareAllPass()
 	{
-		CheckPasses();
-		CameraCulling();
-		BuildPasses();
+		auto cam = Camera::Current();
+
+		// culled in CullingAll already unless camera started rendering since
+		CheckPasses(cam);
+		CameraCulling(cam);
+		BuildPasses(cam);
 
-		auto& passes = m_passes[Camera::Current()].list;
+		auto& passes = m_passes[cam].list;
 		for (auto& i : passes)
 		{
 			Renderer::PreparePass(i);
 		}
+
+		// renderers and materials destroyed by next update stay alive until render thread drew them
+		auto render_thread = Graphics::GetRenderThread();
+		if (render_thread)
+		{
+			for (const auto& i : passes)
+			{
+				for (const auto& j : i)
+				{
+					render_thread->Retain(j.renderer->GetGameObject());
+					render_thread->Retain(j.renderer->GetSharedMaterials()[j.material_index]);
+				}
+			}
+		}
+
+#if VR_VULKAN
+		// render pass begins with secondary contents, so decide before it is recorded
+		bool parallel = Graphics::GetDisplay()->GetRecordThreadCount() > 1 && passes.Size() >= PARALLEL_RECORD_PASS_MIN;
+		RenderPass::GetRenderPassBinding()->SetSecondaryContents(parallel);
+#endif
 	}
 
 	void Renderer::BindStaticBuffers()
 	{
 		if (m_static_vertex_buffer && m_static_index_buffer)
 		{
+			Graphics::GetDisplay()->BindVertexArray();
 			Graphics::GetDisplay()->BindVertexBuffer(m_static_vertex_buffer.get());
 			Graphics::GetDisplay()->BindIndexBuffer(m_static_index_buffer.get(), IndexType::UnsignedInt);
 		}
@@ -722,21 +842,17 @@ namespace Viry3D
 
 	void Renderer::RenderAllPass()
 	{
-		BindStaticBuffers();
-		m_static_buffers_binding = true;
-		m_batching_start = -1;
-		m_batching_count = -1;
-
 		auto cam = Camera::Current();
 		auto& passes = m_passes[cam].list;
 		List<List<MaterialPass>> passes_transparent;
 		List<List<MaterialPass>> passes_ui;
+		Vector<List<MaterialPass>*> commits;
 
 		for (auto& i : passes)
 		{
 			if (i.First().queue < (int) RenderQueue::Transparent)
 			{
-				Renderer::CommitPass(i);
+				commits.Add(&i);
 			}
 			else
 			{
@@ -754,7 +870,7 @@ namespace Viry3D
 
 		for (auto& i : passes_transparent)
 		{
-			Renderer::CommitPass(i);
+			commits.Add(&i);
 		}
 
 		passes_ui.Sort([](const List<MaterialPass>& a, const List<MaterialPass>& b) {
@@ -770,12 +886,62 @@ namespace Viry3D
 
 		for (auto& i : passes_ui)
 		{
-			Renderer::CommitPass(i);
+			commits.Add(&i);
+		}
+
+#if VR_VULKAN
+		if (RenderPass::GetRenderPassBinding()->IsSecondaryContents())
+		{
+			Renderer::CommitPassesParallel(commits);
+			return;
+		}
+#endif
+
+		BindStaticBuffers();
+		m_static_buffers_binding = true;
+		m_batching_start = -1;
+		m_batching_count = -1;
+
+		for (auto i : commits)
+		{
+			Renderer::CommitPass(*i);
+		}
+	}
+
+#if VR_VULKAN
+	void Renderer::CommitPassesParallel(const Vector<List<MaterialPass>*>& passes)
+	{
+		// consecutive passes per job keep draw order when jobs execute in order
+		int thread_count = Graphics::GetDisplay()->GetRecordThreadCount();
+		int job_count = Mathf::Min(passes.Size(), thread_count * PARALLEL_RECORD_CHUNKS_PER_THREAD);
+		Vector<Action> jobs(job_count);
+
+		for (int i = 0; i < job_count; i++)
+		{
+			int begin = passes.Size() * i / job_count;
+			int end = passes.Size() * (i + 1) / job_count;
+
+			jobs[i] = [&passes, begin, end]() {
+				// secondary command buffers inherit no bound buffers
+				BindStaticBuffers();
+				m_static_buffers_binding = true;
+				m_batching_start = -1;
+				m_batching_count = -1;
+
+				for (int j = begin; j < end; j++)
+				{
+					Renderer::CommitPass(*passes[j]);
+				}
+			};
 		}
+
+		Graphics::GetDisplay()->RecordSecondaryCommandBuffers(jobs, RenderPass::GetRenderPassBinding()->GetInheritanceInfo());
 	}
+#endif
 
 	Renderer::Renderer():
 		m_sorting_order(0),
+		m_static(false),
 		m_lightmap_index(-1),
 		m_lightmap_scale_offset(),
 		m_bounds(Vector3::One() * Mathf::MinFloatValue, Vector3::One() * Mathf::MaxFloatValue)
@@ -785,21 +951,61 @@ namespace Viry3D
 	Renderer::~Renderer()
 	{
 		SetRenderersDirty(true);
+
+		if (this->IsStatic())
+		{
+			m_static_version++;
+		}
 	}
 
 	void Renderer::Start()
 	{
 		SetRenderersDirty(true);
+
+		if (this->IsStatic())
+		{
+			m_static_version++;
+		}
 	}
 
 	void Renderer::OnEnable()
 	{
 		SetRenderersDirty(true);
+
+		if (this->IsStatic())
+		{
+			m_static_version++;
+		}
 	}
 
 	void Renderer::OnDisable()
 	{
 		SetRenderersDirty(true);
+
+		if (this->IsStatic())
+		{
+			m_static_version++;
+		}
+	}
+
+	void Renderer::OnTranformChanged()
+	{
+		if (this->IsStatic())
+		{
+			m_static_version++;
+		}
+	}
+
+	void Renderer::SetStatic(bool value)
+	{
+		if (m_static != value)
+		{
+			m_static = value;
+			m_static_version++;
+
+			// shadow cameras split casters by it
+			SetRenderersDirty(true);
+		}
 	}
 
 	Ref<Material> Renderer::GetSharedMaterial() const
@@ -882,6 +1088,7 @@ namespace Viry3D
 
 			r->m_batch_indices[submesh].index_start = index_count;
 			r->m_batch_indices[submesh].index_count = count;
+			m_static_version++;
 
 			vertex_count += mesh->vertices.Size();
 			index_count += count;
@@ -27,6 +27,7 @@
 #include "math/Bounds.h"
 #include "math/Matrix4x4.h"
 #include "thread/Thread.h"
+#include "thread/TaskGraph.h"
 
 namespace Viry3D
 {
@@ -45,14 +46,23 @@ namespace Viry3D
 		static void OnPause();
 		static bool IsRenderersDirty();
 		static void SetRenderersDirty(bool dirty);
+		//	passes are cleared when next frame is prepared, a frame rendering may still use them
 		static void ClearPasses();
+		//	before first camera prepares passes of a frame
+		static void BeginFrame();
 		static void SetCullingDirty(Camera* cam);
         static void SetRendererDirty(Renderer* renderer);
 		static List<Renderer*>& GetRenderers();
+		//	renderers passed culling of camera in last frame it rendered
+		static int GetCulledRendererCount(Camera* cam);
+		//	cull cameras in parallel before their passes are prepared in order
+		static void CullingAll(const List<Camera*>& cameras);
 		static void PrepareAllPass();
 		static void RenderAllPass();
 		static void HandleUIEvent();
 		static void BuildStaticBatch(const Ref<GameObject>& obj);
+		//	changes when a static renderer is added, removed, enabled, disabled or moved
+		static uint32_t GetStaticVersion() { return m_static_version; }
 
 		Ref<Material> GetSharedMaterial() const;
 		void SetSharedMaterial(const Ref<Material>& mat);
@@ -72,18 +82,42 @@ namespace Viry3D
 		void SetLightmapScaleOffset(const Vector4& scale_offset) { m_lightmap_scale_offset = scale_offset; }
 		void SetBounds(const Bounds& bounds) { m_bounds = bounds; }
 		const Bounds& GetBounds() const { return m_bounds; }
+		//	static renderers never move, their shadows may be cached, static batched renderers are static
+		bool IsStatic() const { return m_static || m_batch_indices.Size() > 0; }
+		void SetStatic(bool value);
 
 	protected:
 		Renderer();
 		virtual void Start();
 		virtual void OnEnable();
 		virtual void OnDisable();
+		virtual void OnTranformChanged();
 		virtual void PreRenderByMaterial(int material_index);
 		virtual void PreRenderByRenderer(int material_index);
 		virtual Matrix4x4 GetWorldMatrix();
-		void Render(int material_index, int pass_index);
 
 	private:
+		struct RenderBuffer
+		{
+			const VertexBuffer* vb;
+			const IndexBuffer* ib;
+			// next update may refill buffers while render thread records, bind versions of this frame
+			int vb_version;
+			int ib_version;
+			int start;
+			int count;
+
+			RenderBuffer():
+				vb(NULL),
+				ib(NULL),
+				vb_version(-1),
+				ib_version(-1),
+				start(0),
+				count(0)
+			{
+			}
+		};
+
 		struct MaterialPass
 		{
 			int queue;
@@ -92,6 +126,8 @@ namespace Viry3D
 			int material_index;
 			int shader_id;
 			int material_id;
+			// captured in PreparePass, render thread never reads renderer's mesh
+			RenderBuffer buffer;
 		};
 
 		struct Passes
@@ -104,49 +140,42 @@ namespace Viry3D
 			Passes(): passes_dirty(true), culling_dirty(true) { }
 		};
 
-		struct RenderBuffer
-		{
-			const VertexBuffer* vb;
-			const IndexBuffer* ib;
-			int start;
-			int count;
-
-			RenderBuffer():
-				vb(NULL),
-				ib(NULL),
-				start(0),
-				count(0)
-			{
-			}
-		};
-
 		struct BatchInfo
 		{
 			int index_start;
 			int index_count;
 		};
 
-		static void CheckPasses();
-		static void CameraCulling();
+		static void CheckPasses(Camera* cam);
+		static void CameraCulling(Camera* cam);
 		static void BuildPasses(const List<Renderer*>& renderers, List<List<MaterialPass>>& passes);
-		static void BuildPasses();
+		static void BuildPasses(Camera* cam);
 		static void PreparePass(List<MaterialPass>& pass);
+		void Render(const MaterialPass& item, int pass_index);
 		static void CommitPass(List<MaterialPass>& pass);
+#if VR_VULKAN
+		static void CommitPassesParallel(const Vector<List<MaterialPass>*>& passes);
+#endif
 		static void BindStaticBuffers();
 
 		static List<Renderer*> m_renderers;
 		static Map<Camera*, Passes> m_passes;
 		static bool m_renderers_dirty;
+		static bool m_passes_clear;
+		static uint32_t m_static_version;
+		static Ref<TaskGraph> m_culling_graph;
 		static Mutex m_mutex;
 		static Ref<VertexBuffer> m_static_vertex_buffer;
 		static Ref<IndexBuffer> m_static_index_buffer;
-		static bool m_static_buffers_binding;
-		static int m_batching_start;
-		static int m_batching_count;
+		// per thread, passes may be recorded on worker threads
+		static thread_local bool m_static_buffers_binding;
+		static thread_local int m_batching_start;
+		static thread_local int m_batching_count;
 
 	protected:
 		Vector<Ref<Material>> m_shared_materials;
 		int m_sorting_order;
+		bool m_static;
 		int m_lightmap_index;
 		Vector4 m_lightmap_scale_offset;
 		Bounds m_bounds;
@@ -0,0 +1,367 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "TaskGraph.h"
+#include "Profiler.h"
+#include "Debug.h"
+#include <chrono>
+
+#define MAX_WORKER_COUNT 7
+#define TIMELINE_WIDTH 40
+
+namespace Viry3D
+{
+	Vector<Ref<std::thread>> TaskGraph::m_workers;
+	Vector<Ref<TaskGraph::Queue>> TaskGraph::m_queues;
+	List<int> TaskGraph::m_main_tasks;
+	Mutex TaskGraph::m_wait_mutex;
+	std::condition_variable TaskGraph::m_wait_condition;
+	std::atomic<int> TaskGraph::m_queued;
+	bool TaskGraph::m_close = false;
+	TaskGraph* TaskGraph::m_running = NULL;
+
+	static long long get_time_us()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void TaskGraph::Init()
+	{
+		int worker_count = (int) std::thread::hardware_concurrency() - 1;
+		if (worker_count < 1)
+		{
+			worker_count = 1;
+		}
+		else if (worker_count > MAX_WORKER_COUNT)
+		{
+			worker_count = MAX_WORKER_COUNT;
+		}
+
+		m_close = false;
+		m_queued = 0;
+
+		m_queues.Resize(worker_count + 1);
+		for (int i = 0; i < m_queues.Size(); i++)
+		{
+			m_queues[i] = RefMake<Queue>();
+		}
+
+		m_workers.Resize(worker_count);
+		for (int i = 0; i < m_workers.Size(); i++)
+		{
+			m_workers[i] = RefMake<std::thread>(&TaskGraph::WorkerRun, i + 1);
+		}
+	}
+
+	void TaskGraph::Deinit()
+	{
+		{
+			std::lock_guard<Mutex> lock(m_wait_mutex);
+			m_close = true;
+			m_wait_condition.notify_all();
+		}
+
+		for (auto& i : m_workers)
+		{
+			i->join();
+		}
+		m_workers.Clear();
+		m_queues.Clear();
+		m_main_tasks.Clear();
+	}
+
+	void TaskGraph::WorkerRun(int index)
+	{
+		while (true)
+		{
+			int task;
+			if (Pop(index, &task) || Steal(index, &task))
+			{
+				m_running->Execute(task, index);
+				continue;
+			}
+
+			std::unique_lock<Mutex> lock(m_wait_mutex);
+			m_wait_condition.wait(lock, []() {
+				return m_queued > 0 || m_close;
+			});
+
+			if (m_close)
+			{
+				break;
+			}
+		}
+	}
+
+	bool TaskGraph::Pop(int index, int* task)
+	{
+		auto& queue = m_queues[index];
+		std::lock_guard<Mutex> lock(queue->mutex);
+
+		// own queue is taken from back, tasks just made ready by this thread are hot
+		if (queue->tasks.Empty())
+		{
+			return false;
+		}
+
+		*task = queue->tasks.Last();
+		queue->tasks.RemoveLast();
+		m_queued--;
+
+		return true;
+	}
+
+	bool TaskGraph::Steal(int index, int* task)
+	{
+		for (int i = 1; i < m_queues.Size(); i++)
+		{
+			auto& queue = m_queues[(index + i) % m_queues.Size()];
+			std::lock_guard<Mutex> lock(queue->mutex);
+
+			if (!queue->tasks.Empty())
+			{
+				*task = queue->tasks.First();
+				queue->tasks.RemoveFirst();
+				m_queued--;
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool TaskGraph::PopMain(int* task)
+	{
+		std::lock_guard<Mutex> lock(m_wait_mutex);
+
+		if (m_main_tasks.Empty())
+		{
+			return false;
+		}
+
+		*task = m_main_tasks.First();
+		m_main_tasks.RemoveFirst();
+
+		return true;
+	}
+
+	TaskGraph::TaskGraph(const String& name):
+		m_name(name),
+		m_remaining(0),
+		m_run_begin(0),
+		m_time(0)
+	{
+	}
+
+	TaskGraph::~TaskGraph()
+	{
+		assert(m_running != this);
+	}
+
+	void TaskGraph::Clear()
+	{
+		assert(m_running != this);
+
+		m_tasks.Clear();
+	}
+
+	int TaskGraph::AddTask(const String& name, Action job, bool main_thread)
+	{
+		auto task = RefMake<Task>();
+		task->name = name;
+		task->sample = m_name + "::" + name;
+		task->job = job;
+		task->main_thread = main_thread;
+		task->pending = 0;
+		task->thread = -1;
+		task->time_begin = 0;
+		task->time_end = 0;
+
+		m_tasks.Add(task);
+
+		return m_tasks.Size() - 1;
+	}
+
+	void TaskGraph::AddDependency(int task, int depends_on)
+	{
+		assert(task != depends_on);
+
+		m_tasks[depends_on]->successors.Add(task);
+		m_tasks[task]->dependencies.Add(depends_on);
+	}
+
+	void TaskGraph::Run()
+	{
+		assert(m_running == NULL);
+
+		if (m_tasks.Empty())
+		{
+			m_time = 0;
+			return;
+		}
+
+		for (auto& i : m_tasks)
+		{
+			i->pending = i->dependencies.Size();
+			i->thread = -1;
+		}
+		m_remaining = m_tasks.Size();
+		m_run_begin = get_time_us();
+		m_running = this;
+
+		for (int i = 0; i < m_tasks.Size(); i++)
+		{
+			if (m_tasks[i]->dependencies.Empty())
+			{
+				this->Push(i, 0);
+			}
+		}
+
+		while (true)
+		{
+			int task;
+			if (PopMain(&task) || Pop(0, &task) || Steal(0, &task))
+			{
+				this->Execute(task, 0);
+				continue;
+			}
+
+			std::unique_lock<Mutex> lock(m_wait_mutex);
+			m_wait_condition.wait(lock, [this]() {
+				return m_remaining == 0 || m_queued > 0 || !m_main_tasks.Empty();
+			});
+
+			if (m_remaining == 0)
+			{
+				break;
+			}
+		}
+
+		m_running = NULL;
+		m_time = this->GetRunTime();
+
+		for (auto& i : m_tasks)
+		{
+			// a task never run means the dependencies have a cycle
+			assert(i->thread >= 0);
+		}
+	}
+
+	void TaskGraph::Push(int task, int thread)
+	{
+		if (m_tasks[task]->main_thread)
+		{
+			std::lock_guard<Mutex> lock(m_wait_mutex);
+			m_main_tasks.AddLast(task);
+			m_wait_condition.notify_all();
+		}
+		else
+		{
+			{
+				auto& queue = m_queues[thread];
+				std::lock_guard<Mutex> lock(queue->mutex);
+				queue->tasks.AddLast(task);
+			}
+
+			// counted under wait mutex so sleeping threads never miss it
+			std::lock_guard<Mutex> lock(m_wait_mutex);
+			m_queued++;
+			m_wait_condition.notify_all();
+		}
+	}
+
+	void TaskGraph::Execute(int task, int thread)
+	{
+		auto& t = m_tasks[task];
+
+		t->thread = thread;
+		t->time_begin = this->GetRunTime();
+
+		Profiler::SampleBegin(t->sample);
+		if (t->job)
+		{
+			t->job();
+		}
+		Profiler::SampleEnd();
+
+		t->time_end = this->GetRunTime();
+
+		for (auto i : t->successors)
+		{
+			if (--m_tasks[i]->pending == 0)
+			{
+				this->Push(i, thread);
+			}
+		}
+
+		if (--m_remaining == 0)
+		{
+			std::lock_guard<Mutex> lock(m_wait_mutex);
+			m_wait_condition.notify_all();
+		}
+	}
+
+	float TaskGraph::GetRunTime() const
+	{
+		return (get_time_us() - m_run_begin) / 1000.0f;
+	}
+
+	String TaskGraph::GetTimeline() const
+	{
+		String timeline = String::Format("%s %.2fms workers:%d\n", m_name.CString(), m_time, m_workers.Size());
+
+		float scale = m_time > 0 ? TIMELINE_WIDTH / m_time : 0;
+
+		for (const auto& i : m_tasks)
+		{
+			// thread 0 is the thread called Run
+			char bar[TIMELINE_WIDTH + 1];
+			int begin = (int) (i->time_begin * scale);
+			int end = (int) (i->time_end * scale);
+			if (end <= begin)
+			{
+				end = begin + 1;
+			}
+			for (int j = 0; j < TIMELINE_WIDTH; j++)
+			{
+				bar[j] = (j >= begin && j < end) ? '#' : ' ';
+			}
+			bar[TIMELINE_WIDTH] = 0;
+
+			String dependencies;
+			for (int j = 0; j < i->dependencies.Size(); j++)
+			{
+				if (j > 0)
+				{
+					dependencies += ",";
+				}
+				dependencies += m_tasks[i->dependencies[j]]->name;
+			}
+
+			timeline += String::Format("%-20s t%d |%s| %6.2fms %6.2fms <- %s\n",
+				i->name.CString(),
+				i->thread,
+				bar,
+				i->time_begin,
+				i->time_end - i->time_begin,
+				dependencies.CString());
+		}
+
+		return timeline;
+	}
+}
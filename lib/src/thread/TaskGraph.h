@@ -0,0 +1,94 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "Thread.h"
+#include "string/String.h"
+#include <atomic>
+
+namespace Viry3D
+{
+	//	tasks run on a work stealing pool shared by all graphs once their dependencies finished,
+	//	main thread tasks run on the thread calling Run, which helps the workers while waiting
+	class TaskGraph
+	{
+	public:
+		static void Init();
+		static void Deinit();
+		static int GetWorkerCount() { return m_workers.Size(); }
+		TaskGraph(const String& name);
+		~TaskGraph();
+		const String& GetName() const { return m_name; }
+		//	remove tasks of last run, timeline is gone with them
+		void Clear();
+		int AddTask(const String& name, Action job, bool main_thread = false);
+		//	task runs after depends_on finished
+		void AddDependency(int task, int depends_on);
+		int GetTaskCount() const { return m_tasks.Size(); }
+		//	blocks until every task finished, one graph runs at a time
+		void Run();
+		//	ms of last run
+		float GetTime() const { return m_time; }
+		//	task rows of last run with thread, start, duration and dependencies
+		String GetTimeline() const;
+
+	private:
+		struct Task
+		{
+			String name;
+			String sample;
+			Action job;
+			bool main_thread;
+			Vector<int> successors;
+			Vector<int> dependencies;
+			std::atomic<int> pending;
+			int thread;
+			float time_begin;
+			float time_end;
+		};
+
+		struct Queue
+		{
+			Mutex mutex;
+			List<int> tasks;
+		};
+
+		static void WorkerRun(int index);
+		static bool Pop(int index, int* task);
+		static bool Steal(int index, int* task);
+		static bool PopMain(int* task);
+		void Push(int task, int thread);
+		void Execute(int task, int thread);
+		float GetRunTime() const;
+
+		static Vector<Ref<std::thread>> m_workers;
+		//	queue 0 belongs to thread calling Run
+		static Vector<Ref<Queue>> m_queues;
+		static List<int> m_main_tasks;
+		static Mutex m_wait_mutex;
+		static std::condition_variable m_wait_condition;
+		static std::atomic<int> m_queued;
+		static bool m_close;
+		static TaskGraph* m_running;
+		String m_name;
+		Vector<Ref<Task>> m_tasks;
+		std::atomic<int> m_remaining;
+		long long m_run_begin;
+		float m_time;
+	};
+}
@@ -0,0 +1,196 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "FramePacer.h"
+#include "Debug.h"
+#include <thread>
+#include <chrono>
+#include <math.h>
+#include <algorithm>
+
+#define HISTORY_SIZE 240
+
+// sleep wakes up this much late at worst, rest of the wait spins
+#if VR_WINDOWS
+#define SPIN_US 2000
+#else
+#define SPIN_US 1000
+#endif
+
+namespace Viry3D
+{
+	long long FramePacer::GetTimeUS()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	FramePacer::FramePacer():
+		m_target_fps(-1),
+		m_deadline(0),
+		m_frame_begin(0),
+		m_frame_time(0),
+		m_work_time(0),
+		m_gpu_time(0),
+		m_history_index(0),
+		m_history_count(0)
+	{
+		m_history.Resize(HISTORY_SIZE);
+	}
+
+	void FramePacer::SetTargetFPS(int fps)
+	{
+		if (m_target_fps != fps)
+		{
+			m_target_fps = fps;
+			m_deadline = 0;
+		}
+	}
+
+	float FramePacer::GetFrameBudget() const
+	{
+		if (m_target_fps <= 0)
+		{
+			return 0;
+		}
+
+		return 1000.0f / m_target_fps;
+	}
+
+	void FramePacer::Wait()
+	{
+		if (m_target_fps <= 0)
+		{
+			return;
+		}
+
+		long long period = 1000000 / m_target_fps;
+		long long now = GetTimeUS();
+
+		if (m_deadline == 0)
+		{
+			m_deadline = now;
+			return;
+		}
+
+		// next deadline follows last one, not the late wake up, so frame times do not drift
+		m_deadline += period;
+
+		if (now >= m_deadline)
+		{
+			// a frame missed its deadline, start over from now instead of rushing frames
+			if (now - m_deadline > period)
+			{
+				m_deadline = now;
+			}
+			return;
+		}
+
+		while (m_deadline - now > SPIN_US)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(m_deadline - now - SPIN_US));
+			now = GetTimeUS();
+		}
+
+		while (now < m_deadline)
+		{
+			std::this_thread::yield();
+			now = GetTimeUS();
+		}
+	}
+
+	void FramePacer::BeginFrame()
+	{
+		long long now = GetTimeUS();
+
+		if (m_frame_begin > 0)
+		{
+			m_frame_time = (now - m_frame_begin) / 1000.0f;
+
+			m_history[m_history_index] = m_frame_time;
+			m_history_index = (m_history_index + 1) % m_history.Size();
+			if (m_history_count < m_history.Size())
+			{
+				m_history_count++;
+			}
+		}
+
+		m_frame_begin = now;
+	}
+
+	void FramePacer::EndFrame()
+	{
+		m_work_time = (GetTimeUS() - m_frame_begin) / 1000.0f;
+	}
+
+	void FramePacer::Reset()
+	{
+		m_deadline = 0;
+		m_frame_begin = 0;
+	}
+
+	FrameTimeStats FramePacer::GetStats() const
+	{
+		FrameTimeStats stats = { };
+		stats.count = m_history_count;
+
+		if (m_history_count == 0)
+		{
+			return stats;
+		}
+
+		Vector<float> times(m_history_count);
+		double sum = 0;
+		for (int i = 0; i < m_history_count; i++)
+		{
+			times[i] = m_history[i];
+			sum += times[i];
+		}
+		stats.average = (float) (sum / m_history_count);
+
+		double variance = 0;
+		for (int i = 0; i < m_history_count; i++)
+		{
+			double d = times[i] - stats.average;
+			variance += d * d;
+		}
+		stats.deviation = (float) sqrt(variance / m_history_count);
+
+		std::sort(&times[0], &times[0] + m_history_count);
+		stats.p50 = times[(m_history_count - 1) * 50 / 100];
+		stats.p95 = times[(m_history_count - 1) * 95 / 100];
+		stats.p99 = times[(m_history_count - 1) * 99 / 100];
+		stats.max = times[m_history_count - 1];
+
+		return stats;
+	}
+
+	void FramePacer::LogStats() const
+	{
+		auto stats = this->GetStats();
+
+		Log("frame time of %d frames avg:%.2fms dev:%.2fms p50:%.2fms p95:%.2fms p99:%.2fms max:%.2fms work:%.2fms gpu:%.2fms",
+			stats.count,
+			stats.average,
+			stats.deviation,
+			stats.p50,
+			stats.p95,
+			stats.p99,
+			stats.max,
+			m_work_time,
+			m_gpu_time);
+	}
+}
@@ -0,0 +1,77 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "container/Vector.h"
+
+namespace Viry3D
+{
+	//	ms of frames kept in history
+	struct FrameTimeStats
+	{
+		int count;
+		float average;
+		float deviation;
+		float p50;
+		float p95;
+		float p99;
+		float max;
+	};
+
+	//	waits for frame deadlines on a microsecond clock, sleeps most of the wait and
+	//	spins the rest since sleep wakes up late, and records frame times
+	class FramePacer
+	{
+	public:
+		FramePacer();
+		//	no waiting when fps <= 0
+		void SetTargetFPS(int fps);
+		int GetTargetFPS() const { return m_target_fps; }
+		//	ms per frame of target fps, 0 when not paced
+		float GetFrameBudget() const;
+		//	blocks until deadline of next frame
+		void Wait();
+		//	enclose update and draw of a frame, waiting of pacer is not work time
+		void BeginFrame();
+		void EndFrame();
+		//	ms from last frame begin to this one
+		float GetFrameTime() const { return m_frame_time; }
+		//	ms of last frame between begin and end
+		float GetWorkTime() const { return m_work_time; }
+		//	ms gpu spent on last measured frame, 0 when display can not measure it
+		float GetGPUTime() const { return m_gpu_time; }
+		void SetGPUTime(float ms) { m_gpu_time = ms; }
+		//	after a pause, so the gap is not taken as a frame
+		void Reset();
+		FrameTimeStats GetStats() const;
+		void LogStats() const;
+
+	private:
+		static long long GetTimeUS();
+
+		int m_target_fps;
+		long long m_deadline;
+		long long m_frame_begin;
+		float m_frame_time;
+		float m_work_time;
+		float m_gpu_time;
+		Vector<float> m_history;
+		int m_history_index;
+		int m_history_count;
+	};
+}
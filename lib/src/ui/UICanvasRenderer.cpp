@@ -23,6 +23,7 @@
 #include "graphics/Material.h"
 #include "graphics/Mesh.h"
 #include "graphics/Camera.h"
+#include "graphics/Graphics.h"
 
 namespace Viry3D
 {
@@ -271,10 +272,8 @@ namespace Viry3D
 		}
         else
         {
-            if (m_mesh)
-            {
-                m_mesh.reset();
-            }
+            // render thread may still draw it, its buffers are captured until then
+            Graphics::ReleaseAfterRender(m_mesh);
         }
 	}
 
@@ -18,7 +18,12 @@
 #include "BufferVulkan.h"
 #include "DisplayVulkan.h"
 #include "graphics/Graphics.h"
+#include "graphics/RenderThread.h"
 #include "memory/Memory.h"
+#include "math/Mathf.h"
+
+// keeps index buffer offsets aligned to index size
+#define BUFFER_VERSION_ALIGNMENT 256
 
 namespace Viry3D
 {
@@ -26,19 +31,114 @@ namespace Viry3D
 		m_size(0),
 		m_type(BufferType::None),
 		m_buffer(VK_NULL_HANDLE),
-		m_memory(VK_NULL_HANDLE)
+		m_version_count(1),
+		m_version_stride(0),
+		m_version(0),
+		m_uniform_offset(0)
 	{
+		Memory::Zero(&m_memory, sizeof(m_memory));
+
+		for (int i = 0; i < BUFFER_VERSION_MAX; i++)
+		{
+			m_read_serials[i] = 0;
+			m_capture_frames[i] = 0;
+		}
 	}
 
 	BufferVulkan::~BufferVulkan()
 	{
+		if (m_type == BufferType::Uniform)
+		{
+			// transient ring is owned by memory allocator
+			return;
+		}
+
 		auto display = (DisplayVulkan*) Graphics::GetDisplay();
 		auto device = display->GetDevice();
+		auto allocator = display->GetMemoryAllocator();
+		auto memory = m_memory;
+		auto buffer = m_buffer;
+
+		display->DestroyDeferred([=]() {
+			vkDestroyBuffer(device, buffer, NULL);
+			allocator->Free(memory);
+		});
+	}
+
+	VkDeviceSize BufferVulkan::GetOffset() const
+	{
+		if (m_type == BufferType::Uniform)
+		{
+			return m_uniform_offset;
+		}
+
+		return m_version * m_version_stride;
+	}
+
+	void* BufferVulkan::GetMapped() const
+	{
+		if (m_type == BufferType::Uniform)
+		{
+			return (void*) &m_uniform_data[0];
+		}
+
+		return (byte*) m_memory.mapped + this->GetOffset();
+	}
+
+	int BufferVulkan::CaptureVersion() const
+	{
+		int version = m_version;
+
+		auto render_thread = Graphics::GetRenderThread();
+		if (render_thread)
+		{
+			// frame being prepared renders after next kick
+			m_capture_frames[version] = render_thread->GetFrameCount() + 1;
+		}
+
+		return version;
+	}
+
+	VkDeviceSize BufferVulkan::MarkGpuRead(int version) const
+	{
+		if (m_type == BufferType::Uniform)
+		{
+			// transient memory is reused only after frame's fence
+			return m_uniform_offset;
+		}
+
+		auto display = (DisplayVulkan*) Graphics::GetDisplay();
+		if (version < 0)
+		{
+			version = m_version;
+		}
+		m_read_serials[version] = display->GetRecordingSerial();
+
+		return version * m_version_stride;
+	}
+
+	void BufferVulkan::WaitGpuRead() const
+	{
+		if (m_type == BufferType::Uniform)
+		{
+			return;
+		}
 
-		vkDeviceWaitIdle(device);
+		this->WaitVersion(m_version);
+	}
+
+	void BufferVulkan::WaitVersion(int version) const
+	{
+		// frame being rendered captured this version but may not have recorded its bind yet,
+		// read serial is only known after that
+		auto render_thread = Graphics::GetRenderThread();
+		if (render_thread && !render_thread->IsRenderThread() && m_capture_frames[version] == render_thread->GetFrameCount())
+		{
+			render_thread->Wait();
+		}
 
-		vkFreeMemory(device, m_memory, NULL);
-		vkDestroyBuffer(device, m_buffer, NULL);
+		auto display = (DisplayVulkan*) Graphics::GetDisplay();
+		display->WaitSubmit(m_read_serials[version]);
 	}
 
 	void BufferVulkan::CreateInternal(BufferType type, bool dynamic)
@@ -47,13 +147,29 @@ namespace Viry3D
 		auto device = display->GetDevice();
 		VkResult err;
 
+		// one more region than frames in flight, render thread may still bind region filled before last
+		if (dynamic && (type == BufferType::Vertex || type == BufferType::Index))
+		{
+			m_version_count = Mathf::Min(display->GetFramesInFlight() + 1, BUFFER_VERSION_MAX);
+		}
+		m_version_stride = (m_size + BUFFER_VERSION_ALIGNMENT - 1) / BUFFER_VERSION_ALIGNMENT * BUFFER_VERSION_ALIGNMENT;
+
+		if (type == BufferType::Uniform)
+		{
+			m_type = type;
+			m_uniform_data.Resize(m_size);
+			Memory::Zero(&m_uniform_data[0], m_size);
+			this->Commit();
+			return;
+		}
+
 		if (m_buffer == VK_NULL_HANDLE)
 		{
 			VkBufferCreateInfo buf_info;
 			Memory::Zero(&buf_info, sizeof(buf_info));
 			buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 			buf_info.pNext = NULL;
-			buf_info.size = (uint32_t) m_size;
+			buf_info.size = m_version_count > 1 ? m_version_stride * m_version_count : (VkDeviceSize) m_size;
 			buf_info.flags = 0;
 
 			m_type = type;
@@ -69,16 +185,13 @@ namespace Viry3D
 					buf_info.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
 					break;
 				}
-				case BufferType::Uniform:
-				{
-					buf_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-					break;
-				}
 				case BufferType::Image:
 				{
 					buf_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 					break;
 				}
+				// uniform buffers live in transient ring
+				case BufferType::Uniform:
 				case BufferType::None:
 					break;
 			}
@@ -87,55 +200,86 @@ namespace Viry3D
 			assert(!err);
 		}
 
-		if (m_memory == VK_NULL_HANDLE)
+		if (m_memory.memory == VK_NULL_HANDLE)
 		{
 			VkMemoryRequirements mem_reqs;
 			vkGetBufferMemoryRequirements(device, m_buffer, &mem_reqs);
 
-			VkMemoryAllocateInfo mem_alloc = {
-				VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-				NULL,
-				mem_reqs.size,
-				0,
-			};
+			uint32_t type_index = 0;
 			bool pass = display->CheckMemoryType(
 				mem_reqs.memoryTypeBits,
 				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				&mem_alloc.memoryTypeIndex);
+				&type_index);
 			assert(pass);
 
-			err = vkAllocateMemory(device, &mem_alloc, NULL, &m_memory);
-			assert(!err);
+			pass = display->GetMemoryAllocator()->Allocate(mem_reqs, type_index, true, &m_memory);
+			assert(pass);
 
-			err = vkBindBufferMemory(device, m_buffer, m_memory, 0);
+			err = vkBindBufferMemory(device, m_buffer, m_memory.memory, m_memory.offset);
 			assert(!err);
 		}
 	}
 
 	void BufferVulkan::Fill(void* param, FillFunc fill)
 	{
-		auto device = ((DisplayVulkan*) Graphics::GetDisplay())->GetDevice();
+		if (m_type == BufferType::Uniform)
+		{
+			ByteBuffer buffer(&m_uniform_data[0], m_size);
+			fill(param, buffer);
 
-		void* data;
-		VkResult err = vkMapMemory(device, m_memory, 0, (uint32_t) m_size, 0, &data);
-		assert(!err);
+			this->Commit();
+			return;
+		}
 
-		ByteBuffer buffer((byte*) data, m_size);
-		fill(param, buffer);
+		if (m_version_count > 1)
+		{
+			// region read frames in flight ago, wait is rare
+			int version = (m_version + 1) % m_version_count;
+			this->WaitVersion(version);
+
+			ByteBuffer buffer((byte*) m_memory.mapped + version * m_version_stride, m_size);
+			fill(param, buffer);
+
+			m_version = version;
+			return;
+		}
+
+		this->WaitGpuRead();
 
-		vkUnmapMemory(device, m_memory);
+		ByteBuffer buffer((byte*) m_memory.mapped, m_size);
+		fill(param, buffer);
 	}
 
 	void BufferVulkan::UpdateRange(int offset, int size, const void* data)
 	{
-		auto device = ((DisplayVulkan*) Graphics::GetDisplay())->GetDevice();
+		if (m_type == BufferType::Uniform)
+		{
+			Memory::Copy(&m_uniform_data[offset], data, size);
+
+			this->Commit();
+			return;
+		}
+
+		this->WaitGpuRead();
+
+		Memory::Copy((byte*) m_memory.mapped + offset, data, size);
+	}
+
+	void BufferVulkan::Commit()
+	{
+		auto display = (DisplayVulkan*) Graphics::GetDisplay();
 
-		void* mapped;
-		VkResult err = vkMapMemory(device, m_memory, (uint32_t) offset, (uint32_t) size, 0, &mapped);
-		assert(!err);
+		TransientAllocation allocation;
+		bool pass = display->GetMemoryAllocator()->AllocateTransient(
+			m_size,
+			display->GetMinUniformBufferOffsetAlignment(),
+			display->GetFrameIndex(),
+			&allocation);
+		assert(pass);
 
-		Memory::Copy(mapped, data, size);
+		Memory::Copy(allocation.mapped, &m_uniform_data[0], m_size);
 
-		vkUnmapMemory(device, m_memory);
+		m_buffer = allocation.buffer;
+		m_uniform_offset = allocation.offset;
 	}
 }
@@ -18,23 +18,42 @@
 #pragma once
 
 #include "vulkan_include.h"
+#include "MemoryAllocatorVulkan.h"
 #include "graphics/BufferType.h"
 #include "memory/ByteBuffer.h"
+#include "container/Vector.h"
 #include <functional>
+#include <atomic>
+
+#define BUFFER_VERSION_MAX 4
 
 namespace Viry3D
 {
+	//	dynamic vertex and index buffers keep a region per frame in flight in one mapped buffer,
+	//	fill writes a region gpu finished reading and binds take region filled last.
+	//	uniform buffers keep a cpu copy, each commit copies it to the frame's transient ring
 	class BufferVulkan
 	{
 	public:
 		virtual ~BufferVulkan();
 		VkBuffer GetBuffer() const { return m_buffer; }
 		int GetSize() const { return m_size; }
-		VkDeviceMemory GetMemory() const { return m_memory; }
+		VkDeviceSize GetOffset() const;
+		//	buffer memory stays mapped for its lifetime, uniform buffers return cpu copy
+		void* GetMapped() const;
 
 		typedef std::function<void(void* param, const ByteBuffer& buffer)> FillFunc;
 		void Fill(void* param, FillFunc fill);
 		void UpdateRange(int offset, int size, const void* data);
+		//	uniform buffers only, copy cpu data to transient memory of recording frame, never waits gpu
+		void Commit();
+		//	version binds of the frame being prepared read, refills of it wait until render thread recorded that frame
+		int CaptureVersion() const;
+		//	record that commands being recorded read this buffer, returns offset of region they read,
+		//	-1 reads region filled last
+		VkDeviceSize MarkGpuRead(int version = -1) const;
+		//	wait gpu finished reading before cpu writes
+		void WaitGpuRead() const;
 
 	protected:
 		BufferVulkan();
@@ -43,8 +62,20 @@ namespace Viry3D
 		int m_size;
 
 	private:
+		void WaitVersion(int version) const;
+
 		BufferType m_type;
 		VkBuffer m_buffer;
-		VkDeviceMemory m_memory;
+		MemoryAllocation m_memory;
+		int m_version_count;
+		VkDeviceSize m_version_stride;
+		//	render thread may bind while main thread fills next region
+		std::atomic<int> m_version;
+		mutable std::atomic<uint64_t> m_read_serials[BUFFER_VERSION_MAX];
+		//	render thread frame that captured each version
+		mutable std::atomic<int> m_capture_frames[BUFFER_VERSION_MAX];
+		Vector<byte> m_uniform_data;
+		//	render thread may bind while main thread commits
+		std::atomic<VkDeviceSize> m_uniform_offset;
 	};
 }
@@ -0,0 +1,526 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "DescriptorAllocatorVulkan.h"
+#include "memory/Memory.h"
+#include "Debug.h"
+
+#define FRAME_POOL_SET_COUNT 1024
+#define CACHE_POOL_SET_COUNT 256
+#define POOL_UNIFORM_BUFFERS_PER_SET 2
+#define POOL_SAMPLERS_PER_SET 4
+// idle cached sets are kept a while, bindings alternating between a few resources hit them again
+#define CACHE_IDLE_FRAMES 120
+
+#if VR_VULKAN
+
+namespace Viry3D
+{
+	DescriptorKey DescriptorKey::FromWrites(VkDescriptorSetLayout layout, const VkWriteDescriptorSet* writes, int count)
+	{
+		DescriptorKey key;
+		key.layout = layout;
+		key.bindings.Resize(count);
+
+		for (int i = 0; i < count; i++)
+		{
+			auto& binding = key.bindings[i];
+
+			// zero padding too, key is hashed and compared as bytes
+			Memory::Zero(&binding, sizeof(binding));
+			binding.binding = writes[i].dstBinding;
+			binding.type = writes[i].descriptorType;
+
+			if (binding.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
+			{
+				binding.buffer = *writes[i].pBufferInfo;
+			}
+			else
+			{
+				binding.image = *writes[i].pImageInfo;
+			}
+		}
+
+		return key;
+	}
+
+	uint64_t DescriptorKey::Hash() const
+	{
+		// fnv-1a
+		uint64_t hash = 14695981039346656037ULL;
+
+		auto add = [&](const void* data, int size) {
+			const byte* bytes = (const byte*) data;
+			for (int i = 0; i < size; i++)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ULL;
+			}
+		};
+
+		add(&layout, sizeof(layout));
+		if (!bindings.Empty())
+		{
+			add(&bindings[0], bindings.SizeInBytes());
+		}
+
+		return hash;
+	}
+
+	bool DescriptorKey::operator ==(const DescriptorKey& right) const
+	{
+		if (layout != right.layout || bindings.Size() != right.bindings.Size())
+		{
+			return false;
+		}
+
+		return bindings.Empty() || Memory::Compare(&bindings[0], &right.bindings[0], bindings.SizeInBytes()) == 0;
+	}
+
+	DescriptorAllocatorVulkan::DescriptorAllocatorVulkan(VkDevice device, int frame_count):
+		m_device(device),
+		m_frame_count(0),
+		m_remove_count(0)
+	{
+		m_frame_pools.Resize(frame_count);
+		for (auto& i : m_frame_pools)
+		{
+			i.used = 0;
+		}
+
+		Memory::Zero(&m_stats, sizeof(m_stats));
+		Memory::Zero(&m_frame_stats, sizeof(m_frame_stats));
+	}
+
+	DescriptorAllocatorVulkan::~DescriptorAllocatorVulkan()
+	{
+		// removed entries are no longer in m_cache
+		for (auto& i : m_cache_sets)
+		{
+			delete i.second;
+		}
+		m_cache.Clear();
+		m_cache_sets.Clear();
+
+		// sets are freed with their pools
+		for (auto i : m_cache_pools)
+		{
+			vkDestroyDescriptorPool(m_device, i, NULL);
+		}
+		m_cache_pools.Clear();
+
+		for (auto& i : m_frame_pools)
+		{
+			for (auto j : i.pools)
+			{
+				vkDestroyDescriptorPool(m_device, j, NULL);
+			}
+		}
+		m_frame_pools.Clear();
+	}
+
+	VkDescriptorPool DescriptorAllocatorVulkan::CreatePool(int set_count, bool free_sets)
+	{
+		VkDescriptorPoolSize pool_sizes[2] = {
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, (uint32_t) (set_count * POOL_UNIFORM_BUFFERS_PER_SET) },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, (uint32_t) (set_count * POOL_SAMPLERS_PER_SET) },
+		};
+
+		VkDescriptorPoolCreateInfo pool_info = {
+			VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			NULL,
+			free_sets ? (VkDescriptorPoolCreateFlags) VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT : 0,
+			(uint32_t) set_count,
+			2,
+			pool_sizes,
+		};
+
+		VkDescriptorPool pool;
+		VkResult err = vkCreateDescriptorPool(m_device, &pool_info, NULL, &pool);
+		assert(!err);
+
+		return pool;
+	}
+
+	VkDescriptorSet DescriptorAllocatorVulkan::AllocateSet(VkDescriptorPool pool, VkDescriptorSetLayout layout)
+	{
+		VkDescriptorSetAllocateInfo set_info = {
+			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			NULL,
+			pool,
+			1,
+			&layout
+		};
+
+		// pool out of memory or fragmented, caller tries next pool
+		VkDescriptorSet set;
+		VkResult err = vkAllocateDescriptorSets(m_device, &set_info, &set);
+		if (err)
+		{
+			return VK_NULL_HANDLE;
+		}
+
+		return set;
+	}
+
+	void DescriptorAllocatorVulkan::WriteSet(VkDescriptorSet set, const DescriptorKey& key)
+	{
+		if (key.bindings.Empty())
+		{
+			return;
+		}
+
+		Vector<VkWriteDescriptorSet> writes(key.bindings.Size());
+		for (int i = 0; i < key.bindings.Size(); i++)
+		{
+			const auto& binding = key.bindings[i];
+			auto& write = writes[i];
+
+			Memory::Zero(&write, sizeof(write));
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = set;
+			write.dstBinding = binding.binding;
+			write.descriptorCount = 1;
+			write.descriptorType = binding.type;
+
+			if (binding.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
+			{
+				write.pBufferInfo = &binding.buffer;
+			}
+			else
+			{
+				write.pImageInfo = &binding.image;
+			}
+		}
+
+		vkUpdateDescriptorSets(m_device, writes.Size(), &writes[0], 0, NULL);
+	}
+
+	VkDescriptorSet DescriptorAllocatorVulkan::AllocateFrameSet(const DescriptorKey& key, int frame_index)
+	{
+		std::lock_guard<Mutex> lock(m_mutex);
+
+		auto& frame = m_frame_pools[frame_index];
+
+		VkDescriptorSet set = VK_NULL_HANDLE;
+		while (set == VK_NULL_HANDLE)
+		{
+			if (frame.used == frame.pools.Size())
+			{
+				frame.pools.Add(this->CreatePool(FRAME_POOL_SET_COUNT, false));
+			}
+
+			set = this->AllocateSet(frame.pools[frame.used], key.layout);
+			if (set == VK_NULL_HANDLE)
+			{
+				frame.used++;
+			}
+		}
+
+		this->WriteSet(set, key);
+		m_frame_stats.frame_sets_allocated++;
+
+		return set;
+	}
+
+	void DescriptorAllocatorVulkan::ResetFrame(int frame_index)
+	{
+		std::lock_guard<Mutex> lock(m_mutex);
+
+		m_frame_count++;
+		m_stats = m_frame_stats;
+		Memory::Zero(&m_frame_stats, sizeof(m_frame_stats));
+
+		// linear pools are reset as a whole, no set is freed one by one
+		auto& frame = m_frame_pools[frame_index];
+		int reset_count = frame.used + 1 < frame.pools.Size() ? frame.used + 1 : frame.pools.Size();
+		for (int i = 0; i < reset_count; i++)
+		{
+			VkResult err = vkResetDescriptorPool(m_device, frame.pools[i], 0);
+			assert(!err);
+		}
+		frame.used = 0;
+		m_frame_stats.frame_pools_reset = reset_count;
+
+		Vector<CacheEntry*> evicts;
+		for (const auto& i : m_cache)
+		{
+			for (auto j : i.second)
+			{
+				if (j->ref_count == 0 && m_frame_count - j->idle_frame > CACHE_IDLE_FRAMES)
+				{
+					evicts.Add(j);
+				}
+			}
+		}
+		for (auto i : evicts)
+		{
+			this->FreeEntry(i);
+		}
+	}
+
+	VkDescriptorSet DescriptorAllocatorVulkan::AcquireCachedSet(const DescriptorKey& key)
+	{
+		std::lock_guard<Mutex> lock(m_mutex);
+
+		uint64_t hash = key.Hash();
+
+		Vector<CacheEntry*>* entries;
+		if (m_cache.TryGet(hash, &entries))
+		{
+			for (auto i : *entries)
+			{
+				if (i->key == key)
+				{
+					i->ref_count++;
+					m_frame_stats.cache_hits++;
+					return i->set;
+				}
+			}
+		}
+
+		VkDescriptorPool pool = VK_NULL_HANDLE;
+		VkDescriptorSet set = VK_NULL_HANDLE;
+		for (int i = m_cache_pools.Size() - 1; i >= 0 && set == VK_NULL_HANDLE; i--)
+		{
+			pool = m_cache_pools[i];
+			set = this->AllocateSet(pool, key.layout);
+		}
+
+		if (set == VK_NULL_HANDLE)
+		{
+			pool = this->CreatePool(CACHE_POOL_SET_COUNT, true);
+			m_cache_pools.Add(pool);
+
+			set = this->AllocateSet(pool, key.layout);
+			assert(set != VK_NULL_HANDLE);
+		}
+
+		this->WriteSet(set, key);
+
+		CacheEntry* entry = new CacheEntry();
+		entry->key = key;
+		entry->hash = hash;
+		entry->set = set;
+		entry->pool = pool;
+		entry->ref_count = 1;
+		entry->idle_frame = 0;
+		entry->removed = false;
+
+		if (!m_cache.Contains(hash))
+		{
+			m_cache.Add(hash, Vector<CacheEntry*>());
+		}
+		m_cache[hash].Add(entry);
+		m_cache_sets.Add(set, entry);
+		m_frame_stats.cache_misses++;
+
+		return set;
+	}
+
+	void DescriptorAllocatorVulkan::ReleaseCachedSet(VkDescriptorSet set)
+	{
+		std::lock_guard<Mutex> lock(m_mutex);
+
+		// already freed by RemoveLayout
+		CacheEntry** find;
+		if (!m_cache_sets.TryGet(set, &find))
+		{
+			return;
+		}
+
+		CacheEntry* entry = *find;
+		entry->ref_count--;
+		if (entry->ref_count == 0)
+		{
+			if (entry->removed)
+			{
+				this->FreeEntry(entry);
+				return;
+			}
+
+			entry->idle_frame = m_frame_count;
+		}
+	}
+
+	void DescriptorAllocatorVulkan::RemoveLayout(VkDescriptorSetLayout layout)
+	{
+		std::lock_guard<Mutex> lock(m_mutex);
+
+		Vector<CacheEntry*> removes;
+		for (const auto& i : m_cache_sets)
+		{
+			if (i.second->key.layout == layout)
+			{
+				removes.Add(i.second);
+			}
+		}
+		for (auto i : removes)
+		{
+			this->FreeEntry(i);
+		}
+	}
+
+	void DescriptorAllocatorVulkan::RemoveImageView(VkImageView image_view)
+	{
+		this->RemoveEntries([=](const DescriptorBinding& binding) {
+			return binding.type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER && binding.image.imageView == image_view;
+		});
+	}
+
+	void DescriptorAllocatorVulkan::RemoveSampler(VkSampler sampler)
+	{
+		this->RemoveEntries([=](const DescriptorBinding& binding) {
+			return binding.type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER && binding.image.sampler == sampler;
+		});
+	}
+
+	void DescriptorAllocatorVulkan::RemoveBuffer(VkBuffer buffer)
+	{
+		this->RemoveEntries([=](const DescriptorBinding& binding) {
+			return binding.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC && binding.buffer.buffer == buffer;
+		});
+	}
+
+	void DescriptorAllocatorVulkan::RemoveEntries(std::function<bool(const DescriptorBinding& binding)> match)
+	{
+		std::lock_guard<Mutex> lock(m_mutex);
+
+		Vector<CacheEntry*> removes;
+		for (const auto& i : m_cache_sets)
+		{
+			if (i.second->removed)
+			{
+				continue;
+			}
+
+			for (const auto& j : i.second->key.bindings)
+			{
+				if (match(j))
+				{
+					removes.Add(i.second);
+					break;
+				}
+			}
+		}
+		for (auto i : removes)
+		{
+			if (i->ref_count == 0)
+			{
+				this->FreeEntry(i);
+			}
+			else
+			{
+				// a new resource may get same handle, key would match a set written with old one
+				this->UnlinkEntry(i);
+				i->removed = true;
+			}
+		}
+
+		if (removes.Size() > 0)
+		{
+			m_remove_count++;
+		}
+	}
+
+	bool DescriptorAllocatorVulkan::IsRemoved(VkDescriptorSet set)
+	{
+		std::lock_guard<Mutex> lock(m_mutex);
+
+		CacheEntry** find;
+		if (m_cache_sets.TryGet(set, &find))
+		{
+			return (*find)->removed;
+		}
+
+		return true;
+	}
+
+	void DescriptorAllocatorVulkan::FreeEntry(CacheEntry* entry)
+	{
+		VkResult err = vkFreeDescriptorSets(m_device, entry->pool, 1, &entry->set);
+		assert(!err);
+
+		if (!entry->removed)
+		{
+			this->UnlinkEntry(entry);
+		}
+		m_cache_sets.Remove(entry->set);
+
+		delete entry;
+	}
+
+	void DescriptorAllocatorVulkan::UnlinkEntry(CacheEntry* entry)
+	{
+		auto& entries = m_cache[entry->hash];
+		for (int i = 0; i < entries.Size(); i++)
+		{
+			if (entries[i] == entry)
+			{
+				entries.Remove(i);
+				break;
+			}
+		}
+		if (entries.Empty())
+		{
+			m_cache.Remove(entry->hash);
+		}
+	}
+
+	DescriptorStats DescriptorAllocatorVulkan::GetStats()
+	{
+		std::lock_guard<Mutex> lock(m_mutex);
+
+		DescriptorStats stats = m_stats;
+		stats.cache_pool_count = m_cache_pools.Size();
+		stats.cached_set_count = m_cache_sets.Size();
+		stats.frame_pool_count = 0;
+		stats.idle_set_count = 0;
+
+		for (const auto& i : m_frame_pools)
+		{
+			stats.frame_pool_count += i.pools.Size();
+		}
+
+		for (const auto& i : m_cache_sets)
+		{
+			if (i.second->ref_count == 0)
+			{
+				stats.idle_set_count++;
+			}
+		}
+
+		return stats;
+	}
+
+	void DescriptorAllocatorVulkan::LogStats()
+	{
+		DescriptorStats stats = this->GetStats();
+
+		Log("vulkan descriptor frame sets:%d pools reset:%d cache hits:%d misses:%d sets:%d idle:%d pools frame:%d cache:%d",
+			stats.frame_sets_allocated,
+			stats.frame_pools_reset,
+			stats.cache_hits,
+			stats.cache_misses,
+			stats.cached_set_count,
+			stats.idle_set_count,
+			stats.frame_pool_count,
+			stats.cache_pool_count);
+	}
+}
+
+#endif
@@ -0,0 +1,129 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "vulkan_include.h"
+#include "container/Vector.h"
+#include "container/Map.h"
+#include "thread/Thread.h"
+#include <functional>
+#include <atomic>
+
+namespace Viry3D
+{
+	struct DescriptorBinding
+	{
+		uint32_t binding;
+		VkDescriptorType type;
+		VkDescriptorBufferInfo buffer;
+		VkDescriptorImageInfo image;
+	};
+
+	//	layout and resources a descriptor set is written with
+	struct DescriptorKey
+	{
+		VkDescriptorSetLayout layout;
+		Vector<DescriptorBinding> bindings;
+
+		DescriptorKey(): layout(VK_NULL_HANDLE) { }
+		static DescriptorKey FromWrites(VkDescriptorSetLayout layout, const VkWriteDescriptorSet* writes, int count);
+		uint64_t Hash() const;
+		bool operator ==(const DescriptorKey& right) const;
+		bool operator !=(const DescriptorKey& right) const { return !(*this == right); }
+	};
+
+	struct DescriptorStats
+	{
+		//	counters of last frame
+		int frame_sets_allocated;
+		int frame_pools_reset;
+		int cache_hits;
+		int cache_misses;
+		int frame_pool_count;
+		int cache_pool_count;
+		int cached_set_count;
+		//	cached sets no owner uses, freed after some frames
+		int idle_set_count;
+	};
+
+	//	frame sets come from linear pools reset when the frame slot is reused,
+	//	long lived sets are shared by owners binding the same resources
+	class DescriptorAllocatorVulkan
+	{
+	public:
+		DescriptorAllocatorVulkan(VkDevice device, int frame_count);
+		~DescriptorAllocatorVulkan();
+		//	written set valid until the frame slot is reused, never release it
+		VkDescriptorSet AllocateFrameSet(const DescriptorKey& key, int frame_index);
+		//	call after gpu finished the frame used this slot before
+		void ResetFrame(int frame_index);
+		uint64_t GetFrameCount() const { return m_frame_count; }
+		//	written set shared by owners with same key, release once for every acquire
+		VkDescriptorSet AcquireCachedSet(const DescriptorKey& key);
+		//	call after gpu finished commands using the set
+		void ReleaseCachedSet(VkDescriptorSet set);
+		//	free cached sets of a layout going to be destroyed, its handle may be reused
+		void RemoveLayout(VkDescriptorSetLayout layout);
+		//	cached sets of a resource going to be destroyed are never acquired again,
+		//	sets still owned are freed on last release
+		void RemoveImageView(VkImageView image_view);
+		void RemoveSampler(VkSampler sampler);
+		void RemoveBuffer(VkBuffer buffer);
+		//	increased by every remove, owners check IsRemoved only when it changed
+		uint64_t GetRemoveCount() const { return m_remove_count; }
+		bool IsRemoved(VkDescriptorSet set);
+		DescriptorStats GetStats();
+		void LogStats();
+
+	private:
+		struct CacheEntry
+		{
+			DescriptorKey key;
+			uint64_t hash;
+			VkDescriptorSet set;
+			VkDescriptorPool pool;
+			int ref_count;
+			uint64_t idle_frame;
+			bool removed;
+		};
+
+		struct FramePools
+		{
+			Vector<VkDescriptorPool> pools;
+			int used;
+		};
+
+		VkDescriptorPool CreatePool(int set_count, bool free_sets);
+		VkDescriptorSet AllocateSet(VkDescriptorPool pool, VkDescriptorSetLayout layout);
+		void WriteSet(VkDescriptorSet set, const DescriptorKey& key);
+		void FreeEntry(CacheEntry* entry);
+		void UnlinkEntry(CacheEntry* entry);
+		void RemoveEntries(std::function<bool(const DescriptorBinding& binding)> match);
+
+		VkDevice m_device;
+		Mutex m_mutex;
+		uint64_t m_frame_count;
+		std::atomic<uint64_t> m_remove_count;
+		Vector<FramePools> m_frame_pools;
+		Vector<VkDescriptorPool> m_cache_pools;
+		Map<uint64_t, Vector<CacheEntry*>> m_cache;
+		Map<VkDescriptorSet, CacheEntry*> m_cache_sets;
+		DescriptorStats m_stats;
+		DescriptorStats m_frame_stats;
+	};
+}
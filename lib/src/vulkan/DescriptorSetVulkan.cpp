@@ -0,0 +1,100 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "DescriptorSetVulkan.h"
+#include "DisplayVulkan.h"
+#include "graphics/Graphics.h"
+
+#if VR_VULKAN
+
+namespace Viry3D
+{
+	DescriptorSetVulkan::~DescriptorSetVulkan()
+	{
+		this->ReleaseCachedSet();
+	}
+
+	void DescriptorSetVulkan::ReleaseCachedSet()
+	{
+		if (set == VK_NULL_HANDLE || frame_set)
+		{
+			return;
+		}
+
+		auto display = (DisplayVulkan*) Graphics::GetDisplay();
+		VkDescriptorSet cached_set = set;
+		display->DestroyDeferred([=]() {
+			auto allocator = display->GetDescriptorAllocator();
+			if (allocator)
+			{
+				allocator->ReleaseCachedSet(cached_set);
+			}
+		});
+	}
+
+	void DescriptorSetVulkan::Update(const DescriptorKey& key)
+	{
+		auto display = (DisplayVulkan*) Graphics::GetDisplay();
+		auto allocator = display->GetDescriptorAllocator();
+		uint64_t frame_count = allocator->GetFrameCount();
+
+		bool changed = set == VK_NULL_HANDLE || key != this->key;
+		if (!changed && !frame_set && remove_count != allocator->GetRemoveCount())
+		{
+			// a resource of the cached set was destroyed, same key now names its successor
+			remove_count = allocator->GetRemoveCount();
+			if (allocator->IsRemoved(set))
+			{
+				changed = true;
+			}
+		}
+		if (!changed)
+		{
+			// frame sets are gone with the frame, refill on first update of the next one
+			if (!frame_set || frame == frame_count)
+			{
+				return;
+			}
+		}
+
+		// bindings changed last frame too, no other owner would share the set
+		bool dynamic = changed && set != VK_NULL_HANDLE && changed_frame + 1 >= frame_count;
+
+		this->ReleaseCachedSet();
+
+		if (dynamic)
+		{
+			set = allocator->AllocateFrameSet(key, display->GetFrameIndex());
+			frame_set = true;
+			frame = frame_count;
+		}
+		else
+		{
+			remove_count = allocator->GetRemoveCount();
+			set = allocator->AcquireCachedSet(key);
+			frame_set = false;
+		}
+
+		if (changed)
+		{
+			this->key = key;
+			changed_frame = frame_count;
+		}
+	}
+}
+
+#endif
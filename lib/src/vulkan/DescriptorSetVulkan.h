@@ -19,12 +19,40 @@
 
 #include "vulkan_include.h"
 #include "graphics/DescriptorSet.h"
+#include "BufferVulkan.h"
+#include "DescriptorAllocatorVulkan.h"
 
 namespace Viry3D
 {
 	class DescriptorSetVulkan: public DescriptorSet
 	{
 	public:
+		DescriptorSetVulkan():
+			set(VK_NULL_HANDLE),
+			buffer(NULL),
+			frame_set(false),
+			frame(0),
+			changed_frame(0),
+			remove_count(0)
+		{
+		}
+		virtual ~DescriptorSetVulkan();
+		//	sets are never written after creation, get another one when bindings changed,
+		//	bindings changing in consecutive frames use frame sets, others share cached sets
+		void Update(const DescriptorKey& key);
+
 		VkDescriptorSet set;
+		// uniform buffer of renderer descriptor set
+		const BufferVulkan* buffer;
+		DescriptorKey key;
+		bool frame_set;
+		// frame the frame set allocated in
+		uint64_t frame;
+		uint64_t changed_frame;
+		// remove count of allocator when cached set was checked last
+		uint64_t remove_count;
+
+	private:
+		void ReleaseCachedSet();
 	};
 }
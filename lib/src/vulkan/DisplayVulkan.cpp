@@ -18,6 +18,8 @@
 #include "DisplayVulkan.h"
 #include "vulkan_check.h"
 #include "vulkan_proc_addr.h"
+#include "ShaderVulkan.h"
+#include "UploadQueueVulkan.h"
 #include "Application.h"
 #include "Debug.h"
 #include "memory/Memory.h"
@@ -25,6 +27,7 @@
 #include "graphics/IndexBuffer.h"
 #include "graphics/Graphics.h"
 #include "thread/Thread.h"
+#include "io/File.h"
 #include "Profiler.h"
 
 #if VR_VULKAN
@@ -37,21 +40,33 @@
 
 namespace Viry3D
 {
+	// secondary command buffer being recorded on this thread
+	static thread_local VkCommandBuffer g_secondary_cmd = NULL;
+	static thread_local int g_secondary_draw_call = 0;
+
 	DisplayVulkan::DisplayVulkan():
 		m_instance(NULL),
 		m_debug_callback(VK_NULL_HANDLE),
 		m_gpu(NULL),
 		m_surface(VK_NULL_HANDLE),
 		m_graphics_queue_index(0),
+		m_transfer_queue_index(UINT32_MAX),
 		m_device(NULL),
 		m_queue(NULL),
+		m_transfer_queue(NULL),
 		m_swap_buffer_index(0),
-		m_image_acquired_semaphore(VK_NULL_HANDLE),
+		m_frames_in_flight(FRAMES_IN_FLIGHT_DEFAULT),
+		m_frame_index(0),
+		m_submit_serial(0),
+		m_completed_serial(0),
 		m_current_draw_cmd(NULL),
+		m_barrier_src_stage(0),
+		m_barrier_dst_stage(0),
+		m_barrier_src_access(0),
+		m_barrier_dst_access(0),
+		m_secondary_contents(false),
 		m_swapchain(VK_NULL_HANDLE),
 		m_cmd_pool(VK_NULL_HANDLE),
-		m_image_cmd_pool(VK_NULL_HANDLE),
-		m_image_cmd_buffer(NULL),
 		m_pipeline_cache(VK_NULL_HANDLE)
 	{
 		Memory::Zero(&m_surface_format, sizeof(m_surface_format));
@@ -60,17 +75,23 @@ namespace Viry3D
 
 	void DisplayVulkan::Deinit()
 	{
-		DestroySizeDependentResources();
+		vkDeviceWaitIdle(m_device);
+		m_upload_queue.reset();
+		m_timer_query.reset();
+		RetireSubmits(true);
 
-		if (m_image_acquired_semaphore != VK_NULL_HANDLE)
-		{
-			vkDestroySemaphore(m_device, m_image_acquired_semaphore, NULL);
-		}
-		for (auto i : m_draw_complete_semaphores)
-		{
-			vkDestroySemaphore(m_device, i, NULL);
-		}
-		m_draw_complete_semaphores.Clear();
+		m_pixels_requests.Clear();
+		ReadPixelsReadbacks(true);
+
+		SavePipelineCache();
+		vkDestroyPipelineCache(m_device, m_pipeline_cache, NULL);
+
+		DestroySizeDependentResources();
+		RetireSubmits(true);
+		DestroyFrames();
+		DestroyRecordThreads();
+		m_descriptor_allocator.reset();
+		m_memory_allocator.reset();
 
 		fpDestroySwapchainKHR(m_device, m_swapchain, NULL);
 		vkDestroyDevice(m_device, NULL);
@@ -82,15 +103,12 @@ namespace Viry3D
 
 	void DisplayVulkan::DestroySizeDependentResources()
 	{
-		vkDestroyPipelineCache(m_device, m_pipeline_cache, NULL);
 		m_depth_texture.reset();
 		for (int i = 0; i < m_swapchain_buffers.Size(); i++)
 		{
 			vkDestroyImageView(m_device, m_swapchain_buffers[i].image_view, NULL);
 		}
 		m_swapchain_buffers.Clear();
-		vkFreeCommandBuffers(m_device, m_image_cmd_pool, 1, &m_image_cmd_buffer);
-		vkDestroyCommandPool(m_device, m_image_cmd_pool, NULL);
 		vkDestroyCommandPool(m_device, m_cmd_pool, NULL);
 	}
 
@@ -113,17 +131,49 @@ namespace Viry3D
 		this->CreateSurface();
 
 		m_graphics_queue_index = check_queue(m_gpu, m_surface);
+		m_transfer_queue_index = check_transfer_queue(m_gpu);
 		m_surface_format = check_surface_format(m_gpu, m_surface);
 
 		this->CreateDevice();
 		get_device_proc_addrs(m_instance, m_device);
 
 		vkGetDeviceQueue(m_device, m_graphics_queue_index, 0, &m_queue);
+		if (m_transfer_queue_index != UINT32_MAX)
+		{
+			vkGetDeviceQueue(m_device, m_transfer_queue_index, 0, &m_transfer_queue);
+		}
 		vkGetPhysicalDeviceMemoryProperties(m_gpu, &m_memory_properties);
 		vkGetPhysicalDeviceProperties(m_gpu, &m_device_properties);
 
 		m_device_name = m_device_properties.deviceName;
 
+		m_memory_allocator = RefMake<MemoryAllocatorVulkan>(m_device, m_memory_properties, m_frames_in_flight);
+		m_descriptor_allocator = RefMake<DescriptorAllocatorVulkan>(m_device, m_frames_in_flight);
+		m_upload_queue = RefMake<UploadQueueVulkan>(
+			m_device,
+			m_queue,
+			m_graphics_queue_index,
+			&m_mutex,
+			m_transfer_queue,
+			m_transfer_queue_index);
+
+		Log("vulkan transfer queue: %s", m_transfer_queue ? "dedicated" : "graphics");
+
+		uint32_t queue_count = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(m_gpu, &queue_count, NULL);
+		Vector<VkQueueFamilyProperties> queue_props(queue_count);
+		vkGetPhysicalDeviceQueueFamilyProperties(m_gpu, &queue_count, &queue_props[0]);
+		m_timer_query = RefMake<TimerQueryVulkan>(
+			m_device,
+			m_frames_in_flight,
+			queue_props[m_graphics_queue_index].timestampValidBits,
+			m_device_properties.limits.timestampPeriod);
+
+		Log("vulkan timestamps: %s", m_timer_query->IsSupported() ? "supported" : "not supported");
+
+		this->CreateFrames();
+		this->CreateRecordThreads();
+		this->CreatePipelineCache();
 		this->CreateSizeDependentResources();
 
 		Log("display vulkan init success");
@@ -137,6 +187,7 @@ namespace Viry3D
 		}
 
 		vkDeviceWaitIdle(m_device);
+		RetireSubmits(true);
 
 		m_width = width;
 		m_height = height;
@@ -149,6 +200,8 @@ namespace Viry3D
 		vkDestroySurfaceKHR(m_instance, m_surface, NULL);
 		m_surface = VK_NULL_HANDLE;
 
+		VkFormat old_format = m_surface_format.format;
+
 		this->CreateSurface();
 
 		m_graphics_queue_index = check_queue(m_gpu, m_surface);
@@ -157,6 +210,12 @@ namespace Viry3D
 		vkGetDeviceQueue(m_device, m_graphics_queue_index, 0, &m_queue);
 
 		this->CreateSizeDependentResources();
+
+		// pipelines do not depend on surface size, only rebuild when format changed
+		if (m_surface_format.format != old_format)
+		{
+			ShaderVulkan::RebuildPipelinesAsync(old_format, m_surface_format.format);
+		}
 	}
 
 	void DisplayVulkan::OnPause()
@@ -164,6 +223,10 @@ namespace Viry3D
 		Log("DisplayVulkan::OnPause");
 
 		vkDeviceWaitIdle(m_device);
+		RetireSubmits(true);
+
+		// app may be killed in background
+		SavePipelineCache();
 
 		DestroySizeDependentResources();
 
@@ -178,6 +241,8 @@ namespace Viry3D
 	{
 		Log("DisplayVulkan::OnResume");
 
+		VkFormat old_format = m_surface_format.format;
+
 		this->CreateSurface();
 
 		m_graphics_queue_index = check_queue(m_gpu, m_surface);
@@ -186,6 +251,12 @@ namespace Viry3D
 		vkGetDeviceQueue(m_device, m_graphics_queue_index, 0, &m_queue);
 
 		this->CreateSizeDependentResources();
+
+		// pipelines do not depend on surface size, only rebuild when format changed
+		if (m_surface_format.format != old_format)
+		{
+			ShaderVulkan::RebuildPipelinesAsync(old_format, m_surface_format.format);
+		}
 	}
 
 	void DisplayVulkan::CreateInstance()
@@ -337,14 +408,25 @@ namespace Viry3D
 		VkResult err;
 
 		float queue_priorities[1] = { 1.0f };
-		VkDeviceQueueCreateInfo queue = {
-			VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-			NULL,
-			0,
-			m_graphics_queue_index,
-			1,
-			queue_priorities
+		VkDeviceQueueCreateInfo queues[2] = {
+			{
+				VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+				NULL,
+				0,
+				m_graphics_queue_index,
+				1,
+				queue_priorities
+			},
+			{
+				VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+				NULL,
+				0,
+				m_transfer_queue_index,
+				1,
+				queue_priorities
+			},
 		};
+		uint32_t queue_count = m_transfer_queue_index != UINT32_MAX ? 2 : 1;
 
 		uint32_t extension_count = 1;
 		const char* extension_names[] = { "VK_KHR_swapchain" };
@@ -353,8 +435,8 @@ namespace Viry3D
 			VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
 			NULL,
 			0,
-			1,
-			&queue,
+			queue_count,
+			queues,
 			0,
 			NULL,
 			extension_count,
@@ -371,7 +453,6 @@ namespace Viry3D
 		this->CreateSwapchain();
 		this->CreateCommandPool();
 		this->CreateSwapchainBuffers();
-		this->CreateImageCommandBuffer();
 
 		m_depth_texture = RenderTexture::Create(
 			m_width, m_height,
@@ -379,8 +460,6 @@ namespace Viry3D
 			DepthBuffer::Depth_24_Stencil_8,
 			FilterMode::Point);
 
-		this->CreatePipelineCache();
-
 		m_swap_buffer_index = 0;
 	}
 
@@ -522,75 +601,10 @@ namespace Viry3D
 		};
 		err = vkCreateCommandPool(m_device, &cmd_pool_info, NULL, &m_cmd_pool);
 		assert(!err);
-
-		err = vkCreateCommandPool(m_device, &cmd_pool_info, NULL, &m_image_cmd_pool);
-		assert(!err);
-	}
-
-	void DisplayVulkan::CreateImageCommandBuffer()
-	{
-		VkResult err;
-
-		VkCommandBufferAllocateInfo cmd_info = {
-			VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-			NULL,
-			m_image_cmd_pool,
-			VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-			1,
-		};
-
-		err = vkAllocateCommandBuffers(m_device, &cmd_info, &m_image_cmd_buffer);
-		assert(!err);
-	}
-
-	void DisplayVulkan::BeginImageCommandBuffer()
-	{
-		VkResult err;
-
-		m_mutex.lock();
-
-		VkCommandBufferBeginInfo cmd_buf_info;
-		cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		cmd_buf_info.pNext = NULL;
-		cmd_buf_info.flags = 0;
-		cmd_buf_info.pInheritanceInfo = NULL;
-
-		err = vkBeginCommandBuffer(m_image_cmd_buffer, &cmd_buf_info);
-		assert(!err);
-	}
-
-	void DisplayVulkan::EndImageCommandBuffer()
-	{
-		VkResult err;
-
-		err = vkEndCommandBuffer(m_image_cmd_buffer);
-		assert(!err);
-
-		VkCommandBuffer cmd_bufs[] = { m_image_cmd_buffer };
-		VkFence nullFence = VK_NULL_HANDLE;
-
-		VkSubmitInfo submit_info;
-		Memory::Zero(&submit_info, sizeof(submit_info));
-		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submit_info.pNext = NULL;
-		submit_info.waitSemaphoreCount = 0;
-		submit_info.pWaitSemaphores = NULL;
-		submit_info.pWaitDstStageMask = NULL;
-		submit_info.commandBufferCount = 1;
-		submit_info.pCommandBuffers = cmd_bufs;
-		submit_info.signalSemaphoreCount = 0;
-		submit_info.pSignalSemaphores = NULL;
-
-		err = vkQueueSubmit(m_queue, 1, &submit_info, nullFence);
-		assert(!err);
-
-		err = vkQueueWaitIdle(m_queue);
-		assert(!err);
-
-		m_mutex.unlock();
 	}
 
 	void DisplayVulkan::SetImageLayout(
+		VkCommandBuffer cmd,
 		VkImage image,
 		VkImageAspectFlags aspect_mask,
 		VkImageLayout old_image_layout,
@@ -645,21 +659,104 @@ namespace Viry3D
 				VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
 		}
 
-		VkPipelineStageFlags src_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		VkPipelineStageFlags dest_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		// uploads are no longer separated by queue idle, order against all commands before and after,
+		// all commands is also the only wide stage valid on a transfer queue
+		VkPipelineStageFlags src_stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkPipelineStageFlags dest_stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
 
-		vkCmdPipelineBarrier(m_image_cmd_buffer, src_stages, dest_stages, 0, 0, NULL, 0, NULL, 1, &image_memory_barrier);
+		vkCmdPipelineBarrier(cmd, src_stages, dest_stages, 0, 0, NULL, 0, NULL, 1, &image_memory_barrier);
+	}
+
+	static String get_pipeline_cache_path()
+	{
+		return Application::SavePath() + "/pipeline.cache";
+	}
+
+	static bool check_pipeline_cache(const ByteBuffer& data, const VkPhysicalDeviceProperties& properties)
+	{
+		struct PipelineCacheHeader
+		{
+			uint32_t header_size;
+			uint32_t header_version;
+			uint32_t vendor_id;
+			uint32_t device_id;
+			uint8_t uuid[VK_UUID_SIZE];
+		};
+
+		PipelineCacheHeader header;
+		if (data.Size() < (int) sizeof(header))
+		{
+			return false;
+		}
+
+		Memory::Copy(&header, data.Bytes(), sizeof(header));
+
+		// data from another gpu or driver is ignored by some drivers and crashes others
+		return header.header_size >= sizeof(header) &&
+			header.header_size <= (uint32_t) data.Size() &&
+			header.header_version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			header.vendor_id == properties.vendorID &&
+			header.device_id == properties.deviceID &&
+			Memory::Compare(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
 	}
 
 	void DisplayVulkan::CreatePipelineCache()
 	{
+		String path = get_pipeline_cache_path();
+		ByteBuffer data;
+
+		if (File::Exist(path))
+		{
+			data = File::ReadAllBytes(path);
+
+			if (!check_pipeline_cache(data, m_device_properties))
+			{
+				Log("pipeline cache not match device, discard: %s", path.CString());
+				File::Delete(path);
+				data = ByteBuffer();
+			}
+		}
+
 		VkPipelineCacheCreateInfo pipeline_cache;
 		Memory::Zero(&pipeline_cache, sizeof(pipeline_cache));
 		pipeline_cache.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		pipeline_cache.initialDataSize = data.Size();
+		pipeline_cache.pInitialData = data.Size() > 0 ? data.Bytes() : NULL;
 
 		VkResult err;
 		err = vkCreatePipelineCache(m_device, &pipeline_cache, NULL, &m_pipeline_cache);
+		if (err && data.Size() > 0)
+		{
+			Log("pipeline cache rejected by driver: %s", path.CString());
+			File::Delete(path);
+
+			pipeline_cache.initialDataSize = 0;
+			pipeline_cache.pInitialData = NULL;
+			err = vkCreatePipelineCache(m_device, &pipeline_cache, NULL, &m_pipeline_cache);
+		}
 		assert(!err);
+
+		if (data.Size() > 0)
+		{
+			Log("pipeline cache loaded: %d bytes", data.Size());
+		}
+	}
+
+	void DisplayVulkan::SavePipelineCache()
+	{
+		size_t size = 0;
+		VkResult err = vkGetPipelineCacheData(m_device, m_pipeline_cache, &size, NULL);
+		if (err == VK_SUCCESS && size > 0)
+		{
+			ByteBuffer data((int) size);
+			err = vkGetPipelineCacheData(m_device, m_pipeline_cache, &size, data.Bytes());
+			if (err == VK_SUCCESS)
+			{
+				File::WriteAllBytes(get_pipeline_cache_path(), data);
+			}
+		}
+
+		ShaderVulkan::SavePipelineManifest();
 	}
 
 	bool DisplayVulkan::CheckMemoryType(
@@ -702,39 +799,333 @@ namespace Viry3D
 		return module;
 	}
 
-	void DisplayVulkan::BeginFrame()
+	void DisplayVulkan::CreateFrames()
 	{
-		VkResult err;
+		VkSemaphoreCreateInfo semaphore = {
+			VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+			NULL,
+			0,
+		};
 
-		Profiler::SampleBegin("DisplayVulkan::BeginFrame");
+		m_frames.Resize(m_frames_in_flight);
+		for (auto& i : m_frames)
+		{
+			VkResult err = vkCreateSemaphore(m_device, &semaphore, NULL, &i.image_acquired_semaphore);
+			assert(!err);
 
-		m_mutex.lock();
+			i.draw_complete_count = 0;
+			i.submit_serial = 0;
+		}
+		m_frame_index = 0;
+	}
+
+	void DisplayVulkan::DestroyFrames()
+	{
+		for (auto& i : m_frames)
+		{
+			vkDestroySemaphore(m_device, i.image_acquired_semaphore, NULL);
+			for (auto j : i.draw_complete_semaphores)
+			{
+				vkDestroySemaphore(m_device, j, NULL);
+			}
+		}
+		m_frames.Clear();
 
-		if (m_image_acquired_semaphore != VK_NULL_HANDLE)
+		for (const auto& i : m_submits)
 		{
-			vkDestroySemaphore(m_device, m_image_acquired_semaphore, NULL);
+			vkDestroyFence(m_device, i.fence, NULL);
 		}
-		for (auto i : m_draw_complete_semaphores)
+		m_submits.Clear();
+		for (auto i : m_free_fences)
 		{
-			vkDestroySemaphore(m_device, i, NULL);
+			vkDestroyFence(m_device, i, NULL);
 		}
-		m_draw_complete_semaphores.Clear();
+		m_free_fences.Clear();
+	}
 
-		VkSemaphoreCreateInfo semaphore = {
-			VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+	void DisplayVulkan::RetireSubmits(bool all)
+	{
+		Vector<Action> destroys;
+
+		m_submit_mutex.lock();
+
+		while (!m_submits.Empty())
+		{
+			auto& submit = m_submits.First();
+			if (!all && vkGetFenceStatus(m_device, submit.fence) != VK_SUCCESS)
+			{
+				break;
+			}
+
+			vkResetFences(m_device, 1, &submit.fence);
+			m_free_fences.Add(submit.fence);
+			m_completed_serial = submit.serial;
+			m_submits.RemoveFirst();
+		}
+
+		while (!m_deferred_destroys.Empty())
+		{
+			auto& destroy = m_deferred_destroys.First();
+			if (!all && destroy.serial > m_completed_serial)
+			{
+				break;
+			}
+
+			destroys.Add(destroy.destroy);
+			m_deferred_destroys.RemoveFirst();
+		}
+
+		m_submit_mutex.unlock();
+
+		for (const auto& i : destroys)
+		{
+			i();
+		}
+	}
+
+	void DisplayVulkan::WaitSubmit(uint64_t serial)
+	{
+		if (serial <= m_completed_serial)
+		{
+			return;
+		}
+
+		// cpu stalls on gpu show up in profiler under this sample
+		Profiler::SampleBegin("DisplayVulkan::WaitSubmit");
+		m_submit_mutex.lock();
+		for (const auto& i : m_submits)
+		{
+			if (i.serial > serial)
+			{
+				break;
+			}
+
+			VkResult err = vkWaitForFences(m_device, 1, &i.fence, VK_TRUE, UINT64_MAX);
+			assert(!err);
+		}
+		m_submit_mutex.unlock();
+		Profiler::SampleEnd();
+
+		RetireSubmits(false);
+	}
+
+	void DisplayVulkan::WaitCommandBuffer(VkCommandBuffer cmd)
+	{
+		uint64_t serial = 0;
+
+		m_submit_mutex.lock();
+		uint64_t* find;
+		if (m_cmd_serials.TryGet(cmd, &find))
+		{
+			serial = *find;
+		}
+		m_submit_mutex.unlock();
+
+		this->WaitSubmit(serial);
+	}
+
+	void DisplayVulkan::DestroyDeferred(Action destroy)
+	{
+		m_submit_mutex.lock();
+		m_deferred_destroys.AddLast({ this->GetRecordingSerial(), destroy });
+		m_submit_mutex.unlock();
+	}
+
+	void DisplayVulkan::FreeCommandBufferDeferred(VkCommandBuffer cmd)
+	{
+		m_submit_mutex.lock();
+		m_cmd_serials.Remove(cmd);
+		m_submit_mutex.unlock();
+
+		VkDevice device = m_device;
+		VkCommandPool cmd_pool = m_cmd_pool;
+		this->DestroyDeferred([=]() {
+			vkFreeCommandBuffers(device, cmd_pool, 1, &cmd);
+		});
+	}
+
+	void DisplayVulkan::CreateRecordThreads()
+	{
+		int thread_count = (int) std::thread::hardware_concurrency() - 1;
+		if (thread_count > RECORD_THREAD_MAX)
+		{
+			thread_count = RECORD_THREAD_MAX;
+		}
+		if (thread_count < 2)
+		{
+			return;
+		}
+
+		m_record_threads = RefMake<ThreadPool>(thread_count);
+
+		VkCommandPoolCreateInfo cmd_pool_info = {
+			VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
 			NULL,
-			0,
+			VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+			m_graphics_queue_index,
 		};
-		err = vkCreateSemaphore(m_device, &semaphore, NULL, &m_image_acquired_semaphore);
-		assert(!err);
+
+		m_thread_data.Resize(m_frames.Size() * thread_count);
+		for (auto& i : m_thread_data)
+		{
+			VkResult err = vkCreateCommandPool(m_device, &cmd_pool_info, NULL, &i.cmd_pool);
+			assert(!err);
+
+			i.cmd_used = 0;
+		}
+	}
+
+	void DisplayVulkan::DestroyRecordThreads()
+	{
+		m_record_threads.reset();
+
+		for (auto& i : m_thread_data)
+		{
+			if (i.cmd.Size() > 0)
+			{
+				vkFreeCommandBuffers(m_device, i.cmd_pool, i.cmd.Size(), &i.cmd[0]);
+			}
+			vkDestroyCommandPool(m_device, i.cmd_pool, NULL);
+		}
+		m_thread_data.Clear();
+	}
+
+	int DisplayVulkan::GetRecordThreadCount() const
+	{
+		if (m_record_threads)
+		{
+			return m_record_threads->GetThreadCount();
+		}
+
+		return 0;
+	}
+
+	VkCommandBuffer DisplayVulkan::GetSecondaryCommandBuffer(int thread_index)
+	{
+		// pools of a thread are only touched by that thread while recording
+		auto& data = m_thread_data[m_frame_index * this->GetRecordThreadCount() + thread_index];
+
+		if (data.cmd_used == data.cmd.Size())
+		{
+			VkCommandBufferAllocateInfo cmd_info = {
+				VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+				NULL,
+				data.cmd_pool,
+				VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+				1,
+			};
+
+			VkCommandBuffer cmd;
+			VkResult err = vkAllocateCommandBuffers(m_device, &cmd_info, &cmd);
+			assert(!err);
+
+			data.cmd.Add(cmd);
+		}
+
+		return data.cmd[data.cmd_used++];
+	}
+
+	void DisplayVulkan::RecordSecondaryCommandBuffers(const Vector<Action>& jobs, const VkCommandBufferInheritanceInfo& inheritance)
+	{
+		int thread_count = this->GetRecordThreadCount();
+		Vector<VkCommandBuffer> cmds(jobs.Size());
+		Vector<int> draw_calls(jobs.Size());
+
+		for (int i = 0; i < thread_count; i++)
+		{
+			m_record_threads->AddTask({
+				[&, i]() {
+					VkCommandBufferBeginInfo cmd_buf_info = {
+						VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+						NULL,
+						VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+						&inheritance,
+					};
+
+					// interleave jobs so each thread gets a share of costly and cheap ones
+					for (int j = i; j < jobs.Size(); j += thread_count)
+					{
+						VkCommandBuffer cmd = this->GetSecondaryCommandBuffer(i);
+						VkResult err = vkBeginCommandBuffer(cmd, &cmd_buf_info);
+						assert(!err);
+
+						g_secondary_cmd = cmd;
+						g_secondary_draw_call = 0;
+
+						jobs[j]();
+
+						g_secondary_cmd = NULL;
+
+						err = vkEndCommandBuffer(cmd);
+						assert(!err);
+
+						cmds[j] = cmd;
+						draw_calls[j] = g_secondary_draw_call;
+					}
+
+					return Ref<Any>();
+				},
+				nullptr
+			}, i);
+		}
+		m_record_threads->Wait();
+
+		if (cmds.Size() > 0)
+		{
+			vkCmdExecuteCommands(m_current_draw_cmd, cmds.Size(), &cmds[0]);
+		}
+
+		for (auto i : draw_calls)
+		{
+			Graphics::draw_call += i;
+		}
+	}
+
+	void DisplayVulkan::BeginFrame()
+	{
+		VkResult err;
+
+		Profiler::SampleBegin("DisplayVulkan::BeginFrame");
+
+		// wait until gpu finished the frame used this slot before
+		m_frame_index = (m_frame_index + 1) % m_frames.Size();
+		auto& frame = m_frames[m_frame_index];
+		this->WaitSubmit(frame.submit_serial);
+
+		Vector<double> timestamps;
+		bool timestamps_read = m_timer_query->BeginFrame(m_frame_index, timestamps);
+		Profiler::OnGPUFrameBegin(m_frame_index, timestamps_read ? &timestamps : NULL);
+
+		// descriptor sets written with a retired uniform ring must not match a new buffer
+		auto descriptor_allocator = m_descriptor_allocator;
+		this->ReadPixelsReadbacks(false);
+
+		m_memory_allocator->ResetTransient(m_frame_index, [=](VkBuffer buffer) {
+			descriptor_allocator->RemoveBuffer(buffer);
+		});
+		m_descriptor_allocator->ResetFrame(m_frame_index);
+		m_upload_queue->Update();
+
+		int thread_count = this->GetRecordThreadCount();
+		for (int i = 0; i < thread_count; i++)
+		{
+			auto& data = m_thread_data[m_frame_index * thread_count + i];
+			err = vkResetCommandPool(m_device, data.cmd_pool, 0);
+			assert(!err);
+			data.cmd_used = 0;
+		}
+
+		m_mutex.lock();
+
+		frame.draw_complete_count = 0;
 
 		uint32_t swap_buffer_index;
 		err = fpAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX,
-			m_image_acquired_semaphore,
+			frame.image_acquired_semaphore,
 			(VkFence) 0,
 			&swap_buffer_index);
 		assert(!err);
-		assert(m_swap_buffer_index == swap_buffer_index);
+		m_swap_buffer_index = swap_buffer_index;
 
 		m_mutex.unlock();
 
@@ -747,8 +1138,13 @@ namespace Viry3D
 
 		Profiler::SampleBegin("DisplayVulkan::EndFrame");
 
+		// copies are submitted before present waits last draw complete semaphore
+		this->ReadPixelsRequests();
+
 		m_mutex.lock();
 
+		auto& frame = m_frames[m_frame_index];
+
 		VkPresentInfoKHR present;
 		Memory::Zero(&present, sizeof(present));
 		present.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -757,24 +1153,26 @@ namespace Viry3D
 		present.pSwapchains = &m_swapchain;
 		present.pImageIndices = &m_swap_buffer_index;
 		present.waitSemaphoreCount = 1;
-		present.pWaitSemaphores = &m_draw_complete_semaphores[m_draw_complete_semaphores.Size() - 1];
+		if (frame.draw_complete_count > 0)
+		{
+			present.pWaitSemaphores = &frame.draw_complete_semaphores[frame.draw_complete_count - 1];
+		}
+		else
+		{
+			present.pWaitSemaphores = &frame.image_acquired_semaphore;
+		}
 
 		err = fpQueuePresentKHR(m_queue, &present);
 		assert(!err);
 
-		err = vkQueueWaitIdle(m_queue);
-		assert(!err);
-
-		err = vkDeviceWaitIdle(m_device);
-		assert(!err);
+		m_mutex.unlock();
 
-		m_swap_buffer_index++;
-		if (m_swap_buffer_index == m_swapchain_buffers.Size())
-		{
-			m_swap_buffer_index = 0;
-		}
+		// no wait here, release what gpu already finished
+		this->RetireSubmits(false);
 
-		m_mutex.unlock();
+		// uploads recorded without rendering still reach gpu, next frame waits them
+		m_upload_queue->Flush();
+		m_upload_queue->Update();
 
 		Profiler::SampleEnd();
 	}
@@ -782,6 +1180,17 @@ namespace Viry3D
 	void DisplayVulkan::WaitQueueIdle()
 	{
 		vkQueueWaitIdle(m_queue);
+		this->RetireSubmits(false);
+	}
+
+	VkCommandBuffer DisplayVulkan::GetCurrentDrawCommand() const
+	{
+		if (g_secondary_cmd)
+		{
+			return g_secondary_cmd;
+		}
+
+		return m_current_draw_cmd;
 	}
 
 	void DisplayVulkan::BeginPrimaryCommandBuffer(VkCommandBuffer cmd)
@@ -797,75 +1206,189 @@ namespace Viry3D
 
 		VkResult err = vkBeginCommandBuffer(cmd, &cmd_buf_info);
 		assert(!err);
+
+		// queries of frame are reset before first command of frame writes one
+		m_timer_query->ResetFrame(cmd);
+		int timestamp = m_timer_query->Write(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		if (timestamp >= 0)
+		{
+			Profiler::OnGPUCommandBegin(timestamp);
+		}
+
+		if (m_barrier_src_stage != 0)
+		{
+			VkMemoryBarrier barrier = {
+				VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+				NULL,
+				m_barrier_src_access,
+				m_barrier_dst_access,
+			};
+			vkCmdPipelineBarrier(cmd, m_barrier_src_stage, m_barrier_dst_stage, 0, 1, &barrier, 0, NULL, 0, NULL);
+
+			m_barrier_src_stage = 0;
+			m_barrier_dst_stage = 0;
+			m_barrier_src_access = 0;
+			m_barrier_dst_access = 0;
+		}
+	}
+
+	void DisplayVulkan::AddPassBarrier(VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage, VkAccessFlags src_access, VkAccessFlags dst_access)
+	{
+		m_barrier_src_stage |= src_stage;
+		m_barrier_dst_stage |= dst_stage;
+		m_barrier_src_access |= src_access;
+		m_barrier_dst_access |= dst_access;
 	}
 
 	void DisplayVulkan::EndPrimaryCommandBuffer()
 	{
+		int timestamp = m_timer_query->Write(m_current_draw_cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		if (timestamp >= 0)
+		{
+			Profiler::OnGPUCommandEnd(timestamp);
+		}
+
 		VkResult err = vkEndCommandBuffer(m_current_draw_cmd);
 		assert(!err);
 
 		m_current_draw_cmd = NULL;
 	}
 
+	int DisplayVulkan::WriteTimestamp()
+	{
+		VkCommandBuffer cmd = g_secondary_cmd;
+		if (cmd == NULL && !m_secondary_contents)
+		{
+			cmd = m_current_draw_cmd;
+		}
+
+		if (cmd == NULL)
+		{
+			return -1;
+		}
+
+		return m_timer_query->Write(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+	}
+
 	void DisplayVulkan::SubmitQueue(VkCommandBuffer cmd)
 	{
+		VkResult err;
+
+		// textures uploaded before this submit must be resident when it runs
+		m_upload_queue->Flush();
+		VkSemaphore upload_semaphore = m_upload_queue->TakeWaitSemaphore();
+
 		m_mutex.lock();
 
-		VkSemaphoreCreateInfo semaphore = {
-			VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-			NULL,
-			0,
-		};
+		auto& frame = m_frames[m_frame_index];
 
-		VkSemaphore draw_complete_semaphore;
-		VkResult err = vkCreateSemaphore(m_device, &semaphore, NULL, &draw_complete_semaphore);
-		assert(!err);
+		// semaphores of a frame slot are reused after its submits completed
+		if (frame.draw_complete_count == frame.draw_complete_semaphores.Size())
+		{
+			VkSemaphoreCreateInfo semaphore = {
+				VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+				NULL,
+				0,
+			};
 
-		VkPipelineStageFlags pipe_stage_flags = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+			VkSemaphore draw_complete_semaphore;
+			err = vkCreateSemaphore(m_device, &semaphore, NULL, &draw_complete_semaphore);
+			assert(!err);
 
-		VkSubmitInfo submit_info;
-		Memory::Zero(&submit_info, sizeof(submit_info));
-		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submit_info.pNext = NULL;
-		submit_info.waitSemaphoreCount = 1;
-		if (m_draw_complete_semaphores.Empty())
+			frame.draw_complete_semaphores.Add(draw_complete_semaphore);
+		}
+
+		// passes are no longer separated by queue idle, so chained passes wait on all commands
+		// of previous pass, render texture written by it may be sampled
+		VkSemaphore wait_semaphores[2];
+		VkPipelineStageFlags pipe_stage_flags[2];
+		uint32_t wait_count = 1;
+		if (frame.draw_complete_count == 0)
 		{
-			submit_info.pWaitSemaphores = &m_image_acquired_semaphore;
+			wait_semaphores[0] = frame.image_acquired_semaphore;
+			pipe_stage_flags[0] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		}
 		else
 		{
-			submit_info.pWaitSemaphores = &m_draw_complete_semaphores[m_draw_complete_semaphores.Size() - 1];
+			wait_semaphores[0] = frame.draw_complete_semaphores[frame.draw_complete_count - 1];
+			pipe_stage_flags[0] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		}
+		if (upload_semaphore)
+		{
+			wait_semaphores[wait_count] = upload_semaphore;
+			pipe_stage_flags[wait_count] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			wait_count++;
 		}
-		submit_info.pWaitDstStageMask = &pipe_stage_flags;
+		VkSemaphore signal_semaphore = frame.draw_complete_semaphores[frame.draw_complete_count];
+
+		VkSubmitInfo submit_info;
+		Memory::Zero(&submit_info, sizeof(submit_info));
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.pNext = NULL;
+		submit_info.waitSemaphoreCount = wait_count;
+		submit_info.pWaitSemaphores = wait_semaphores;
+		submit_info.pWaitDstStageMask = pipe_stage_flags;
 		submit_info.commandBufferCount = 1;
 		submit_info.pCommandBuffers = &cmd;
 		submit_info.signalSemaphoreCount = 1;
-		submit_info.pSignalSemaphores = &draw_complete_semaphore;
+		submit_info.pSignalSemaphores = &signal_semaphore;
 
-		err = vkQueueSubmit(m_queue, 1, &submit_info, VK_NULL_HANDLE);
-		assert(!err);
+		m_submit_mutex.lock();
 
-		err = vkQueueWaitIdle(m_queue);
-		assert(!err);
+		VkFence fence;
+		if (m_free_fences.Size() > 0)
+		{
+			fence = m_free_fences[m_free_fences.Size() - 1];
+			m_free_fences.Remove(m_free_fences.Size() - 1);
+		}
+		else
+		{
+			VkFenceCreateInfo fence_info;
+			Memory::Zero(&fence_info, sizeof(fence_info));
+			fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 
-		err = vkDeviceWaitIdle(m_device);
+			err = vkCreateFence(m_device, &fence_info, NULL, &fence);
+			assert(!err);
+		}
+
+		err = vkQueueSubmit(m_queue, 1, &submit_info, fence);
 		assert(!err);
 
-		m_draw_complete_semaphores.Add(draw_complete_semaphore);
+		m_submit_serial++;
+		m_submits.AddLast({ m_submit_serial, fence });
+		m_cmd_serials[cmd] = m_submit_serial;
+		frame.submit_serial = m_submit_serial;
+		frame.draw_complete_count++;
+
+		m_submit_mutex.unlock();
 
 		m_mutex.unlock();
+
+		if (upload_semaphore)
+		{
+			VkDevice device = m_device;
+			this->DestroyDeferred([=]() {
+				vkDestroySemaphore(device, upload_semaphore, NULL);
+			});
+		}
 	}
 
-	void DisplayVulkan::BindVertexBuffer(const VertexBuffer* buffer)
+	void DisplayVulkan::BindVertexArray(const VertexBuffer* vertex_buffer, const IndexBuffer* index_buffer, IndexType index_type, const Ref<Shader>& shader, int pass_index, int vertex_version, int index_version)
+	{
+		this->BindVertexBuffer(vertex_buffer, vertex_version);
+		this->BindIndexBuffer(index_buffer, index_type, index_version);
+	}
+
+	void DisplayVulkan::BindVertexBuffer(const VertexBuffer* buffer, int version)
 	{
 		VkBuffer buf = buffer->GetBuffer();
-		VkDeviceSize offsets[1] = { 0 };
+		VkDeviceSize offsets[1] = { buffer->MarkGpuRead(version) };
 		VkCommandBuffer cmd = GetCurrentDrawCommand();
 
 		vkCmdBindVertexBuffers(cmd, 0, 1, &buf, offsets);
 	}
 
-	void DisplayVulkan::BindIndexBuffer(const IndexBuffer* buffer, IndexType index_type)
+	void DisplayVulkan::BindIndexBuffer(const IndexBuffer* buffer, IndexType index_type, int version)
 	{
 		VkIndexType type;
 		VkCommandBuffer cmd = GetCurrentDrawCommand();
@@ -879,7 +1402,9 @@ namespace Viry3D
 			type = VK_INDEX_TYPE_UINT32;
 		}
 
-		vkCmdBindIndexBuffer(cmd, buffer->GetBuffer(), 0, type);
+		VkDeviceSize offset = buffer->MarkGpuRead(version);
+
+		vkCmdBindIndexBuffer(cmd, buffer->GetBuffer(), offset, type);
 	}
 
 	void DisplayVulkan::DrawIndexed(int start, int count, IndexType index_type)
@@ -888,7 +1413,211 @@ namespace Viry3D
 
 		vkCmdDrawIndexed(cmd, count, 1, start, 0, 0);
 
-		Graphics::draw_call++;
+		if (g_secondary_cmd)
+		{
+			g_secondary_draw_call++;
+		}
+		else
+		{
+			Graphics::draw_call++;
+		}
+	}
+
+	void DisplayVulkan::ReadPixelsAsync(const Ref<RenderTexture>& texture, ReadPixelsComplete complete)
+	{
+		PixelsReadback readback;
+		readback.texture = texture;
+		readback.complete = complete;
+		readback.buffer = VK_NULL_HANDLE;
+		Memory::Zero(&readback.memory, sizeof(readback.memory));
+		readback.serial = 0;
+		readback.width = texture ? texture->GetWidth() : m_width;
+		readback.height = texture ? texture->GetHeight() : m_height;
+		readback.bgra = false;
+
+		m_pixels_mutex.lock();
+		m_pixels_requests.Add(readback);
+		m_pixels_mutex.unlock();
+	}
+
+	void DisplayVulkan::ReadPixelsRequests()
+	{
+		m_pixels_mutex.lock();
+		Vector<PixelsReadback> requests = m_pixels_requests;
+		m_pixels_requests.Clear();
+		m_pixels_mutex.unlock();
+
+		if (requests.Empty())
+		{
+			return;
+		}
+
+		VkResult err;
+		auto& frame = m_frames[m_frame_index];
+
+		VkCommandBufferAllocateInfo cmd_info = {
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			NULL,
+			m_cmd_pool,
+			VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			1,
+		};
+
+		VkCommandBuffer cmd;
+		err = vkAllocateCommandBuffers(m_device, &cmd_info, &cmd);
+		assert(!err);
+
+		VkCommandBufferBeginInfo cmd_buf_info = {
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			NULL,
+			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			NULL,
+		};
+
+		err = vkBeginCommandBuffer(cmd, &cmd_buf_info);
+		assert(!err);
+
+		for (auto& i : requests)
+		{
+			VkImage image;
+			VkFormat format;
+			VkImageLayout layout;
+			if (i.texture)
+			{
+				if (i.texture->GetFormat() != RenderTextureFormat::RGBA32)
+				{
+					Log("read pixels supports RGBA32 render texture only");
+					continue;
+				}
+
+				image = i.texture->GetImage();
+				format = i.texture->GetVkFormat();
+				layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			}
+			else
+			{
+				// back buffer is only in present layout after a pass drew to it
+				if (frame.draw_complete_count == 0)
+				{
+					continue;
+				}
+
+				image = m_swapchain_buffers[m_swap_buffer_index].image;
+				format = m_surface_format.format;
+				layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+			}
+
+			VkBufferCreateInfo buf_info;
+			Memory::Zero(&buf_info, sizeof(buf_info));
+			buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			buf_info.size = i.width * i.height * 4;
+			buf_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+			err = vkCreateBuffer(m_device, &buf_info, NULL, &i.buffer);
+			assert(!err);
+
+			VkMemoryRequirements mem_reqs;
+			vkGetBufferMemoryRequirements(m_device, i.buffer, &mem_reqs);
+
+			uint32_t type_index = 0;
+			bool pass = this->CheckMemoryType(
+				mem_reqs.memoryTypeBits,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&type_index);
+			assert(pass);
+
+			pass = m_memory_allocator->Allocate(mem_reqs, type_index, true, &i.memory);
+			assert(pass);
+
+			err = vkBindBufferMemory(m_device, i.buffer, i.memory.memory, i.memory.offset);
+			assert(!err);
+
+			this->SetImageLayout(cmd, image, VK_IMAGE_ASPECT_COLOR_BIT, layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+
+			VkBufferImageCopy region;
+			Memory::Zero(&region, sizeof(region));
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent.width = i.width;
+			region.imageExtent.height = i.height;
+			region.imageExtent.depth = 1;
+
+			vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, i.buffer, 1, &region);
+
+			this->SetImageLayout(cmd, image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout, VK_ACCESS_TRANSFER_READ_BIT);
+
+			i.bgra = format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+		}
+
+		err = vkEndCommandBuffer(cmd);
+		assert(!err);
+
+		// render thread is the only one submitting while frame renders
+		uint64_t serial = this->GetRecordingSerial();
+		this->SubmitQueue(cmd);
+		this->FreeCommandBufferDeferred(cmd);
+
+		m_pixels_mutex.lock();
+		for (auto& i : requests)
+		{
+			i.serial = serial;
+			m_pixels_readbacks.Add(i);
+		}
+		m_pixels_mutex.unlock();
+	}
+
+	void DisplayVulkan::ReadPixelsReadbacks(bool all)
+	{
+		Vector<PixelsReadback> completes;
+
+		m_pixels_mutex.lock();
+		for (int i = 0; i < m_pixels_readbacks.Size(); i++)
+		{
+			if (all || m_pixels_readbacks[i].serial <= m_completed_serial)
+			{
+				completes.Add(m_pixels_readbacks[i]);
+				m_pixels_readbacks.Remove(i);
+				i--;
+			}
+		}
+		m_pixels_mutex.unlock();
+
+		for (auto& i : completes)
+		{
+			ByteBuffer pixels;
+			if (i.buffer != VK_NULL_HANDLE)
+			{
+				if (!all)
+				{
+					pixels = ByteBuffer(i.width * i.height * 4);
+					Memory::Copy(pixels.Bytes(), i.memory.mapped, pixels.Size());
+
+					for (int j = 0; j < pixels.Size(); j += 4)
+					{
+						if (i.bgra)
+						{
+							byte b = pixels[j];
+							pixels[j] = pixels[j + 2];
+							pixels[j + 2] = b;
+						}
+
+						// back buffer alpha is whatever blending left
+						if (!i.texture)
+						{
+							pixels[j + 3] = 255;
+						}
+					}
+				}
+
+				vkDestroyBuffer(m_device, i.buffer, NULL);
+				m_memory_allocator->Free(i.memory);
+			}
+
+			if (!all)
+			{
+				i.complete(pixels, i.width, i.height);
+			}
+		}
 	}
 }
 
@@ -25,16 +25,26 @@
 
 #include "vulkan_include.h"
 #include "container/Vector.h"
+#include "container/List.h"
+#include "container/Map.h"
 #include "graphics/RenderTexture.h"
 #include "graphics/IndexBuffer.h"
 #include "thread/Thread.h"
+#include "MemoryAllocatorVulkan.h"
+#include "DescriptorAllocatorVulkan.h"
+#include "TimerQueryVulkan.h"
+#include "Action.h"
 
 namespace Viry3D
 {
+#define FRAMES_IN_FLIGHT_DEFAULT 2
+#define RECORD_THREAD_MAX 8
+
 	class VertexBuffer;
 	class IndexBuffer;
 	class Shader;
 	class ThreadPool;
+	class UploadQueueVulkan;
 
 #if VR_WINDOWS
 	class DisplayVulkan: public DisplayWindows
@@ -55,13 +65,41 @@ namespace Viry3D
 		void WaitQueueIdle();
 		void BeginPrimaryCommandBuffer(VkCommandBuffer cmd);
 		void EndPrimaryCommandBuffer();
+		//	recorded at start of next primary command buffer, e.g. hazards between render graph passes
+		void AddPassBarrier(VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage, VkAccessFlags src_access, VkAccessFlags dst_access);
+		//	primary command buffer is inside a render pass executing secondary command buffers
+		void SetSecondaryContents(bool secondary) { m_secondary_contents = secondary; }
+		bool IsTimestampSupported() const { return m_timer_query && m_timer_query->IsSupported(); }
+		//	into command buffer being recorded on this thread, -1 when none can take it
+		int WriteTimestamp();
 		void BindVertexArray() { }
-		void BindVertexBuffer(const VertexBuffer* buffer);
-		void BindIndexBuffer(const IndexBuffer* buffer, IndexType index_type);
+		//	versions captured when frame was prepared, -1 binds versions filled last
+		void BindVertexArray(const VertexBuffer* vertex_buffer, const IndexBuffer* index_buffer, IndexType index_type, const Ref<Shader>& shader, int pass_index, int vertex_version = -1, int index_version = -1);
+		void BindVertexBuffer(const VertexBuffer* buffer, int version = -1);
+		void BindIndexBuffer(const IndexBuffer* buffer, IndexType index_type, int version = -1);
 		void BindVertexAttribArray(const Ref<Shader>& shader, int pass_index) { }
 		void DrawIndexed(int start, int count, IndexType index_type);
 		void DisableVertexArray(const Ref<Shader>& shader, int pass_index) { }
 		void SubmitQueue(VkCommandBuffer cmd);
+		//	null texture reads back buffer, image is copied to a buffer at end of frame and mapped after its fence signaled,
+		//	call on main thread, complete runs on main thread
+		void ReadPixelsAsync(const Ref<RenderTexture>& texture, ReadPixelsComplete complete);
+		//	frames cpu can record ahead of gpu, set before Init
+		void SetFramesInFlight(int count) { m_frames_in_flight = count; }
+		int GetFramesInFlight() const { return m_frames_in_flight; }
+		int GetFrameIndex() const { return m_frame_index; }
+		//	serial of the next submit, commands being recorded complete with it
+		uint64_t GetRecordingSerial() const { return m_submit_serial + 1; }
+		void WaitSubmit(uint64_t serial);
+		void WaitCommandBuffer(VkCommandBuffer cmd);
+		//	run destroy after gpu finished all commands recorded so far
+		void DestroyDeferred(Action destroy);
+		void FreeCommandBufferDeferred(VkCommandBuffer cmd);
+		//	worker threads for secondary command buffers, less than 2 means serial recording
+		int GetRecordThreadCount() const;
+		//	record jobs on worker threads into own secondary command buffers,
+		//	then execute them in job order inside the render pass being recorded
+		void RecordSecondaryCommandBuffers(const Vector<Action>& jobs, const VkCommandBufferInheritanceInfo& inheritance);
 
 		void CreateSharedContext() { }
 		void DestroySharedContext() { }
@@ -74,24 +112,27 @@ namespace Viry3D
 		VkImage GetSwapchainBufferImage(int index) const { return m_swapchain_buffers[index].image; }
 		VkImageView GetSwapchainBufferImageView(int index) const { return m_swapchain_buffers[index].image_view; }
 		VkCommandPool GetCommandPool() const { return m_cmd_pool; }
-		VkCommandBuffer GetCurrentDrawCommand() const { return m_current_draw_cmd; }
+		VkCommandBuffer GetCurrentDrawCommand() const;
 		int GetSwapchainBufferCount() const { return m_swapchain_buffers.Size(); }
 		int GetSwapBufferIndex() const { return m_swap_buffer_index; }
 		VkPipelineCache GetPipelineCache() const { return m_pipeline_cache; }
+		//	write pipeline cache and pipeline manifest to save path
+		void SavePipelineCache();
 		int GetMinUniformBufferOffsetAlignment() const { return (int) m_device_properties.limits.minUniformBufferOffsetAlignment; }
 		const String& GetDeviceName() const { return m_device_name; }
+		MemoryAllocatorVulkan* GetMemoryAllocator() const { return m_memory_allocator.get(); }
+		UploadQueueVulkan* GetUploadQueue() const { return m_upload_queue.get(); }
+		DescriptorAllocatorVulkan* GetDescriptorAllocator() const { return m_descriptor_allocator.get(); }
 
 		bool CheckMemoryType(uint32_t type_bits, VkFlags requirements_mask, uint32_t* type_index);
-		void BeginImageCommandBuffer();
 		void SetImageLayout(
+			VkCommandBuffer cmd,
 			VkImage image,
 			VkImageAspectFlags aspect_mask,
 			VkImageLayout old_image_layout,
 			VkImageLayout new_image_layout,
 			VkAccessFlagBits src_access_mask,
 			VkImageSubresourceRange* subresource_range = NULL);
-		VkCommandBuffer GetImageCommandBuffer() const { return m_image_cmd_buffer; }
-		void EndImageCommandBuffer();
 
 	private:
 		void CreateInstance();
@@ -104,8 +145,17 @@ namespace Viry3D
 		void CreateSwapchain();
 		void CreateSwapchainBuffers();
 		void CreateCommandPool();
-		void CreateImageCommandBuffer();
 		void CreatePipelineCache();
+		void CreateFrames();
+		void DestroyFrames();
+		//	all: device is idle, run every deferred destroy
+		void RetireSubmits(bool all);
+		void CreateRecordThreads();
+		void DestroyRecordThreads();
+		VkCommandBuffer GetSecondaryCommandBuffer(int thread_index);
+		void ReadPixelsRequests();
+		//	all: device is idle, free every readback without completing it
+		void ReadPixelsReadbacks(bool all);
 
 		VkShaderModule CreateShaderModule(void *spv_bytes, int size);
 
@@ -119,6 +169,39 @@ namespace Viry3D
 		{
 			VkCommandPool cmd_pool;
 			Vector<VkCommandBuffer> cmd;
+			int cmd_used;
+		};
+
+		struct FrameData
+		{
+			VkSemaphore image_acquired_semaphore;
+			Vector<VkSemaphore> draw_complete_semaphores;
+			int draw_complete_count;
+			uint64_t submit_serial;
+		};
+
+		struct Submit
+		{
+			uint64_t serial;
+			VkFence fence;
+		};
+
+		struct DeferredDestroy
+		{
+			uint64_t serial;
+			Action destroy;
+		};
+
+		struct PixelsReadback
+		{
+			Ref<RenderTexture> texture;
+			ReadPixelsComplete complete;
+			VkBuffer buffer;
+			MemoryAllocation memory;
+			uint64_t serial;
+			int width;
+			int height;
+			bool bgra;
 		};
 
 		VkInstance m_instance;
@@ -126,25 +209,49 @@ namespace Viry3D
 		VkPhysicalDevice m_gpu;
 		VkSurfaceKHR m_surface;
 		uint32_t m_graphics_queue_index;
+		uint32_t m_transfer_queue_index;
 		VkDevice m_device;
 		VkQueue m_queue;
+		VkQueue m_transfer_queue;
 		VkSurfaceFormatKHR m_surface_format;
 		VkPhysicalDeviceMemoryProperties m_memory_properties;
 		VkPhysicalDeviceProperties m_device_properties;
 
 		Mutex m_mutex;
+		Mutex m_submit_mutex;
 		uint32_t m_swap_buffer_index;
-		VkSemaphore m_image_acquired_semaphore;
-		Vector<VkSemaphore> m_draw_complete_semaphores;
+		int m_frames_in_flight;
+		int m_frame_index;
+		Vector<FrameData> m_frames;
+		uint64_t m_submit_serial;
+		uint64_t m_completed_serial;
+		List<Submit> m_submits;
+		Vector<VkFence> m_free_fences;
+		Map<VkCommandBuffer, uint64_t> m_cmd_serials;
+		List<DeferredDestroy> m_deferred_destroys;
 		VkCommandBuffer m_current_draw_cmd;
+		VkPipelineStageFlags m_barrier_src_stage;
+		VkPipelineStageFlags m_barrier_dst_stage;
+		VkAccessFlags m_barrier_src_access;
+		VkAccessFlags m_barrier_dst_access;
+		Ref<ThreadPool> m_record_threads;
+		// one per frame slot and record thread
+		Vector<ThreadData> m_thread_data;
 		String m_device_name;
+		Ref<MemoryAllocatorVulkan> m_memory_allocator;
+		Ref<UploadQueueVulkan> m_upload_queue;
+		Ref<DescriptorAllocatorVulkan> m_descriptor_allocator;
+		Ref<TimerQueryVulkan> m_timer_query;
+		bool m_secondary_contents;
+		// requested on main thread, copied at end of frame on render thread
+		Mutex m_pixels_mutex;
+		Vector<PixelsReadback> m_pixels_requests;
+		Vector<PixelsReadback> m_pixels_readbacks;
 
 		// resources need recreate when window resize
 		VkSwapchainKHR m_swapchain;
 		Vector<SwapchainBuffer> m_swapchain_buffers;
 		VkCommandPool m_cmd_pool;
-		VkCommandPool m_image_cmd_pool;
-		VkCommandBuffer m_image_cmd_buffer;
 		Ref<RenderTexture> m_depth_texture;
 		VkPipelineCache m_pipeline_cache;
 	};
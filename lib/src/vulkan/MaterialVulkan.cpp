@@ -47,31 +47,30 @@ namespace Viry3D
 		return m_descriptor_sets[pass_index];
 	}
 
-	void* MaterialVulkan::SetUniformBegin(int pass_index)
+	const Ref<UniformBuffer>& MaterialVulkan::GetUniformBuffer(int pass_index)
 	{
-		auto display = (DisplayVulkan*) Graphics::GetDisplay();
-		auto device = display->GetDevice();
+		if (Camera::Current()->GetRenderMode() == CameraRenderMode::ShadowMap)
+		{
+			return m_uniform_buffers_shadowmap[pass_index];
+		}
 
+		return m_uniform_buffers[pass_index];
+	}
+
+	void* MaterialVulkan::SetUniformBegin(int pass_index)
+	{
 		if (Camera::Current()->GetRenderMode() == CameraRenderMode::ShadowMap)
 		{
 			if (m_uniform_buffers_shadowmap[pass_index])
 			{
-				void* mapped;
-				VkResult err = vkMapMemory(device, m_uniform_buffers_shadowmap[pass_index]->GetMemory(), 0, m_uniform_buffers_shadowmap[pass_index]->GetSize(), 0, &mapped);
-				assert(!err);
-
-				return mapped;
+				return m_uniform_buffers_shadowmap[pass_index]->GetMapped();
 			}
 		}
 		else
 		{
 			if (m_uniform_buffers[pass_index])
 			{
-				void* mapped;
-				VkResult err = vkMapMemory(device, m_uniform_buffers[pass_index]->GetMemory(), 0, m_uniform_buffers[pass_index]->GetSize(), 0, &mapped);
-				assert(!err);
-
-				return mapped;
+				return m_uniform_buffers[pass_index]->GetMapped();
 			}
 		}
 
@@ -95,7 +94,7 @@ namespace Viry3D
 		{
 			auto& write = writes[i];
 
-			if (write.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+			if (write.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
 			{
 				auto uniform_info = write.pBufferInfo;
 
@@ -118,22 +117,11 @@ namespace Viry3D
 
 	void MaterialVulkan::SetUniformEnd(int pass_index)
 	{
-		auto display = (DisplayVulkan*) Graphics::GetDisplay();
-		auto device = display->GetDevice();
-
-		if (Camera::Current()->GetRenderMode() == CameraRenderMode::ShadowMap)
+		// writes went to cpu copy, gpu reads a new transient copy from now on
+		auto& uniform_buffer = this->GetUniformBuffer(pass_index);
+		if (uniform_buffer)
 		{
-			if (m_uniform_buffers_shadowmap[pass_index])
-			{
-				vkUnmapMemory(device, m_uniform_buffers_shadowmap[pass_index]->GetMemory());
-			}
-		}
-		else
-		{
-			if (m_uniform_buffers[pass_index])
-			{
-				vkUnmapMemory(device, m_uniform_buffers[pass_index]->GetMemory());
-			}
+			uniform_buffer->Commit();
 		}
 	}
 
@@ -197,9 +185,7 @@ namespace Viry3D
 
 			if (!m_descriptor_sets_shadowmap[pass_index])
 			{
-				auto ds = RefMake<DescriptorSetVulkan>();
-				ds->set = shader->CreateDescriptorSet(pass_index);
-				m_descriptor_sets_shadowmap[pass_index] = ds;
+				m_descriptor_sets_shadowmap[pass_index] = RefMake<DescriptorSetVulkan>();
 
 				m_uniform_buffers_shadowmap[pass_index] = shader->CreateUniformBuffer(pass_index);
 			}
@@ -214,9 +200,7 @@ namespace Viry3D
 
 			if (!m_descriptor_sets[pass_index])
 			{
-				auto ds = RefMake<DescriptorSetVulkan>();
-				ds->set = shader->CreateDescriptorSet(pass_index);
-				m_descriptor_sets[pass_index] = ds;
+				m_descriptor_sets[pass_index] = RefMake<DescriptorSetVulkan>();
 
 				m_uniform_buffers[pass_index] = shader->CreateUniformBuffer(pass_index);
 			}
@@ -250,38 +234,23 @@ namespace Viry3D
 		}
 
 		auto& writes = shader->GetDescriptorSetWriteInfo(pass_index);
-		auto display = (DisplayVulkan*) Graphics::GetDisplay();
-		auto device = display->GetDevice();
+		auto& uniform_buffer = this->GetUniformBuffer(pass_index);
 
 		for (int i = 0; i < writes.Size(); i++)
 		{
 			auto& write = writes[i];
 
-			if (Camera::Current()->GetRenderMode() == CameraRenderMode::ShadowMap)
-			{
-				if (write.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
-				{
-					void* p = (void*) write.pBufferInfo;
-					VkDescriptorBufferInfo* uniform_info = (VkDescriptorBufferInfo*) p;
-					uniform_info->buffer = m_uniform_buffers_shadowmap[pass_index]->GetBuffer();
-				}
-
-				write.dstSet = RefCast<DescriptorSetVulkan>(m_descriptor_sets_shadowmap[pass_index])->set;
-			}
-			else
+			if (write.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
 			{
-				if (write.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
-				{
-					void* p = (void*) write.pBufferInfo;
-					VkDescriptorBufferInfo* uniform_info = (VkDescriptorBufferInfo*) p;
-					uniform_info->buffer = m_uniform_buffers[pass_index]->GetBuffer();
-				}
-
-				write.dstSet = RefCast<DescriptorSetVulkan>(m_descriptor_sets[pass_index])->set;
+				void* p = (void*) write.pBufferInfo;
+				VkDescriptorBufferInfo* uniform_info = (VkDescriptorBufferInfo*) p;
+				uniform_info->buffer = uniform_buffer->GetBuffer();
 			}
 		}
 
-		vkUpdateDescriptorSets(device, writes.Size(), &writes[0], 0, NULL);
+		// set bound by pending commands is never written, a set with same bindings is reused or allocated
+		auto key = DescriptorKey::FromWrites(shader->GetDescriptorSetLayout(pass_index), writes.Empty() ? NULL : &writes[0], writes.Size());
+		RefCast<DescriptorSetVulkan>(this->GetDescriptorSet(pass_index))->Update(key);
 	}
 }
 
@@ -38,6 +38,7 @@ namespace Viry3D
 	public:
 		virtual ~MaterialVulkan() { }
 		const Ref<DescriptorSet>& GetDescriptorSet(int pass_index);
+		const Ref<UniformBuffer>& GetUniformBuffer(int pass_index);
 
 	protected:
 		void OnShaderChanged();
@@ -0,0 +1,451 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "MemoryAllocatorVulkan.h"
+#include "memory/TLSFAllocator.h"
+#include "memory/Memory.h"
+#include "Debug.h"
+
+#define BLOCK_SIZE_DEFAULT (64 * 1024 * 1024)
+#define SMALL_HEAP_SIZE (1024 * 1024 * 1024)
+// per frame slot, ring grows when a frame needs more
+#define TRANSIENT_FRAME_SIZE (1024 * 1024)
+
+#if VR_VULKAN
+
+namespace Viry3D
+{
+	struct MemoryBlockVulkan
+	{
+		VkDeviceMemory memory;
+		VkDeviceSize size;
+		uint32_t type_index;
+		int pool;
+		void* mapped;
+		//	NULL for a dedicated allocation
+		TLSFAllocator* allocator;
+	};
+
+	MemoryAllocatorVulkan::MemoryAllocatorVulkan(VkDevice device, const VkPhysicalDeviceMemoryProperties& properties, int frame_count):
+		m_device(device),
+		m_properties(properties)
+	{
+		Memory::Zero(&m_transient, sizeof(m_transient));
+		m_transient_used.Resize(frame_count);
+		for (auto& i : m_transient_used)
+		{
+			i = 0;
+		}
+	}
+
+	MemoryAllocatorVulkan::~MemoryAllocatorVulkan()
+	{
+		for (auto& i : m_pools)
+		{
+			for (auto j : i.second)
+			{
+				if (!j->allocator->IsEmpty())
+				{
+					Log("memory block destroyed with %d allocations alive", j->allocator->GetAllocationCount());
+				}
+				this->DestroyBlock(j);
+			}
+		}
+		m_pools.Clear();
+
+		for (auto i : m_dedicated)
+		{
+			this->DestroyBlock(i);
+		}
+		m_dedicated.Clear();
+
+		if (m_transient.buffer != VK_NULL_HANDLE)
+		{
+			this->DestroyTransientRing(m_transient);
+		}
+		for (const auto& i : m_transient_retired)
+		{
+			this->DestroyTransientRing(i);
+		}
+		m_transient_retired.Clear();
+	}
+
+	VkDeviceSize MemoryAllocatorVulkan::GetBlockSize(uint32_t type_index) const
+	{
+		uint32_t heap_index = m_properties.memoryTypes[type_index].heapIndex;
+		VkDeviceSize heap_size = m_properties.memoryHeaps[heap_index].size;
+
+		// small heaps would be used up by a few blocks
+		if (heap_size <= SMALL_HEAP_SIZE)
+		{
+			return heap_size / 8;
+		}
+
+		return BLOCK_SIZE_DEFAULT;
+	}
+
+	void* MemoryAllocatorVulkan::MapMemory(VkDeviceMemory memory, uint32_t type_index)
+	{
+		if ((m_properties.memoryTypes[type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0)
+		{
+			return NULL;
+		}
+
+		void* mapped = NULL;
+		VkResult err = vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+		assert(!err);
+
+		return mapped;
+	}
+
+	MemoryBlockVulkan* MemoryAllocatorVulkan::CreateBlock(uint32_t type_index, VkDeviceSize size, int pool)
+	{
+		VkMemoryAllocateInfo info = {
+			VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			NULL,
+			size,
+			type_index,
+		};
+
+		VkDeviceMemory memory;
+		VkResult err = vkAllocateMemory(m_device, &info, NULL, &memory);
+		if (err)
+		{
+			return NULL;
+		}
+
+		MemoryBlockVulkan* block = new MemoryBlockVulkan();
+		block->memory = memory;
+		block->size = size;
+		block->type_index = type_index;
+		block->pool = pool;
+		block->mapped = this->MapMemory(memory, type_index);
+		block->allocator = pool >= 0 ? new TLSFAllocator(size) : NULL;
+
+		return block;
+	}
+
+	void MemoryAllocatorVulkan::DestroyBlock(MemoryBlockVulkan* block)
+	{
+		if (block->mapped)
+		{
+			vkUnmapMemory(m_device, block->memory);
+		}
+		vkFreeMemory(m_device, block->memory, NULL);
+		delete block->allocator;
+		delete block;
+	}
+
+	bool MemoryAllocatorVulkan::Allocate(const VkMemoryRequirements& reqs, uint32_t type_index, bool linear, MemoryAllocation* allocation)
+	{
+		std::lock_guard<Mutex> lock(m_mutex);
+
+		VkDeviceSize block_size = this->GetBlockSize(type_index);
+
+		// big resources get own memory, they would waste most of a block
+		if (reqs.size > block_size / 2)
+		{
+			MemoryBlockVulkan* block = this->CreateBlock(type_index, reqs.size, -1);
+			if (block == NULL)
+			{
+				return false;
+			}
+			m_dedicated.Add(block);
+
+			allocation->memory = block->memory;
+			allocation->offset = 0;
+			allocation->size = reqs.size;
+			allocation->mapped = block->mapped;
+			allocation->block = block;
+			return true;
+		}
+
+		int pool = (int) type_index * 2 + (linear ? 1 : 0);
+		if (!m_pools.Contains(pool))
+		{
+			m_pools.Add(pool, Vector<MemoryBlockVulkan*>());
+		}
+		auto& blocks = m_pools[pool];
+
+		MemoryBlockVulkan* block = NULL;
+		uint64_t offset = TLSFAllocator::INVALID_OFFSET;
+		for (auto i : blocks)
+		{
+			offset = i->allocator->Allocate(reqs.size, reqs.alignment);
+			if (offset != TLSFAllocator::INVALID_OFFSET)
+			{
+				block = i;
+				break;
+			}
+		}
+
+		if (block == NULL)
+		{
+			block = this->CreateBlock(type_index, block_size, pool);
+			if (block == NULL)
+			{
+				return false;
+			}
+			blocks.Add(block);
+
+			offset = block->allocator->Allocate(reqs.size, reqs.alignment);
+			assert(offset != TLSFAllocator::INVALID_OFFSET);
+		}
+
+		allocation->memory = block->memory;
+		allocation->offset = offset;
+		allocation->size = reqs.size;
+		allocation->mapped = block->mapped ? (char*) block->mapped + offset : NULL;
+		allocation->block = block;
+		return true;
+	}
+
+	void MemoryAllocatorVulkan::Free(const MemoryAllocation& allocation)
+	{
+		MemoryBlockVulkan* block = allocation.block;
+		if (block == NULL)
+		{
+			return;
+		}
+
+		std::lock_guard<Mutex> lock(m_mutex);
+
+		if (block->allocator == NULL)
+		{
+			for (int i = 0; i < m_dedicated.Size(); i++)
+			{
+				if (m_dedicated[i] == block)
+				{
+					m_dedicated.Remove(i);
+					break;
+				}
+			}
+			this->DestroyBlock(block);
+			return;
+		}
+
+		block->allocator->Free(allocation.offset);
+
+		// keep one empty block per pool to avoid reallocation when resources come and go
+		auto& blocks = m_pools[block->pool];
+		if (block->allocator->IsEmpty() && blocks.Size() > 1)
+		{
+			for (int i = 0; i < blocks.Size(); i++)
+			{
+				if (blocks[i] == block)
+				{
+					blocks.Remove(i);
+					break;
+				}
+			}
+			this->DestroyBlock(block);
+		}
+	}
+
+	bool MemoryAllocatorVulkan::CreateTransientRing(VkDeviceSize frame_size, TransientRing* ring)
+	{
+		VkBufferCreateInfo buf_info;
+		Memory::Zero(&buf_info, sizeof(buf_info));
+		buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buf_info.size = frame_size * m_transient_used.Size();
+		buf_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+
+		VkBuffer buffer;
+		VkResult err = vkCreateBuffer(m_device, &buf_info, NULL, &buffer);
+		if (err)
+		{
+			return false;
+		}
+
+		VkMemoryRequirements reqs;
+		vkGetBufferMemoryRequirements(m_device, buffer, &reqs);
+
+		VkFlags flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		uint32_t type_index = VK_MAX_MEMORY_TYPES;
+		for (uint32_t i = 0; i < m_properties.memoryTypeCount; i++)
+		{
+			if ((reqs.memoryTypeBits & (1 << i)) && (m_properties.memoryTypes[i].propertyFlags & flags) == flags)
+			{
+				type_index = i;
+				break;
+			}
+		}
+
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		if (type_index != VK_MAX_MEMORY_TYPES)
+		{
+			VkMemoryAllocateInfo info = {
+				VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+				NULL,
+				reqs.size,
+				type_index,
+			};
+			err = vkAllocateMemory(m_device, &info, NULL, &memory);
+		}
+
+		if (memory == VK_NULL_HANDLE)
+		{
+			vkDestroyBuffer(m_device, buffer, NULL);
+			return false;
+		}
+
+		err = vkBindBufferMemory(m_device, buffer, memory, 0);
+		assert(!err);
+
+		ring->buffer = buffer;
+		ring->memory = memory;
+		ring->frame_size = frame_size;
+		ring->mapped = this->MapMemory(memory, type_index);
+		ring->retire_resets = 0;
+
+		for (auto& i : m_transient_used)
+		{
+			i = 0;
+		}
+
+		return true;
+	}
+
+	void MemoryAllocatorVulkan::DestroyTransientRing(const TransientRing& ring)
+	{
+		vkUnmapMemory(m_device, ring.memory);
+		vkDestroyBuffer(m_device, ring.buffer, NULL);
+		vkFreeMemory(m_device, ring.memory, NULL);
+	}
+
+	bool MemoryAllocatorVulkan::AllocateTransient(VkDeviceSize size, VkDeviceSize alignment, int frame_index, TransientAllocation* allocation)
+	{
+		std::lock_guard<Mutex> lock(m_mutex);
+
+		if (m_transient.buffer == VK_NULL_HANDLE)
+		{
+			if (!this->CreateTransientRing(TRANSIENT_FRAME_SIZE, &m_transient))
+			{
+				return false;
+			}
+		}
+
+		VkDeviceSize offset = (m_transient_used[frame_index] + alignment - 1) / alignment * alignment;
+		if (offset + size > m_transient.frame_size)
+		{
+			VkDeviceSize frame_size = m_transient.frame_size * 2;
+			while (frame_size < size)
+			{
+				frame_size *= 2;
+			}
+
+			TransientRing ring;
+			if (!this->CreateTransientRing(frame_size, &ring))
+			{
+				return false;
+			}
+
+			// frames recorded before may read old ring, it is destroyed after every frame slot was reset once
+			m_transient.retire_resets = m_transient_used.Size();
+			m_transient_retired.Add(m_transient);
+			m_transient = ring;
+
+			offset = 0;
+		}
+
+		m_transient_used[frame_index] = offset + size;
+
+		allocation->buffer = m_transient.buffer;
+		allocation->offset = frame_index * m_transient.frame_size + offset;
+		allocation->mapped = (char*) m_transient.mapped + allocation->offset;
+		return true;
+	}
+
+	void MemoryAllocatorVulkan::ResetTransient(int frame_index, RemoveBufferFunc remove_buffer)
+	{
+		std::lock_guard<Mutex> lock(m_mutex);
+
+		m_transient_used[frame_index] = 0;
+
+		for (int i = m_transient_retired.Size() - 1; i >= 0; i--)
+		{
+			auto& ring = m_transient_retired[i];
+			ring.retire_resets--;
+			if (ring.retire_resets <= 0)
+			{
+				remove_buffer(ring.buffer);
+				this->DestroyTransientRing(ring);
+				m_transient_retired.Remove(i);
+			}
+		}
+	}
+
+	MemoryStats MemoryAllocatorVulkan::GetStats()
+	{
+		std::lock_guard<Mutex> lock(m_mutex);
+
+		MemoryStats stats;
+		Memory::Zero(&stats, sizeof(stats));
+
+		for (const auto& i : m_pools)
+		{
+			for (auto j : i.second)
+			{
+				stats.block_count++;
+				stats.block_bytes += j->size;
+				stats.used_bytes += j->allocator->GetUsedSize();
+				stats.allocation_count += j->allocator->GetAllocationCount();
+				stats.free_range_count += j->allocator->GetFreeRangeCount();
+
+				float fragmentation = j->allocator->GetFragmentation();
+				if (fragmentation > stats.fragmentation)
+				{
+					stats.fragmentation = fragmentation;
+				}
+			}
+		}
+
+		for (auto i : m_dedicated)
+		{
+			stats.dedicated_count++;
+			stats.allocation_count++;
+			stats.block_bytes += i->size;
+			stats.used_bytes += i->size;
+		}
+
+		stats.transient_bytes = m_transient.frame_size * m_transient_used.Size();
+		for (auto i : m_transient_used)
+		{
+			stats.transient_used_bytes += i;
+		}
+
+		return stats;
+	}
+
+	void MemoryAllocatorVulkan::LogStats()
+	{
+		MemoryStats stats = this->GetStats();
+
+		Log("vulkan memory blocks:%d dedicated:%d allocations:%d free ranges:%d used:%dKB/%dKB transient:%dKB/%dKB fragmentation:%.2f",
+			stats.block_count,
+			stats.dedicated_count,
+			stats.allocation_count,
+			stats.free_range_count,
+			(int) (stats.used_bytes / 1024),
+			(int) (stats.block_bytes / 1024),
+			(int) (stats.transient_used_bytes / 1024),
+			(int) (stats.transient_bytes / 1024),
+			stats.fragmentation);
+	}
+}
+
+#endif
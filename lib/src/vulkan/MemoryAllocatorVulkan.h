@@ -0,0 +1,108 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "vulkan_include.h"
+#include "container/Vector.h"
+#include "container/Map.h"
+#include "thread/Thread.h"
+#include <functional>
+
+namespace Viry3D
+{
+	struct MemoryBlockVulkan;
+
+	struct MemoryAllocation
+	{
+		VkDeviceMemory memory;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		//	persistently mapped address for host visible memory, NULL otherwise
+		void* mapped;
+		MemoryBlockVulkan* block;
+	};
+
+	//	range of transient ring, buffer is shared by every allocation so descriptors of it stay valid
+	struct TransientAllocation
+	{
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		void* mapped;
+	};
+
+	struct MemoryStats
+	{
+		int block_count;
+		int dedicated_count;
+		int allocation_count;
+		int free_range_count;
+		uint64_t block_bytes;
+		uint64_t used_bytes;
+		uint64_t transient_bytes;
+		uint64_t transient_used_bytes;
+		//	worst block, 0 when every block has its free space in one range
+		float fragmentation;
+	};
+
+	//	sub allocate resources from large device memory blocks per memory type
+	class MemoryAllocatorVulkan
+	{
+	public:
+		MemoryAllocatorVulkan(VkDevice device, const VkPhysicalDeviceMemoryProperties& properties, int frame_count);
+		~MemoryAllocatorVulkan();
+		//	linear: buffers and linear images, kept apart from optimal images for buffer image granularity
+		bool Allocate(const VkMemoryRequirements& reqs, uint32_t type_index, bool linear, MemoryAllocation* allocation);
+		void Free(const MemoryAllocation& allocation);
+		//	per frame data like uniforms, lives until the frame slot is reused, never free it
+		bool AllocateTransient(VkDeviceSize size, VkDeviceSize alignment, int frame_index, TransientAllocation* allocation);
+		typedef std::function<void(VkBuffer buffer)> RemoveBufferFunc;
+		//	call after gpu finished the frame used this slot before,
+		//	remove_buffer gets buffer of a retired ring before it is destroyed, its handle may be reused
+		void ResetTransient(int frame_index, RemoveBufferFunc remove_buffer);
+		MemoryStats GetStats();
+		void LogStats();
+
+	private:
+		//	host visible uniform buffer with a region per frame slot
+		struct TransientRing
+		{
+			VkBuffer buffer;
+			VkDeviceMemory memory;
+			VkDeviceSize frame_size;
+			void* mapped;
+			//	resets left until no frame reads a replaced ring
+			int retire_resets;
+		};
+
+		MemoryBlockVulkan* CreateBlock(uint32_t type_index, VkDeviceSize size, int pool);
+		void DestroyBlock(MemoryBlockVulkan* block);
+		VkDeviceSize GetBlockSize(uint32_t type_index) const;
+		void* MapMemory(VkDeviceMemory memory, uint32_t type_index);
+		bool CreateTransientRing(VkDeviceSize frame_size, TransientRing* ring);
+		void DestroyTransientRing(const TransientRing& ring);
+
+		VkDevice m_device;
+		VkPhysicalDeviceMemoryProperties m_properties;
+		Mutex m_mutex;
+		Map<int, Vector<MemoryBlockVulkan*>> m_pools;
+		Vector<MemoryBlockVulkan*> m_dedicated;
+		TransientRing m_transient;
+		Vector<VkDeviceSize> m_transient_used;
+		Vector<TransientRing> m_transient_retired;
+	};
+}
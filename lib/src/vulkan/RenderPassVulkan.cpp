@@ -26,9 +26,119 @@
 
 namespace Viry3D
 {
+	static VkRenderPass create_render_pass(
+		VkDevice device,
+		VkFormat color_format,
+		VkFormat depth_format,
+		bool need_depth,
+		VkAttachmentLoadOp color_load,
+		VkAttachmentLoadOp depth_load,
+		VkImageLayout color_final_layout)
+	{
+		Vector<VkAttachmentDescription> attachments;
+		attachments.Add(VkAttachmentDescription());
+		Memory::Zero(&attachments[0], sizeof(VkAttachmentDescription));
+
+		attachments[0].format = color_format;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = color_load;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[0].finalLayout = color_final_layout;
+
+		if (need_depth)
+		{
+			attachments.Add(VkAttachmentDescription());
+			Memory::Zero(&attachments[1], sizeof(VkAttachmentDescription));
+
+			attachments[1].format = depth_format;
+			attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+			attachments[1].loadOp = depth_load;
+			attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachments[1].stencilLoadOp = depth_load;
+			attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		}
+
+		VkAttachmentReference color_reference = {
+			0,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		};
+		VkAttachmentReference depth_reference = {
+			1,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		};
+
+		VkSubpassDescription subpass;
+		Memory::Zero(&subpass, sizeof(subpass));
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.flags = 0;
+		subpass.inputAttachmentCount = 0;
+		subpass.pInputAttachments = NULL;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &color_reference;
+		subpass.pResolveAttachments = NULL;
+		if (need_depth)
+		{
+			subpass.pDepthStencilAttachment = &depth_reference;
+		}
+		subpass.preserveAttachmentCount = 0;
+		subpass.pPreserveAttachments = NULL;
+
+		VkRenderPassCreateInfo rp_info;
+		Memory::Zero(&rp_info, sizeof(rp_info));
+		rp_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		rp_info.pNext = NULL;
+		rp_info.attachmentCount = attachments.Size();
+		rp_info.pAttachments = &attachments[0];
+		rp_info.subpassCount = 1;
+		rp_info.pSubpasses = &subpass;
+
+		VkSubpassDependency dependencies[2];
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		rp_info.dependencyCount = 2;
+		rp_info.pDependencies = dependencies;
+
+		VkRenderPass render_pass;
+		VkResult err = vkCreateRenderPass(device, &rp_info, NULL, &render_pass);
+		assert(!err);
+
+		return render_pass;
+	}
+
+	VkRenderPass RenderPassVulkan::CreateCompatibleRenderPass(const RenderPassKey& key)
+	{
+		auto display = (DisplayVulkan*) Graphics::GetDisplay();
+		auto device = display->GetDevice();
+		bool need_depth = key.depth_format != VK_FORMAT_UNDEFINED;
+
+		return create_render_pass(device, key.color_format, key.depth_format, need_depth,
+			VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+
 	RenderPassVulkan::RenderPassVulkan():
-		m_render_pass(VK_NULL_HANDLE)
+		m_render_pass(VK_NULL_HANDLE),
+		m_secondary_contents(false)
 	{
+		Memory::Zero(&m_inheritance_info, sizeof(m_inheritance_info));
 	}
 
 	RenderPassVulkan::~RenderPassVulkan()
@@ -36,14 +146,20 @@ namespace Viry3D
 		auto display = (DisplayVulkan*) Graphics::GetDisplay();
 		auto device = display->GetDevice();
 
-		vkDeviceWaitIdle(device);
-
-		for (auto i : m_framebuffers)
+		for (auto i : m_cmd_buffers)
 		{
-			vkFreeCommandBuffers(device, display->GetCommandPool(), 1, &i.cmd_buffer);
-			vkDestroyFramebuffer(device, i.frame_buffer, NULL);
+			display->FreeCommandBufferDeferred(i);
 		}
-		vkDestroyRenderPass(device, m_render_pass, NULL);
+
+		auto framebuffers = m_framebuffers;
+		auto render_pass = m_render_pass;
+		display->DestroyDeferred([=]() {
+			for (const auto& i : framebuffers)
+			{
+				vkDestroyFramebuffer(device, i.frame_buffer, NULL);
+			}
+			vkDestroyRenderPass(device, render_pass, NULL);
+		});
 	}
 
 	void RenderPassVulkan::CreateInternal()
@@ -119,91 +235,13 @@ namespace Viry3D
 			color_final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		}
 
-		Vector<VkAttachmentDescription> attachments;
-		attachments.Add(VkAttachmentDescription());
-		Memory::Zero(&attachments[0], sizeof(VkAttachmentDescription));
-
-		attachments[0].format = color_format;
-		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
-		attachments[0].loadOp = color_load;
-		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachments[0].finalLayout = color_final_layout;
-
-		if (need_depth)
-		{
-			attachments.Add(VkAttachmentDescription());
-			Memory::Zero(&attachments[1], sizeof(VkAttachmentDescription));
-
-			attachments[1].format = depth_format;
-			attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
-			attachments[1].loadOp = depth_load;
-			attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			attachments[1].stencilLoadOp = depth_load;
-			attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
-			attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-		}
+		m_render_pass = create_render_pass(device, color_format, depth_format, need_depth, color_load, depth_load, color_final_layout);
 
-		VkAttachmentReference color_reference = {
-			0,
-			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-		};
-		VkAttachmentReference depth_reference = {
-			1,
-			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-		};
-
-		VkSubpassDescription subpass;
-		Memory::Zero(&subpass, sizeof(subpass));
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.flags = 0;
-		subpass.inputAttachmentCount = 0;
-		subpass.pInputAttachments = NULL;
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &color_reference;
-		subpass.pResolveAttachments = NULL;
-		if (need_depth)
-		{
-			subpass.pDepthStencilAttachment = &depth_reference;
-		}
-		subpass.preserveAttachmentCount = 0;
-		subpass.pPreserveAttachments = NULL;
-
-		VkRenderPassCreateInfo rp_info;
-		Memory::Zero(&rp_info, sizeof(rp_info));
-		rp_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		rp_info.pNext = NULL;
-		rp_info.attachmentCount = attachments.Size();
-		rp_info.pAttachments = &attachments[0];
-		rp_info.subpassCount = 1;
-		rp_info.pSubpasses = &subpass;
-
-		VkSubpassDependency dependencies[2];
-		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-		dependencies[1].srcSubpass = 0;
-		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-		rp_info.dependencyCount = 2;
-		rp_info.pDependencies = dependencies;
+		m_key.color_format = color_format;
+		m_key.depth_format = need_depth ? depth_format : VK_FORMAT_UNDEFINED;
+		m_key.samples = VK_SAMPLE_COUNT_1_BIT;
 
 		VkResult err;
-		err = vkCreateRenderPass(device, &rp_info, NULL, &m_render_pass);
-		assert(!err);
 
 		//	create frame buffers
 		Vector<VkImageView> attachments_view(1);
@@ -267,30 +305,25 @@ namespace Viry3D
 			attachments_view[0] = color_views[i];
 			err = vkCreateFramebuffer(device, &fb_info, NULL, &m_framebuffers[i].frame_buffer);
 			assert(!err);
-
-			VkCommandBufferAllocateInfo cmd_info = {
-				VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-				NULL,
-				display->GetCommandPool(),
-				VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-				1,
-			};
-			err = vkAllocateCommandBuffers(device, &cmd_info, &m_framebuffers[i].cmd_buffer);
-			assert(!err);
 		}
+
+		m_cmd_buffers.Resize(display->GetFramesInFlight());
+
+		VkCommandBufferAllocateInfo cmd_info = {
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			NULL,
+			display->GetCommandPool(),
+			VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			(uint32_t) m_cmd_buffers.Size(),
+		};
+		err = vkAllocateCommandBuffers(device, &cmd_info, &m_cmd_buffers[0]);
+		assert(!err);
 	}
 
 	VkCommandBuffer RenderPassVulkan::GetCommandBuffer() const
 	{
 		auto display = Graphics::GetDisplay();
-		auto pass = (RenderPass*) this;
-		bool is_default = !pass->HasFrameBuffer();
-		int swap_index = display->GetSwapBufferIndex();
-		if (!is_default)
-		{
-			swap_index = 0;
-		}
-		return m_framebuffers[swap_index].cmd_buffer;
+		return m_cmd_buffers[display->GetFrameIndex()];
 	}
 
 	void RenderPassVulkan::Begin(const Color& clear_color)
@@ -327,12 +360,14 @@ namespace Viry3D
 			framebuffer = m_framebuffers[0].frame_buffer;
 		}
 
-		VkCommandBufferInheritanceInfo inheritance_info;
-		Memory::Zero(&inheritance_info, sizeof(inheritance_info));
-		inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
-		inheritance_info.renderPass = m_render_pass;
-		inheritance_info.framebuffer = framebuffer;
+		Memory::Zero(&m_inheritance_info, sizeof(m_inheritance_info));
+		m_inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		m_inheritance_info.renderPass = m_render_pass;
+		m_inheritance_info.subpass = 0;
+		m_inheritance_info.framebuffer = framebuffer;
 
+		// same pass may be submitted more than once, e.g. blit
+		display->WaitCommandBuffer(cmd);
 		display->BeginPrimaryCommandBuffer(cmd);
 
 		Vector<VkClearValue> clear_values(1);
@@ -361,7 +396,8 @@ namespace Viry3D
 		rp_begin.clearValueCount = clear_values.Size();
 		rp_begin.pClearValues = &clear_values[0];
 
-		vkCmdBeginRenderPass(cmd, &rp_begin, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(cmd, &rp_begin, m_secondary_contents ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+		display->SetSecondaryContents(m_secondary_contents);
 
 		m_framebuffers[swap_index].draw_call = Graphics::draw_call;
 	}
@@ -378,6 +414,7 @@ namespace Viry3D
 		}
 
 		vkCmdEndRenderPass(GetCommandBuffer());
+		display->SetSecondaryContents(false);
 
 		display->EndPrimaryCommandBuffer();
 
@@ -24,28 +24,67 @@
 
 namespace Viry3D
 {
+	//	render passes with same key are compatible, pipelines can be shared between them
+	struct RenderPassKey
+	{
+		VkFormat color_format;
+		VkFormat depth_format;
+		VkSampleCountFlagBits samples;
+
+		RenderPassKey():
+			color_format(VK_FORMAT_UNDEFINED),
+			depth_format(VK_FORMAT_UNDEFINED),
+			samples(VK_SAMPLE_COUNT_1_BIT)
+		{
+		}
+
+		bool operator <(const RenderPassKey& right) const
+		{
+			if (color_format != right.color_format)
+			{
+				return color_format < right.color_format;
+			}
+			if (depth_format != right.depth_format)
+			{
+				return depth_format < right.depth_format;
+			}
+			return samples < right.samples;
+		}
+	};
+
 	class RenderPassVulkan
 	{
 	public:
+		static VkRenderPass CreateCompatibleRenderPass(const RenderPassKey& key);
+
 		virtual ~RenderPassVulkan();
 		void Begin(const Color& clear_color);
 		void End();
 		VkRenderPass GetVkRenderPass() const { return m_render_pass; }
+		const RenderPassKey& GetKey() const { return m_key; }
 		VkCommandBuffer GetCommandBuffer() const;
+		//	draws come from secondary command buffers only, set before Begin
+		void SetSecondaryContents(bool secondary) { m_secondary_contents = secondary; }
+		bool IsSecondaryContents() const { return m_secondary_contents; }
+		const VkCommandBufferInheritanceInfo& GetInheritanceInfo() const { return m_inheritance_info; }
 
 	protected:
 		RenderPassVulkan();
 		void CreateInternal();
 
 	private:
-		struct CommandBuffer
+		struct Framebuffer
 		{
 			VkFramebuffer frame_buffer;
-			VkCommandBuffer cmd_buffer;
 			int draw_call;
 		};
 
 		VkRenderPass m_render_pass;
-		Vector<CommandBuffer> m_framebuffers;
+		RenderPassKey m_key;
+		Vector<Framebuffer> m_framebuffers;
+		// one per frame in flight, recorded while older frames still execute
+		Vector<VkCommandBuffer> m_cmd_buffers;
+		bool m_secondary_contents;
+		VkCommandBufferInheritanceInfo m_inheritance_info;
 	};
 }
@@ -22,6 +22,7 @@
 #include "MaterialVulkan.h"
 #include "DescriptorSetVulkan.h"
 #include "Application.h"
+#include "Resource.h"
 #include "graphics/Graphics.h"
 #include "graphics/Shader.h"
 #include "graphics/Camera.h"
@@ -31,6 +32,7 @@
 #include "io/File.h"
 #include "io/MemoryStream.h"
 #include "memory/Memory.h"
+#include "Debug.h"
 #include "vulkan_shader_compiler.h"
 
 extern "C"
@@ -93,21 +95,18 @@ namespace Viry3D
 		auto display = (DisplayVulkan*) Graphics::GetDisplay();
 		auto device = display->GetDevice();
 
-		Vector<VkDescriptorPoolSize> pool_sizes;
 		Vector<VkDescriptorSetLayoutBinding> bindings;
 
 		// for world matrix, light map scale offset vector
-		pool_sizes.Add({ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, DESCRIPTOR_POOL_SIZE_MAX });
 		bindings.Add({
 			0, // binding
-			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, // descriptorType
+			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, // descriptorType
 			1, // descriptorCount
 			VK_SHADER_STAGE_VERTEX_BIT, //stageFlags
 			NULL // pImmutableSamplers
 		});
 
 		// for light map texture
-		pool_sizes.Add({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, DESCRIPTOR_POOL_SIZE_MAX });
 		bindings.Add({
 			1, // binding
 			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, // descriptorType
@@ -116,17 +115,6 @@ namespace Viry3D
 			NULL // pImmutableSamplers
 		});
 
-		VkDescriptorPoolCreateInfo pool_info = {
-			VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-			NULL,
-			0,
-			DESCRIPTOR_POOL_SIZE_MAX,
-			(uint32_t) pool_sizes.Size(),
-			&pool_sizes[0],
-		};
-		VkResult err = vkCreateDescriptorPool(device, &pool_info, NULL, &renderer_descriptor.pool);
-		assert(!err);
-
 		VkDescriptorSetLayoutCreateInfo layout_info = {
 			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
 			NULL,
@@ -134,7 +122,7 @@ namespace Viry3D
 			(uint32_t) bindings.Size(),
 			&bindings[0],
 		};
-		err = vkCreateDescriptorSetLayout(device, &layout_info, NULL, &renderer_descriptor.layout);
+		VkResult err = vkCreateDescriptorSetLayout(device, &layout_info, NULL, &renderer_descriptor.layout);
 		assert(!err);
 	}
 
@@ -154,7 +142,7 @@ namespace Viry3D
 				{
 					VkDescriptorSetLayoutBinding binding;
 					binding.binding = i.uniform_buffer.binding;
-					binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+					binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 					binding.descriptorCount = 1;
 					binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 					binding.pImmutableSamplers = NULL;
@@ -175,7 +163,7 @@ namespace Viry3D
 				{
 					VkDescriptorSetLayoutBinding binding;
 					binding.binding = i.uniform_buffer.binding;
-					binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+					binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 					binding.descriptorCount = 1;
 					binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 					binding.pImmutableSamplers = NULL;
@@ -217,45 +205,12 @@ namespace Viry3D
 			assert(!err);
 		}
 
-		// create descriptor pool
-		{
-			Vector<VkDescriptorPoolSize> type_counts;
-
-			for (const auto& i : binds)
-			{
-				VkDescriptorPoolSize type_count;
-				type_count.type = i.descriptorType;
-				type_count.descriptorCount = DESCRIPTOR_POOL_SIZE_MAX;
-
-				type_counts.Add(type_count);
-			}
-
-			if (!type_counts.Empty())
-			{
-				VkDescriptorPoolCreateInfo pool_info = {
-					VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-					NULL,
-					0,
-					DESCRIPTOR_POOL_SIZE_MAX,
-					(uint32_t) type_counts.Size(),
-					&type_counts[0],
-				};
-
-				err = vkCreateDescriptorPool(device, &pool_info, NULL, &shader_pass.descriptor_pool);
-				assert(!err);
-			}
-			else
-			{
-				shader_pass.descriptor_pool = VK_NULL_HANDLE;
-			}
-		}
-
 		// create uniform info and sampler info
 		{
 			int buffer_size = 0;
 			for (int i = 0; i < binds.Size(); i++)
 			{
-				if (binds[i].descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+				if (binds[i].descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
 				{
 					auto& uniform_buffer_info = *(XMLUniformBuffer*) shader_pass.uniform_xmls[i];
 
@@ -300,7 +255,7 @@ namespace Viry3D
 			write.descriptorType = i.descriptorType;
 			write.dstSet = VK_NULL_HANDLE;
 
-			if (i.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+			if (i.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
 			{
 				write.pBufferInfo = &shader_pass.uniform_infos[uniform_info_index];
 				uniform_info_index++;
@@ -315,45 +270,6 @@ namespace Viry3D
 		}
 	}
 
-	VkDescriptorSet ShaderVulkan::CreateDescriptorSet(int index)
-	{
-		auto device = ((DisplayVulkan*) Graphics::GetDisplay())->GetDevice();
-		auto& pass = m_passes[index];
-
-		VkDescriptorSetAllocateInfo set_info = {
-			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-			NULL,
-			pass.descriptor_pool,
-			1,
-			&pass.descriptor_layout
-		};
-
-		VkDescriptorSet descriptor_set;
-		VkResult err = vkAllocateDescriptorSets(device, &set_info, &descriptor_set);
-		assert(!err);
-
-		return descriptor_set;
-	}
-
-	VkDescriptorSet ShaderVulkan::CreateRendererDescriptorSet()
-	{
-		auto device = ((DisplayVulkan*) Graphics::GetDisplay())->GetDevice();
-
-		VkDescriptorSetAllocateInfo set_info = {
-			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-			NULL,
-			m_renderer_descriptor.pool,
-			1,
-			&m_renderer_descriptor.layout
-		};
-
-		VkDescriptorSet descriptor_set;
-		VkResult err = vkAllocateDescriptorSets(device, &set_info, &descriptor_set);
-		assert(!err);
-
-		return descriptor_set;
-	}
-
 	Ref<UniformBuffer> ShaderVulkan::CreateUniformBuffer(int index)
 	{
 		Ref<UniformBuffer> uniform_buffer;
@@ -364,7 +280,7 @@ namespace Viry3D
 		for (int i = writes.Size() - 1; i >= 0; i--)
 		{
 			auto& write = writes[i];
-			if (write.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+			if (write.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
 			{
 				buffer_size = (int) (write.pBufferInfo->offset + write.pBufferInfo->range);
 				break;
@@ -796,9 +712,37 @@ namespace Viry3D
 		pipeline_info.pDynamicState = &dynamic_state;
 	}
 
+	Mutex ShaderVulkan::m_pipelines_mutex;
+	Mutex ShaderVulkan::m_manifest_mutex;
+	Map<String, PipelineManifestEntry> ShaderVulkan::m_manifest;
+	bool ShaderVulkan::m_manifest_loaded = false;
+	bool ShaderVulkan::m_manifest_dirty = false;
+	Ref<ThreadPool> ShaderVulkan::m_prewarm_threads;
+	int ShaderVulkan::m_prewarm_pending = 0;
+
+	static void destroy_descriptor_set_layout(VkDescriptorSetLayout layout)
+	{
+		if (layout == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		auto display = (DisplayVulkan*) Graphics::GetDisplay();
+		auto device = display->GetDevice();
+
+		// cached sets of the layout may be bound by pending commands
+		display->DestroyDeferred([=]() {
+			auto allocator = display->GetDescriptorAllocator();
+			if (allocator)
+			{
+				allocator->RemoveLayout(layout);
+			}
+			vkDestroyDescriptorSetLayout(device, layout, NULL);
+		});
+	}
+
 	ShaderVulkan::ShaderVulkan()
 	{
-		m_renderer_descriptor.pool = VK_NULL_HANDLE;
 		m_renderer_descriptor.layout = VK_NULL_HANDLE;
 	}
 
@@ -826,16 +770,11 @@ namespace Viry3D
 			i.pipelines.Clear();
 
 			vkDestroyPipelineLayout(device, i.pipeline_layout, NULL);
-			if (i.descriptor_pool)
-			{
-				vkDestroyDescriptorPool(device, i.descriptor_pool, NULL);
-			}
-			vkDestroyDescriptorSetLayout(device, i.descriptor_layout, NULL);
+			destroy_descriptor_set_layout(i.descriptor_layout);
 		}
 		m_passes.Clear();
 
-		vkDestroyDescriptorPool(device, m_renderer_descriptor.pool, NULL);
-		vkDestroyDescriptorSetLayout(device, m_renderer_descriptor.layout, NULL);
+		destroy_descriptor_set_layout(m_renderer_descriptor.layout);
 	}
 
 	void ShaderVulkan::Compile()
@@ -868,6 +807,20 @@ namespace Viry3D
 		return source;
 	}
 
+	bool ShaderVulkan::CompileSpirv(Vector<unsigned int>& spirv, const String& src, VkShaderStageFlagBits shader_type)
+	{
+		auto source = combine_shader_src(Vector<String>(), src);
+
+		String error;
+		bool success = glsl_to_spv(shader_type, source.CString(), spirv, error);
+		if (!success)
+		{
+			Log("%s", error.CString());
+		}
+
+		return success;
+	}
+
 	void ShaderVulkan::CreateShaders()
 	{
 		auto display = (DisplayVulkan*) Graphics::GetDisplay();
@@ -877,10 +830,12 @@ namespace Viry3D
 
 		for (const auto& i : xml.vss)
 		{
-			auto source = combine_shader_src(i.includes, i.src);
-
-			Vector<unsigned int> spirv;
-			compile_with_cache(spirv, source, VK_SHADER_STAGE_VERTEX_BIT);
+			Vector<unsigned int> spirv = i.spirv;
+			if (spirv.Empty())
+			{
+				auto source = combine_shader_src(i.includes, i.src);
+				compile_with_cache(spirv, source, VK_SHADER_STAGE_VERTEX_BIT);
+			}
 
 			VkShaderModule module = create_shader_module(device, &spirv[0], spirv.SizeInBytes());
 
@@ -889,10 +844,12 @@ namespace Viry3D
 
 		for (const auto& i : xml.pss)
 		{
-			auto source = combine_shader_src(i.includes, i.src);
-
-			Vector<unsigned int> spirv;
-			compile_with_cache(spirv, source, VK_SHADER_STAGE_FRAGMENT_BIT);
+			Vector<unsigned int> spirv = i.spirv;
+			if (spirv.Empty())
+			{
+				auto source = combine_shader_src(i.includes, i.src);
+				compile_with_cache(spirv, source, VK_SHADER_STAGE_FRAGMENT_BIT);
+			}
 
 			VkShaderModule module = create_shader_module(device, &spirv[0], spirv.SizeInBytes());
 
@@ -924,6 +881,7 @@ namespace Viry3D
 		auto display = (DisplayVulkan*) Graphics::GetDisplay();
 		auto device = display->GetDevice();
 
+		std::lock_guard<Mutex> lock(m_pipelines_mutex);
 		for (auto& i : m_passes)
 		{
 			for (auto& j : i.pipelines)
@@ -939,90 +897,392 @@ namespace Viry3D
 		auto display = (DisplayVulkan*) Graphics::GetDisplay();
 		auto device = display->GetDevice();
 		auto& pass = m_passes[index];
-		auto render_pass = RenderPass::GetRenderPassBinding()->GetVkRenderPass();
+		auto render_pass = RenderPass::GetRenderPassBinding();
+		const auto& key = render_pass->GetKey();
+
+		m_pipelines_mutex.lock();
+		bool created = pass.pipelines.Contains(key);
+		m_pipelines_mutex.unlock();
 
-		if (!pass.pipelines.Contains(render_pass))
+		if (!created)
 		{
 			VkPipeline pipeline;
-			pass.pipeline_info.renderPass = render_pass;
+			pass.pipeline_info.renderPass = render_pass->GetVkRenderPass();
 			VkResult err = vkCreateGraphicsPipelines(device, display->GetPipelineCache(), 1, &pass.pipeline_info, NULL, &pipeline);
 			assert(!err);
 
-			pass.pipelines.Add(render_pass, pipeline);
+			m_pipelines_mutex.lock();
+			if (pass.pipelines.Contains(key))
+			{
+				// added by AddPipelines while creating
+				vkDestroyPipeline(device, pipeline, NULL);
+			}
+			else
+			{
+				pass.pipelines.Add(key, pipeline);
+			}
+			m_pipelines_mutex.unlock();
+
+			// generated shaders can not be found by name on next launch
+			if (!((Shader*) this)->IsGenerated())
+			{
+				AddPipelineManifest(this->GetName(), index, key);
+			}
 		}
 	}
 
-	void ShaderVulkan::UpdateRendererDescriptorSet(Ref<DescriptorSet>& renderer_descriptor_set, Ref<UniformBuffer>& descriptor_set_buffer, const void* data, int size, int lightmap_index)
+	struct PipelineBuild
+	{
+		Ref<Shader> shader;
+		int pass_index;
+		RenderPassKey key;
+		VkPipeline pipeline;
+	};
+
+	void ShaderVulkan::CreatePipelines(Vector<PipelineBuild>& builds)
 	{
 		auto display = (DisplayVulkan*) Graphics::GetDisplay();
 		auto device = display->GetDevice();
-		bool update = false;
+		Map<RenderPassKey, VkRenderPass> render_passes;
+
+		for (auto& i : builds)
+		{
+			VkRenderPass* find;
+			if (!render_passes.TryGet(i.key, &find))
+			{
+				render_passes.Add(i.key, RenderPassVulkan::CreateCompatibleRenderPass(i.key));
+				render_passes.TryGet(i.key, &find);
+			}
+
+			// copy info, main thread may use pass.pipeline_info at same time
+			auto info = i.shader->m_passes[i.pass_index].pipeline_info;
+			info.renderPass = *find;
+			VkResult err = vkCreateGraphicsPipelines(device, display->GetPipelineCache(), 1, &info, NULL, &i.pipeline);
+			assert(!err);
+		}
+
+		for (const auto& i : render_passes)
+		{
+			vkDestroyRenderPass(device, i.second, NULL);
+		}
+	}
+
+	void ShaderVulkan::AddPipelines(const Vector<PipelineBuild>& builds)
+	{
+		auto display = (DisplayVulkan*) Graphics::GetDisplay();
+		auto device = display->GetDevice();
+
+		std::lock_guard<Mutex> lock(m_pipelines_mutex);
+		for (const auto& i : builds)
+		{
+			auto& pipelines = i.shader->m_passes[i.pass_index].pipelines;
+			if (pipelines.Contains(i.key))
+			{
+				// already created by PreparePass before this finished
+				vkDestroyPipeline(device, i.pipeline, NULL);
+			}
+			else
+			{
+				pipelines.Add(i.key, i.pipeline);
+			}
+		}
+	}
+
+	void ShaderVulkan::RebuildPipelinesAsync(VkFormat old_color_format, VkFormat new_color_format)
+	{
+		Vector<PipelineBuild> rebuilds;
+
+		Shader::m_mutex.lock();
+		for (const auto& i : Shader::m_shaders)
+		{
+			if (!i.second->m_compiled)
+			{
+				continue;
+			}
+
+			auto& passes = i.second->m_passes;
+			std::lock_guard<Mutex> lock(m_pipelines_mutex);
+			for (int j = 0; j < passes.Size(); j++)
+			{
+				for (const auto& k : passes[j].pipelines)
+				{
+					if (k.first.color_format == old_color_format)
+					{
+						PipelineBuild rebuild;
+						rebuild.shader = i.second;
+						rebuild.pass_index = j;
+						rebuild.key = k.first;
+						rebuild.key.color_format = new_color_format;
+						rebuild.pipeline = VK_NULL_HANDLE;
+						rebuilds.Add(rebuild);
+					}
+				}
+			}
+		}
+		Shader::m_mutex.unlock();
+
+		if (rebuilds.Empty())
+		{
+			return;
+		}
+
+		Resource::AddAsyncLoadTask({
+			[=]() {
+			auto result = rebuilds;
+			CreatePipelines(result);
+			return RefMake<Any>(result);
+		},
+			[](Ref<Any> any) {
+			AddPipelines(any->Get<Vector<PipelineBuild>>());
+		}
+		});
+	}
+
+	static String get_pipeline_manifest_path()
+	{
+		return Application::SavePath() + "/pipeline.manifest";
+	}
+
+	static String get_pipeline_manifest_line(const String& shader, int pass_index, const RenderPassKey& key)
+	{
+		return String::Format("%s|%d|%d|%d|%d",
+			shader.CString(),
+			pass_index,
+			(int) key.color_format,
+			(int) key.depth_format,
+			(int) key.samples);
+	}
+
+	void ShaderVulkan::LoadPipelineManifest()
+	{
+		if (m_manifest_loaded)
+		{
+			return;
+		}
+		m_manifest_loaded = true;
+
+		String path = get_pipeline_manifest_path();
+		if (!File::Exist(path))
+		{
+			return;
+		}
+
+		auto lines = File::ReadAllText(path).Split("\n", true);
+		for (const auto& i : lines)
+		{
+			auto parts = i.Split("|");
+			if (parts.Size() != 5)
+			{
+				continue;
+			}
+
+			PipelineManifestEntry entry;
+			entry.shader = parts[0];
+			entry.pass_index = parts[1].To<int>();
+			entry.key.color_format = (VkFormat) parts[2].To<int>();
+			entry.key.depth_format = (VkFormat) parts[3].To<int>();
+			entry.key.samples = (VkSampleCountFlagBits) parts[4].To<int>();
+			m_manifest.Add(i, entry);
+		}
+	}
+
+	void ShaderVulkan::AddPipelineManifest(const String& shader, int pass_index, const RenderPassKey& key)
+	{
+		std::lock_guard<Mutex> lock(m_manifest_mutex);
+
+		LoadPipelineManifest();
+
+		String line = get_pipeline_manifest_line(shader, pass_index, key);
+		if (!m_manifest.Contains(line))
+		{
+			PipelineManifestEntry entry;
+			entry.shader = shader;
+			entry.pass_index = pass_index;
+			entry.key = key;
+			m_manifest.Add(line, entry);
+			m_manifest_dirty = true;
+		}
+	}
+
+	void ShaderVulkan::SavePipelineManifest()
+	{
+		std::lock_guard<Mutex> lock(m_manifest_mutex);
+
+		if (!m_manifest_dirty)
+		{
+			return;
+		}
+		m_manifest_dirty = false;
+
+		String text;
+		for (const auto& i : m_manifest)
+		{
+			text += i.first + "\n";
+		}
+		File::WriteAllText(get_pipeline_manifest_path(), text);
+	}
+
+	void ShaderVulkan::PrewarmPipelines(Action done)
+	{
+		Map<String, Vector<PipelineManifestEntry>> shader_entries;
+
+		m_manifest_mutex.lock();
+		LoadPipelineManifest();
+		for (const auto& i : m_manifest)
+		{
+			if (!shader_entries.Contains(i.second.shader))
+			{
+				shader_entries.Add(i.second.shader, Vector<PipelineManifestEntry>());
+			}
+			shader_entries[i.second.shader].Add(i.second);
+		}
+		m_manifest_mutex.unlock();
+
+		if (shader_entries.Empty())
+		{
+			if (done)
+			{
+				done();
+			}
+			return;
+		}
+
+		// prewarm threads live while any prewarm is pending, all counted on main thread
+		m_prewarm_pending += shader_entries.Size();
+		auto remain = RefMake<int>(shader_entries.Size());
+		auto finish = [=]() {
+			(*remain)--;
+			m_prewarm_pending--;
+			if (m_prewarm_pending == 0)
+			{
+				m_prewarm_threads.reset();
+			}
+			if (*remain == 0 && done)
+			{
+				done();
+			}
+		};
+
+		for (const auto& i : shader_entries)
+		{
+			auto entries = i.second;
 
+			// shaders compile on resource load thread, pipelines of each shader on a prewarm thread
+			Shader::FindAsync(i.first, [=](const Ref<Shader>& shader) {
+				Vector<PipelineBuild> builds;
+
+				if (shader)
+				{
+					std::lock_guard<Mutex> lock(m_pipelines_mutex);
+					for (const auto& j : entries)
+					{
+						if (j.pass_index < shader->m_passes.Size() &&
+							!shader->m_passes[j.pass_index].pipelines.Contains(j.key))
+						{
+							PipelineBuild build;
+							build.shader = shader;
+							build.pass_index = j.pass_index;
+							build.key = j.key;
+							build.pipeline = VK_NULL_HANDLE;
+							builds.Add(build);
+						}
+					}
+				}
+
+				if (builds.Empty())
+				{
+					finish();
+					return;
+				}
+
+				if (!m_prewarm_threads)
+				{
+					int thread_count = (int) std::thread::hardware_concurrency() - 1;
+					if (thread_count < 1)
+					{
+						thread_count = 1;
+					}
+					m_prewarm_threads = RefMake<ThreadPool>(thread_count);
+				}
+
+				m_prewarm_threads->AddTask({
+					[=]() {
+					auto result = builds;
+					CreatePipelines(result);
+					return RefMake<Any>(result);
+				},
+					[=](Ref<Any> any) {
+					AddPipelines(any->Get<Vector<PipelineBuild>>());
+					finish();
+				}
+				});
+			});
+		}
+	}
+
+	void ShaderVulkan::UpdateRendererDescriptorSet(Ref<DescriptorSet>& renderer_descriptor_set, Ref<UniformBuffer>& descriptor_set_buffer, const void* data, int size, int lightmap_index)
+	{
 		if (!renderer_descriptor_set)
 		{
-			auto set = RefMake<DescriptorSetVulkan>();
-			set->set = CreateRendererDescriptorSet();
-			renderer_descriptor_set = set;
-			update = true;
+			renderer_descriptor_set = RefMake<DescriptorSetVulkan>();
 		}
 
 		if (!descriptor_set_buffer)
 		{
 			descriptor_set_buffer = UniformBuffer::Create(size);
-			update = true;
 		}
 
 		descriptor_set_buffer->UpdateRange(0, size, data);
+		RefCast<DescriptorSetVulkan>(renderer_descriptor_set)->buffer = descriptor_set_buffer.get();
 
-		if (update)
-		{
-			Vector<VkWriteDescriptorSet> writes;
+		// transient ring is replaced when it grows, key is unchanged otherwise and update returns early
+		Vector<VkWriteDescriptorSet> writes;
 
-			VkDescriptorBufferInfo buffer = {
-				descriptor_set_buffer->GetBuffer(),
-				0,
-				(VkDeviceSize) descriptor_set_buffer->GetSize()
-			};
+		VkDescriptorBufferInfo buffer = {
+			descriptor_set_buffer->GetBuffer(),
+			0,
+			(VkDeviceSize) descriptor_set_buffer->GetSize()
+		};
 
+		writes.Add({
+			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			NULL,
+			VK_NULL_HANDLE,
+			0,
+			0,
+			1,
+			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+			NULL,
+			&buffer,
+			NULL
+		});
+
+		VkDescriptorImageInfo image;
+
+		if (lightmap_index >= 0)
+		{
+			auto tex = (TextureVulkan*) LightmapSettings::GetLightmap(lightmap_index);
+			image = {
+				tex->GetSampler(),
+				tex->GetImageView(),
+				VK_IMAGE_LAYOUT_GENERAL
+			};
 			writes.Add({
 				VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
 				NULL,
-				RefCast<DescriptorSetVulkan>(renderer_descriptor_set)->set,
-				0,
+				VK_NULL_HANDLE,
+				1,
 				0,
 				1,
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				&image,
 				NULL,
-				&buffer,
 				NULL
 			});
-
-			VkDescriptorImageInfo image;
-
-			if (lightmap_index >= 0)
-			{
-				auto tex = (TextureVulkan*) LightmapSettings::GetLightmap(lightmap_index);
-				image = {
-					tex->GetSampler(),
-					tex->GetImageView(),
-					VK_IMAGE_LAYOUT_GENERAL
-				};
-				writes.Add({
-					VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-					NULL,
-					RefCast<DescriptorSetVulkan>(renderer_descriptor_set)->set,
-					1,
-					0,
-					1,
-					VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-					&image,
-					NULL,
-					NULL
-				});
-			}
-
-			vkUpdateDescriptorSets(device, writes.Size(), &writes[0], 0, NULL);
 		}
+
+		auto key = DescriptorKey::FromWrites(m_renderer_descriptor.layout, &writes[0], writes.Size());
+		RefCast<DescriptorSetVulkan>(renderer_descriptor_set)->Update(key);
 	}
 
 	void ShaderVulkan::BindMaterial(int index, const Ref<Material>& material, const Ref<DescriptorSet>& renderer_descriptor_set)
@@ -1032,12 +1292,31 @@ namespace Viry3D
 		auto& descriptor_set = RefCast<MaterialVulkan>(material)->GetDescriptorSet(index);
 		VkCommandBuffer cmd = display->GetCurrentDrawCommand();
 
+		auto material_set = RefCast<DescriptorSetVulkan>(descriptor_set);
+		auto renderer_set = RefCast<DescriptorSetVulkan>(renderer_descriptor_set);
+
 		Vector<VkDescriptorSet> ds(2);
-		ds[0] = RefCast<DescriptorSetVulkan>(descriptor_set)->set;
-		ds[1] = RefCast<DescriptorSetVulkan>(renderer_descriptor_set)->set;
+		ds[0] = material_set->set;
+		ds[1] = renderer_set->set;
+
+		// dynamic offsets in set then binding order, material uniforms share one transient copy
+		Vector<uint32_t> offsets;
+		auto& uniform_buffer = RefCast<MaterialVulkan>(material)->GetUniformBuffer(index);
+		if (uniform_buffer)
+		{
+			uint32_t offset = (uint32_t) uniform_buffer->MarkGpuRead();
+			for (const auto& i : pass.binds)
+			{
+				if (i.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
+				{
+					offsets.Add(offset);
+				}
+			}
+		}
+		offsets.Add(renderer_set->buffer ? (uint32_t) renderer_set->buffer->MarkGpuRead() : 0);
 
 		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
-			pass.pipeline_layout, 0, 2, &ds[0], 0, NULL);
+			pass.pipeline_layout, 0, 2, &ds[0], offsets.Size(), &offsets[0]);
 	}
 
 	void ShaderVulkan::BeginPass(int index)
@@ -1046,7 +1325,19 @@ namespace Viry3D
 		auto& pass = m_passes[index];
 		auto render_pass = RenderPass::GetRenderPassBinding();
 		VkCommandBuffer cmd = display->GetCurrentDrawCommand();
-		VkPipeline pipeline = pass.pipelines[render_pass->GetVkRenderPass()];
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkPipeline* find;
+		m_pipelines_mutex.lock();
+		if (pass.pipelines.TryGet(render_pass->GetKey(), &find))
+		{
+			pipeline = *find;
+		}
+		m_pipelines_mutex.unlock();
+		if (pipeline == VK_NULL_HANDLE)
+		{
+			// PreparePass was not called for this render pass
+			return;
+		}
 
 		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
@@ -19,23 +19,22 @@
 
 #include "Object.h"
 #include "vulkan_include.h"
+#include "RenderPassVulkan.h"
 #include "graphics/Texture.h"
 #include "graphics/UniformBuffer.h"
 #include "math/Matrix4x4.h"
+#include "thread/Thread.h"
 
 namespace Viry3D
 {
-#define DESCRIPTOR_POOL_SIZE_MAX 65536
-
 	struct ShaderPass
 	{
 		String name;
 		Vector<VkDescriptorSetLayoutBinding> binds;
 		VkDescriptorSetLayout descriptor_layout;
-		VkDescriptorPool descriptor_pool;
 		VkPipelineLayout pipeline_layout;
 
-		Map<VkRenderPass, VkPipeline> pipelines;
+		Map<RenderPassKey, VkPipeline> pipelines;
 		VkGraphicsPipelineCreateInfo pipeline_info;
 		VkPipelineDynamicStateCreateInfo dynamic_state;
 		VkDynamicState dynamic_state_enables[VK_DYNAMIC_STATE_RANGE_SIZE];
@@ -60,15 +59,30 @@ namespace Viry3D
 	struct RendererDescriptor
 	{
 		VkDescriptorSetLayout layout;
-		VkDescriptorPool pool;
 	};
 
+	//	shader pass and render pass combination drawn before, replayed by PrewarmPipelines
+	struct PipelineManifestEntry
+	{
+		String shader;
+		int pass_index;
+		RenderPassKey key;
+	};
+
+	struct PipelineBuild;
 	class Material;
 	class DescriptorSet;
 
 	class ShaderVulkan: public Object
 	{
 	public:
+		static bool CompileSpirv(Vector<unsigned int>& spirv, const String& src, VkShaderStageFlagBits shader_type);
+		//	create pipelines for new color format on resource load thread, e.g. surface format changed
+		static void RebuildPipelinesAsync(VkFormat old_color_format, VkFormat new_color_format);
+		//	create pipelines recorded in manifest on worker threads, e.g. on loading screen, done run on main thread
+		static void PrewarmPipelines(Action done = NULL);
+		static void SavePipelineManifest();
+
 		ShaderVulkan();
 		virtual ~ShaderVulkan();
 		int GetPassCount() const { return m_passes.Size(); }
@@ -81,8 +95,8 @@ namespace Viry3D
 		void BindRendererDescriptorSet(int index, Ref<UniformBuffer>& descriptor_set_buffer, int lightmap_index) { }
 		void EndPass(int index);
 
-		VkDescriptorSet CreateDescriptorSet(int index);
-		VkDescriptorSet CreateRendererDescriptorSet();
+		VkDescriptorSetLayout GetDescriptorSetLayout(int index) const { return m_passes[index].descriptor_layout; }
+		VkDescriptorSetLayout GetRendererDescriptorSetLayout() const { return m_renderer_descriptor.layout; }
 		Ref<UniformBuffer> CreateUniformBuffer(int index);
 		Vector<VkWriteDescriptorSet>& GetDescriptorSetWriteInfo(int index);
 		const Vector<const void*>& GetUniformXmls(int index);
@@ -91,9 +105,22 @@ namespace Viry3D
 		void Compile();
 
 	private:
+		static void LoadPipelineManifest();
+		static void AddPipelineManifest(const String& shader, int pass_index, const RenderPassKey& key);
+		static void CreatePipelines(Vector<PipelineBuild>& builds);
+		static void AddPipelines(const Vector<PipelineBuild>& builds);
 		void CreateShaders();
 		void CreatePasses();
 
+		// pass pipelines are added by main loop callbacks while render thread records
+		static Mutex m_pipelines_mutex;
+		static Mutex m_manifest_mutex;
+		static Map<String, PipelineManifestEntry> m_manifest;
+		static bool m_manifest_loaded;
+		static bool m_manifest_dirty;
+		static Ref<ThreadPool> m_prewarm_threads;
+		static int m_prewarm_pending;
+
 		Vector<ShaderPass> m_passes;
 		Map<String, VkShaderModule> m_vertex_shaders;
 		Map<String, VkShaderModule> m_pixel_shaders;
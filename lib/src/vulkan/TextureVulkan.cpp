@@ -22,7 +22,7 @@
 #include "graphics/RenderTexture.h"
 #include "graphics/Texture2D.h"
 #include "graphics/Cubemap.h"
-#include "graphics/ImageBuffer.h"
+#include "UploadQueueVulkan.h"
 
 #if VR_VULKAN
 
@@ -31,26 +31,44 @@ namespace Viry3D
 	TextureVulkan::TextureVulkan():
 		m_format(VK_FORMAT_UNDEFINED),
 		m_image(VK_NULL_HANDLE),
-		m_memory(VK_NULL_HANDLE),
 		m_image_view(VK_NULL_HANDLE),
-		m_sampler(VK_NULL_HANDLE)
+		m_sampler(VK_NULL_HANDLE),
+		m_uploaded(false)
 	{
 		SetName("TextureVulkan");
-		Memory::Zero(&m_memory_info, sizeof(m_memory_info));
+		Memory::Zero(&m_memory, sizeof(m_memory));
 	}
 
 	TextureVulkan::~TextureVulkan()
 	{
 		auto display = (DisplayVulkan*) Graphics::GetDisplay();
 		auto device = display->GetDevice();
+		auto allocator = display->GetMemoryAllocator();
+		auto sampler = m_sampler;
+		auto image_view = m_image_view;
+		auto memory = m_memory;
+		auto image = m_image;
+
+		display->DestroyDeferred([=]() {
+			// handles may be reused, cached descriptor sets must not match them
+			auto descriptor_allocator = display->GetDescriptorAllocator();
+			if (descriptor_allocator)
+			{
+				if (sampler)
+				{
+					descriptor_allocator->RemoveSampler(sampler);
+				}
+				descriptor_allocator->RemoveImageView(image_view);
+			}
 
-		if (m_sampler)
-		{
-			vkDestroySampler(device, m_sampler, NULL);
-		}
-		vkDestroyImageView(device, m_image_view, NULL);
-		vkFreeMemory(device, m_memory, NULL);
-		vkDestroyImage(device, m_image, NULL);
+			if (sampler)
+			{
+				vkDestroySampler(device, sampler, NULL);
+			}
+			vkDestroyImageView(device, image_view, NULL);
+			vkDestroyImage(device, image, NULL);
+			allocator->Free(memory);
+		});
 	}
 
 	void TextureVulkan::CreateColorRenderTexture()
@@ -71,8 +89,9 @@ namespace Viry3D
 				break;
 		}
 
+		// transfer src for pixel readback
 		this->Create(VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			VK_IMAGE_LAYOUT_UNDEFINED,
 			false);
@@ -167,12 +186,17 @@ namespace Viry3D
 			m_format = VK_FORMAT_R8_UNORM;
 			buffer_size = width * height;
 		}
+		else if (format == TextureFormat::RGBAFloat)
+		{
+			m_format = VK_FORMAT_R32G32B32A32_SFLOAT;
+			buffer_size = width * height * 16;
+		}
 		else
 		{
 			assert(!"texture format not implement");
 		}
 
-		m_image_buffers.Add(ImageBuffer::Create(buffer_size));
+		assert(colors.Size() == buffer_size);
 
 		Create(VK_IMAGE_TILING_OPTIMAL,
 			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
@@ -185,9 +209,8 @@ namespace Viry3D
 			false);
 
 		this->CreateSampler();
-		this->FillImageBuffer(colors, m_image_buffers[0], 0, buffer_size);
 		this->CopyBufferImageBegin();
-		this->CopyBufferImage(m_image_buffers[0], 0, 0, width, height);
+		this->CopyBufferImage(colors, 0, 0, width, height);
 		this->CopyBufferImageEnd();
 		this->GenerateMipmap();
 	}
@@ -197,6 +220,7 @@ namespace Viry3D
 		auto texture = (Texture2D*) this;
 		auto format = texture->GetFormat();
 		int buffer_size;
+		ByteBuffer colors_local = colors;
 
 		if (format == TextureFormat::RGBA32)
 		{
@@ -217,26 +241,27 @@ namespace Viry3D
 				temp[i * 4 + 2] = colors[i * 3 + 2];
 				temp[i * 4 + 3] = 255;
 			}
+			colors_local = temp;
 		}
 		else if (format == TextureFormat::R8)
 		{
 			m_format = VK_FORMAT_R8_UNORM;
 			buffer_size = w * h;
 		}
+		else if (format == TextureFormat::RGBAFloat)
+		{
+			m_format = VK_FORMAT_R32G32B32A32_SFLOAT;
+			buffer_size = w * h * 16;
+		}
 		else
 		{
 			assert(!"texture format not implement");
 		}
 
-		if (m_image_buffers.Empty() || m_image_buffers[0]->GetSize() < buffer_size)
-		{
-			m_image_buffers.Clear();
-			m_image_buffers.Add(ImageBuffer::Create(buffer_size));
-		}
+		assert(colors_local.Size() == buffer_size);
 
-		this->FillImageBuffer(colors, m_image_buffers[0], 0, buffer_size);
 		this->CopyBufferImageBegin();
-		this->CopyBufferImage(m_image_buffers[0], x, y, w, h);
+		this->CopyBufferImage(colors_local, x, y, w, h);
 		this->CopyBufferImageEnd();
 	}
 
@@ -268,6 +293,16 @@ namespace Viry3D
 		image.flags = cubemap ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
 		image.arrayLayers = cubemap ? 6 : 1;
 
+		// uploaded images are used by transfer and graphics queue without ownership transfer
+		auto upload = display->GetUploadQueue();
+		uint32_t queue_families[2] = { upload->GetGraphicsFamily(), upload->GetTransferFamily() };
+		if ((usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0 && upload->IsTransferQueueSeparate())
+		{
+			image.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			image.queueFamilyIndexCount = 2;
+			image.pQueueFamilyIndices = queue_families;
+		}
+
 		err = vkCreateImage(device, &image, NULL, &m_image);
 		assert(!err);
 
@@ -275,21 +310,17 @@ namespace Viry3D
 		vkGetImageMemoryRequirements(device, m_image, &mem_reqs);
 		assert(!err);
 
-		m_memory_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		m_memory_info.pNext = NULL;
-		m_memory_info.allocationSize = mem_reqs.size;
-		m_memory_info.memoryTypeIndex = 0;
-
+		uint32_t type_index = 0;
 		bool pass = display->CheckMemoryType(
 			mem_reqs.memoryTypeBits,
 			required_props,
-			&m_memory_info.memoryTypeIndex);
+			&type_index);
 		assert(pass);
 
-		err = vkAllocateMemory(device, &m_memory_info, NULL, &m_memory);
-		assert(!err);
+		pass = display->GetMemoryAllocator()->Allocate(mem_reqs, type_index, tiling == VK_IMAGE_TILING_LINEAR, &m_memory);
+		assert(pass);
 
-		err = vkBindImageMemory(device, m_image, m_memory, 0);
+		err = vkBindImageMemory(device, m_image, m_memory.memory, m_memory.offset);
 		assert(!err);
 	}
 
@@ -325,7 +356,15 @@ namespace Viry3D
 
 		if (m_sampler)
 		{
-			vkDestroySampler(device, m_sampler, NULL);
+			auto sampler = m_sampler;
+			display->DestroyDeferred([=]() {
+				auto descriptor_allocator = display->GetDescriptorAllocator();
+				if (descriptor_allocator)
+				{
+					descriptor_allocator->RemoveSampler(sampler);
+				}
+				vkDestroySampler(device, sampler, NULL);
+			});
 			m_sampler = VK_NULL_HANDLE;
 		}
 
@@ -388,18 +427,18 @@ namespace Viry3D
 		assert(!err);
 	}
 
-	void TextureVulkan::FillImageBuffer(const ByteBuffer& buffer, const Ref<ImageBuffer>& image_buffer, int offset, int size)
+	VkCommandBuffer TextureVulkan::GetUploadCommandBuffer() const
 	{
 		auto display = (DisplayVulkan*) Graphics::GetDisplay();
-		auto device = display->GetDevice();
-		VkResult err;
+		auto upload = display->GetUploadQueue();
 
-		assert(buffer.Size() == size);
+		// rendering may sample an uploaded image, only graphics queue is ordered with it
+		if (m_uploaded)
+		{
+			return upload->GetGraphicsCommandBuffer();
+		}
 
-		void* mapped;
-		err = vkMapMemory(device, image_buffer->GetMemory(), offset, size, 0, &mapped);
-		Memory::Copy(mapped, buffer.Bytes(), buffer.Size());
-		vkUnmapMemory(device, image_buffer->GetMemory());
+		return upload->GetCopyCommandBuffer();
 	}
 
 	void TextureVulkan::CopyBufferImageBegin(bool cubemap)
@@ -414,25 +453,31 @@ namespace Viry3D
 		subresourceRange.levelCount = mip_count;
 		subresourceRange.layerCount = cubemap ? 6 : 1;
 
-		display->BeginImageCommandBuffer();
+		display->GetUploadQueue()->Begin();
 
+		// keep content outside updated region
 		display->SetImageLayout(
+			this->GetUploadCommandBuffer(),
 			m_image,
 			VK_IMAGE_ASPECT_COLOR_BIT,
-			VK_IMAGE_LAYOUT_UNDEFINED,
+			m_uploaded ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			(VkAccessFlagBits) 0,
+			m_uploaded ? VK_ACCESS_SHADER_READ_BIT : (VkAccessFlagBits) 0,
 			&subresourceRange);
 	}
 
-	void TextureVulkan::CopyBufferImage(const Ref<ImageBuffer>& image_buffer, int x, int y, int w, int h, bool cubemap, int face, int level)
+	void TextureVulkan::CopyBufferImage(const ByteBuffer& colors, int x, int y, int w, int h, int face, int level)
 	{
-		auto texture = (Texture*) this;
-		auto mip_count = texture->GetMipmapCount();
 		auto display = (DisplayVulkan*) Graphics::GetDisplay();
 
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		void* mapped = display->GetUploadQueue()->AllocateStaging(colors.Size(), &buffer, &offset);
+		Memory::Copy(mapped, colors.Bytes(), colors.Size());
+
 		VkBufferImageCopy copy;
 		Memory::Zero(&copy, sizeof(copy));
+		copy.bufferOffset = offset;
 		copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		copy.imageSubresource.mipLevel = level;
 		copy.imageSubresource.baseArrayLayer = face;
@@ -443,13 +488,9 @@ namespace Viry3D
 		copy.imageOffset.x = x;
 		copy.imageOffset.y = y;
 
-		if (cubemap)
-		{
-			copy.bufferOffset = image_buffer->GetSize() / 6 * face;
-		}
-
-		vkCmdCopyBufferToImage(display->GetImageCommandBuffer(),
-			image_buffer->GetBuffer(),
+		// staging allocation may have submitted the batch, get command buffer after it
+		vkCmdCopyBufferToImage(this->GetUploadCommandBuffer(),
+			buffer,
 			m_image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			1,
@@ -461,6 +502,7 @@ namespace Viry3D
 		auto texture = (Texture*) this;
 		auto mip_count = texture->GetMipmapCount();
 		auto display = (DisplayVulkan*) Graphics::GetDisplay();
+		auto upload = display->GetUploadQueue();
 
 		VkImageSubresourceRange subresourceRange = { };
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -468,7 +510,9 @@ namespace Viry3D
 		subresourceRange.levelCount = mip_count;
 		subresourceRange.layerCount = cubemap ? 6 : 1;
 
+		// shader read layout is set on graphics queue, transfer queue has no shader stages
 		display->SetImageLayout(
+			upload->GetGraphicsCommandBuffer(),
 			m_image,
 			VK_IMAGE_ASPECT_COLOR_BIT,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
@@ -476,7 +520,9 @@ namespace Viry3D
 			VK_ACCESS_TRANSFER_WRITE_BIT,
 			&subresourceRange);
 
-		display->EndImageCommandBuffer();
+		m_uploaded = true;
+
+		upload->End();
 	}
 
 	void TextureVulkan::GenerateMipmap(bool cubemap)
@@ -494,8 +540,11 @@ namespace Viry3D
 		}
 
 		auto display = (DisplayVulkan*) Graphics::GetDisplay();
+		auto upload = display->GetUploadQueue();
 
-		display->BeginImageCommandBuffer();
+		// blit needs graphics queue
+		upload->Begin();
+		VkCommandBuffer cmd = upload->GetGraphicsCommandBuffer();
 
 		VkImageSubresourceRange range;
 		Memory::Zero(&range, sizeof(range));
@@ -506,6 +555,7 @@ namespace Viry3D
 		range.layerCount = layer_count;
 
 		display->SetImageLayout(
+			cmd,
 			m_image,
 			VK_IMAGE_ASPECT_COLOR_BIT,
 			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
@@ -539,6 +589,7 @@ namespace Viry3D
 			range.layerCount = layer_count;
 
 			display->SetImageLayout(
+				cmd,
 				m_image,
 				VK_IMAGE_ASPECT_COLOR_BIT,
 				VK_IMAGE_LAYOUT_UNDEFINED,
@@ -547,7 +598,7 @@ namespace Viry3D
 				&range);
 
 			vkCmdBlitImage(
-				display->GetImageCommandBuffer(),
+				cmd,
 				m_image,
 				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
 				m_image,
@@ -557,6 +608,7 @@ namespace Viry3D
 				VK_FILTER_LINEAR);
 
 			display->SetImageLayout(
+				cmd,
 				m_image,
 				VK_IMAGE_ASPECT_COLOR_BIT,
 				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
@@ -571,6 +623,7 @@ namespace Viry3D
 		range.layerCount = layer_count;
 
 		display->SetImageLayout(
+			cmd,
 			m_image,
 			VK_IMAGE_ASPECT_COLOR_BIT,
 			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
@@ -578,7 +631,7 @@ namespace Viry3D
 			VK_ACCESS_TRANSFER_READ_BIT,
 			&range);
 
-		display->EndImageCommandBuffer();
+		upload->End();
 	}
 
 	void TextureVulkan::CreateCubemap()
@@ -660,14 +713,9 @@ namespace Viry3D
 			buffer_size = width * height;
 		}
 
-		if (m_image_buffers.Size() <= level)
-		{
-			m_image_buffers.Resize(level + 1);
-			m_image_buffers[level] = ImageBuffer::Create(buffer_size * 6);
-		}
+		assert(colors_local.Size() == buffer_size);
 
-		this->FillImageBuffer(colors_local, m_image_buffers[level], buffer_size * face, buffer_size);
-		this->CopyBufferImage(m_image_buffers[level], 0, 0, width, height, true, face, level);
+		this->CopyBufferImage(colors_local, 0, 0, width, height, face, level);
 	}
 
 	void TextureVulkan::UpdateCubemapFaceEnd()
@@ -19,11 +19,10 @@
 
 #include "vulkan_include.h"
 #include "Object.h"
+#include "MemoryAllocatorVulkan.h"
 
 namespace Viry3D
 {
-	class ImageBuffer;
-
 	class TextureVulkan: public Object
 	{
 	public:
@@ -55,18 +54,18 @@ namespace Viry3D
 			VkImageLayout init_layout,
 			bool cubemap);
 		void CreateView(VkImageAspectFlags aspect_mask, VkComponentMapping components, bool cubemap);
-		void FillImageBuffer(const ByteBuffer& buffer, const Ref<ImageBuffer>& image_buffer, int offset, int size);
 		void CopyBufferImageBegin(bool cubemap = false);
-		void CopyBufferImage(const Ref<ImageBuffer>& image_buffer, int x, int y, int w, int h, bool cubemap = false, int face = 0, int level = 0);
+		void CopyBufferImage(const ByteBuffer& colors, int x, int y, int w, int h, int face = 0, int level = 0);
 		void CopyBufferImageEnd(bool cubemap = false);
+		//	image never sampled yet goes through copy queue, later updates through graphics queue
+		VkCommandBuffer GetUploadCommandBuffer() const;
 		void CreateSampler();
 
 		VkFormat m_format;
 		VkImage m_image;
-		VkMemoryAllocateInfo m_memory_info;
-		VkDeviceMemory m_memory;
+		MemoryAllocation m_memory;
 		VkImageView m_image_view;
 		VkSampler m_sampler;
-		Vector<Ref<ImageBuffer>> m_image_buffers;
+		bool m_uploaded;
 	};
 }
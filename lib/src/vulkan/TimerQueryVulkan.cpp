@@ -0,0 +1,147 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "TimerQueryVulkan.h"
+#include "Debug.h"
+
+#define TIMESTAMP_COUNT_MAX 1024
+
+#if VR_VULKAN
+
+namespace Viry3D
+{
+	TimerQueryVulkan::TimerQueryVulkan(VkDevice device, int frame_count, uint32_t valid_bits, float period):
+		m_device(device),
+		m_valid_bits(valid_bits),
+		m_period(period),
+		m_frame_index(0),
+		m_reset(false),
+		m_count(0)
+	{
+		if (!this->IsSupported())
+		{
+			return;
+		}
+
+		m_pools.Resize(frame_count);
+		m_counts.Resize(frame_count);
+
+		for (int i = 0; i < m_pools.Size(); i++)
+		{
+			VkQueryPoolCreateInfo info = {
+				VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+				NULL,
+				0,
+				VK_QUERY_TYPE_TIMESTAMP,
+				TIMESTAMP_COUNT_MAX,
+				0
+			};
+
+			VkResult err = vkCreateQueryPool(m_device, &info, NULL, &m_pools[i]);
+			assert(!err);
+
+			m_counts[i] = 0;
+		}
+	}
+
+	TimerQueryVulkan::~TimerQueryVulkan()
+	{
+		for (auto i : m_pools)
+		{
+			vkDestroyQueryPool(m_device, i, NULL);
+		}
+		m_pools.Clear();
+	}
+
+	bool TimerQueryVulkan::BeginFrame(int frame_index, Vector<double>& timestamps)
+	{
+		if (!this->IsSupported())
+		{
+			return false;
+		}
+
+		// finish frame recorded into last slot, writes past a full pool were dropped
+		m_counts[m_frame_index] = m_count < TIMESTAMP_COUNT_MAX ? (int) m_count : TIMESTAMP_COUNT_MAX;
+
+		m_frame_index = frame_index;
+		m_reset = false;
+		m_count = 0;
+
+		int count = m_counts[frame_index];
+		m_counts[frame_index] = 0;
+		if (count == 0)
+		{
+			return false;
+		}
+
+		Vector<uint64_t> values(count);
+		VkResult err = vkGetQueryPoolResults(m_device, m_pools[frame_index], 0, count,
+			count * sizeof(uint64_t), &values[0], sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT);
+		if (err != VK_SUCCESS)
+		{
+			return false;
+		}
+
+		uint64_t mask = m_valid_bits >= 64 ? ~0ULL : (1ULL << m_valid_bits) - 1;
+
+		timestamps.Resize(count);
+		for (int i = 0; i < count; i++)
+		{
+			// relative to first timestamp keeps precision of double, counter may wrap
+			int64_t ticks = (int64_t) ((values[i] - values[0]) & mask);
+			if (mask != ~0ULL && ticks > (int64_t) (mask >> 1))
+			{
+				ticks -= (int64_t) mask + 1;
+			}
+			timestamps[i] = ticks * (double) m_period / 1000000.0;
+		}
+
+		return true;
+	}
+
+	void TimerQueryVulkan::ResetFrame(VkCommandBuffer cmd)
+	{
+		if (!this->IsSupported() || m_reset)
+		{
+			return;
+		}
+
+		vkCmdResetQueryPool(cmd, m_pools[m_frame_index], 0, TIMESTAMP_COUNT_MAX);
+		m_reset = true;
+	}
+
+	int TimerQueryVulkan::Write(VkCommandBuffer cmd, VkPipelineStageFlagBits stage)
+	{
+		if (!this->IsSupported() || !m_reset)
+		{
+			return -1;
+		}
+
+		int index = m_count++;
+		if (index >= TIMESTAMP_COUNT_MAX)
+		{
+			return -1;
+		}
+
+		vkCmdWriteTimestamp(cmd, stage, m_pools[m_frame_index], index);
+
+		return index;
+	}
+}
+
+#endif
@@ -0,0 +1,53 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "vulkan_include.h"
+#include "container/Vector.h"
+#include <atomic>
+
+namespace Viry3D
+{
+	//	timestamp query pool per frame slot, results are read when the slot is reused,
+	//	so reading never waits the gpu
+	class TimerQueryVulkan
+	{
+	public:
+		//	valid_bits of graphics queue family, 0 means timestamps are not supported
+		TimerQueryVulkan(VkDevice device, int frame_count, uint32_t valid_bits, float period);
+		~TimerQueryVulkan();
+		bool IsSupported() const { return m_valid_bits > 0; }
+		//	call after gpu finished the frame used this slot before,
+		//	gets its timestamps in ms, false when it wrote none
+		bool BeginFrame(int frame_index, Vector<double>& timestamps);
+		//	record reset of frame pool into first command buffer of frame, outside render pass
+		void ResetFrame(VkCommandBuffer cmd);
+		//	any thread, -1 when pool of frame is full or reset is not recorded yet
+		int Write(VkCommandBuffer cmd, VkPipelineStageFlagBits stage);
+
+	private:
+		VkDevice m_device;
+		uint32_t m_valid_bits;
+		float m_period;
+		Vector<VkQueryPool> m_pools;
+		Vector<int> m_counts;
+		int m_frame_index;
+		bool m_reset;
+		std::atomic<int> m_count;
+	};
+}
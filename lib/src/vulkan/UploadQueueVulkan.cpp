@@ -0,0 +1,483 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "UploadQueueVulkan.h"
+#include "graphics/ImageBuffer.h"
+#include "memory/Memory.h"
+#include "Application.h"
+
+#define STAGING_RING_SIZE (32 * 1024 * 1024)
+#define STAGING_ALIGNMENT 16
+
+#if VR_VULKAN
+
+namespace Viry3D
+{
+	UploadQueueVulkan::UploadQueueVulkan(VkDevice device,
+		VkQueue graphics_queue,
+		uint32_t graphics_family,
+		Mutex* graphics_queue_mutex,
+		VkQueue transfer_queue,
+		uint32_t transfer_family):
+		m_device(device),
+		m_graphics_queue(graphics_queue),
+		m_graphics_family(graphics_family),
+		m_graphics_queue_mutex(graphics_queue_mutex),
+		m_transfer_queue(transfer_queue),
+		m_transfer_family(transfer_family),
+		m_copy_cmd_pool(VK_NULL_HANDLE),
+		m_graphics_cmd_pool(VK_NULL_HANDLE),
+		m_recording(NULL),
+		m_wait_semaphore(VK_NULL_HANDLE),
+		m_ring_head(0),
+		m_ring_tail(0),
+		m_ring_empty(true)
+	{
+		VkResult err;
+
+		VkCommandPoolCreateInfo cmd_pool_info = {
+			VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			NULL,
+			VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+			this->IsTransferQueueSeparate() ? m_transfer_family : m_graphics_family,
+		};
+		err = vkCreateCommandPool(m_device, &cmd_pool_info, NULL, &m_copy_cmd_pool);
+		assert(!err);
+
+		if (this->IsTransferQueueSeparate())
+		{
+			cmd_pool_info.queueFamilyIndex = m_graphics_family;
+			err = vkCreateCommandPool(m_device, &cmd_pool_info, NULL, &m_graphics_cmd_pool);
+			assert(!err);
+		}
+
+		m_ring = ImageBuffer::Create(STAGING_RING_SIZE);
+	}
+
+	UploadQueueVulkan::~UploadQueueVulkan()
+	{
+		// device is idle here
+		Vector<Batch*> batches = m_free_batches;
+		if (m_recording)
+		{
+			batches.Add(m_recording);
+		}
+		for (auto i : m_flushed)
+		{
+			batches.Add(i);
+		}
+
+		for (auto i : batches)
+		{
+			vkDestroyFence(m_device, i->fence, NULL);
+			if (i->copy_semaphore)
+			{
+				vkDestroySemaphore(m_device, i->copy_semaphore, NULL);
+			}
+			if (i->semaphore)
+			{
+				vkDestroySemaphore(m_device, i->semaphore, NULL);
+			}
+			if (i->waited_semaphore)
+			{
+				vkDestroySemaphore(m_device, i->waited_semaphore, NULL);
+			}
+			delete i;
+		}
+		m_free_batches.Clear();
+		m_flushed.Clear();
+		m_recording = NULL;
+
+		if (m_wait_semaphore)
+		{
+			vkDestroySemaphore(m_device, m_wait_semaphore, NULL);
+		}
+
+		vkDestroyCommandPool(m_device, m_copy_cmd_pool, NULL);
+		if (m_graphics_cmd_pool)
+		{
+			vkDestroyCommandPool(m_device, m_graphics_cmd_pool, NULL);
+		}
+
+		m_ring.reset();
+	}
+
+	VkCommandBuffer UploadQueueVulkan::AllocateCommandBuffer(VkCommandPool pool)
+	{
+		VkCommandBufferAllocateInfo cmd_info = {
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			NULL,
+			pool,
+			VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			1,
+		};
+
+		VkCommandBuffer cmd;
+		VkResult err = vkAllocateCommandBuffers(m_device, &cmd_info, &cmd);
+		assert(!err);
+
+		return cmd;
+	}
+
+	VkSemaphore UploadQueueVulkan::NewSemaphore()
+	{
+		VkSemaphoreCreateInfo semaphore_info = {
+			VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+			NULL,
+			0,
+		};
+
+		VkSemaphore semaphore;
+		VkResult err = vkCreateSemaphore(m_device, &semaphore_info, NULL, &semaphore);
+		assert(!err);
+
+		return semaphore;
+	}
+
+	void UploadQueueVulkan::Begin()
+	{
+		m_mutex.lock();
+	}
+
+	void UploadQueueVulkan::End()
+	{
+		m_mutex.unlock();
+	}
+
+	void UploadQueueVulkan::BeginBatch()
+	{
+		VkResult err;
+		Batch* batch;
+
+		if (m_free_batches.Size() > 0)
+		{
+			batch = m_free_batches[m_free_batches.Size() - 1];
+			m_free_batches.Remove(m_free_batches.Size() - 1);
+		}
+		else
+		{
+			batch = new Batch();
+			batch->copy_cmd = this->AllocateCommandBuffer(m_copy_cmd_pool);
+			batch->graphics_cmd = VK_NULL_HANDLE;
+			batch->copy_semaphore = VK_NULL_HANDLE;
+
+			// graphics commands wait copies of the batch on the other queue
+			if (this->IsTransferQueueSeparate())
+			{
+				batch->graphics_cmd = this->AllocateCommandBuffer(m_graphics_cmd_pool);
+				batch->copy_semaphore = this->NewSemaphore();
+			}
+			else
+			{
+				batch->graphics_cmd = batch->copy_cmd;
+			}
+
+			VkFenceCreateInfo fence_info;
+			Memory::Zero(&fence_info, sizeof(fence_info));
+			fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+			err = vkCreateFence(m_device, &fence_info, NULL, &batch->fence);
+			assert(!err);
+		}
+
+		batch->copy_used = false;
+		batch->graphics_used = false;
+		batch->semaphore = this->NewSemaphore();
+		batch->waited_semaphore = VK_NULL_HANDLE;
+		batch->ring_end = 0;
+		batch->ring_used = false;
+
+		VkCommandBufferBeginInfo cmd_buf_info = {
+			VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			NULL,
+			VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			NULL,
+		};
+
+		err = vkBeginCommandBuffer(batch->copy_cmd, &cmd_buf_info);
+		assert(!err);
+
+		if (batch->graphics_cmd != batch->copy_cmd)
+		{
+			err = vkBeginCommandBuffer(batch->graphics_cmd, &cmd_buf_info);
+			assert(!err);
+		}
+
+		m_recording = batch;
+	}
+
+	VkCommandBuffer UploadQueueVulkan::GetCopyCommandBuffer()
+	{
+		if (m_recording == NULL)
+		{
+			this->BeginBatch();
+		}
+		m_recording->copy_used = true;
+
+		return m_recording->copy_cmd;
+	}
+
+	VkCommandBuffer UploadQueueVulkan::GetGraphicsCommandBuffer()
+	{
+		if (m_recording == NULL)
+		{
+			this->BeginBatch();
+		}
+		m_recording->graphics_used = true;
+
+		return m_recording->graphics_cmd;
+	}
+
+	bool UploadQueueVulkan::AllocateRing(VkDeviceSize size, VkDeviceSize* offset)
+	{
+		VkDeviceSize ring_size = m_ring->GetSize();
+
+		VkDeviceSize start = (m_ring_head + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+
+		// in use range is from tail to head, positions are kept when empty,
+		// batches without staging data still in flight retire to them
+		if (m_ring_empty)
+		{
+			if (start + size > ring_size)
+			{
+				start = 0;
+			}
+		}
+		else if (m_ring_head > m_ring_tail)
+		{
+			if (start + size > ring_size)
+			{
+				if (size > m_ring_tail)
+				{
+					return false;
+				}
+				start = 0;
+			}
+		}
+		else
+		{
+			if (start + size > m_ring_tail)
+			{
+				return false;
+			}
+		}
+
+		m_ring_head = start + size;
+		m_ring_empty = false;
+		*offset = start;
+
+		return true;
+	}
+
+	void* UploadQueueVulkan::AllocateStaging(int size, VkBuffer* buffer, VkDeviceSize* offset)
+	{
+		if (m_recording == NULL)
+		{
+			this->BeginBatch();
+		}
+
+		// big images would flush the ring for every upload, they get own buffer
+		if (size > STAGING_RING_SIZE / 4)
+		{
+			auto temp = ImageBuffer::Create(size);
+			m_recording->temp_buffers.Add(temp);
+
+			*buffer = temp->GetBuffer();
+			*offset = 0;
+			return temp->GetMapped();
+		}
+
+		VkDeviceSize ring_offset;
+		while (!this->AllocateRing(size, &ring_offset))
+		{
+			// ring is full, submit what is recorded and wait the oldest batch
+			this->FlushBatch();
+			this->BeginBatch();
+			this->RetireBatches(true);
+		}
+
+		m_recording->ring_used = true;
+
+		*buffer = m_ring->GetBuffer();
+		*offset = ring_offset;
+		return (byte*) m_ring->GetMapped() + ring_offset;
+	}
+
+	void UploadQueueVulkan::FlushBatch()
+	{
+		VkResult err;
+
+		Batch* batch = m_recording;
+		if (batch == NULL)
+		{
+			return;
+		}
+		m_recording = NULL;
+
+		err = vkEndCommandBuffer(batch->copy_cmd);
+		assert(!err);
+
+		if (batch->graphics_cmd != batch->copy_cmd)
+		{
+			err = vkEndCommandBuffer(batch->graphics_cmd);
+			assert(!err);
+		}
+
+		// batches complete in order, so waiting the previous one makes this semaphore cover all uploads before
+		VkSemaphore wait_semaphore = m_wait_semaphore;
+		VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		batch->waited_semaphore = wait_semaphore;
+		m_wait_semaphore = VK_NULL_HANDLE;
+
+		VkSubmitInfo submit_info;
+		Memory::Zero(&submit_info, sizeof(submit_info));
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.pWaitDstStageMask = &wait_stage;
+
+		bool separate = this->IsTransferQueueSeparate();
+		bool graphics_submit = !separate || batch->graphics_used || !batch->copy_used;
+
+		if (separate && batch->copy_used)
+		{
+			submit_info.waitSemaphoreCount = wait_semaphore ? 1 : 0;
+			submit_info.pWaitSemaphores = &wait_semaphore;
+			submit_info.commandBufferCount = 1;
+			submit_info.pCommandBuffers = &batch->copy_cmd;
+			submit_info.signalSemaphoreCount = 1;
+			submit_info.pSignalSemaphores = graphics_submit ? &batch->copy_semaphore : &batch->semaphore;
+
+			err = vkQueueSubmit(m_transfer_queue, 1, &submit_info, graphics_submit ? VK_NULL_HANDLE : batch->fence);
+			assert(!err);
+
+			wait_semaphore = batch->copy_semaphore;
+		}
+
+		if (graphics_submit)
+		{
+			submit_info.waitSemaphoreCount = wait_semaphore ? 1 : 0;
+			submit_info.pWaitSemaphores = &wait_semaphore;
+			submit_info.commandBufferCount = (!separate || batch->graphics_used) ? 1 : 0;
+			submit_info.pCommandBuffers = &batch->graphics_cmd;
+			submit_info.signalSemaphoreCount = 1;
+			submit_info.pSignalSemaphores = &batch->semaphore;
+
+			m_graphics_queue_mutex->lock();
+			err = vkQueueSubmit(m_graphics_queue, 1, &submit_info, batch->fence);
+			m_graphics_queue_mutex->unlock();
+			assert(!err);
+		}
+
+		m_wait_semaphore = batch->semaphore;
+		batch->semaphore = VK_NULL_HANDLE;
+		batch->ring_end = m_ring_head;
+
+		m_flushed.AddLast(batch);
+	}
+
+	void UploadQueueVulkan::RetireBatches(bool wait_one)
+	{
+		while (!m_flushed.Empty())
+		{
+			Batch* batch = m_flushed.First();
+
+			if (wait_one)
+			{
+				VkResult err = vkWaitForFences(m_device, 1, &batch->fence, VK_TRUE, UINT64_MAX);
+				assert(!err);
+				wait_one = false;
+			}
+			else if (vkGetFenceStatus(m_device, batch->fence) != VK_SUCCESS)
+			{
+				break;
+			}
+
+			vkResetFences(m_device, 1, &batch->fence);
+
+			m_ring_tail = batch->ring_end;
+
+			if (batch->waited_semaphore)
+			{
+				vkDestroySemaphore(m_device, batch->waited_semaphore, NULL);
+				batch->waited_semaphore = VK_NULL_HANDLE;
+			}
+			batch->temp_buffers.Clear();
+
+			// may be retired on a loader thread, callbacks always run in main loop
+			for (const auto& i : batch->callbacks)
+			{
+				Application::RunTaskInPreLoop(RunLoop::Task(i));
+			}
+			batch->callbacks.Clear();
+
+			m_flushed.RemoveFirst();
+			m_free_batches.Add(batch);
+
+			bool ring_used = m_recording && m_recording->ring_used;
+			for (auto i : m_flushed)
+			{
+				ring_used = ring_used || i->ring_used;
+			}
+			m_ring_empty = !ring_used;
+		}
+	}
+
+	void UploadQueueVulkan::Flush()
+	{
+		m_mutex.lock();
+		this->FlushBatch();
+		m_mutex.unlock();
+	}
+
+	VkSemaphore UploadQueueVulkan::TakeWaitSemaphore()
+	{
+		m_mutex.lock();
+		VkSemaphore semaphore = m_wait_semaphore;
+		m_wait_semaphore = VK_NULL_HANDLE;
+		m_mutex.unlock();
+
+		return semaphore;
+	}
+
+	void UploadQueueVulkan::Update()
+	{
+		m_mutex.lock();
+		this->RetireBatches(false);
+		m_mutex.unlock();
+	}
+
+	void UploadQueueVulkan::WhenComplete(Action callback)
+	{
+		m_mutex.lock();
+
+		if (m_recording)
+		{
+			m_recording->callbacks.Add(callback);
+		}
+		else if (!m_flushed.Empty())
+		{
+			m_flushed.Last()->callbacks.Add(callback);
+		}
+		else
+		{
+			Application::RunTaskInPreLoop(RunLoop::Task(callback));
+		}
+
+		m_mutex.unlock();
+	}
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+* Viry3D
+* Copyright 2014-2018 by Stack - stackos@qq.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#pragma once
+
+#include "vulkan_include.h"
+#include "container/Vector.h"
+#include "container/List.h"
+#include "thread/Thread.h"
+#include "Action.h"
+
+namespace Viry3D
+{
+	class ImageBuffer;
+
+	//	batch uploads of many resources into one submit, staging data lives in a ring buffer
+	//	until the batch completed, copies run on a dedicated transfer queue when device has one
+	class UploadQueueVulkan
+	{
+	public:
+		//	transfer_queue is NULL when device has no dedicated transfer queue,
+		//	graphics_queue_mutex guards graphics queue shared with display
+		UploadQueueVulkan(VkDevice device,
+			VkQueue graphics_queue,
+			uint32_t graphics_family,
+			Mutex* graphics_queue_mutex,
+			VkQueue transfer_queue,
+			uint32_t transfer_family);
+		~UploadQueueVulkan();
+		bool IsTransferQueueSeparate() const { return m_transfer_queue != NULL; }
+		uint32_t GetGraphicsFamily() const { return m_graphics_family; }
+		uint32_t GetTransferFamily() const { return m_transfer_family; }
+		//	commands of one upload are recorded between Begin and End, batch is not submitted in between
+		void Begin();
+		void End();
+		//	for copies into images not used by any command yet, on transfer queue when separate
+		VkCommandBuffer GetCopyCommandBuffer();
+		//	for blits and for images rendering may use, runs after copy commands of the batch
+		VkCommandBuffer GetGraphicsCommandBuffer();
+		//	staging memory stays valid until the batch completed,
+		//	may submit the batch when ring is full, get command buffers again after it
+		void* AllocateStaging(int size, VkBuffer* buffer, VkDeviceSize* offset);
+		void Flush();
+		//	signaled when flushed uploads completed, next graphics submit must wait it and destroy it
+		VkSemaphore TakeWaitSemaphore();
+		//	retire completed batches, call on main thread
+		void Update();
+		//	callback runs on main thread after every upload recorded so far is resident
+		void WhenComplete(Action callback);
+
+	private:
+		struct Batch
+		{
+			VkCommandBuffer copy_cmd;
+			VkCommandBuffer graphics_cmd;
+			bool copy_used;
+			bool graphics_used;
+			VkFence fence;
+			VkSemaphore copy_semaphore;
+			VkSemaphore semaphore;
+			//	semaphore of previous batch waited by this one
+			VkSemaphore waited_semaphore;
+			VkDeviceSize ring_end;
+			bool ring_used;
+			Vector<Ref<ImageBuffer>> temp_buffers;
+			Vector<Action> callbacks;
+		};
+
+		void BeginBatch();
+		void FlushBatch();
+		void RetireBatches(bool wait_one);
+		bool AllocateRing(VkDeviceSize size, VkDeviceSize* offset);
+		VkCommandBuffer AllocateCommandBuffer(VkCommandPool pool);
+		VkSemaphore NewSemaphore();
+
+		VkDevice m_device;
+		VkQueue m_graphics_queue;
+		uint32_t m_graphics_family;
+		Mutex* m_graphics_queue_mutex;
+		VkQueue m_transfer_queue;
+		uint32_t m_transfer_family;
+		Mutex m_mutex;
+		VkCommandPool m_copy_cmd_pool;
+		VkCommandPool m_graphics_cmd_pool;
+		Batch* m_recording;
+		List<Batch*> m_flushed;
+		Vector<Batch*> m_free_batches;
+		//	latest flushed batch not waited by a submit yet
+		VkSemaphore m_wait_semaphore;
+		Ref<ImageBuffer> m_ring;
+		VkDeviceSize m_ring_head;
+		VkDeviceSize m_ring_tail;
+		bool m_ring_empty;
+	};
+}
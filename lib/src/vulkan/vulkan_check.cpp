@@ -146,6 +146,36 @@ namespace Viry3D
 		return graphics_index;
 	}
 
+	uint32_t check_transfer_queue(VkPhysicalDevice gpu)
+	{
+		uint32_t queue_count;
+		vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queue_count, NULL);
+
+		VkQueueFamilyProperties *queue_props = Memory::Alloc<VkQueueFamilyProperties>(queue_count * sizeof(VkQueueFamilyProperties));
+		vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queue_count, queue_props);
+
+		// a family with transfer only is a dma engine, copies there run beside rendering,
+		// partial image updates need texel granularity
+		uint32_t transfer_index = UINT32_MAX;
+		for (uint32_t i = 0; i < queue_count; i++)
+		{
+			const auto& props = queue_props[i];
+			if ((props.queueFlags & VK_QUEUE_TRANSFER_BIT) != 0 &&
+				(props.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0 &&
+				props.minImageTransferGranularity.width == 1 &&
+				props.minImageTransferGranularity.height == 1 &&
+				props.minImageTransferGranularity.depth == 1)
+			{
+				transfer_index = i;
+				break;
+			}
+		}
+
+		Memory::Free(queue_props);
+
+		return transfer_index;
+	}
+
 	VkSurfaceFormatKHR check_surface_format(VkPhysicalDevice gpu, VkSurfaceKHR surface)
 	{
 		VkResult err;
@@ -23,5 +23,7 @@ namespace Viry3D
 {
 	uint32_t check_instance_extensions(const char** extension_names);
 	uint32_t check_queue(VkPhysicalDevice gpu, VkSurfaceKHR surface);
+	//	UINT32_MAX when device has no dedicated transfer queue
+	uint32_t check_transfer_queue(VkPhysicalDevice gpu);
 	VkSurfaceFormatKHR check_surface_format(VkPhysicalDevice gpu, VkSurfaceKHR surface);
 }